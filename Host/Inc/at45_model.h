@@ -0,0 +1,110 @@
+/*
+ * at45_model.h
+ *
+ *  Host model of the AT45DB041E DataFlash at the SPI command level.
+ *
+ *  The model sits beneath the unchanged driver (at45db041.c, spi.c): the SPI
+ *  register model (spi_model.c) passes it the chip select edges and every byte
+ *  clocked on the bus. It keeps the 2048 pages of 264 bytes, the two SRAM buffers,
+ *  the status register (RDY, COMP, PGS, EPE) and the page size configuration,
+ *  decodes the addresses of both page sizes, and runs the program and erase
+ *  operations on the virtual clock of clock_model.c: the device stays busy for
+ *  the datasheet time and applies the result when it is over. Deep and ultra-deep
+ *  power-down, the exit timings and the loss of the buffers are modelled.
+ *
+ *  What a real device does with a command it does not accept (while busy, powered
+ *  down, or with a chip select released before the address is complete) is to
+ *  ignore it; the model does the same and counts it, so a test can check that the
+ *  driver never relies on one.
+ *
+ *  The supply can be cut at the end of the Nth buffer write, program or erase
+ *  command: a program or erase the command has started stops part way, leaving the
+ *  pages with a mix of old, new and weakly programmed bits, the SRAM buffers are
+ *  lost and the device ignores the bus until at45_model_power_up(). A handler
+ *  called at the cut lets a test stop the firmware there, like the brownout that
+ *  took the MCU down with the flash.
+ */
+
+#ifndef AT45_MODEL_H_
+#define AT45_MODEL_H_
+
+#include <stdint.h>
+
+/*Geometry*/
+#define AT45_MODEL_PAGES			2048U
+#define AT45_MODEL_PAGE_SIZE		264U		/*Physical page, 256 used in binary page size*/
+#define AT45_MODEL_BLOCK_PAGES		8U
+#define AT45_MODEL_SECTOR_PAGES		256U
+
+/*Datasheet timings (typical values) in microseconds, the driver waits for the maxima*/
+#define AT45_MODEL_T_XFR_US			200U		/*Page to buffer transfer and compare*/
+#define AT45_MODEL_T_EP_US			8000U		/*Page erase and programming*/
+#define AT45_MODEL_T_P_US			1500U		/*Page programming*/
+#define AT45_MODEL_T_PE_US			6000U		/*Page erase*/
+#define AT45_MODEL_T_BE_US			25000U		/*Block erase*/
+#define AT45_MODEL_T_SE_US			700000U		/*Sector erase*/
+#define AT45_MODEL_T_CE_US			7000000U	/*Chip erase*/
+#define AT45_MODEL_T_EDPD_US		3U			/*Chip select high to deep power-down*/
+#define AT45_MODEL_T_RDPD_US		35U			/*Resume from deep power-down*/
+#define AT45_MODEL_T_EUDPD_US		3U			/*Chip select high to ultra-deep power-down*/
+#define AT45_MODEL_T_XUDPD_US		120U		/*Exit from ultra-deep power-down*/
+#define AT45_MODEL_T_VCSL_US		70U			/*Supply up to the first chip select*/
+
+/**
+ * @brief Busy times of the operations, see at45_model_set_timing().
+ */
+typedef struct {
+	uint32_t xfr_us;
+	uint32_t ep_us;
+	uint32_t p_us;
+	uint32_t pe_us;
+	uint32_t be_us;
+	uint32_t se_us;
+	uint32_t ce_us;
+}at45_model_timing_t;
+
+/**
+ * @brief Counters of the commands the driver has issued to the model.
+ */
+typedef struct {
+	uint32_t commands;			//Chip select cycles with an opcode
+	uint32_t status_reads;
+	uint32_t array_reads;
+	uint32_t buffer_reads;
+	uint32_t buffer_writes;
+	uint32_t page_programs;		//Buffer to page, with or without built-in erase
+	uint32_t page_erases;		//Explicit, and built into the programs
+	uint32_t block_erases;
+	uint32_t sector_erases;
+	uint32_t chip_erases;
+	uint32_t transfers;			//Page to buffer transfers and compares
+	uint32_t power_downs;		//Deep and ultra-deep
+	uint32_t rejected_busy;		//Commands ignored because an operation was running
+	uint32_t rejected_asleep;	//Commands ignored in power-down or before its exit time
+	uint32_t aborted;			//Chip select released before the command was complete
+	uint32_t unsupported;
+	uint32_t failures;			//Operations that ended with EPE set
+	uint32_t power_cuts;
+	uint32_t torn;				//Program and erase operations stopped by a cut
+	uint64_t read_bytes;		//Bytes shifted out of the array and the buffers
+	uint64_t busy_us;			//Time the device spent busy
+}at45_model_stats_t;
+
+/*Function prototypes*/
+void at45_model_reset(void);
+void at45_model_set_timing(const at45_model_timing_t *timing);
+void at45_model_fail_next(void);
+void at45_model_cut_after(uint32_t commands, uint32_t tear_permille, void (*handler)(void));
+void at45_model_power_cut(uint32_t tear_permille);
+void at45_model_power_up(void);
+void at45_model_select(void);
+void at45_model_deselect(void);
+uint8_t at45_model_exchange(uint8_t mosi);
+int at45_model_busy(void);
+int at45_model_binary(void);
+uint8_t *at45_model_page(uint32_t page);
+uint32_t at45_model_wear(uint32_t page);
+void at45_model_get_stats(at45_model_stats_t *stats);
+void at45_model_clear_stats(void);
+
+#endif /* AT45_MODEL_H_ */
@@ -0,0 +1,50 @@
+/*
+ * clock_model.h
+ *
+ *  Host stand-in for the DWT cycle counter the time base runs on.
+ *
+ *  The counter is a virtual clock: it advances only when the program asks it
+ *  to, so timing logic (deadlines, timeouts, datasheet waits) runs the same
+ *  way on every run. Each read of the counter costs a configurable number of
+ *  cycles, which lets polling loops terminate, and models can advance the clock
+ *  by the time an operation takes.
+ *
+ *  The model also owns SystemCoreClock: SystemCoreClockUpdate() keeps the value
+ *  set by clock_model_set_hz(), which the RCC model (rcc_model.h) calls when the
+ *  system clock switches.
+ */
+
+#ifndef CLOCK_MODEL_H_
+#define CLOCK_MODEL_H_
+
+#include <stdint.h>
+
+/*Cycles a read of the counter costs by default, a short polling loop*/
+#define CLOCK_MODEL_POLL_CYCLES		16U
+
+/*SYSCLK after reset of the model, the HSI16 the firmware starts on*/
+#define CLOCK_MODEL_RESET_HZ		16000000U
+
+extern DWT_Type       host_dwt_regs;
+extern CoreDebug_Type host_coredebug_regs;
+
+/*Redirect the time base to the model*/
+#undef DWT
+#define DWT						(&host_dwt_regs)
+#undef CoreDebug
+#define CoreDebug				(&host_coredebug_regs)
+#define TIMEBASE_CYCCNT()		clock_model_cyccnt()
+/*An idle event loop jumps to its next timer*/
+#define EVLOOP_IDLE(us)			clock_model_advance_us(us)
+
+/*Function prototypes*/
+void clock_model_reset(void);
+void clock_model_set_hz(uint32_t hz);
+uint32_t clock_model_cyccnt(void);
+void clock_model_set_poll_cycles(uint32_t cycles);
+void clock_model_advance_cycles(uint64_t cycles);
+void clock_model_advance_us(uint64_t us);
+uint64_t clock_model_cycles(void);
+uint64_t clock_model_reads(void);
+
+#endif /* CLOCK_MODEL_H_ */
@@ -0,0 +1,69 @@
+/*
+ * flash_model.h
+ *
+ *  Host model of the STM32L4 FLASH controller and the 512KB dual bank array.
+ *
+ *  The model follows the sequences of RM0351 (3.3.7 and 3.3.8): it raises the
+ *  same SR error flags as the silicon when the driver skips a step (writes with
+ *  PG/FSTPG cleared, misaligned double-words, programming a non erased location,
+ *  a broken fast programming row, fast programming in a bank that has not been
+ *  mass erased), and it accounts every BSY wait and program
+ *  or erase operation with datasheet timings. The CPU waits for an operation at
+ *  the next BSY wait, which advances the clock of clock_model.c by the part of
+ *  the busy time that was not overlapped with other work. A read through
+ *  BL_FLASH_READ() costs LATENCY + 1 HCLK cycles per double-word it fetches, the
+ *  wait states of FLASH_ACR at the current clock (the ART data cache is not modelled).
+ */
+
+#ifndef FLASH_MODEL_H_
+#define FLASH_MODEL_H_
+
+#include <stdint.h>
+
+/*Datasheet timings (DS10198, typical values) in nanoseconds*/
+#define FLASH_MODEL_T_PROG_DWORD		81690U		/*64-bit programming*/
+#define FLASH_MODEL_T_PROG_ROW_FAST		1910000U	/*32 double-words, fast programming*/
+#define FLASH_MODEL_T_ERASE_PAGE		22020000U	/*2KB page erase*/
+#define FLASH_MODEL_T_ERASE_BANK		22020000U	/*Bank mass erase*/
+
+/**
+ * @brief Counters of the operations the driver has issued to the model.
+ */
+typedef struct flash_model_stats_ {
+	uint32_t bsy_waits;			/*Calls to the BSY wait hook*/
+	uint32_t dword_programs;	/*Standard double-word program operations*/
+	uint32_t row_programs;		/*Fast programming rows*/
+	uint32_t page_erases;
+	uint32_t bank_erases;
+	uint32_t option_programs;
+	uint32_t read_dwords;		/*Double-words fetched by BL_FLASH_READ()*/
+	uint32_t seq_errors;		/*Operations rejected with an SR error flag*/
+	uint64_t busy_ns;			/*Virtual time the controller spent busy*/
+}flash_model_stats_t;
+
+extern FLASH_TypeDef  host_flash_regs;
+extern SYSCFG_TypeDef host_syscfg_regs;
+
+/*Redirect the driver to the model*/
+#undef FLASH
+#define FLASH					(&host_flash_regs)
+#undef SYSCFG
+#define SYSCFG					(&host_syscfg_regs)
+#define BL_FLASH_WAIT_BSY()				flash_model_wait_bsy()
+#define BL_FLASH_WRITE32(addr, data)	flash_model_write32((addr), (uint32_t)(data))
+#define BL_FLASH_PTR(addr)				((const uint8_t *)flash_model_ptr(addr))
+#define BL_FLASH_READ(buf, addr, len)	flash_model_read((buf), (addr), (len))
+#define BL_FLASH_CLEAR_SR(flags)		flash_model_clear_sr(flags)
+
+/*Function prototypes*/
+void flash_model_reset(void);
+void flash_model_write32(uint32_t addr, uint32_t data);
+void flash_model_wait_bsy(void);
+uint8_t *flash_model_ptr(uint32_t addr);
+void flash_model_read(void *buf, uint32_t addr, uint32_t len);
+void flash_model_clear_sr(uint32_t flags);
+void flash_model_boot(void);
+void flash_model_get_stats(flash_model_stats_t *stats);
+void flash_model_clear_stats(void);
+
+#endif /* FLASH_MODEL_H_ */
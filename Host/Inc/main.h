@@ -0,0 +1,51 @@
+/*
+ * main.h
+ *
+ *  Host (Linux) stand-in for the firmware common header.
+ *
+ *  It pulls the same CMSIS device definitions as the target build and then
+ *  redirects the peripherals used by the drivers to RAM-backed register models,
+ *  so the files in Src/ compile unchanged with the host gcc.
+ */
+
+#ifndef HOST_MAIN_H_
+#define HOST_MAIN_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef STM32L476xx
+#define STM32L476xx
+#endif
+#include "stm32l4xx.h"
+
+/*Core intrinsics, there is no Cortex-M core underneath*/
+#define __get_PRIMASK()			(0U)
+#define __set_PRIMASK(x)		((void)(x))
+#define __disable_irq()			((void)0)
+#define __enable_irq()			((void)0)
+#undef NVIC_EnableIRQ
+#define NVIC_EnableIRQ(irq)		((void)(irq))
+#undef NVIC_DisableIRQ
+#define NVIC_DisableIRQ(irq)	((void)(irq))
+
+/*Device parameters that the target reads from the silicon*/
+#undef FLASH_SIZE
+#define FLASH_SIZE				(512U << 10U)
+
+/*Board definitions of the firmware main.h: the AT45 on SPI2, chip select on PB9*/
+#define SPI_PERIPH				SPI2
+#define GPIO_SPIx				GPIOB
+#define SPI_MODE				2U
+#define BAUDRATE				115200U
+
+/*Register models*/
+#include "flash_model.h"
+#include "clock_model.h"
+#include "spi_model.h"
+#include "rcc_model.h"
+#include "at45_model.h"
+
+#endif /* HOST_MAIN_H_ */
@@ -0,0 +1,77 @@
+/*
+ * rcc_model.h
+ *
+ *  Host model of the clock tree of the STM32L476: the RCC oscillators and system
+ *  clock switch, PWR voltage scaling, and the USART instances that
+ *  rcc_set_profile() reprograms (the SPI instances are in spi_model.h).
+ *
+ *  system_init.c polls the ready flags through RCC_WAIT_UNTIL() (system_init.h),
+ *  which steps the model first. A step applies what the driver has written since
+ *  the previous one the way the silicon does (an oscillator turned on becomes
+ *  ready, SWS follows SW once the source is ready, VOSF clears) and checks the
+ *  order of the sequence: the SYSCLK must never exceed the limit of the flash
+ *  wait states and of the voltage range, the ART (prefetch, instruction and data
+ *  caches) must be on while the core runs with wait states, the PLL may only be
+ *  configured while it is off and MSIRANGE only while the MSI is off or ready.
+ *  A step that breaks a rule is counted. Every change of the voltage range, the
+ *  flash latency, the ART and the clock selected is recorded as an event, and
+ *  SystemCoreClock follows the clock selected.
+ */
+
+#ifndef RCC_MODEL_H_
+#define RCC_MODEL_H_
+
+#include <stdint.h>
+
+#define RCC_MODEL_EVENTS		32U
+
+/**
+ * @brief Event of the clock sequence, in the order the model has seen them.
+ */
+typedef enum {
+	RCC_EV_VOS = 0,				//Voltage range changed, value is the range
+	RCC_EV_LATENCY,				//Flash wait states changed, value is the latency
+	RCC_EV_ART,					//ART changed, value is 1 when prefetch and caches are on
+	RCC_EV_SYSCLK,				//System clock switched, value is the new frequency
+}rcc_model_ev_type_t;
+
+typedef struct {
+	rcc_model_ev_type_t type;
+	uint32_t value;
+}rcc_model_ev_t;
+
+/**
+ * @brief Counters and the events since the last rcc_model_clear_stats().
+ */
+typedef struct {
+	uint32_t steps;				//Polls of a ready flag
+	uint32_t violations;		//Steps that broke a rule of the sequence
+	const char *first_violation;
+	uint32_t events;
+	rcc_model_ev_t event[RCC_MODEL_EVENTS];
+}rcc_model_stats_t;
+
+extern PWR_TypeDef   host_pwr_regs;
+extern USART_TypeDef host_usart1_regs;
+extern USART_TypeDef host_usart2_regs;
+extern USART_TypeDef host_usart3_regs;
+
+/*Redirect the drivers to the model, RCC itself is in spi_model.h*/
+#undef PWR
+#define PWR						(&host_pwr_regs)
+#undef USART1
+#define USART1					(&host_usart1_regs)
+#undef USART2
+#define USART2					(&host_usart2_regs)
+#undef USART3
+#define USART3					(&host_usart3_regs)
+#define RCC_WAIT_UNTIL(cond)	do { rcc_model_step(); } while (!(cond))
+
+/*Function prototypes*/
+void rcc_model_reset(void);
+void rcc_model_step(void);
+uint32_t rcc_model_sysclk(void);
+void rcc_model_get_stats(rcc_model_stats_t *stats);
+void rcc_model_clear_stats(void);
+
+#endif /* RCC_MODEL_H_ */
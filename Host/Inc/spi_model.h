@@ -0,0 +1,62 @@
+/*
+ * spi_model.h
+ *
+ *  Host model of the SPI2 peripheral, the GPIO port of its pins and the AT45
+ *  DataFlash on the bus.
+ *
+ *  spi.c reaches the data register and the chip select through the hooks of
+ *  spi.h, which the model takes over: a write to DR clocks one byte to the
+ *  device model (at45_model.c), advances the virtual clock by 8 SCK periods at
+ *  the prescaler in CR1 and pushes the byte the device returned to a 4 frame
+ *  RX FIFO, with the FRLVL, RXNE and OVR flags of the silicon. A write with the
+ *  RXNE interrupt enabled runs SPIx_irq_handler(), so the asynchronous transfers
+ *  complete too. While the MISO pin is not in alternate function mode the
+ *  peripheral receives 0x00. SPI1 and SPI3 are plain registers with nothing on
+ *  their buses, so the code that reprograms every SPI instance runs on the host.
+ */
+
+#ifndef SPI_MODEL_H_
+#define SPI_MODEL_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Counters of the bus traffic.
+ */
+typedef struct {
+	uint64_t bytes;				//Bytes clocked, each one is sent and received
+	uint32_t selects;			//Chip select cycles
+	uint32_t overruns;			//Bytes lost to a full RX FIFO
+	uint64_t bus_cycles;		//Virtual time spent clocking bytes
+}spi_model_stats_t;
+
+extern SPI_TypeDef  host_spi1_regs;
+extern SPI_TypeDef  host_spi2_regs;
+extern SPI_TypeDef  host_spi3_regs;
+extern GPIO_TypeDef host_gpiob_regs;
+extern RCC_TypeDef  host_rcc_regs;
+
+/*Redirect the driver to the model*/
+#undef SPI1
+#define SPI1					(&host_spi1_regs)
+#undef SPI2
+#define SPI2					(&host_spi2_regs)
+#undef SPI3
+#define SPI3					(&host_spi3_regs)
+#undef GPIOB
+#define GPIOB					(&host_gpiob_regs)
+#undef RCC
+#define RCC						(&host_rcc_regs)
+#define SPIx_DR_WRITE(sSPIx, data)	spi_model_write((sSPIx), (uint8_t)(data))
+#define SPIx_DR_READ(sSPIx)			spi_model_read(sSPIx)
+#define SPIx_CS_CHANGED(GPIOx)		spi_model_cs(GPIOx)
+
+/*Function prototypes*/
+void spi_model_reset(void);
+void spi_model_write(SPI_TypeDef *spi, uint8_t data);
+uint8_t spi_model_read(SPI_TypeDef *spi);
+void spi_model_cs(GPIO_TypeDef *gpio);
+void spi_model_get_stats(spi_model_stats_t *stats);
+void spi_model_clear_stats(void);
+
+#endif /* SPI_MODEL_H_ */
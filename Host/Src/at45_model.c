@@ -0,0 +1,774 @@
+/*
+ * at45_model.c
+ *
+ *  Host model of the AT45DB041E, see at45_model.h.
+ */
+
+#include "main.h"
+
+/*Opcodes (AT45DB041E datasheet, section 15)*/
+#define OP_READ_HF			0x0B		/*Continuous array read, one dummy byte*/
+#define OP_READ_HF2			0x1B		/*Continuous array read, two dummy bytes*/
+#define OP_READ_LF			0x03		/*Continuous array read, low frequency*/
+#define OP_READ_LP			0x01		/*Continuous array read, low power*/
+#define OP_READ_LEGACY		0xE8		/*Continuous array read, four dummy bytes*/
+#define OP_BUF1_READ_LF		0xD1
+#define OP_BUF2_READ_LF		0xD3
+#define OP_BUF1_READ		0xD4
+#define OP_BUF2_READ		0xD6
+#define OP_BUF1_WRITE		0x84
+#define OP_BUF2_WRITE		0x87
+#define OP_BUF1_PROG_ERASE	0x83
+#define OP_BUF2_PROG_ERASE	0x86
+#define OP_BUF1_PROG		0x88
+#define OP_BUF2_PROG		0x89
+#define OP_PAGE_PROG_BUF1	0x82		/*Through buffer 1, with built-in erase*/
+#define OP_PAGE_PROG_BUF2	0x85
+#define OP_BYTE_PROG		0x02		/*Through buffer 1, without built-in erase*/
+#define OP_PAGE_ERASE		0x81
+#define OP_BLOCK_ERASE		0x50
+#define OP_SECTOR_ERASE		0x7C
+#define OP_CHIP_ERASE		0xC7
+#define OP_XFR_BUF1			0x53
+#define OP_XFR_BUF2			0x55
+#define OP_CMP_BUF1			0x60
+#define OP_CMP_BUF2			0x61
+#define OP_REWRITE_BUF1		0x58
+#define OP_REWRITE_BUF2		0x59
+#define OP_STATUS			0xD7
+#define OP_ID				0x9F
+#define OP_DEEP_PD			0xB9
+#define OP_RESUME			0xAB
+#define OP_ULTRA_PD			0x79
+#define OP_CONFIG			0x3D		/*Page size and sector protection*/
+#define OP_RESET			0xF0
+
+/*Status register*/
+#define SR1_RDY				0x80
+#define SR1_COMP			0x40
+#define SR1_DENSITY			0x1C		/*0111: 4Mbit*/
+#define SR1_PGS				0x01
+#define SR2_RDY				0x80
+#define SR2_EPE				0x20
+
+typedef enum {
+	PWR_ON = 0,
+	PWR_DEEP,
+	PWR_ULTRA,
+	PWR_OFF,
+}pwr_t;
+
+/**
+ * @brief A program or erase operation, its result is applied when the busy time is over.
+ */
+typedef struct {
+	uint8_t active;
+	uint8_t erase;				//Erase the pages first
+	uint8_t fail;				//End with EPE set and the pages unchanged
+	int8_t buf;					//Buffer programmed into the pages, -1 for an erase
+	uint32_t first;
+	uint32_t pages;
+	uint16_t lo, hi;			//Byte range programmed from the buffer
+}op_t;
+
+/**
+ * @brief The command of the current chip select cycle.
+ */
+typedef struct {
+	uint8_t selected;
+	uint8_t ignored;
+	uint8_t wake_pulse;			//Chip select low while in ultra-deep power-down
+	uint8_t hdr[8];
+	uint32_t len;				//Opcode, address and dummy bytes
+	uint32_t n;					//Bytes clocked
+	uint32_t page, byte;		//Array or buffer pointer of the data phase
+	uint16_t lo, hi;			//Buffer bytes written
+}cmd_t;
+
+static uint8_t mem[AT45_MODEL_PAGES][AT45_MODEL_PAGE_SIZE];
+static uint8_t buf[2][AT45_MODEL_PAGE_SIZE];
+static uint32_t wear[AT45_MODEL_PAGES];
+static at45_model_timing_t tm;
+static at45_model_stats_t st;
+static op_t op;
+static cmd_t cmd;
+static pwr_t pwr;
+static uint64_t busy_until;		//Cycles of the virtual clock
+static uint64_t wake_at;
+static int busy_buf;
+static uint8_t pgs, epe, comp, fail_next;
+static uint32_t cut_after, cut_tear;
+static uint8_t cut_pending;
+static void (*cut_handler)(void);
+static uint32_t tear_rnd;
+
+static const at45_model_timing_t tm_default = {
+	AT45_MODEL_T_XFR_US, AT45_MODEL_T_EP_US, AT45_MODEL_T_P_US, AT45_MODEL_T_PE_US,
+	AT45_MODEL_T_BE_US, AT45_MODEL_T_SE_US, AT45_MODEL_T_CE_US,
+};
+
+
+static uint64_t now(void)
+{
+	return clock_model_cycles();
+}
+
+static uint64_t us_to_cycles(uint32_t us)
+{
+	return (uint64_t)us * (SystemCoreClock / 1000000U);
+}
+
+static uint32_t page_size(void)
+{
+	return pgs ? 256U : AT45_MODEL_PAGE_SIZE;
+}
+
+/**
+ * @brief Ends the running operation when its time is over.
+ */
+static void settle(void)
+{
+	if (!op.active || now() < busy_until) {
+		return;
+	}
+
+	for (uint32_t p = op.first; !op.fail && p < op.first + op.pages; p++) {
+		if (op.erase) {
+			memset(mem[p], 0xFF, AT45_MODEL_PAGE_SIZE);
+			wear[p]++;
+		}
+		/*Programming only clears bits*/
+		for (uint32_t i = op.lo; op.buf >= 0 && i < op.hi; i++) {
+			mem[p][i] &= buf[op.buf][i];
+		}
+	}
+
+	epe = op.fail;
+	if (op.fail) {
+		st.failures++;
+	}
+	op.active = 0;
+	busy_buf = -1;
+}
+
+static int busy(void)
+{
+	settle();
+	return now() < busy_until;
+}
+
+static void start_op(uint32_t first, uint32_t pages, int b, int erase, uint32_t lo, uint32_t hi, uint32_t us)
+{
+	op.active = 1;
+	op.first  = first;
+	op.pages  = pages;
+	op.buf    = (int8_t)b;
+	op.erase  = (uint8_t)erase;
+	op.lo     = (uint16_t)lo;
+	op.hi     = (uint16_t)hi;
+	op.fail   = fail_next;
+	fail_next = 0;
+
+	busy_buf   = b;
+	busy_until = now() + us_to_cycles(us);
+	st.busy_us += us;
+}
+
+static void start_wait(int b, uint32_t us)
+{
+	busy_buf   = b;
+	busy_until = now() + us_to_cycles(us);
+	st.busy_us += us;
+}
+
+/**
+ * @brief Bits that an interrupted operation has flipped: each one with the probability
+ * of the fraction of the operation that was done, in permille.
+ */
+static uint8_t weak_bits(uint32_t permille)
+{
+	uint8_t mask = 0;
+
+	for (uint32_t b = 0; b < 8U; b++) {
+		tear_rnd = tear_rnd * 1103515245U + 12345U;
+		if (((tear_rnd >> 16) % 1000U) < permille) {
+			mask |= (uint8_t)(1U << b);
+		}
+	}
+	return mask;
+}
+
+/**
+ * @brief Stops the running operation after a part of its work. The erase of a program
+ * with built-in erase comes first, for the share of tPE in tEP.
+ */
+static void tear(uint32_t permille)
+{
+	uint32_t erase_pm = 0;
+	uint32_t p_pm;
+
+	if (!op.active) {
+		return;
+	}
+	if (op.erase) {
+		erase_pm = (op.buf < 0) ? 1000U : (tm.pe_us * 1000U) / tm.ep_us;
+		if (erase_pm > 1000U) {
+			erase_pm = 1000U;
+		}
+	}
+
+	for (uint32_t p = op.first; p < op.first + op.pages; p++) {
+		if (op.erase) {
+			wear[p]++;
+			for (uint32_t i = 0; i < AT45_MODEL_PAGE_SIZE; i++) {
+				mem[p][i] |= (permille >= erase_pm) ? 0xFFU : weak_bits((permille * 1000U) / erase_pm);
+			}
+		}
+		if (op.buf >= 0 && permille > erase_pm) {
+			p_pm = ((permille - erase_pm) * 1000U) / (1000U - erase_pm);
+			for (uint32_t i = op.lo; i < op.hi; i++) {
+				/*Only the bits the program clears can be half done*/
+				mem[p][i] &= (uint8_t)~(mem[p][i] & ~buf[op.buf][i] & weak_bits(p_pm));
+			}
+		}
+	}
+
+	st.torn++;
+	op.active = 0;
+}
+
+/**
+ * @brief Splits the 24-bit address of the command into page and byte, for the page size.
+ */
+static void decode(uint32_t *page, uint32_t *byte)
+{
+	uint32_t a = ((uint32_t)cmd.hdr[1] << 16) | ((uint32_t)cmd.hdr[2] << 8) | cmd.hdr[3];
+
+	if (pgs) {
+		*page = (a >> 8) & (AT45_MODEL_PAGES - 1U);
+		*byte = a & 0xFFU;
+	} else {
+		*page = (a >> 9) & (AT45_MODEL_PAGES - 1U);
+		*byte = (a & 0x1FFU) % AT45_MODEL_PAGE_SIZE;
+	}
+}
+
+/**
+ * @brief Bytes before the data phase, 0 for an opcode the model does not know.
+ */
+static uint32_t header_len(uint8_t opcode)
+{
+	switch (opcode) {
+	case OP_STATUS: case OP_ID: case OP_DEEP_PD: case OP_RESUME: case OP_ULTRA_PD:
+		return 1;
+	case OP_READ_HF: case OP_BUF1_READ: case OP_BUF2_READ:
+		return 5;
+	case OP_READ_HF2:
+		return 6;
+	case OP_READ_LEGACY:
+		return 8;
+	case OP_READ_LF: case OP_READ_LP: case OP_BUF1_READ_LF: case OP_BUF2_READ_LF:
+	case OP_BUF1_WRITE: case OP_BUF2_WRITE: case OP_BUF1_PROG_ERASE: case OP_BUF2_PROG_ERASE:
+	case OP_BUF1_PROG: case OP_BUF2_PROG: case OP_PAGE_PROG_BUF1: case OP_PAGE_PROG_BUF2:
+	case OP_BYTE_PROG: case OP_PAGE_ERASE: case OP_BLOCK_ERASE: case OP_SECTOR_ERASE:
+	case OP_CHIP_ERASE: case OP_XFR_BUF1: case OP_XFR_BUF2: case OP_CMP_BUF1: case OP_CMP_BUF2:
+	case OP_REWRITE_BUF1: case OP_REWRITE_BUF2: case OP_CONFIG: case OP_RESET:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief The buffer a command reads or writes, -1 for none.
+ */
+static int cmd_buffer(uint8_t opcode)
+{
+	switch (opcode) {
+	case OP_BUF1_READ_LF: case OP_BUF1_READ: case OP_BUF1_WRITE: case OP_BYTE_PROG:
+	case OP_PAGE_PROG_BUF1: case OP_BUF1_PROG_ERASE: case OP_BUF1_PROG:
+	case OP_XFR_BUF1: case OP_CMP_BUF1: case OP_REWRITE_BUF1:
+		return 0;
+	case OP_BUF2_READ_LF: case OP_BUF2_READ: case OP_BUF2_WRITE:
+	case OP_PAGE_PROG_BUF2: case OP_BUF2_PROG_ERASE: case OP_BUF2_PROG:
+	case OP_XFR_BUF2: case OP_CMP_BUF2: case OP_REWRITE_BUF2:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+/**
+ * @brief Returns 1 for a command that writes a buffer or the array.
+ */
+static int writes(uint8_t opcode)
+{
+	switch (opcode) {
+	case OP_BUF1_WRITE: case OP_BUF2_WRITE: case OP_BUF1_PROG_ERASE: case OP_BUF2_PROG_ERASE:
+	case OP_BUF1_PROG: case OP_BUF2_PROG: case OP_PAGE_PROG_BUF1: case OP_PAGE_PROG_BUF2:
+	case OP_BYTE_PROG: case OP_PAGE_ERASE: case OP_BLOCK_ERASE: case OP_SECTOR_ERASE:
+	case OP_CHIP_ERASE: case OP_REWRITE_BUF1: case OP_REWRITE_BUF2: case OP_CONFIG:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Decides on the opcode whether the device accepts the command.
+ */
+static void begin(uint8_t opcode)
+{
+	int b = cmd_buffer(opcode);
+
+	st.commands++;
+	cmd.len = header_len(opcode);
+
+	/*Only the commands that change the device count, a cut during a read or a status
+	  poll is the same as a cut at the end of the write before it*/
+	if (cut_after && writes(opcode) && --cut_after == 0) {
+		cut_pending = 1;
+	}
+
+	if (pwr == PWR_ULTRA || now() < wake_at || (pwr == PWR_DEEP && opcode != OP_RESUME)) {
+		st.rejected_asleep++;
+		cmd.ignored = 1;
+	} else if (cmd.len == 0) {
+		st.unsupported++;
+		cmd.ignored = 1;
+	} else if (busy() && opcode != OP_STATUS &&
+			   !(b >= 0 && b != busy_buf && (opcode == OP_BUF1_WRITE || opcode == OP_BUF2_WRITE ||
+			     opcode == OP_BUF1_READ || opcode == OP_BUF2_READ ||
+			     opcode == OP_BUF1_READ_LF || opcode == OP_BUF2_READ_LF))) {
+		/*Only the status and the buffer that is not in use are accessible while busy*/
+		st.rejected_busy++;
+		cmd.ignored = 1;
+	}
+}
+
+/**
+ * @brief The address is complete: set up the data phase.
+ */
+static void header_done(uint8_t opcode)
+{
+	decode(&cmd.page, &cmd.byte);
+	cmd.lo = (uint16_t)cmd.byte;
+	cmd.hi = (uint16_t)cmd.byte;
+
+	switch (opcode) {
+	case OP_READ_HF: case OP_READ_HF2: case OP_READ_LF: case OP_READ_LP: case OP_READ_LEGACY:
+		st.array_reads++;
+		break;
+	case OP_BUF1_READ_LF: case OP_BUF2_READ_LF: case OP_BUF1_READ: case OP_BUF2_READ:
+		st.buffer_reads++;
+		break;
+	case OP_BUF1_WRITE: case OP_BUF2_WRITE:
+		st.buffer_writes++;
+		break;
+	case OP_STATUS:
+		st.status_reads++;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief One byte of the data phase.
+ * @retval The byte on MISO.
+ */
+static uint8_t data_phase(uint8_t opcode, uint8_t mosi, uint32_t idx)
+{
+	static const uint8_t id[5] = { 0x1F, 0x24, 0x00, 0x01, 0x00 };
+	int b = cmd_buffer(opcode);
+	uint8_t out = 0xFF;
+
+	switch (opcode) {
+	case OP_STATUS:
+		busy();
+		if (idx % 2U == 0) {
+			out = (uint8_t)((now() < busy_until ? 0 : SR1_RDY) | (comp ? SR1_COMP : 0) |
+							SR1_DENSITY | (pgs ? SR1_PGS : 0));
+		} else {
+			out = (uint8_t)((now() < busy_until ? 0 : SR2_RDY) | (epe ? SR2_EPE : 0));
+		}
+		break;
+
+	case OP_ID:
+		out = (idx < sizeof(id)) ? id[idx] : 0x00;
+		break;
+
+	case OP_READ_HF: case OP_READ_HF2: case OP_READ_LF: case OP_READ_LP: case OP_READ_LEGACY:
+		/*Continuous read, across the page boundaries and around the end of the array*/
+		out = mem[cmd.page][cmd.byte];
+		if (++cmd.byte == page_size()) {
+			cmd.byte = 0;
+			cmd.page = (cmd.page + 1U) % AT45_MODEL_PAGES;
+		}
+		st.read_bytes++;
+		break;
+
+	case OP_BUF1_READ_LF: case OP_BUF2_READ_LF: case OP_BUF1_READ: case OP_BUF2_READ:
+		out = buf[b][cmd.byte];
+		cmd.byte = (cmd.byte + 1U) % page_size();
+		st.read_bytes++;
+		break;
+
+	case OP_BUF1_WRITE: case OP_BUF2_WRITE: case OP_PAGE_PROG_BUF1: case OP_PAGE_PROG_BUF2:
+	case OP_BYTE_PROG:
+		/*The buffer address wraps around inside the buffer*/
+		buf[b][cmd.byte] = mosi;
+		if (cmd.byte + 1U > cmd.hi) {
+			cmd.hi = (uint16_t)(cmd.byte + 1U);
+		}
+		cmd.byte = (cmd.byte + 1U) % page_size();
+		if (cmd.byte == 0) {
+			cmd.lo = 0;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return out;
+}
+
+/**
+ * @brief The chip select went high: start the operation of the command.
+ */
+static void execute(uint8_t opcode)
+{
+	uint32_t page = cmd.page;
+	uint32_t ps = page_size();
+	int b = cmd_buffer(opcode);
+
+	switch (opcode) {
+	case OP_BUF1_PROG_ERASE: case OP_BUF2_PROG_ERASE: case OP_PAGE_PROG_BUF1: case OP_PAGE_PROG_BUF2:
+		st.page_programs++;
+		st.page_erases++;
+		start_op(page, 1, b, 1, 0, ps, tm.ep_us);
+		break;
+	case OP_BUF1_PROG: case OP_BUF2_PROG:
+		st.page_programs++;
+		start_op(page, 1, b, 0, 0, ps, tm.p_us);
+		break;
+	case OP_BYTE_PROG:
+		st.page_programs++;
+		start_op(page, 1, b, 0, cmd.lo, cmd.hi, tm.p_us);
+		break;
+	case OP_PAGE_ERASE:
+		st.page_erases++;
+		start_op(page, 1, -1, 1, 0, 0, tm.pe_us);
+		break;
+	case OP_BLOCK_ERASE:
+		st.block_erases++;
+		start_op(page & ~(AT45_MODEL_BLOCK_PAGES - 1U), AT45_MODEL_BLOCK_PAGES, -1, 1, 0, 0, tm.be_us);
+		break;
+	case OP_SECTOR_ERASE:
+		/*Sector 0 is split in 0a (block 0) and 0b (the rest of the first 256 pages)*/
+		st.sector_erases++;
+		if (page < AT45_MODEL_SECTOR_PAGES) {
+			if (page < AT45_MODEL_BLOCK_PAGES) {
+				start_op(0, AT45_MODEL_BLOCK_PAGES, -1, 1, 0, 0, tm.se_us);
+			} else {
+				start_op(AT45_MODEL_BLOCK_PAGES, AT45_MODEL_SECTOR_PAGES - AT45_MODEL_BLOCK_PAGES,
+						 -1, 1, 0, 0, tm.se_us);
+			}
+		} else {
+			start_op(page & ~(AT45_MODEL_SECTOR_PAGES - 1U), AT45_MODEL_SECTOR_PAGES, -1, 1, 0, 0, tm.se_us);
+		}
+		break;
+	case OP_CHIP_ERASE:
+		if (cmd.hdr[1] == 0x94 && cmd.hdr[2] == 0x80 && cmd.hdr[3] == 0x9A) {
+			st.chip_erases++;
+			start_op(0, AT45_MODEL_PAGES, -1, 1, 0, 0, tm.ce_us);
+		} else {
+			st.unsupported++;
+		}
+		break;
+	case OP_XFR_BUF1: case OP_XFR_BUF2:
+		st.transfers++;
+		memcpy(buf[b], mem[page], AT45_MODEL_PAGE_SIZE);
+		start_wait(b, tm.xfr_us);
+		break;
+	case OP_CMP_BUF1: case OP_CMP_BUF2:
+		st.transfers++;
+		comp = (memcmp(buf[b], mem[page], ps) != 0);
+		start_wait(b, tm.xfr_us);
+		break;
+	case OP_REWRITE_BUF1: case OP_REWRITE_BUF2:
+		/*The page goes through the buffer and is programmed back*/
+		st.transfers++;
+		st.page_programs++;
+		st.page_erases++;
+		memcpy(buf[b], mem[page], AT45_MODEL_PAGE_SIZE);
+		start_op(page, 1, b, 1, 0, AT45_MODEL_PAGE_SIZE, tm.ep_us);
+		break;
+	case OP_DEEP_PD:
+		st.power_downs++;
+		pwr = PWR_DEEP;
+		wake_at = now() + us_to_cycles(AT45_MODEL_T_EDPD_US);
+		break;
+	case OP_RESUME:
+		if (pwr == PWR_DEEP) {
+			pwr = PWR_ON;
+			wake_at = now() + us_to_cycles(AT45_MODEL_T_RDPD_US);
+		}
+		break;
+	case OP_ULTRA_PD:
+		/*The buffers are not powered*/
+		st.power_downs++;
+		pwr = PWR_ULTRA;
+		memset(buf, 0x00, sizeof(buf));
+		wake_at = now() + us_to_cycles(AT45_MODEL_T_EUDPD_US);
+		break;
+	case OP_CONFIG:
+		if (cmd.hdr[1] == 0x2A && cmd.hdr[2] == 0x80 && (cmd.hdr[3] == 0xA6 || cmd.hdr[3] == 0xA7)) {
+			/*The page size is a nonvolatile bit, programmed like a page*/
+			pgs = (cmd.hdr[3] == 0xA6);
+			start_wait(-1, tm.p_us);
+		} else if (cmd.hdr[1] != 0x2A || cmd.hdr[2] != 0x7F) {
+			st.unsupported++;
+		}
+		break;
+	case OP_RESET:
+		/*Terminates the running operation, the pages it was writing are left undefined*/
+		if (cmd.hdr[1] == 0 && cmd.hdr[2] == 0 && cmd.hdr[3] == 0) {
+			op.active = 0;
+			busy_buf = -1;
+			busy_until = now();
+		} else {
+			st.unsupported++;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Restores a new device: erased array, DataFlash (264 bytes) page size as
+ * shipped, typical timings, counters cleared.
+ */
+void at45_model_reset(void)
+{
+	memset(mem, 0xFF, sizeof(mem));
+	memset(buf, 0xFF, sizeof(buf));
+	memset(wear, 0, sizeof(wear));
+	memset(&op, 0, sizeof(op));
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&st, 0, sizeof(st));
+	tm          = tm_default;
+	pwr         = PWR_ON;
+	busy_until  = 0;
+	wake_at     = 0;
+	busy_buf    = -1;
+	pgs         = 0;
+	epe         = 0;
+	comp        = 0;
+	fail_next   = 0;
+	cut_after   = 0;
+	cut_pending = 0;
+	cut_handler = NULL;
+	tear_rnd    = 1;
+}
+
+/**
+ * @brief Replaces the busy times, for example with the maxima of the datasheet.
+ */
+void at45_model_set_timing(const at45_model_timing_t *timing)
+{
+	tm = *timing;
+}
+
+/**
+ * @brief The next program or erase operation fails: EPE is set and the pages keep their data.
+ */
+void at45_model_fail_next(void)
+{
+	fail_next = 1;
+}
+
+/**
+ * @brief Arms a power cut at the chip select of a later command.
+ * @param commands : The cut happens when the chip select rises at the end of the
+ * commands-th buffer write, program or erase command from now. 0 disarms.
+ * @param tear_permille : Part of a running operation done at the cut, see at45_model_power_cut().
+ * @param handler : Called after the cut, NULL for none. It may not return (longjmp).
+ */
+void at45_model_cut_after(uint32_t commands, uint32_t tear_permille, void (*handler)(void))
+{
+	cut_after   = commands;
+	cut_pending = 0;
+	cut_tear    = tear_permille;
+	cut_handler = handler;
+}
+
+/**
+ * @brief Cuts the supply now. A running program or erase stops with tear_permille/1000
+ * of its work done, the buffers are lost, the device ignores the bus until power-up.
+ */
+void at45_model_power_cut(uint32_t tear_permille)
+{
+	if (op.active && now() < busy_until) {
+		tear(tear_permille);
+	} else {
+		settle();
+	}
+
+	st.power_cuts++;
+	pwr        = PWR_OFF;
+	op.active  = 0;
+	busy_buf   = -1;
+	busy_until = now();
+	memset(&cmd, 0, sizeof(cmd));
+}
+
+/**
+ * @brief The supply is back: status cleared, buffers undefined (0x00 here), the page
+ * size kept (nonvolatile). The device accepts commands after tVCSL.
+ */
+void at45_model_power_up(void)
+{
+	memset(buf, 0x00, sizeof(buf));
+	memset(&cmd, 0, sizeof(cmd));
+	pwr     = PWR_ON;
+	epe     = 0;
+	comp    = 0;
+	wake_at = now() + us_to_cycles(AT45_MODEL_T_VCSL_US);
+}
+
+/**
+ * @brief Chip select falling edge.
+ */
+void at45_model_select(void)
+{
+	memset(&cmd, 0, sizeof(cmd));
+
+	if (pwr == PWR_OFF) {
+		return;
+	}
+	cmd.selected = 1;
+
+	if (pwr == PWR_ULTRA && now() >= wake_at) {
+		cmd.wake_pulse = 1;
+	}
+}
+
+/**
+ * @brief Chip select rising edge, most program and erase commands start on it.
+ */
+void at45_model_deselect(void)
+{
+	uint8_t opcode = cmd.hdr[0];
+
+	if (!cmd.selected) {
+		return;
+	}
+	cmd.selected = 0;
+
+	if (cmd.wake_pulse) {
+		pwr = PWR_ON;
+		wake_at = now() + us_to_cycles(AT45_MODEL_T_XUDPD_US);
+		return;
+	}
+	if (cmd.n != 0 && !cmd.ignored) {
+		if (cmd.n < cmd.len) {
+			st.aborted++;
+		} else {
+			execute(opcode);
+		}
+	}
+
+	/*The armed cut: the program or erase this command has started is torn*/
+	if (cut_pending) {
+		cut_pending = 0;
+		at45_model_power_cut(cut_tear);
+		if (cut_handler) {
+			cut_handler();
+		}
+	}
+}
+
+/**
+ * @brief Clocks one byte.
+ * @param mosi : The byte the master sends.
+ * @retval The byte the device drives on MISO, 0xFF while it does not drive it.
+ */
+uint8_t at45_model_exchange(uint8_t mosi)
+{
+	uint32_t idx;
+
+	if (!cmd.selected || cmd.wake_pulse) {
+		return 0xFF;
+	}
+
+	idx = cmd.n++;
+	if (idx == 0) {
+		cmd.hdr[0] = mosi;
+		begin(mosi);
+		if (!cmd.ignored && cmd.len == 1) {
+			header_done(mosi);
+		}
+		return 0xFF;
+	}
+	if (cmd.ignored) {
+		return 0xFF;
+	}
+	if (idx < cmd.len) {
+		cmd.hdr[idx] = mosi;
+		if (idx == cmd.len - 1U) {
+			header_done(cmd.hdr[0]);
+		}
+		return 0xFF;
+	}
+
+	return data_phase(cmd.hdr[0], mosi, idx - cmd.len);
+}
+
+/**
+ * @brief Returns 1 while a program, erase or transfer runs.
+ */
+int at45_model_busy(void)
+{
+	return busy();
+}
+
+/**
+ * @brief Returns 1 when the device is configured for the binary (256 bytes) page size.
+ */
+int at45_model_binary(void)
+{
+	return pgs;
+}
+
+/**
+ * @brief Direct access to a page of the array (AT45_MODEL_PAGE_SIZE bytes), to preload
+ * or verify the content. A running operation is applied first if its time is over.
+ */
+uint8_t *at45_model_page(uint32_t page)
+{
+	settle();
+	return mem[page % AT45_MODEL_PAGES];
+}
+
+/**
+ * @brief Returns the number of erases of a page.
+ */
+uint32_t at45_model_wear(uint32_t page)
+{
+	settle();
+	return wear[page % AT45_MODEL_PAGES];
+}
+
+void at45_model_get_stats(at45_model_stats_t *stats)
+{
+	settle();
+	*stats = st;
+}
+
+void at45_model_clear_stats(void)
+{
+	memset(&st, 0, sizeof(st));
+}
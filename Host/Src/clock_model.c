@@ -0,0 +1,84 @@
+/*
+ * clock_model.c
+ *
+ *  Host stand-in for the DWT cycle counter, see clock_model.h.
+ */
+
+#include "main.h"
+
+DWT_Type       host_dwt_regs;
+CoreDebug_Type host_coredebug_regs;
+uint32_t       SystemCoreClock = CLOCK_MODEL_RESET_HZ;
+
+/*Virtual time in cycles since reset, it runs whether CYCCNT is enabled or not*/
+static uint64_t clock_cycles;
+static uint64_t clock_reads;
+static uint32_t clock_poll_cycles = CLOCK_MODEL_POLL_CYCLES;
+
+
+/**
+ * @brief Advances the virtual time, and CYCCNT if the firmware has enabled it.
+ * Writes of the firmware to DWT->CYCCNT are kept, the counter continues from them.
+ */
+static void clock_model_tick(uint64_t cycles)
+{
+	clock_cycles += cycles;
+
+	if (READ_BIT(host_dwt_regs.CTRL, DWT_CTRL_CYCCNTENA_Msk) &&
+		READ_BIT(host_coredebug_regs.DEMCR, CoreDebug_DEMCR_TRCENA_Msk)) {
+		host_dwt_regs.CYCCNT += (uint32_t)cycles;
+	}
+}
+
+void clock_model_reset(void)
+{
+	memset(&host_dwt_regs, 0, sizeof(host_dwt_regs));
+	memset(&host_coredebug_regs, 0, sizeof(host_coredebug_regs));
+	SystemCoreClock   = CLOCK_MODEL_RESET_HZ;
+	clock_cycles      = 0;
+	clock_reads       = 0;
+	clock_poll_cycles = CLOCK_MODEL_POLL_CYCLES;
+}
+
+void clock_model_set_hz(uint32_t hz)
+{
+	SystemCoreClock = hz;
+}
+
+void SystemCoreClockUpdate(void)
+{
+	/*Nothing to read back, SystemCoreClock is set by clock_model_set_hz()*/
+}
+
+uint32_t clock_model_cyccnt(void)
+{
+	clock_model_tick(clock_poll_cycles);
+	clock_reads++;
+
+	return host_dwt_regs.CYCCNT;
+}
+
+void clock_model_set_poll_cycles(uint32_t cycles)
+{
+	clock_poll_cycles = cycles;
+}
+
+void clock_model_advance_cycles(uint64_t cycles)
+{
+	clock_model_tick(cycles);
+}
+
+void clock_model_advance_us(uint64_t us)
+{
+	clock_model_tick(us * (SystemCoreClock / 1000000U));
+}
+
+uint64_t clock_model_cycles(void)
+{
+	return clock_cycles;
+}
+
+uint64_t clock_model_reads(void)
+{
+	return clock_reads;
+}
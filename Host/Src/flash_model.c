@@ -0,0 +1,346 @@
+/*
+ * flash_model.c
+ *
+ *  Host model of the STM32L4 FLASH controller, see flash_model.h.
+ */
+
+#include "flash.h"
+
+#define MODEL_SIZE			FLASH_SIZE
+#define MODEL_BANK_SIZE		(FLASH_SIZE >> 1U)
+#define MODEL_KEY1			0x45670123U
+#define MODEL_KEY2			0xCDEF89ABU
+#define MODEL_OPTKEY2		0x4C5D6E7FU
+
+FLASH_TypeDef  host_flash_regs;
+SYSCFG_TypeDef host_syscfg_regs;
+
+/*Physical array, bank 1 followed by bank 2*/
+static uint8_t flash_mem[MODEL_SIZE];
+
+/*Double-word being assembled in standard programming*/
+static uint32_t pg_words;
+static uint32_t pg_addr;
+static uint32_t pg_low;
+
+/*Row being assembled in fast programming*/
+static uint32_t fst_words;
+static uint32_t fst_addr;
+static uint32_t fst_row[FLASH_ROW_DWORDS*2];
+
+/*Physical banks mass erased, with no page erase since: fast programming is only
+  allowed in them*/
+static uint8_t mass_erased[2];
+
+static flash_model_stats_t stats;
+
+/*Busy time not yet waited for, and the virtual time of the last BSY wait*/
+static uint64_t pending_ns;
+static uint64_t last_wait;
+
+
+/**
+ * @brief Maps a CPU address to an offset inside the physical array, taking the
+ * bank swap of SYSCFG_MEMRMP into account.
+ * @retval The offset, or -1 if the address is not part of the main array.
+ */
+static int32_t flash_model_offset(uint32_t addr)
+{
+	uint32_t off;
+
+	if (addr < FLASH_BASE || addr >= (FLASH_BASE + MODEL_SIZE)) {
+		return -1;
+	}
+
+	off = addr - FLASH_BASE;
+	if (READ_BIT(host_syscfg_regs.MEMRMP, SYSCFG_MEMRMP_FB_MODE)) {
+		off ^= MODEL_BANK_SIZE;
+	}
+
+	return (int32_t)off;
+}
+
+/**
+ * @brief Accounts the busy time of an operation, the CPU waits for it at the next BSY wait.
+ */
+static void flash_model_busy(uint64_t ns)
+{
+	stats.busy_ns += ns;
+	pending_ns += ns;
+}
+
+/**
+ * @brief Raises an SR error flag and drops any partially assembled operation.
+ */
+static void flash_model_error(uint32_t flag)
+{
+	SET_BIT(host_flash_regs.SR, flag);
+	pg_words  = 0;
+	fst_words = 0;
+	stats.seq_errors++;
+}
+
+/**
+ * @brief Applies the KEYR unlock sequence. The driver writes both keys back to back,
+ * so the second key being the last value written is enough to model it.
+ */
+static void flash_model_sync_keys(void)
+{
+	if (READ_BIT(host_flash_regs.CR, FLASH_CR_LOCK) && host_flash_regs.KEYR == MODEL_KEY2) {
+		CLEAR_BIT(host_flash_regs.CR, FLASH_CR_LOCK);
+	}
+	host_flash_regs.KEYR = 0;
+
+	if (READ_BIT(host_flash_regs.CR, FLASH_CR_OPTLOCK) && !READ_BIT(host_flash_regs.CR, FLASH_CR_LOCK) &&
+		host_flash_regs.OPTKEYR == MODEL_OPTKEY2) {
+		CLEAR_BIT(host_flash_regs.CR, FLASH_CR_OPTLOCK);
+	}
+	host_flash_regs.OPTKEYR = 0;
+}
+
+static int flash_model_is_erased(uint32_t off, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++) {
+		if (flash_mem[off + i] != 0xFF) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Reset the array to the erased state and the registers to their reset values.
+ */
+void flash_model_reset(void)
+{
+	memset(flash_mem, 0xFF, sizeof(flash_mem));
+	memset(&host_flash_regs, 0, sizeof(host_flash_regs));
+	memset(&host_syscfg_regs, 0, sizeof(host_syscfg_regs));
+	host_flash_regs.CR = FLASH_CR_LOCK | FLASH_CR_OPTLOCK;
+	host_flash_regs.OPTR = FLASH_OPTR_DUALBANK;
+	pg_words   = 0;
+	fst_words  = 0;
+	mass_erased[0] = 0;
+	mass_erased[1] = 0;
+	pending_ns = 0;
+	last_wait  = clock_model_cycles();
+	flash_model_clear_stats();
+}
+
+/**
+ * @brief A 32-bit store from the CPU into the flash array.
+ */
+void flash_model_write32(uint32_t addr, uint32_t data)
+{
+	int32_t off = flash_model_offset(addr);
+	uint32_t cr;
+	uint64_t dword;
+
+	flash_model_sync_keys();
+	cr = host_flash_regs.CR;
+
+	/*A store needs an unlocked controller, exactly one programming mode and a clean SR*/
+	if (off < 0 || READ_BIT(cr, FLASH_CR_LOCK) ||
+		(READ_BIT(cr, FLASH_CR_PG) != 0) == (READ_BIT(cr, FLASH_CR_FSTPG) != 0) ||
+		READ_BIT(host_flash_regs.SR, FLASH_SR_ERRORS)) {
+		flash_model_error(FLASH_SR_PGSERR);
+		return;
+	}
+
+	if (READ_BIT(cr, FLASH_CR_PG)) {
+		if (pg_words == 0) {
+			/*First word, must open a double-word*/
+			if (addr % 8) {
+				flash_model_error(FLASH_SR_PGAERR);
+				return;
+			}
+			pg_addr  = addr;
+			pg_low   = data;
+			pg_words = 1;
+			return;
+		}
+
+		/*Second word, must complete the same double-word*/
+		pg_words = 0;
+		if (addr != pg_addr + 4) {
+			flash_model_error(FLASH_SR_PGAERR);
+			return;
+		}
+
+		dword = ((uint64_t)data << 32) | pg_low;
+		off = flash_model_offset(pg_addr);
+		if (dword != 0 && !flash_model_is_erased(off, 8)) {
+			flash_model_error(FLASH_SR_PROGERR);
+			return;
+		}
+
+		memcpy(&flash_mem[off], &dword, 8);
+		stats.dword_programs++;
+		flash_model_busy(FLASH_MODEL_T_PROG_DWORD);
+		return;
+	}
+
+	/*Fast programming, 64 successive words of one row*/
+	if (fst_words == 0) {
+		if (addr % FLASH_ROW_SIZE) {
+			flash_model_error(FLASH_SR_PGAERR);
+			return;
+		}
+		if (!mass_erased[(uint32_t)off / MODEL_BANK_SIZE]) {
+			flash_model_error(FLASH_SR_PGSERR);
+			return;
+		}
+		if (!flash_model_is_erased(off, FLASH_ROW_SIZE)) {
+			flash_model_error(FLASH_SR_PROGERR);
+			return;
+		}
+		fst_addr = addr;
+	} else if (addr != fst_addr + fst_words*4) {
+		flash_model_error(FLASH_SR_MISERR);
+		return;
+	}
+
+	fst_row[fst_words++] = data;
+	if (fst_words == FLASH_ROW_DWORDS*2) {
+		memcpy(&flash_mem[flash_model_offset(fst_addr)], fst_row, FLASH_ROW_SIZE);
+		fst_words = 0;
+		stats.row_programs++;
+		flash_model_busy(FLASH_MODEL_T_PROG_ROW_FAST);
+	}
+}
+
+/**
+ * @brief The driver polls BSY. Any operation started by STRT completes here.
+ */
+void flash_model_wait_bsy(void)
+{
+	uint32_t cr;
+	uint32_t page;
+	uint64_t elapsed_ns;
+
+	stats.bsy_waits++;
+	flash_model_sync_keys();
+	cr = host_flash_regs.CR;
+
+	/*A fast programming row that stalls before its last word is lost*/
+	if (fst_words && fst_words != FLASH_ROW_DWORDS*2 && READ_BIT(cr, FLASH_CR_FSTPG)) {
+		flash_model_error(FLASH_SR_MISERR);
+	}
+
+	if (READ_BIT(cr, FLASH_CR_STRT)) {
+		if (READ_BIT(cr, FLASH_CR_LOCK) || READ_BIT(host_flash_regs.SR, FLASH_SR_ERRORS)) {
+			flash_model_error(FLASH_SR_PGSERR);
+		} else if (READ_BIT(cr, FLASH_CR_PER)) {
+			page = READ_BIT(cr, FLASH_CR_PNB) >> FLASH_CR_PNB_Pos;
+			memset(&flash_mem[(READ_BIT(cr, FLASH_CR_BKER) ? MODEL_BANK_SIZE : 0) + page*FLASH_PAGE_SIZE],
+				   0xFF, FLASH_PAGE_SIZE);
+			mass_erased[READ_BIT(cr, FLASH_CR_BKER) ? 1 : 0] = 0;
+			stats.page_erases++;
+			flash_model_busy(FLASH_MODEL_T_ERASE_PAGE);
+		} else if (READ_BIT(cr, FLASH_CR_MER1 | FLASH_CR_MER2)) {
+			if (READ_BIT(cr, FLASH_CR_MER1)) {
+				memset(&flash_mem[0], 0xFF, MODEL_BANK_SIZE);
+				mass_erased[0] = 1;
+				stats.bank_erases++;
+			}
+			if (READ_BIT(cr, FLASH_CR_MER2)) {
+				memset(&flash_mem[MODEL_BANK_SIZE], 0xFF, MODEL_BANK_SIZE);
+				mass_erased[1] = 1;
+				stats.bank_erases++;
+			}
+			flash_model_busy(FLASH_MODEL_T_ERASE_BANK);
+		} else {
+			flash_model_error(FLASH_SR_PGSERR);
+		}
+
+		/*STRT is cleared by hardware at the end of the operation*/
+		CLEAR_BIT(host_flash_regs.CR, FLASH_CR_STRT);
+	}
+
+	if (READ_BIT(cr, FLASH_CR_OPTSTRT)) {
+		if (READ_BIT(cr, FLASH_CR_OPTLOCK)) {
+			flash_model_error(FLASH_SR_PGSERR);
+		} else {
+			stats.option_programs++;
+			flash_model_busy(FLASH_MODEL_T_ERASE_PAGE);
+		}
+		CLEAR_BIT(host_flash_regs.CR, FLASH_CR_OPTSTRT);
+	}
+
+	CLEAR_BIT(host_flash_regs.SR, FLASH_SR_BSY);
+
+	/*The operation has been running since the previous wait (an erase started with
+	  bl_flash_page_erase_start), the CPU only waits for the rest of it*/
+	elapsed_ns = ((clock_model_cycles() - last_wait) * 1000U) / (SystemCoreClock / 1000000U);
+	if (pending_ns > elapsed_ns) {
+		clock_model_advance_cycles(((pending_ns - elapsed_ns) * (SystemCoreClock / 1000000U)) / 1000U);
+	}
+	pending_ns = 0;
+	last_wait  = clock_model_cycles();
+}
+
+/**
+ * @brief Direct access to the array, for checking what has been programmed.
+ */
+uint8_t *flash_model_ptr(uint32_t addr)
+{
+	int32_t off = flash_model_offset(addr);
+
+	return (off < 0) ? NULL : &flash_mem[off];
+}
+
+/**
+ * @brief A memory mapped read: the CPU stalls for the wait states of every double-word
+ * of the array it fetches.
+ */
+void flash_model_read(void *buf, uint32_t addr, uint32_t len)
+{
+	uint32_t latency = READ_BIT(host_flash_regs.ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos;
+	uint32_t dwords;
+
+	if (len == 0) {
+		return;
+	}
+
+	memcpy(buf, flash_model_ptr(addr), len);
+	dwords = ((addr + len - 1U) >> 3) - (addr >> 3) + 1U;
+	stats.read_dwords += dwords;
+	clock_model_advance_cycles((uint64_t)dwords * (latency + 1U));
+}
+
+/**
+ * @brief A write to SR: the error flags and EOP are cleared by writing 1.
+ */
+void flash_model_clear_sr(uint32_t flags)
+{
+	CLEAR_BIT(host_flash_regs.SR, flags & (FLASH_SR_ERRORS | FLASH_SR_EOP));
+}
+
+/**
+ * @brief Models the reset that follows OBL_LAUNCH or a power cycle: the registers go
+ * back to their reset values and BFB2 selects which bank is mapped at FLASH_BASE.
+ */
+void flash_model_boot(void)
+{
+	uint32_t optr = host_flash_regs.OPTR;
+
+	memset(&host_flash_regs, 0, sizeof(host_flash_regs));
+	host_flash_regs.CR   = FLASH_CR_LOCK | FLASH_CR_OPTLOCK;
+	host_flash_regs.OPTR = optr;
+	MODIFY_REG(host_syscfg_regs.MEMRMP, SYSCFG_MEMRMP_FB_MODE,
+			   READ_BIT(optr, FLASH_OPTR_BFB2) ? SYSCFG_MEMRMP_FB_MODE : 0);
+	pg_words  = 0;
+	fst_words = 0;
+	mass_erased[0] = 0;
+	mass_erased[1] = 0;
+}
+
+void flash_model_get_stats(flash_model_stats_t *out)
+{
+	*out = stats;
+}
+
+void flash_model_clear_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
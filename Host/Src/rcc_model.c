@@ -0,0 +1,227 @@
+/*
+ * rcc_model.c
+ *
+ *  Host model of the RCC clock tree and PWR voltage scaling, see rcc_model.h.
+ */
+
+#include "main.h"
+
+#define RCC_MODEL_HSI_HZ		16000000U
+#define RCC_MODEL_WS_STEP_HZ	16000000U	/*Range 1, RM0351 table 11*/
+#define RCC_MODEL_RANGE2_HZ		26000000U
+#define RCC_MODEL_VCO_MIN_HZ	64000000U
+#define RCC_MODEL_VCO_MAX_HZ	344000000U
+#define RCC_MODEL_PLL_MAX_HZ	80000000U
+#define RCC_MODEL_ART			(FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN)
+
+PWR_TypeDef   host_pwr_regs;
+USART_TypeDef host_usart1_regs;
+USART_TypeDef host_usart2_regs;
+USART_TypeDef host_usart3_regs;
+
+/*MSI frequency of each MSIRANGE value*/
+static const uint32_t msi_hz[12] = {
+	100000U, 200000U, 400000U, 800000U, 1000000U, 2000000U,
+	4000000U, 8000000U, 16000000U, 24000000U, 32000000U, 48000000U
+};
+
+/*Registers at the previous step*/
+static uint32_t prev_cr;
+static uint32_t prev_pllcfgr;
+static uint32_t prev_vos;
+static uint32_t prev_latency;
+static uint32_t prev_art;
+static uint32_t prev_hz;
+
+static rcc_model_stats_t stats;
+
+
+static void rcc_model_event(rcc_model_ev_type_t type, uint32_t value)
+{
+	if (stats.events < RCC_MODEL_EVENTS) {
+		stats.event[stats.events].type  = type;
+		stats.event[stats.events].value = value;
+	}
+	stats.events++;
+}
+
+static void rcc_model_violation(const char *rule)
+{
+	if (stats.violations++ == 0) {
+		stats.first_violation = rule;
+	}
+}
+
+static uint32_t rcc_model_msi(void)
+{
+	uint32_t range;
+
+	if (READ_BIT(host_rcc_regs.CR, RCC_CR_MSIRGSEL)) {
+		range = READ_BIT(host_rcc_regs.CR, RCC_CR_MSIRANGE) >> RCC_CR_MSIRANGE_Pos;
+	} else {
+		range = READ_BIT(host_rcc_regs.CSR, RCC_CSR_MSISRANGE) >> RCC_CSR_MSISRANGE_Pos;
+	}
+
+	return (range < 12U) ? msi_hz[range] : 0U;
+}
+
+/**
+ * @brief Output R of the PLL, 0 if the configuration is out of the limits of the part.
+ */
+static uint32_t rcc_model_pll(void)
+{
+	uint32_t cfg = host_rcc_regs.PLLCFGR;
+	uint32_t src = READ_BIT(cfg, RCC_PLLCFGR_PLLSRC);
+	uint32_t m = (READ_BIT(cfg, RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos) + 1U;
+	uint32_t n = READ_BIT(cfg, RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+	uint32_t r = ((READ_BIT(cfg, RCC_PLLCFGR_PLLR) >> RCC_PLLCFGR_PLLR_Pos) + 1U) * 2U;
+	uint64_t vco;
+	uint32_t in;
+
+	if (src == RCC_PLLCFGR_PLLSRC_HSI) {
+		in = RCC_MODEL_HSI_HZ;
+	} else if (src == RCC_PLLCFGR_PLLSRC_MSI) {
+		in = rcc_model_msi();
+	} else {
+		in = 0;		/*No HSE on the board*/
+	}
+
+	vco = (uint64_t)in / m * n;
+	if (!READ_BIT(cfg, RCC_PLLCFGR_PLLREN) || n < 8U || vco < RCC_MODEL_VCO_MIN_HZ ||
+		vco > RCC_MODEL_VCO_MAX_HZ || vco / r > RCC_MODEL_PLL_MAX_HZ) {
+		return 0;
+	}
+
+	return (uint32_t)(vco / r);
+}
+
+/**
+ * @brief Reset values of the clock tree: MSI at 4MHz is the system clock, range 1.
+ */
+void rcc_model_reset(void)
+{
+	memset(&host_rcc_regs, 0, sizeof(host_rcc_regs));
+	memset(&host_pwr_regs, 0, sizeof(host_pwr_regs));
+	memset(&host_usart1_regs, 0, sizeof(host_usart1_regs));
+	memset(&host_usart2_regs, 0, sizeof(host_usart2_regs));
+	memset(&host_usart3_regs, 0, sizeof(host_usart3_regs));
+
+	host_rcc_regs.CR  = RCC_CR_MSION | RCC_CR_MSIRDY | RCC_CR_MSIRANGE_6;
+	host_rcc_regs.CSR = RCC_CSR_MSISRANGE_2;	/*4MHz after standby*/
+	host_rcc_regs.PLLCFGR = 0x00001000U;		/*N = 16*/
+	host_pwr_regs.CR1 = PWR_CR1_VOS_0;
+
+	/*The USARTs are idle, their last frame has left*/
+	host_usart1_regs.ISR = USART_ISR_TC | USART_ISR_TXE;
+	host_usart2_regs.ISR = USART_ISR_TC | USART_ISR_TXE;
+	host_usart3_regs.ISR = USART_ISR_TC | USART_ISR_TXE;
+
+	prev_cr      = host_rcc_regs.CR;
+	prev_pllcfgr = host_rcc_regs.PLLCFGR;
+	prev_vos     = 1U;
+	prev_latency = READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos;
+	prev_art     = (READ_BIT(FLASH->ACR, RCC_MODEL_ART) == RCC_MODEL_ART);
+	prev_hz      = rcc_model_sysclk();
+	clock_model_set_hz(prev_hz);
+	rcc_model_clear_stats();
+}
+
+/**
+ * @brief The SYSCLK frequency of the source the switch status selects.
+ */
+uint32_t rcc_model_sysclk(void)
+{
+	switch (READ_BIT(host_rcc_regs.CFGR, RCC_CFGR_SWS)) {
+	case RCC_CFGR_SWS_MSI:
+		return rcc_model_msi();
+	case RCC_CFGR_SWS_HSI:
+		return RCC_MODEL_HSI_HZ;
+	case RCC_CFGR_SWS_PLL:
+		return rcc_model_pll();
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Applies the writes since the previous poll and checks the sequence.
+ */
+void rcc_model_step(void)
+{
+	uint32_t cr = host_rcc_regs.CR;
+	uint32_t sw = READ_BIT(host_rcc_regs.CFGR, RCC_CFGR_SW) >> RCC_CFGR_SW_Pos;
+	uint32_t vos = READ_BIT(host_pwr_regs.CR1, PWR_CR1_VOS) >> PWR_CR1_VOS_Pos;
+	uint32_t latency = READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos;
+	uint32_t art = (READ_BIT(FLASH->ACR, RCC_MODEL_ART) == RCC_MODEL_ART);
+	uint32_t ready;
+	uint32_t hz;
+
+	stats.steps++;
+
+	/*What has been written since the previous step*/
+	if (host_rcc_regs.PLLCFGR != prev_pllcfgr && READ_BIT(prev_cr, RCC_CR_PLLON | RCC_CR_PLLRDY)) {
+		rcc_model_violation("PLLCFGR written while the PLL is on");
+	}
+	if (READ_BIT(cr ^ prev_cr, RCC_CR_MSIRANGE) && READ_BIT(prev_cr, RCC_CR_MSION) &&
+		!READ_BIT(prev_cr, RCC_CR_MSIRDY)) {
+		rcc_model_violation("MSIRANGE written while the MSI is not ready");
+	}
+
+	/*Oscillators*/
+	MODIFY_REG(cr, RCC_CR_HSIRDY, READ_BIT(cr, RCC_CR_HSION) ? RCC_CR_HSIRDY : 0U);
+	MODIFY_REG(cr, RCC_CR_MSIRDY, READ_BIT(cr, RCC_CR_MSION) ? RCC_CR_MSIRDY : 0U);
+	MODIFY_REG(cr, RCC_CR_PLLRDY, (READ_BIT(cr, RCC_CR_PLLON) && rcc_model_pll()) ? RCC_CR_PLLRDY : 0U);
+	host_rcc_regs.CR = cr;
+
+	/*Voltage scaling completes at once*/
+	CLEAR_BIT(host_pwr_regs.SR2, PWR_SR2_VOSF);
+	if (vos != prev_vos) {
+		rcc_model_event(RCC_EV_VOS, vos);
+	}
+	if (latency != prev_latency) {
+		rcc_model_event(RCC_EV_LATENCY, latency);
+	}
+	if (art != prev_art) {
+		rcc_model_event(RCC_EV_ART, art);
+	}
+
+	/*The switch follows SW once the source is ready*/
+	ready = (sw == 0U) ? RCC_CR_MSIRDY : (sw == 1U) ? RCC_CR_HSIRDY : (sw == 3U) ? RCC_CR_PLLRDY : 0U;
+	if (ready && READ_BIT(cr, ready)) {
+		MODIFY_REG(host_rcc_regs.CFGR, RCC_CFGR_SWS, sw << RCC_CFGR_SWS_Pos);
+	}
+
+	hz = rcc_model_sysclk();
+	if (hz != prev_hz) {
+		rcc_model_event(RCC_EV_SYSCLK, hz);
+		clock_model_set_hz(hz);
+	}
+
+	/*Limits of the state the core now runs in*/
+	if (hz > (latency + 1U) * RCC_MODEL_WS_STEP_HZ) {
+		rcc_model_violation("SYSCLK above the limit of the flash wait states");
+	}
+	if (vos != 1U && hz > RCC_MODEL_RANGE2_HZ) {
+		rcc_model_violation("SYSCLK above the limit of the voltage range");
+	}
+	if (latency > 0U && hz > RCC_MODEL_WS_STEP_HZ && !art) {
+		rcc_model_violation("wait states without the ART");
+	}
+
+	prev_cr      = host_rcc_regs.CR;
+	prev_pllcfgr = host_rcc_regs.PLLCFGR;
+	prev_vos     = vos;
+	prev_latency = latency;
+	prev_art     = art;
+	prev_hz      = hz;
+}
+
+void rcc_model_get_stats(rcc_model_stats_t *out)
+{
+	*out = stats;
+}
+
+void rcc_model_clear_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
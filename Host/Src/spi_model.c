@@ -0,0 +1,156 @@
+/*
+ * spi_model.c
+ *
+ *  Host model of SPI2 and the AT45 chip select, see spi_model.h.
+ */
+
+#include "main.h"
+#include "spi.h"
+
+#define SPI_MODEL_FIFO		4U		/*RX FIFO of 32 bits, 8-bit frames*/
+
+SPI_TypeDef  host_spi1_regs;
+SPI_TypeDef  host_spi2_regs;
+SPI_TypeDef  host_spi3_regs;
+GPIO_TypeDef host_gpiob_regs;
+RCC_TypeDef  host_rcc_regs;
+
+static uint8_t rx_fifo[SPI_MODEL_FIFO];
+static uint32_t rx_head, rx_count;
+static uint8_t cs_low;
+static uint8_t in_irq;
+static uint8_t warned;
+static spi_model_stats_t stats;
+
+
+/**
+ * @brief Updates the SR flags after a change of the RX FIFO. The transmit side is
+ * always empty and the bus never busy: a byte is clocked when DR is written.
+ */
+static void spi_model_update_sr(void)
+{
+	uint32_t sr = host_spi2_regs.SR & ~(SPI_SR_RXNE | SPI_SR_TXE | SPI_SR_BSY | SPI_SR_FRLVL | SPI_SR_FTLVL);
+	uint32_t frlvl = (rx_count == 0) ? 0U : (rx_count == 1) ? 1U : (rx_count < SPI_MODEL_FIFO) ? 2U : 3U;
+
+	sr |= SPI_SR_TXE | (frlvl << SPI_SR_FRLVL_Pos);
+	if (rx_count) {
+		sr |= SPI_SR_RXNE;		//FRXTH is set, one frame is enough
+	}
+	host_spi2_regs.SR = (uint16_t)sr;
+}
+
+void spi_model_reset(void)
+{
+	memset(&host_spi1_regs, 0, sizeof(host_spi1_regs));
+	memset(&host_spi2_regs, 0, sizeof(host_spi2_regs));
+	memset(&host_spi3_regs, 0, sizeof(host_spi3_regs));
+	memset(&host_gpiob_regs, 0, sizeof(host_gpiob_regs));
+	memset(&host_rcc_regs, 0, sizeof(host_rcc_regs));
+	memset(&stats, 0, sizeof(stats));
+	rx_head  = 0;
+	rx_count = 0;
+	cs_low   = 0;
+	in_irq   = 0;
+	spi_model_update_sr();
+}
+
+void spi_model_write(SPI_TypeDef *spi, uint8_t data)
+{
+	uint32_t br;
+	uint8_t miso;
+
+	if (spi != &host_spi2_regs) {
+		return;
+	}
+	if (!READ_BIT(spi->CR1, SPI_CR1_SPE)) {
+		/*A disabled peripheral does not clock anything, the receive would wait forever*/
+		if (!warned) {
+			fprintf(stderr, "spi_model: DR written with SPE cleared, call SPIx_init() first\n");
+			warned = 1;
+		}
+		return;
+	}
+
+	/*8 SCK periods at the prescaler of CR1*/
+	br = READ_BIT(spi->CR1, SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+	clock_model_advance_cycles(8U << (br + 1U));
+	stats.bus_cycles += 8U << (br + 1U);
+	stats.bytes++;
+
+	miso = cs_low ? at45_model_exchange(data) : 0xFF;
+
+	/*The MISO pin reaches the peripheral only in alternate function mode*/
+	if (((host_gpiob_regs.MODER >> (SPIx_GPIO_MISO_PIN * 2U)) & 0x3U) != 0x2U) {
+		miso = 0x00;
+	}
+
+	if (rx_count == SPI_MODEL_FIFO) {
+		SET_BIT(spi->SR, SPI_SR_OVR);
+		stats.overruns++;
+	} else {
+		rx_fifo[(rx_head + rx_count) % SPI_MODEL_FIFO] = miso;
+		rx_count++;
+	}
+	spi_model_update_sr();
+
+	/*RXNE interrupt: the handler loads the next byte, which lands here again*/
+	if (READ_BIT(spi->CR2, SPI_CR2_RXNEIE) && !in_irq) {
+		in_irq = 1;
+		while (READ_BIT(spi->CR2, SPI_CR2_RXNEIE) && rx_count) {
+			SPIx_irq_handler(spi);
+		}
+		in_irq = 0;
+	}
+}
+
+uint8_t spi_model_read(SPI_TypeDef *spi)
+{
+	uint8_t data = 0;
+
+	if (spi != &host_spi2_regs) {
+		return 0;
+	}
+
+	if (rx_count) {
+		data = rx_fifo[rx_head];
+		rx_head = (rx_head + 1U) % SPI_MODEL_FIFO;
+		rx_count--;
+	}
+	/*The read of DR and the following read of SR clear the overrun*/
+	CLEAR_BIT(spi->SR, SPI_SR_OVR);
+	spi_model_update_sr();
+
+	return data;
+}
+
+void spi_model_cs(GPIO_TypeDef *gpio)
+{
+	uint8_t low;
+
+	if (gpio != &host_gpiob_regs) {
+		return;
+	}
+
+	low = !READ_BIT(gpio->ODR, (1U << SPIx_GPIO_CS_PIN));
+	if (low == cs_low) {
+		return;
+	}
+	cs_low = low;
+
+	if (low) {
+		stats.selects++;
+		at45_model_select();
+	} else {
+		at45_model_deselect();
+	}
+}
+
+void spi_model_get_stats(spi_model_stats_t *s)
+{
+	*s = stats;
+}
+
+void spi_model_clear_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,297 @@
+/*
+ * at45_sim.c
+ *
+ *  Runs the AT45 driver (at45db041.c over spi.c) and the littlefs block device
+ *  (lfs_at45.c) on the AT45DB041E model of Host/Src/at45_model.c.
+ *
+ *  usage: at45_sim [files] [file_size]
+ *
+ *  The checks follow the life of the device: bring-up of a new part (DataFlash page
+ *  size, switched to binary by at45db_init), page program and read back with both
+ *  read commands, block erase, deep and ultra-deep power-down and wake up, a program
+ *  failure reported through EPE, an asynchronous program on the event loop, then a
+ *  littlefs format, write, remount and read back, and renames out of a directory
+ *  while the commits relocate. The counters of the models and the virtual time of
+ *  each step are printed; exit status 1 on the first failure.
+ *  Built with -DPROF_ENABLE and Src/prof.c, the profiler regions of the drivers and
+ *  littlefs are printed too, in host nanoseconds. Built with -DPC_SAMPLE_ENABLE and
+ *  Src/pc_sample.c, the run is sampled at 10kHz and the samples are printed for
+ *  Host/Tools/pcs_fold.sh.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "pc_sample.h"
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static volatile uint8_t async_done;
+static uint32_t async_result;
+
+static int fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	return 1;
+}
+
+static void step(const char *name, uint64_t *t0)
+{
+	uint64_t t = clock_model_cycles();
+
+	printf("%-28s %10llu us\n", name, (unsigned long long)((t - *t0) / (SystemCoreClock / 1000000U)));
+	*t0 = t;
+}
+
+static void async_handler(void *arg, uint32_t data)
+{
+	(void)arg;
+	async_result = data;
+	async_done = 1;
+}
+
+static int check_driver(void)
+{
+	static uint8_t wr[256], rd[256];
+	uint64_t t0 = clock_model_cycles();
+
+	/*A new part ships with the 264 bytes page size*/
+	at45db_init();
+	if (!at45_model_binary()) {
+		return fail("init did not select the binary page size");
+	}
+	step("init", &t0);
+
+	for (uint32_t i = 0; i < sizeof(wr); i++) {
+		wr[i] = (uint8_t)(i * 7U + 3U);
+	}
+	at45db_program(5U * 256U, wr, sizeof(wr));
+	if (at45db_fault_check()) {
+		return fail("program reported EPE");
+	}
+	step("page program", &t0);
+
+	at45db_read_data(5U * 256U, rd, sizeof(rd));
+	if (memcmp(wr, rd, sizeof(wr))) {
+		return fail("read back (0x0B) differs");
+	}
+	memset(rd, 0, sizeof(rd));
+	at45db_read_continuous(5U * 256U, rd, sizeof(rd));
+	if (memcmp(wr, rd, sizeof(wr))) {
+		return fail("read back (0xE8) differs");
+	}
+	step("read back", &t0);
+
+	at45db_block_erase(0);
+	if (!at45db_wait_ready(AT45_TBE_US)) {
+		return fail("block erase timed out");
+	}
+	at45db_read_data(5U * 256U, rd, sizeof(rd));
+	for (uint32_t i = 0; i < sizeof(rd); i++) {
+		if (rd[i] != 0xFF) {
+			return fail("block not erased");
+		}
+	}
+	step("block erase", &t0);
+
+	at45db_deep_sleep(&AT45DB);
+	if (at45db_read_manID() == DEV_ID_OK) {
+		return fail("device answers in deep power-down");
+	}
+	if (!at45db_wake_up_from_deep_sleep(AT45DB)) {
+		return fail("wake up from deep power-down");
+	}
+	at45db_ultra_deep_sleep(AT45DB);
+	if (!at45db_wake_up_from_ultra_deep_sleep(AT45DB)) {
+		return fail("wake up from ultra-deep power-down");
+	}
+	step("power-down cycles", &t0);
+
+	at45_model_fail_next();
+	at45db_program(9U * 256U, wr, sizeof(wr));
+	if (!at45db_fault_check()) {
+		return fail("failed program not reported");
+	}
+	step("program failure", &t0);
+
+	evloop_init();
+	async_done = 0;
+	if (!at45db_program_async(12U * 256U, wr, sizeof(wr), async_handler, NULL)) {
+		return fail("async program did not start");
+	}
+	evloop_run_until(&async_done);
+	at45db_read_data(12U * 256U, rd, sizeof(rd));
+	if (!async_result || memcmp(wr, rd, sizeof(wr))) {
+		return fail("async program");
+	}
+	step("async program", &t0);
+
+	return 0;
+}
+
+static int check_lfs(uint32_t files, uint32_t file_size)
+{
+	uint8_t chunk[64];
+	char name[16];
+	lfs_t lfs;
+	lfs_file_t file;
+	uint64_t t0 = clock_model_cycles();
+
+	if (lfs_format(&lfs, &lfs_at45_cfg) || lfs_mount(&lfs, &lfs_at45_cfg)) {
+		return fail("lfs format/mount");
+	}
+	step("lfs format and mount", &t0);
+
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "f%03u", f);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT) < 0) {
+			return fail("lfs open for write");
+		}
+		for (uint32_t off = 0; off < file_size; off += sizeof(chunk)) {
+			memset(chunk, (int)(f * 31U + off), sizeof(chunk));
+			lfs_file_write(&lfs, &file, chunk, sizeof(chunk));
+		}
+		if (lfs_file_close(&lfs, &file)) {
+			return fail("lfs close");
+		}
+	}
+	lfs_unmount(&lfs);
+	step("lfs write", &t0);
+
+	if (lfs_mount(&lfs, &lfs_at45_cfg)) {
+		return fail("lfs remount");
+	}
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "f%03u", f);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) < 0) {
+			return fail("lfs open for read");
+		}
+		for (uint32_t off = 0; off < file_size; off += sizeof(chunk)) {
+			if (lfs_file_read(&lfs, &file, chunk, sizeof(chunk)) != (lfs_ssize_t)sizeof(chunk)) {
+				return fail("lfs short read");
+			}
+			for (uint32_t i = 0; i < sizeof(chunk); i++) {
+				if (chunk[i] != (uint8_t)(f * 31U + off)) {
+					return fail("lfs data differs");
+				}
+			}
+		}
+		lfs_file_close(&lfs, &file);
+	}
+	lfs_unmount(&lfs);
+	step("lfs remount and read", &t0);
+
+	return 0;
+}
+
+/**
+ * @brief Renames the only file of a directory into the directory after it in the
+ * metadata list, with a block_cycles of 1 so the commits relocate often. A relocation
+ * of the destination then deletes the pending move from the source directory in the
+ * fix-up of its predecessor, which empties it.
+ */
+static int check_lfs_relocation(void)
+{
+	struct lfs_config cfg = lfs_at45_cfg;
+	struct lfs_info info;
+	char name[16];
+	uint32_t v;
+	lfs_t lfs;
+	lfs_dir_t dir;
+	lfs_file_t file;
+	int entries;
+	uint64_t t0 = clock_model_cycles();
+
+	cfg.block_cycles = 1;
+	if (lfs_format(&lfs, &cfg) || lfs_mount(&lfs, &cfg)) {
+		return fail("lfs format/mount");
+	}
+
+	/*A new directory goes right after the last pair of its parent, so "a" precedes "b"*/
+	if (lfs_mkdir(&lfs, "b") || lfs_mkdir(&lfs, "a")) {
+		return fail("lfs mkdir");
+	}
+	for (v = 0; v < 64U; v++) {
+		snprintf(name, sizeof(name), "b/f%u", v % 4U);
+		if (lfs_file_open(&lfs, &file, "a/x", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0 ||
+			lfs_file_write(&lfs, &file, &v, sizeof(v)) != (lfs_ssize_t)sizeof(v) ||
+			lfs_file_close(&lfs, &file) || lfs_rename(&lfs, "a/x", name)) {
+			return fail("lfs rename out of a directory");
+		}
+	}
+	lfs_unmount(&lfs);
+
+	/*"a" is an empty directory, "b" holds the last version of each file*/
+	if (lfs_mount(&lfs, &cfg) || lfs_dir_open(&lfs, &dir, "a")) {
+		return fail("lfs remount");
+	}
+	entries = 0;
+	while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+		entries++;
+	}
+	lfs_dir_close(&lfs, &dir);
+	if (entries != 2) {
+		return fail("source directory not empty");
+	}
+	for (v = 60; v < 64U; v++) {
+		uint32_t d = 0;
+
+		snprintf(name, sizeof(name), "b/f%u", v % 4U);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) < 0 ||
+			lfs_file_read(&lfs, &file, &d, sizeof(d)) != (lfs_ssize_t)sizeof(d) || d != v) {
+			return fail("renamed file differs");
+		}
+		lfs_file_close(&lfs, &file);
+	}
+	if (lfs_fs_size(&lfs) < 0 || lfs_mkdir(&lfs, "a/c") || lfs_remove(&lfs, "a/c") || lfs_remove(&lfs, "a")) {
+		return fail("lfs use of the emptied directory");
+	}
+	lfs_unmount(&lfs);
+	step("lfs renames with relocations", &t0);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t files = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 8U;
+	uint32_t file_size = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 4096U;
+	at45_model_stats_t st;
+	spi_model_stats_t bus;
+
+	clock_model_reset();
+	spi_model_reset();
+	at45_model_reset();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+#ifdef PC_SAMPLE_ENABLE
+	pc_sample_start(10000U, 0);
+#endif
+
+	if (check_driver() || check_lfs(files, file_size) || check_lfs_relocation()) {
+		return 1;
+	}
+
+	at45_model_get_stats(&st);
+	spi_model_get_stats(&bus);
+
+	printf("commands %u: status %u, array reads %u, buffer writes %u, page programs %u\n",
+		   st.commands, st.status_reads, st.array_reads, st.buffer_writes, st.page_programs);
+	printf("erases: page %u, block %u, sector %u, chip %u; power-downs %u, failures %u\n",
+		   st.page_erases, st.block_erases, st.sector_erases, st.chip_erases, st.power_downs, st.failures);
+	printf("rejected: busy %u, asleep %u; aborted %u, unsupported %u\n",
+		   st.rejected_busy, st.rejected_asleep, st.aborted, st.unsupported);
+	printf("spi: %llu bytes, %u selects, %u overruns, busy %llu us of %llu us\n",
+		   (unsigned long long)bus.bytes, bus.selects, bus.overruns, (unsigned long long)st.busy_us,
+		   (unsigned long long)(clock_model_cycles() / (SystemCoreClock / 1000000U)));
+
+#ifdef PROF_ENABLE
+	prof_report();
+#endif
+#ifdef PC_SAMPLE_ENABLE
+	pc_sample_stop();
+	pc_sample_dump();
+#endif
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,458 @@
+/*
+ * at45_trace.c
+ *
+ *  Decoder and analyser of the SPI transaction traces of Src/spi_trace.c, for the
+ *  AT45DB041E command set.
+ *
+ *  usage: at45_trace [-v] [-w window_us] [-p page_size] [-o out.bin] [trace.bin]
+ *
+ *  The trace is a dump of spi_trace_dump(), captured from the UART of the board.
+ *  Without a file the tool records one itself: a littlefs workload (format, mount,
+ *  files written, a log appended with a sync each, a remount and the files read
+ *  twice) runs on lfs_at45.c over the AT45 model, and -o keeps the dump.
+ *
+ *  The report gives, per opcode, the transactions, the bytes sent and received and
+ *  the chip select time; the bus utilisation (chip select time over the span of the
+ *  trace) and the distribution of the idle gaps between transactions; the status
+ *  polls per program or erase; and the redundant reads: an array read of a page that
+ *  was read less than window_us (default 100000) before and not programmed or erased
+ *  since. -p 264 decodes the addresses of the DataFlash page size (default 256,
+ *  binary), -v lists every transaction.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+
+#ifndef SPI_TRACE_ENABLE
+#error "at45_trace records through the SPI trace hooks, build with -DSPI_TRACE_ENABLE"
+#endif
+
+#define TRACE_HZ			80000000U
+#define TRACE_PAGES			2048U
+#define TRACE_BLOCK_PAGES	8U
+#define TRACE_TOP			10U
+
+/**
+ * @brief What a command does to the main memory.
+ */
+typedef enum {
+	K_OTHER = 0,
+	K_READ,					//Array read, the data follows the header
+	K_BUF,					//Buffer read or write, the main memory is not touched
+	K_PROG,					//Programs the addressed page
+	K_ERASE_PAGE,
+	K_ERASE_BLOCK,
+	K_ERASE_ALL,			//Sector or chip erase, every page is treated as erased
+	K_STATUS,
+}trace_kind_t;
+
+/**
+ * @brief An AT45 opcode: name, kind and whether bytes 1-3 are an address.
+ */
+typedef struct {
+	uint8_t op;
+	const char *name;
+	trace_kind_t kind;
+	uint8_t addr;
+}trace_op_t;
+
+/**
+ * @brief Totals of an opcode.
+ */
+typedef struct {
+	uint32_t count;
+	uint64_t tx;
+	uint64_t rx;
+	double hold_us;
+	double max_us;
+}trace_sum_t;
+
+static const trace_op_t trace_ops[] = {
+	{ 0x0B, "read",          K_READ,        1 }, { 0x1B, "read_hf2",     K_READ,        1 },
+	{ 0x03, "read_lf",       K_READ,        1 }, { 0x01, "read_lp",      K_READ,        1 },
+	{ 0xE8, "read_legacy",   K_READ,        1 },
+	{ 0xD1, "buf1_read_lf",  K_BUF,         1 }, { 0xD3, "buf2_read_lf", K_BUF,         1 },
+	{ 0xD4, "buf1_read",     K_BUF,         1 }, { 0xD6, "buf2_read",    K_BUF,         1 },
+	{ 0x84, "buf1_write",    K_BUF,         1 }, { 0x87, "buf2_write",   K_BUF,         1 },
+	{ 0x83, "buf1_prog_er",  K_PROG,        1 }, { 0x86, "buf2_prog_er", K_PROG,        1 },
+	{ 0x88, "buf1_prog",     K_PROG,        1 }, { 0x89, "buf2_prog",    K_PROG,        1 },
+	{ 0x82, "page_prog1",    K_PROG,        1 }, { 0x85, "page_prog2",   K_PROG,        1 },
+	{ 0x02, "byte_prog",     K_PROG,        1 },
+	{ 0x58, "rewrite1",      K_PROG,        1 }, { 0x59, "rewrite2",     K_PROG,        1 },
+	{ 0x81, "page_erase",    K_ERASE_PAGE,  1 }, { 0x50, "block_erase",  K_ERASE_BLOCK, 1 },
+	{ 0x7C, "sector_erase",  K_ERASE_ALL,   1 }, { 0xC7, "chip_erase",   K_ERASE_ALL,   0 },
+	{ 0x53, "page_to_buf1",  K_OTHER,       1 }, { 0x55, "page_to_buf2", K_OTHER,       1 },
+	{ 0x60, "compare1",      K_OTHER,       1 }, { 0x61, "compare2",     K_OTHER,       1 },
+	{ 0xD7, "status",        K_STATUS,      0 }, { 0x9F, "id",           K_OTHER,       0 },
+	{ 0xB9, "deep_pd",       K_OTHER,       0 }, { 0xAB, "resume",       K_OTHER,       0 },
+	{ 0x79, "ultra_pd",      K_OTHER,       0 }, { 0x3D, "config",       K_OTHER,       0 },
+	{ 0xF0, "reset",         K_OTHER,       0 },
+};
+#define TRACE_NOPS			(sizeof(trace_ops)/sizeof(trace_ops[0]))
+
+static const trace_op_t trace_unknown = { 0x00, "unknown", K_OTHER, 0 };
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static uint8_t *dump_buf;
+static size_t dump_len, dump_cap;
+
+static uint32_t page_size = 256U;
+static uint32_t window_us = 100000U;
+static int verbose;
+
+
+static void dump_out(const void *data, uint32_t size)
+{
+	if (dump_len + size > dump_cap) {
+		dump_cap = (dump_len + size) * 2U;
+		dump_buf = realloc(dump_buf, dump_cap);
+	}
+	memcpy(dump_buf + dump_len, data, size);
+	dump_len += size;
+}
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+/**
+ * @brief Records the trace of a littlefs workload on the AT45 model into dump_buf.
+ */
+static int record(void)
+{
+	static uint8_t buf[512];
+	char name[16];
+	lfs_t lfs;
+	lfs_file_t file;
+	int res;
+
+	clock_model_reset();
+	clock_model_set_hz(TRACE_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+	spi_trace_reset();
+
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+
+	for (uint32_t f = 0; f < 4U; f++) {
+		snprintf(name, sizeof(name), "f%u", f);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) {
+			return fail("open for write", f);
+		}
+		for (uint32_t off = 0; off < 4096U; off += sizeof(buf)) {
+			memset(buf, (int)(f + off), sizeof(buf));
+			lfs_file_write(&lfs, &file, buf, sizeof(buf));
+		}
+		lfs_file_close(&lfs, &file);
+	}
+
+	if (lfs_file_open(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) {
+		return fail("log open", 0);
+	}
+	for (uint32_t i = 0; i < 32U; i++) {
+		memset(buf, (int)i, 32U);
+		lfs_file_write(&lfs, &file, buf, 32U);
+		lfs_file_sync(&lfs, &file);
+	}
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+
+	res = lfs_mount(&lfs, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("remount", res);
+	}
+	for (uint32_t pass = 0; pass < 2U; pass++) {
+		for (uint32_t f = 0; f < 4U; f++) {
+			snprintf(name, sizeof(name), "f%u", f);
+			if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) < 0) {
+				return fail("open for read", f);
+			}
+			while (lfs_file_read(&lfs, &file, buf, 100U) > 0) {
+				;
+			}
+			lfs_file_close(&lfs, &file);
+		}
+	}
+	lfs_unmount(&lfs);
+
+	spi_trace_dump(dump_out);
+	return 0;
+}
+
+static int load(const char *path)
+{
+	uint8_t chunk[4096];
+	size_t n;
+	FILE *f = fopen(path, "rb");
+
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		dump_out(chunk, (uint32_t)n);
+	}
+	fclose(f);
+	return 0;
+}
+
+static const trace_op_t *decode(uint8_t op)
+{
+	for (uint32_t i = 0; i < TRACE_NOPS; i++) {
+		if (trace_ops[i].op == op) {
+			return &trace_ops[i];
+		}
+	}
+	return &trace_unknown;
+}
+
+/**
+ * @brief Page and offset of an address, in the page size of the dump.
+ */
+static uint32_t page_of(const spi_trace_rec_t *r, uint32_t *offset)
+{
+	uint32_t addr = ((uint32_t)r->cmd[1] << 16) | ((uint32_t)r->cmd[2] << 8) | r->cmd[3];
+
+	if (page_size == 264U) {
+		*offset = addr & 0x1FFU;
+		return (addr >> 9) % TRACE_PAGES;
+	}
+	*offset = addr % page_size;
+	return (addr / page_size) % TRACE_PAGES;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double pct(const double *v, uint32_t n, uint32_t permille)
+{
+	return n ? v[((uint64_t)(n - 1U) * permille) / 1000U] : 0.0;
+}
+
+static int analyse(void)
+{
+	static trace_sum_t sum[TRACE_NOPS + 1U];
+	static uint32_t last_read[TRACE_PAGES];
+	static uint8_t read_valid[TRACE_PAGES];
+	static uint32_t page_redundant[TRACE_PAGES];
+	spi_trace_hdr_t hdr;
+	const spi_trace_rec_t *rec;
+	double *gaps;
+	double hold_total = 0.0, end_prev = 0.0, span;
+	uint64_t redundant_bytes = 0;
+	uint32_t redundant = 0, array_reads = 0;
+	uint32_t ngaps = 0, polls = 0, poll_ops = 0, poll_max = 0, polling = 0;
+	double poll_us = 0.0;
+
+	if (dump_len < sizeof(hdr)) {
+		return fail("trace too short", (int)dump_len);
+	}
+	memcpy(&hdr, dump_buf, sizeof(hdr));
+	if (hdr.magic != SPI_TRACE_MAGIC || hdr.version != SPI_TRACE_VERSION ||
+		hdr.rec_size != sizeof(spi_trace_rec_t) || hdr.core_hz == 0 ||
+		dump_len < sizeof(hdr) + (size_t)hdr.records * sizeof(spi_trace_rec_t)) {
+		return fail("not a trace of spi_trace_dump()", 0);
+	}
+	rec  = (const spi_trace_rec_t *)(dump_buf + sizeof(hdr));
+	gaps = malloc(sizeof(double) * (hdr.records + 1U));
+
+	for (uint32_t i = 0; i < hdr.records; i++) {
+		const spi_trace_rec_t *r = &rec[i];
+		const trace_op_t *op = (r->tx_bytes) ? decode(r->cmd[0]) : &trace_unknown;
+		trace_sum_t *s = &sum[(op == &trace_unknown) ? TRACE_NOPS : (uint32_t)(op - trace_ops)];
+		double hold = (double)r->hold_cycles * 1e6 / hdr.core_hz;
+		uint32_t off = 0, page = op->addr ? page_of(r, &off) : 0;
+
+		s->count++;
+		s->tx += r->tx_bytes;
+		s->rx += r->rx_bytes;
+		s->hold_us += hold;
+		if (hold > s->max_us) {
+			s->max_us = hold;
+		}
+		hold_total += hold;
+
+		if (i) {
+			double gap = (double)(uint32_t)(r->start_us - rec[0].start_us) - end_prev;
+
+			gaps[ngaps++] = (gap < 0.0) ? 0.0 : gap;
+		}
+		end_prev = (double)(uint32_t)(r->start_us - rec[0].start_us) + hold;
+
+		if (verbose) {
+			printf("%10u us %9.1f us  %-13s", r->start_us, hold, op->name);
+			if (op->addr) {
+				printf(" page %4u +%3u", page, off);
+			} else {
+				printf("               ");
+			}
+			printf("  tx %5u rx %5u\n", r->tx_bytes, r->rx_bytes);
+		}
+
+		/*Status polls that follow a program or erase*/
+		if (op->kind == K_STATUS) {
+			if (polling) {
+				polls++;
+				poll_us += hold;
+				polling++;
+			}
+			continue;
+		}
+		if (polling > 1U && polling - 1U > poll_max) {
+			poll_max = polling - 1U;
+		}
+		polling = 0;
+
+		switch (op->kind) {
+		case K_READ: {
+			uint32_t left = (r->rx_bytes) ? r->rx_bytes : 1U;
+
+			array_reads++;
+			while (left) {
+				uint32_t n = (page_size - off < left) ? page_size - off : left;
+
+				if (read_valid[page] && r->start_us - last_read[page] <= window_us) {
+					redundant++;
+					redundant_bytes += n;
+					page_redundant[page]++;
+				}
+				read_valid[page] = 1;
+				last_read[page]  = r->start_us;
+				left -= n;
+				off   = 0;
+				page  = (page + 1U) % TRACE_PAGES;
+			}
+			break;
+		}
+		case K_PROG:
+		case K_ERASE_PAGE:
+			read_valid[page] = 0;
+			poll_ops++;
+			polling = 1;
+			break;
+		case K_ERASE_BLOCK:
+			for (uint32_t p = 0; p < TRACE_BLOCK_PAGES; p++) {
+				read_valid[(page & ~(TRACE_BLOCK_PAGES - 1U)) + p] = 0;
+			}
+			poll_ops++;
+			polling = 1;
+			break;
+		case K_ERASE_ALL:
+			memset(read_valid, 0, sizeof(read_valid));
+			poll_ops++;
+			polling = 1;
+			break;
+		default:
+			break;
+		}
+	}
+	if (polling > 1U && polling - 1U > poll_max) {
+		poll_max = polling - 1U;
+	}
+
+	span = hdr.records ? end_prev : 0.0;
+	printf("trace: %u transactions (%u lost before the dump), %.0f us, core clock %u Hz\n",
+		   hdr.records, hdr.lost, span, hdr.core_hz);
+	printf("%-13s %8s %10s %10s %12s %9s %9s %6s\n", "opcode", "count", "tx", "rx",
+		   "cs_us", "mean_us", "max_us", "cs%");
+	for (uint32_t i = 0; i <= TRACE_NOPS; i++) {
+		const trace_sum_t *s = &sum[i];
+
+		if (!s->count) {
+			continue;
+		}
+		printf("%-13s %8u %10llu %10llu %12.0f %9.1f %9.1f %5.1f%%\n",
+			   (i < TRACE_NOPS) ? trace_ops[i].name : trace_unknown.name, s->count,
+			   (unsigned long long)s->tx, (unsigned long long)s->rx, s->hold_us,
+			   s->hold_us / s->count, s->max_us, hold_total ? 100.0 * s->hold_us / hold_total : 0.0);
+	}
+
+	qsort(gaps, ngaps, sizeof(double), cmp_double);
+	printf("bus: chip select low %.0f of %.0f us, utilisation %.1f%%\n", hold_total, span,
+		   span ? 100.0 * hold_total / span : 0.0);
+	printf("idle gaps: %u, min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f us\n", ngaps,
+		   pct(gaps, ngaps, 0), pct(gaps, ngaps, 500), pct(gaps, ngaps, 900),
+		   pct(gaps, ngaps, 990), pct(gaps, ngaps, 1000));
+	printf("status polls: %u after %u programs/erases, mean %.1f max %u per operation, %.0f us\n",
+		   polls, poll_ops, poll_ops ? (double)polls / poll_ops : 0.0, poll_max, poll_us);
+	printf("redundant reads: %u page reads of %u array reads, %llu bytes, window %u us\n",
+		   redundant, array_reads, (unsigned long long)redundant_bytes, window_us);
+
+	for (uint32_t t = 0; t < TRACE_TOP; t++) {
+		uint32_t best = 0;
+
+		for (uint32_t p = 1; p < TRACE_PAGES; p++) {
+			if (page_redundant[p] > page_redundant[best]) {
+				best = p;
+			}
+		}
+		if (!page_redundant[best]) {
+			break;
+		}
+		printf("  page %4u (block %3u): read again %u times\n", best, best / TRACE_BLOCK_PAGES,
+			   page_redundant[best]);
+		page_redundant[best] = 0;
+	}
+
+	free(gaps);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *in = NULL, *out = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			window_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			page_size = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out = argv[++i];
+		} else if (argv[i][0] != '-') {
+			in = argv[i];
+		} else {
+			fprintf(stderr, "usage: at45_trace [-v] [-w window_us] [-p page_size] [-o out.bin] [trace.bin]\n");
+			return 1;
+		}
+	}
+	if (page_size != 256U && page_size != 264U) {
+		return fail("page size must be 256 or 264", (int)page_size);
+	}
+
+	if (in ? load(in) : record()) {
+		return 1;
+	}
+	if (out) {
+		FILE *f = fopen(out, "wb");
+
+		if (!f || fwrite(dump_buf, 1, dump_len, f) != dump_len) {
+			perror(out);
+			return 1;
+		}
+		fclose(f);
+	}
+
+	return analyse();
+}
@@ -0,0 +1,228 @@
+/*
+ * clock_profile.c
+ *
+ *  Checks rcc_set_profile() on the RCC model: the register sequence of every switch
+ *  between the clock profiles and the divisors derived for the new clock.
+ *
+ *  usage: clock_profile
+ *
+ *  SPI2 is initialized by SPIx_init() as the AT45 driver does, SPI3 is only enabled
+ *  and USART2 is programmed for BAUDRATE. The profiles are then switched in an order
+ *  that takes every transition up and down. After each switch SystemCoreClock, the
+ *  flash latency, the ART bits, the voltage range, the SPI BR fields and the USART
+ *  BRR must have the expected values, calculate_u_div() must agree with BRR, and the
+ *  model must not have counted a step that broke the sequence. The events of the
+ *  switch are checked too: going up the wait states are raised before the clock,
+ *  going down they are lowered after it, and the ART is on before any wait state.
+ *  A wrong sequence written by hand must be caught by the model.
+ *
+ *  One line per switch is printed with the registers and the events in order.
+ *  Exit status 1 on any difference.
+ */
+
+#include "system_init.h"
+#include "spi.h"
+#include "uart.h"
+
+#define CP_ART				(FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN)
+
+/**
+ * @brief The registers a profile must leave behind.
+ */
+typedef struct {
+	const char *name;
+	clock_profile_t profile;
+	uint32_t hz;
+	uint32_t latency;
+	uint32_t spi_br;			/*SCK = hz / 2^(BR+1), at most SPIx_MAX_CLK_HZ*/
+	uint32_t brr;				/*USART2 at BAUDRATE, oversampling by 16*/
+}cp_profile_t;
+
+static const cp_profile_t cp_profiles[] = {
+	{ "HSI16", CLOCK_HSI_16MHZ, 16000000U, 0, 1, 138 },
+	{ "MSI48", CLOCK_MSI_48MHZ, 48000000U, 2, 3, 416 },
+	{ "PLL80", CLOCK_PLL_80MHZ, 80000000U, 4, 3, 694 },
+};
+
+/*Every transition between two profiles, up and down*/
+static const clock_profile_t cp_sequence[] = {
+	CLOCK_HSI_16MHZ, CLOCK_PLL_80MHZ, CLOCK_MSI_48MHZ, CLOCK_PLL_80MHZ,
+	CLOCK_HSI_16MHZ, CLOCK_MSI_48MHZ, CLOCK_HSI_16MHZ,
+};
+
+
+static int fail(const char *name, const char *what)
+{
+	fprintf(stderr, "FAIL: %s: %s\n", name, what);
+	return 1;
+}
+
+static void setup(void)
+{
+	clock_model_reset();
+	flash_model_reset();
+	spi_model_reset();
+	rcc_model_reset();
+
+	rcc_init();
+
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	SET_BIT(SPI3->CR1, SPI_CR1_SPE);
+
+	SET_BIT(USART2->CR1, USART_CR1_TE | USART_CR1_UE);
+	USARTx_set_baudrate(USART2, BAUDRATE, SystemCoreClock);
+}
+
+/**
+ * @brief Position of the first event of a type, from the end if last is set, -1 if none.
+ */
+static int find_event(const rcc_model_stats_t *st, rcc_model_ev_type_t type, int last)
+{
+	int found = -1;
+
+	for (uint32_t i = 0; i < st->events && i < RCC_MODEL_EVENTS; i++) {
+		if (st->event[i].type == type) {
+			found = (int)i;
+			if (!last) {
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+static int check_order(const char *name, const rcc_model_stats_t *st, uint32_t old_hz, uint32_t new_hz)
+{
+	int latency = find_event(st, RCC_EV_LATENCY, 1);
+	int art = find_event(st, RCC_EV_ART, 0);
+	int clk = find_event(st, RCC_EV_SYSCLK, 1);
+
+	if (st->events > RCC_MODEL_EVENTS) {
+		return fail(name, "too many events");
+	}
+	if (art >= 0 && latency >= 0 && art > latency) {
+		return fail(name, "ART enabled after the wait states");
+	}
+	if (latency >= 0 && new_hz > old_hz && latency > clk) {
+		return fail(name, "wait states raised after the clock");
+	}
+	if (latency >= 0 && new_hz < old_hz && latency < clk) {
+		return fail(name, "wait states lowered before the clock");
+	}
+
+	return 0;
+}
+
+static void print_events(const rcc_model_stats_t *st)
+{
+	static const char *const names[] = { "vos", "ws", "art", "clk" };
+
+	for (uint32_t i = 0; i < st->events && i < RCC_MODEL_EVENTS; i++) {
+		if (st->event[i].type == RCC_EV_SYSCLK) {
+			printf(" %s=%u", names[st->event[i].type], st->event[i].value / 1000000U);
+		} else {
+			printf(" %s=%u", names[st->event[i].type], st->event[i].value);
+		}
+	}
+	printf("\n");
+}
+
+static int run(clock_profile_t profile)
+{
+	const cp_profile_t *p = &cp_profiles[profile];
+	uint32_t old_hz = SystemCoreClock;
+	uint32_t latency, vos, spi2, spi3;
+	rcc_model_stats_t st;
+	int res = 0;
+
+	rcc_model_clear_stats();
+	if (!rcc_set_profile(profile)) {
+		return fail(p->name, "rcc_set_profile");
+	}
+	rcc_model_get_stats(&st);
+
+	latency = READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos;
+	vos = READ_BIT(PWR->CR1, PWR_CR1_VOS) >> PWR_CR1_VOS_Pos;
+	spi2 = READ_BIT(SPI_PERIPH->CR1, SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+	spi3 = READ_BIT(SPI3->CR1, SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+
+	printf("%-6s -> %-6s %9u %3u %4u %4u %4u %4u %6u %3u", (old_hz == 16000000U) ? "16MHz" :
+		   (old_hz == 48000000U) ? "48MHz" : "80MHz", p->name, SystemCoreClock, latency,
+		   (READ_BIT(FLASH->ACR, CP_ART) == CP_ART), vos, spi2, spi3, USART2->BRR, st.steps);
+	print_events(&st);
+
+	if (st.violations) {
+		res |= fail(p->name, st.first_violation);
+	}
+	if (SystemCoreClock != p->hz || rcc_model_sysclk() != p->hz) {
+		res |= fail(p->name, "SystemCoreClock");
+	}
+	if (latency != p->latency || rcc_flash_latency(p->hz) != p->latency) {
+		res |= fail(p->name, "flash latency");
+	}
+	if (READ_BIT(FLASH->ACR, CP_ART) != CP_ART) {
+		res |= fail(p->name, "ART off");
+	}
+	if (vos != 1U) {
+		res |= fail(p->name, "voltage range");
+	}
+	if (spi2 != p->spi_br || spi3 != p->spi_br || SPIx_prescaler(p->hz, SPIx_MAX_CLK_HZ) != p->spi_br ||
+		!READ_BIT(SPI_PERIPH->CR1, SPI_CR1_SPE) || !READ_BIT(SPI3->CR1, SPI_CR1_SPE)) {
+		res |= fail(p->name, "SPI prescaler");
+	}
+	if ((p->hz >> (p->spi_br + 1U)) > SPIx_MAX_CLK_HZ) {
+		res |= fail(p->name, "SCK above the limit");
+	}
+	if (USART2->BRR != p->brr || calculate_u_div(BAUDRATE) != p->brr ||
+		!READ_BIT(USART2->CR1, USART_CR1_UE) || USARTx_get_baudrate(USART2) != BAUDRATE) {
+		res |= fail(p->name, "USART BRR");
+	}
+	if (READ_BIT(SPI1->CR1, SPI_CR1_SPE) || USART1->BRR || USART3->BRR) {
+		res |= fail(p->name, "disabled peripheral reprogrammed");
+	}
+	res |= check_order(p->name, &st, old_hz, p->hz);
+
+	return res;
+}
+
+/**
+ * @brief Switch to the PLL without raising the wait states: the model must count it.
+ */
+static int check_model(void)
+{
+	rcc_model_stats_t st;
+
+	setup();
+	rcc_model_clear_stats();
+
+	WRITE_REG(RCC->PLLCFGR, RCC_PLLCFGR_PLLSRC_HSI | (10U << RCC_PLLCFGR_PLLN_Pos) | RCC_PLLCFGR_PLLREN);
+	SET_BIT(RCC->CR, RCC_CR_PLLON);
+	RCC_WAIT_UNTIL(READ_BIT(RCC->CR, RCC_CR_PLLRDY));
+	MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, (0x03<<RCC_CFGR_SW_Pos));
+	RCC_WAIT_UNTIL((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL);
+
+	rcc_model_get_stats(&st);
+	if (st.violations == 0 || SystemCoreClock != 80000000U) {
+		return fail("model", "80MHz with 0 wait states not caught");
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int res = 0;
+
+	setup();
+
+	printf("%-16s %9s %3s %4s %4s %4s %4s %6s %3s %s\n", "switch", "hz", "ws", "art", "vos",
+		   "spi2", "spi3", "brr", "polls", "events");
+	for (uint32_t i = 0; i < sizeof(cp_sequence) / sizeof(cp_sequence[0]); i++) {
+		res |= run(cp_sequence[i]);
+	}
+
+	res |= check_model();
+
+	return res;
+}
@@ -0,0 +1,444 @@
+/*
+ * compress_bench.c
+ *
+ *  Compression ratio and throughput of compressed littlefs files (zchunk in
+ *  lfs_file_config) on the AT45 model, with logs like those of the logger.
+ *
+ *  usage: compress_bench [bytes] [-s records] [-f file] [-max]
+ *
+ *  Three logs of [bytes] (default 65536) bytes are generated: csv, a sensor log of
+ *  one line per sample (time, temperature, humidity, pressure, acceleration),
+ *  events, a text log of driver messages, and binary, 16 byte records of a time
+ *  and six ADC samples. -f adds a file of the host as a fourth log. Each one is
+ *  appended record by record (a line, or 16 bytes) to a file on a new file system,
+ *  synced every [records] (default 16) records, as a plain file, with LFS_O_LOG and
+ *  compressed in chunks of 256 to 2048 bytes. For each run the bytes stored and
+ *  the ratio to the log, the bytes programmed (AT45 pages x 256) and the block
+ *  erases are printed, with the write and read back throughput and the mean time of
+ *  a 32 byte read at a random offset. The log is checked after a remount, lfs_stat()
+ *  must report its size, not the bytes stored, and the attribute type of compressed
+ *  files (LFS_ZATTR) must be refused to lfs_setattr() and lfs_file_opencfg(). The times
+ *  are bus and device time at 80MHz, the CPU time is not counted: built with
+ *  -DPROF_ENABLE and Src/prof.c the host time of the compressor and decompressor
+ *  per byte of the log is added.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+#include "prof.h"
+
+#define CB_HZ				80000000U
+#define CB_BYTES_MAX		(256U*1024U)
+#define CB_LINE_MAX			128U
+#define CB_BIN_RECORD		16U
+#define CB_SEEKS			200U
+#define CB_SEEK_SIZE		32U
+#define CB_CHUNK_MAX		2048U
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+/**
+ * @brief A log: its data and where each record ends.
+ */
+typedef struct {
+	const char *name;
+	uint8_t *data;
+	uint32_t size;
+	uint32_t *ends;
+	uint32_t records;
+}cb_log_t;
+
+static const uint32_t cb_chunks[] = { 256U, 512U, 1024U, 2048U };
+
+static const at45_model_timing_t cb_max = {
+	400U, AT45_TEP_US, AT45_TP_US, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+};
+
+static int max_timing;
+static uint32_t sync_every = 16U;
+static uint32_t seed;
+static lfs_t lfs;
+static lfs_file_t file;
+static struct lfs_file_config file_cfg;
+static uint8_t zbuffer[LFS_ZBUFFER_SIZE(CB_CHUNK_MAX)] __attribute__((aligned(4)));
+static uint8_t got[CB_BYTES_MAX];
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)(clock_model_cycles() / (SystemCoreClock / 1000000U));
+}
+
+static uint32_t rnd(void)
+{
+	seed = seed * 1103515245U + 12345U;
+	return seed >> 8;
+}
+
+/**
+ * @brief Random step of -range to +range.
+ */
+static int32_t step(int32_t range)
+{
+	return (int32_t)(rnd() % (uint32_t)(2 * range + 1)) - range;
+}
+
+static int log_alloc(cb_log_t *log, const char *name, uint32_t size)
+{
+	log->name = name;
+	log->data = malloc(size + CB_LINE_MAX);
+	log->ends = malloc(sizeof(uint32_t) * (size + 1U));
+	log->size = 0;
+	log->records = 0;
+
+	return (log->data && log->ends) ? 0 : fail("malloc", 0);
+}
+
+static void log_add(cb_log_t *log, uint32_t len)
+{
+	log->size += len;
+	log->ends[log->records++] = log->size;
+}
+
+/**
+ * @brief Sensor log: ms,temp,humidity,pressure,ax,ay,az with slowly moving values.
+ */
+static int gen_csv(cb_log_t *log, uint32_t size)
+{
+	uint32_t t = 3600000U;
+	int32_t temp = 2341, hum = 452, press = 101325, ax = -12, ay = 981, az = 4;
+
+	if (log_alloc(log, "csv", size)) {
+		return 1;
+	}
+	seed = 1U;
+	while (log->size < size) {
+		t += 1000U + rnd() % 3U;
+		temp += step(2);
+		hum += step(1);
+		press += step(3);
+		ax = -12 + step(6);
+		ay = 981 + step(6);
+		az = 4 + step(6);
+		log_add(log, (uint32_t)snprintf((char *)&log->data[log->size], CB_LINE_MAX,
+				"%lu,%ld.%02ld,%ld.%ld,%ld.%02ld,%.3f,%.3f,%.3f\n", (unsigned long)t,
+				(long)(temp / 100), (long)(temp % 100), (long)(hum / 10), (long)(hum % 10),
+				(long)(press / 100), (long)(press % 100), ax / 1000.0, ay / 1000.0, az / 1000.0));
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Text log of a few driver messages with changing numbers.
+ */
+static int gen_events(cb_log_t *log, uint32_t size)
+{
+	uint32_t ms = 1000U;
+	char *line;
+
+	if (log_alloc(log, "events", size)) {
+		return 1;
+	}
+	seed = 2U;
+	while (log->size < size) {
+		ms += 1U + rnd() % 250U;
+		line = (char *)&log->data[log->size];
+		switch (rnd() % 5U) {
+		case 0:
+			log_add(log, (uint32_t)snprintf(line, CB_LINE_MAX, "[%7lu.%03lu] I at45: page 0x%04lx programmed in %lu us\n",
+					(unsigned long)(ms / 1000U), (unsigned long)(ms % 1000U),
+					(unsigned long)(rnd() % 2048U), (unsigned long)(2500U + rnd() % 800U)));
+			break;
+		case 1:
+			log_add(log, (uint32_t)snprintf(line, CB_LINE_MAX, "[%7lu.%03lu] I lfs: sync log%lu, %lu bytes\n",
+					(unsigned long)(ms / 1000U), (unsigned long)(ms % 1000U),
+					(unsigned long)(rnd() % 4U), (unsigned long)(rnd() % 4096U)));
+			break;
+		case 2:
+			log_add(log, (uint32_t)snprintf(line, CB_LINE_MAX, "[%7lu.%03lu] W spi: busy timeout, retry %lu\n",
+					(unsigned long)(ms / 1000U), (unsigned long)(ms % 1000U), (unsigned long)(1U + rnd() % 3U)));
+			break;
+		case 3:
+			log_add(log, (uint32_t)snprintf(line, CB_LINE_MAX, "[%7lu.%03lu] I adc: vbat %lu mV, temp %lu.%lu C\n",
+					(unsigned long)(ms / 1000U), (unsigned long)(ms % 1000U),
+					(unsigned long)(3600U + rnd() % 200U), (unsigned long)(20U + rnd() % 10U),
+					(unsigned long)(rnd() % 10U)));
+			break;
+		default:
+			log_add(log, (uint32_t)snprintf(line, CB_LINE_MAX, "[%7lu.%03lu] I uart: upload %lu of %lu blocks\n",
+					(unsigned long)(ms / 1000U), (unsigned long)(ms % 1000U),
+					(unsigned long)(rnd() % 256U), 256UL));
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Binary records: time in ms and six 12-bit ADC samples around a level.
+ */
+static int gen_binary(cb_log_t *log, uint32_t size)
+{
+	uint32_t t = 0;
+	int32_t level[6] = { 2048, 1500, 3000, 700, 2500, 1024 };
+
+	if (log_alloc(log, "binary", size)) {
+		return 1;
+	}
+	seed = 3U;
+	while (log->size < size) {
+		uint8_t *rec = &log->data[log->size];
+
+		t += 10U;
+		memcpy(rec, &t, sizeof(t));
+		for (uint32_t i = 0; i < 6U; i++) {
+			uint16_t s;
+
+			level[i] += step(4);
+			s = (uint16_t)((level[i] + step(8)) & 0x0fff);
+			memcpy(&rec[4U + 2U * i], &s, sizeof(s));
+		}
+		log_add(log, CB_BIN_RECORD);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief A host file, cut in lines.
+ */
+static int load_file(cb_log_t *log, const char *path, uint32_t size)
+{
+	FILE *fp = fopen(path, "rb");
+	uint32_t n;
+
+	if (!fp) {
+		return fail("open host file", 0);
+	}
+	if (log_alloc(log, path, size)) {
+		fclose(fp);
+		return 1;
+	}
+	n = (uint32_t)fread(log->data, 1, size, fp);
+	fclose(fp);
+	for (uint32_t i = 0, start = 0; i < n; i++) {
+		if (log->data[i] == '\n' || i + 1U == n || i + 1U - start == CB_LINE_MAX) {
+			log_add(log, i + 1U - start);
+			start = i + 1U;
+		}
+	}
+
+	return 0;
+}
+
+static void bench_reset(void)
+{
+	clock_model_reset();
+	clock_model_set_hz(CB_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&cb_max);
+	}
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+}
+
+/**
+ * @brief Host ns per byte of the log spent in a profiler region.
+ */
+static double codec_ns(prof_id_t id, uint32_t bytes)
+{
+#ifdef PROF_ENABLE
+	return (double)prof_regions()[id].total / bytes;
+#else
+	(void)id;
+	(void)bytes;
+	return 0.0;
+#endif
+}
+
+/**
+ * @brief One run, chunk 0 is a plain file, with log set an LFS_O_LOG one.
+ */
+static int run(const cb_log_t *log, uint32_t chunk, int log_flag)
+{
+	static const struct lfs_attr zattr = { LFS_ZATTR, NULL, 0 };
+	const struct lfs_file_config bad_cfg = { .attrs = (struct lfs_attr *)&zattr, .attr_count = 1 };
+	struct lfs_info info;
+	at45_model_stats_t st;
+	uint32_t t0, write_us, read_us, seek_us = 0, stored;
+	double comp_ns, dec_ns;
+	char name[16];
+	int res;
+
+	bench_reset();
+	memset(&file_cfg, 0, sizeof(file_cfg));
+	file_cfg.zchunk = chunk;
+	file_cfg.zbuffer = chunk ? zbuffer : NULL;
+
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+	res = lfs_file_opencfg(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND |
+						   (log_flag ? LFS_O_LOG : 0), &file_cfg);
+	if (res < 0) {
+		return fail("open", res);
+	}
+
+	prof_reset();
+	at45_model_clear_stats();
+	t0 = now_us();
+	for (uint32_t r = 0, start = 0; r < log->records; r++) {
+		uint32_t len = log->ends[r] - start;
+
+		res = lfs_file_write(&lfs, &file, &log->data[start], len);
+		if (res != (int)len) {
+			return fail("write", res);
+		}
+		start = log->ends[r];
+		if (sync_every && (r % sync_every) == sync_every - 1U) {
+			res = lfs_file_sync(&lfs, &file);
+			if (res < 0) {
+				return fail("sync", res);
+			}
+		}
+	}
+	/*The struct of the file holds the bytes stored once it is synced*/
+	res = lfs_file_sync(&lfs, &file);
+	stored = file.ctz.size;
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_close(&lfs, &file);
+	}
+	if (res < 0) {
+		return fail("close", res);
+	}
+	write_us = now_us() - t0;
+	comp_ns = codec_ns(PROF_LFS_ZCOMP, log->size);
+	at45_model_get_stats(&st);
+
+	res = lfs_stat(&lfs, "log", &info);
+	if (res < 0 || info.size != log->size) {
+		return fail("stat size", res < 0 ? res : (int)info.size);
+	}
+	res = lfs_setattr(&lfs, "log", LFS_ZATTR, &info, sizeof(info.size));
+	if (res != LFS_ERR_INVAL || lfs_removeattr(&lfs, "log", LFS_ZATTR) != LFS_ERR_INVAL ||
+		lfs_file_opencfg(&lfs, &file, "log", LFS_O_RDONLY, &bad_cfg) != LFS_ERR_INVAL) {
+		return fail("compressed file attribute open to the user", res);
+	}
+	lfs_unmount(&lfs);
+
+	/*Read back after a remount, then at random offsets*/
+	res = lfs_mount(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_opencfg(&lfs, &file, "log", LFS_O_RDONLY, &file_cfg);
+	}
+	if (res < 0) {
+		return fail("reopen", res);
+	}
+	prof_reset();
+	t0 = now_us();
+	res = lfs_file_read(&lfs, &file, got, log->size + 1U);
+	read_us = now_us() - t0;
+	dec_ns = codec_ns(PROF_LFS_ZDECOMP, log->size);
+	if (res != (int)log->size || memcmp(got, log->data, log->size) != 0) {
+		return fail("read back", res);
+	}
+	seed = 4U;
+	for (uint32_t i = 0; i < CB_SEEKS; i++) {
+		uint32_t off = rnd() % (log->size - CB_SEEK_SIZE);
+
+		t0 = now_us();
+		if (lfs_file_seek(&lfs, &file, (lfs_soff_t)off, LFS_SEEK_SET) < 0 ||
+			lfs_file_read(&lfs, &file, got, CB_SEEK_SIZE) != (lfs_ssize_t)CB_SEEK_SIZE ||
+			memcmp(got, &log->data[off], CB_SEEK_SIZE) != 0) {
+			return fail("random read", (int)off);
+		}
+		seek_us += now_us() - t0;
+	}
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+
+	if (chunk) {
+		snprintf(name, sizeof(name), "z%lu", (unsigned long)chunk);
+	} else {
+		snprintf(name, sizeof(name), "%s", log_flag ? "log" : "plain");
+	}
+	printf("%-8s %-6s %8lu %6.2f %9lu %6lu %8.1f %8.1f %7lu %8.1f %8.1f\n", log->name, name,
+		   (unsigned long)stored, (double)log->size / stored,
+		   (unsigned long)st.page_programs * LFS_AT45_PAGE_SIZE, (unsigned long)st.block_erases,
+		   log->size * 1000000.0 / 1024.0 / write_us, log->size * 1000000.0 / 1024.0 / read_us,
+		   (unsigned long)(seek_us / CB_SEEKS), comp_ns, dec_ns);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	cb_log_t logs[4];
+	uint32_t bytes = 65536U, nlogs = 3U;
+	const char *path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			sync_every = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			path = argv[++i];
+		} else {
+			bytes = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+	if (bytes < 1024U || bytes > CB_BYTES_MAX) {
+		fprintf(stderr, "usage: compress_bench [bytes 1024..%u] [-s records] [-f file] [-max]\n",
+				CB_BYTES_MAX);
+		return 1;
+	}
+
+	if (gen_csv(&logs[0], bytes) || gen_events(&logs[1], bytes) || gen_binary(&logs[2], bytes)) {
+		return 1;
+	}
+	if (path) {
+		if (load_file(&logs[3], path, bytes)) {
+			return 1;
+		}
+		nlogs++;
+	}
+
+	printf("%-8s %-6s %8s %6s %9s %6s %8s %8s %7s %8s %8s\n", "log", "mode", "stored", "ratio",
+		   "prog_B", "erases", "wr_KB/s", "rd_KB/s", "seek_us", "comp_ns", "dec_ns");
+	for (uint32_t l = 0; l < nlogs; l++) {
+		if (logs[l].size < CB_SEEK_SIZE + 1U) {
+			return fail("log too short", (int)logs[l].size);
+		}
+		if (run(&logs[l], 0, 0) || run(&logs[l], 0, 1)) {
+			return 1;
+		}
+		for (uint32_t c = 0; c < sizeof(cb_chunks) / sizeof(cb_chunks[0]); c++) {
+			if (run(&logs[l], cb_chunks[c], 0)) {
+				return 1;
+			}
+		}
+		free(logs[l].data);
+		free(logs[l].ends);
+	}
+
+	return 0;
+}
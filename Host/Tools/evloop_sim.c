@@ -0,0 +1,308 @@
+/*
+ * evloop_sim.c
+ *
+ *  Host simulation of a combined log-and-upload workload on the event loop
+ *  (Src/evloop.c), driven by the virtual clock of the clock model.
+ *
+ *  usage: evloop_sim [pages] [sample_period_us]
+ *
+ *  A periodic timer samples a sensor (16 bytes every 2ms by default, 20us of CPU work each).
+ *  A writer task programs every full 256 byte page to the AT45 and an uploader task reads
+ *  the written pages back and sends them over USART2 at BAUDRATE. The firmware drivers
+ *  do the work: at45db041.c and spi.c run on the SPI and AT45 models (spi_model.c,
+ *  at45_model.c), so the bus and the device take their modelled times, and uart.c runs
+ *  on the registers of the RCC model. The USART has no line model: its time is added
+ *  by the tool, and a timer at the frame rate stands in for the TXE/TC interrupt.
+ *
+ *  The workload runs twice: once with the blocking functions (at45db_program(),
+ *  USARTx_transmit()), where the CPU waits for every operation, and once with
+ *  at45db_program_async() and USARTx_transmit_async(), which post their completion to
+ *  the loop. The read back is at45db_read_continuous() in both runs, the driver has no
+ *  asynchronous read. Every page read back must match what was written. For each run
+ *  the time to upload every page, the utilisation of each peripheral (the SPI and the
+ *  AT45 from the counters of their models) and the worst lateness of the sampling timer
+ *  are printed as CSV. Exit status 1 on a difference or a command the device ignored.
+ */
+
+#include <stdlib.h>
+#include "system_init.h"
+#include "at45db041.h"
+#include "uart.h"
+
+#define SIM_SAMPLE_PERIOD_US	2000U	/*Default*/
+#define SIM_SAMPLE_SIZE			16U
+#define SIM_SAMPLE_CPU_US		20U
+#define SIM_PAGE_SIZE			256U
+#define SIM_PAGES_MAX			2048U
+
+/*Time of a USART frame, 10 bits, rounded up*/
+#define SIM_UART_FRAME_US		((10U * 1000000U + BAUDRATE - 1U) / BAUDRATE)
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static ev_resource_t res_cpu  = { .name = "cpu" };
+static ev_resource_t res_uart = { .name = "usart" };
+
+static ev_task_t writer;
+static ev_task_t uploader;
+static ev_timer_t sample_timer;
+static ev_timer_t uart_line;
+
+static uint8_t  wr_page[SIM_PAGE_SIZE];
+static char     up_page[SIM_PAGE_SIZE];
+
+static uint8_t  sim_blocking;
+static uint32_t sim_pages;
+static uint32_t sim_period_us;
+static uint32_t sample_bytes;
+static uint32_t pages_filled;
+static uint32_t pages_written;
+static uint32_t pages_uploaded;
+static uint32_t mismatches;
+static uint32_t failures;
+static uint8_t  programming;
+static uint8_t  sending;
+static uint32_t next_sample_us;
+static uint32_t max_late_us;
+static volatile uint8_t finished;
+
+
+static void signal_all(void)
+{
+	evloop_task_signal(&writer);
+	evloop_task_signal(&uploader);
+}
+
+/**
+ * @brief Content of a page, from the page number.
+ */
+static uint8_t page_byte(uint32_t page, uint32_t i)
+{
+	return (uint8_t)(page * 31U + i * 7U + (i >> 4));
+}
+
+static void programmed(void *arg, uint32_t data)
+{
+	(void)arg;
+
+	if (!data) {
+		failures++;
+	}
+	programming = 0;
+	pages_written++;
+	signal_all();
+}
+
+static void sent(void *arg, uint32_t data)
+{
+	(void)arg;
+	(void)data;
+
+	evloop_timer_stop(&uart_line);
+	evloop_resource_end(&res_uart);
+	sending = 0;
+	pages_uploaded++;
+	evloop_task_signal(&uploader);
+}
+
+/**
+ * @brief The TXE and TC interrupts of USART2, once per frame while one is enabled.
+ */
+static void uart_irq(void *arg, uint32_t data)
+{
+	(void)arg;
+	(void)data;
+
+	if (READ_BIT(USART2->CR1, USART_CR1_TXEIE | USART_CR1_TCIE)) {
+		USARTx_irq_handler(USART2);
+	}
+}
+
+static void sample(void *arg, uint32_t data)
+{
+	uint32_t late = timebase_us() - next_sample_us;
+
+	(void)arg;
+	(void)data;
+
+	if ((int32_t)late > 0 && late > max_late_us) {
+		max_late_us = late;
+	}
+	next_sample_us += sim_period_us;
+
+	/*Filter and format the sample*/
+	evloop_resource_begin(&res_cpu);
+	clock_model_advance_us(SIM_SAMPLE_CPU_US);
+	evloop_resource_end(&res_cpu);
+
+	sample_bytes += SIM_SAMPLE_SIZE;
+	if (sample_bytes >= SIM_PAGE_SIZE) {
+		sample_bytes = 0;
+		pages_filled++;
+		evloop_task_signal(&writer);
+
+		if (pages_filled == sim_pages) {
+			evloop_timer_stop(&sample_timer);
+		}
+	}
+}
+
+static int writer_run(ev_task_t *t)
+{
+	PT_BEGIN(&t->pt);
+
+	while (pages_written < sim_pages) {
+		PT_WAIT_UNTIL(&t->pt, pages_written < pages_filled);
+
+		for (uint32_t i = 0; i < SIM_PAGE_SIZE; i++) {
+			wr_page[i] = page_byte(pages_written, i);
+		}
+
+		if (sim_blocking) {
+			/*Buffer load, page program and the wait for the end*/
+			at45db_program(pages_written * SIM_PAGE_SIZE, wr_page, SIM_PAGE_SIZE);
+			programmed(NULL, at45db_fault_check() ? 0 : 1);
+		} else {
+			/*The device programs while the loop runs, the bus is free meanwhile*/
+			programming = 1;
+			if (!at45db_program_async(pages_written * SIM_PAGE_SIZE, wr_page, SIM_PAGE_SIZE, programmed, NULL)) {
+				programming = 0;
+				failures++;
+				pages_written++;
+			}
+			PT_WAIT_UNTIL(&t->pt, !programming);
+		}
+	}
+
+	PT_END(&t->pt);
+}
+
+static int uploader_run(ev_task_t *t)
+{
+	PT_BEGIN(&t->pt);
+
+	while (pages_uploaded < sim_pages) {
+		/*The device ignores a read while it programs*/
+		PT_WAIT_UNTIL(&t->pt, pages_uploaded < pages_written && !programming);
+
+		at45db_read_continuous(pages_uploaded * SIM_PAGE_SIZE, (uint8_t *)up_page, SIM_PAGE_SIZE);
+		for (uint32_t i = 0; i < SIM_PAGE_SIZE; i++) {
+			if ((uint8_t)up_page[i] != page_byte(pages_uploaded, i)) {
+				mismatches++;
+				break;
+			}
+		}
+		signal_all();
+
+		evloop_resource_begin(&res_uart);
+		sending = 1;
+		if (sim_blocking) {
+			USARTx_transmit(USART2, up_page, SIM_PAGE_SIZE);
+			clock_model_advance_us(SIM_PAGE_SIZE * 10ULL * 1000000U / BAUDRATE);
+			sent(NULL, SIM_PAGE_SIZE);
+		} else {
+			USARTx_transmit_async(USART2, up_page, SIM_PAGE_SIZE, sent, NULL);
+			evloop_timer_start(&uart_line, SIM_UART_FRAME_US, SIM_UART_FRAME_US, uart_irq, NULL);
+		}
+		PT_WAIT_UNTIL(&t->pt, !sending);
+	}
+
+	finished = 1;
+
+	PT_END(&t->pt);
+}
+
+/**
+ * @brief The board: 80MHz, the AT45 on SPI2 and the console on USART2. Both runs
+ * share it, at45db_init() prints what it finds.
+ */
+static void setup(void)
+{
+	clock_model_reset();
+	flash_model_reset();
+	spi_model_reset();
+	rcc_model_reset();
+	at45_model_reset();
+	timebase_init();
+	rcc_init();
+	rcc_set_profile(CLOCK_PLL_80MHZ);
+
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_init();
+	SET_BIT(USART2->CR1, USART_CR1_TE | USART_CR1_UE);
+	USARTx_set_baudrate(USART2, BAUDRATE, SystemCoreClock);
+}
+
+static int run(uint8_t blocking)
+{
+	at45_model_stats_t dev;
+	spi_model_stats_t bus;
+	uint32_t start, elapsed;
+
+	evloop_init();
+
+	res_cpu.busy_us  = 0;
+	res_cpu.ops      = 0;
+	res_uart.busy_us = 0;
+	res_uart.ops     = 0;
+	sim_blocking   = blocking;
+	sample_bytes   = 0;
+	pages_filled   = 0;
+	pages_written  = 0;
+	pages_uploaded = 0;
+	mismatches     = 0;
+	failures       = 0;
+	programming    = 0;
+	sending        = 0;
+	max_late_us    = 0;
+	finished       = 0;
+	spi_model_clear_stats();
+	at45_model_clear_stats();
+
+	start = timebase_us();
+	next_sample_us = start + sim_period_us;
+	evloop_timer_start(&sample_timer, sim_period_us, sim_period_us, sample, NULL);
+	evloop_task_start(&writer, writer_run);
+	evloop_task_start(&uploader, uploader_run);
+
+	evloop_run_until(&finished);
+	elapsed = timebase_elapsed_us(start);
+
+	spi_model_get_stats(&bus);
+	at45_model_get_stats(&dev);
+
+	printf("%s,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", blocking ? "blocking" : "evloop", sim_pages, sim_period_us,
+		   elapsed, evloop_resource_permille(&res_cpu, elapsed),
+		   (uint32_t)(bus.bus_cycles / (SystemCoreClock / 1000000U) * 1000U / elapsed),
+		   (uint32_t)(dev.busy_us * 1000U / elapsed), evloop_resource_permille(&res_uart, elapsed),
+		   max_late_us, evloop_dropped());
+
+	if (mismatches || failures || dev.rejected_busy || dev.aborted) {
+		fprintf(stderr, "FAIL: %s: %u pages differ, %u failed, %u commands ignored, %u aborted\n",
+				blocking ? "blocking" : "evloop", mismatches, failures, dev.rejected_busy, dev.aborted);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int res = 0;
+
+	sim_pages = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 64U;
+	sim_period_us = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : SIM_SAMPLE_PERIOD_US;
+	if (sim_pages == 0 || sim_pages > SIM_PAGES_MAX || sim_period_us <= SIM_SAMPLE_CPU_US) {
+		fprintf(stderr, "usage: %s [pages] [sample_period_us]\n", argv[0]);
+		return 1;
+	}
+
+	setup();
+
+	printf("mode,pages,sample_period_us,elapsed_us,cpu_permille,spi_permille,at45_permille,usart_permille,max_sample_late_us,dropped\n");
+	res |= run(1);
+	res |= run(0);
+
+	return res;
+}
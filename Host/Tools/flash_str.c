@@ -0,0 +1,158 @@
+/*
+ * flash_str.c
+ *
+ *  Checks bl_flash_write64_str() on the FLASH model: the program operations it
+ *  issues per KiB, the packed layout read back with bl_flash_read_str(), and the
+ *  old sparse layout (one byte per double-word) read back with
+ *  bl_flash_read64_str_sparse().
+ *
+ *  usage: flash_str
+ *
+ *  Every case erases the destination, by page or by a mass erase of its bank, writes
+ *  a string and compares the double-word and fast row programs the model counted with
+ *  the expected ones. The string must read back unchanged, the padding of the last
+ *  double-word must be 0xFF and the flash after FLASH_STR_SPAN() must stay erased.
+ *  One line per case is printed with the programs and the busy time per KiB. Exit
+ *  status 1 on any difference.
+ */
+
+#include <stdlib.h>
+#include "flash.h"
+
+#define FS_HZ				80000000U
+#define FS_LEN_MAX			2048U
+#define FS_PAGE				8U				/*First page of bank 2 used*/
+
+/**
+ * @brief A string written at an offset of a page, with the programs it must take.
+ */
+typedef struct {
+	const char *name;
+	uint32_t offset;			/*From the start of the page, double-word aligned*/
+	uint16_t len;
+	int mass;					/*Mass erase the bank instead of erasing the page*/
+	int sparse;					/*Old layout, one double-word per byte*/
+	uint32_t rows;				/*Expected fast rows*/
+	uint32_t dwords;			/*Expected double-word programs*/
+}fs_case_t;
+
+static const fs_case_t fs_cases[] = {
+	{ "packed/page",         0, 1024, 0, 0, 0,  128 },
+	{ "packed/mass",         0, 1024, 1, 0, 4,    0 },
+	{ "packed/mass+8",       8, 1024, 1, 0, 3,   32 },
+	{ "packed/page/1000",    0, 1000, 0, 0, 0,  125 },
+	{ "packed/mass/1000",    0, 1000, 1, 0, 3,   29 },
+	{ "packed/page/13",     16,   13, 0, 0, 0,    2 },
+	{ "sparse/page",         0,  256, 0, 1, 0,  256 },
+};
+
+static uint8_t src[FS_LEN_MAX];
+static uint8_t dst[FS_LEN_MAX];
+
+
+static int fail(const char *name, const char *what)
+{
+	fprintf(stderr, "FAIL: %s: %s\n", name, what);
+	return 1;
+}
+
+/**
+ * @brief The writer of the firmware before the packed layout: every byte in the low
+ * byte of its own double-word.
+ */
+static void sparse_write(uint32_t addr, const uint8_t *buf, uint16_t len)
+{
+	bl_flash_unlock();
+	for (uint32_t i = 0; i < len; i++) {
+		bl_flash_write64(addr + i*8, buf[i]);
+	}
+	bl_flash_lock();
+}
+
+static int run(const fs_case_t *c)
+{
+	uint32_t page = FS_PAGE;
+	uint32_t addr = FLASH_BASE + FLASH_BANK_SIZE + page*FLASH_PAGE_SIZE + c->offset;
+	uint32_t span = c->sparse ? (uint32_t)c->len * 8U : FLASH_STR_SPAN(c->len);
+	flash_model_stats_t st;
+	const uint8_t *p;
+
+	for (uint32_t i = 0; i < c->len; i++) {
+		src[i] = (uint8_t)rand();
+	}
+
+	/*Erase the destination*/
+	bl_flash_unlock();
+	if (c->mass) {
+		if (!bl_flash_mass_erase_bank((uint16_t)bl_flash_get_bank(addr))) {
+			return fail(c->name, "mass erase");
+		}
+	} else {
+		for (uint32_t pg = page; pg <= page + (c->offset + span + 8U) / FLASH_PAGE_SIZE; pg++) {
+			if (!bl_flash_page_erase(pg, (uint16_t)bl_flash_get_bank(addr))) {
+				return fail(c->name, "page erase");
+			}
+		}
+	}
+	bl_flash_lock();
+
+	flash_model_clear_stats();
+	if (c->sparse) {
+		sparse_write(addr, src, c->len);
+	} else if (!bl_flash_write64_str(addr, src, c->len)) {
+		return fail(c->name, "bl_flash_write64_str");
+	}
+	flash_model_get_stats(&st);
+
+	if (!READ_BIT(FLASH->CR, FLASH_CR_LOCK)) {
+		return fail(c->name, "left unlocked");
+	}
+	if (st.seq_errors) {
+		return fail(c->name, "sequence error");
+	}
+	if (st.row_programs != c->rows || st.dword_programs != c->dwords) {
+		fprintf(stderr, "FAIL: %s: %u rows, %u double-words, expected %u, %u\n", c->name,
+				st.row_programs, st.dword_programs, c->rows, c->dwords);
+		return 1;
+	}
+
+	/*Read back, check the padding and what follows the span*/
+	memset(dst, 0, sizeof(dst));
+	if (c->sparse) {
+		bl_flash_read64_str_sparse(addr, dst, c->len);
+	} else {
+		bl_flash_read_str(addr, dst, c->len);
+	}
+	if (memcmp(src, dst, c->len) != 0) {
+		return fail(c->name, "read back");
+	}
+	p = BL_FLASH_PTR(addr);
+	for (uint32_t i = c->sparse ? span : c->len; i < span + 8U; i++) {
+		if (p[i] != 0xFF) {
+			return fail(c->name, "padding or next double-word not erased");
+		}
+	}
+
+	printf("%-18s %6u %6u %6u %8.1f %10.1f\n", c->name, c->len, st.row_programs, st.dword_programs,
+		   (double)(st.row_programs + st.dword_programs) * 1024.0 / c->len,
+		   (double)st.busy_ns / 1000.0 * 1024.0 / c->len);
+
+	return 0;
+}
+
+int main(void)
+{
+	int res = 0;
+
+	clock_model_reset();
+	clock_model_set_hz(FS_HZ);
+	flash_model_reset();
+	srand(1);
+
+	printf("%-18s %6s %6s %6s %8s %10s\n", "case", "bytes", "rows", "dwords", "prog/KiB", "busy_us/KiB");
+	for (uint32_t i = 0; i < sizeof(fs_cases) / sizeof(fs_cases[0]); i++) {
+		res |= run(&fs_cases[i]);
+	}
+
+	return res;
+}
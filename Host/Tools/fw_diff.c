@@ -0,0 +1,497 @@
+/*
+ * fw_diff.c
+ *
+ *  Host tool that builds the patches applied by fw_delta_apply() (Src/fw_delta.c).
+ *
+ *  usage: fw_diff <old.bin> <new.bin> <patch.bin> [-v]
+ *         fw_diff -t
+ *
+ *  The op stream is produced greedily: exact matches against the old image become
+ *  COPY ops, the bytes that follow a match and still mostly agree with the old image
+ *  (relocated addresses, changed constants) become ADD ops, the rest is INSERT.
+ *
+ *  With -v the patch is applied by the firmware code itself: the old image is placed
+ *  in bank 1 of the FLASH model, the patch in a RAM backed littlefs, and the inactive
+ *  bank is compared with new.bin after fw_delta_apply().
+ *
+ *  With -t the tool checks itself on generated image pairs shaped like two builds of
+ *  the firmware: a vector table, functions ending with literal pools of absolute
+ *  addresses, and constant data. The new image of a pair has a constant edited, a
+ *  function grown (every address after it moves, as the linker relocates them), data
+ *  appended, or is a different program. Each patch is applied as with -v, then a patch
+ *  with a corrupted byte and a patch applied to the wrong running image must both be
+ *  rejected. Exit status 1 on any mismatch.
+ */
+
+#include <stdlib.h>
+#include "fw_delta.h"
+
+#define DIFF_MIN_MATCH		12
+#define DIFF_HASH_BITS		16
+#define DIFF_MAX_CHAIN		64
+#define DIFF_ADD_BLOCK		8
+
+/*Generated images of -t*/
+#define TEST_FUNCS			400
+#define TEST_VECTORS		98
+#define TEST_POOL			4		/*Literal words at the end of a function*/
+#define TEST_RODATA			8192
+#define TEST_SIZE_MAX		(160U * 1024U)
+
+typedef struct {
+	uint8_t *data;
+	uint32_t len;
+	uint32_t cap;
+}buf_t;
+
+static void buf_put(buf_t *b, const void *src, uint32_t len)
+{
+	if (b->len + len > b->cap) {
+		b->cap = (b->len + len) * 2;
+		b->data = realloc(b->data, b->cap);
+	}
+	memcpy(b->data + b->len, src, len);
+	b->len += len;
+}
+
+static void buf_varint(buf_t *b, uint32_t v)
+{
+	uint8_t c;
+
+	do {
+		c = v & 0x7F;
+		v >>= 7;
+		if (v) {
+			c |= 0x80;
+		}
+		buf_put(b, &c, 1);
+	} while (v);
+}
+
+static void buf_op(buf_t *b, uint8_t op)
+{
+	buf_put(b, &op, 1);
+}
+
+static uint8_t *load(const char *path, uint32_t *len)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *data;
+	long size;
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(size ? size : 1);
+	if (fread(data, 1, size, f) != (size_t)size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*len = (uint32_t)size;
+
+	return data;
+}
+
+static uint32_t hash4(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return (v * 2654435761U) >> (32 - DIFF_HASH_BITS);
+}
+
+static void flush_insert(buf_t *out, const uint8_t *nw, uint32_t from, uint32_t to)
+{
+	if (to > from) {
+		buf_op(out, FW_DELTA_OP_INSERT);
+		buf_varint(out, to - from);
+		buf_put(out, nw + from, to - from);
+	}
+}
+
+/**
+ * @brief Builds the op stream of new against old.
+ */
+static void diff(const uint8_t *old, uint32_t olen, const uint8_t *nw, uint32_t nlen, buf_t *out)
+{
+	int32_t *head = malloc(sizeof(int32_t) << DIFF_HASH_BITS);
+	int32_t *prev = malloc(sizeof(int32_t) * (olen ? olen : 1));
+	uint32_t i = 0;
+	uint32_t lit = 0;
+
+	memset(head, 0xFF, sizeof(int32_t) << DIFF_HASH_BITS);
+	for (uint32_t j = 0; j + 4 <= olen; j++) {
+		uint32_t h = hash4(old + j);
+		prev[j] = head[h];
+		head[h] = (int32_t)j;
+	}
+
+	while (i < nlen) {
+		uint32_t best_len = 0;
+		uint32_t best_off = 0;
+
+		/*Longest exact match among the candidates of the hash chain*/
+		if (i + 4 <= nlen) {
+			int32_t cand = head[hash4(nw + i)];
+			for (int n = 0; cand >= 0 && n < DIFF_MAX_CHAIN; n++, cand = prev[cand]) {
+				uint32_t l = 0;
+				while (i + l < nlen && cand + l < olen && nw[i + l] == old[cand + l]) {
+					l++;
+				}
+				if (l > best_len) {
+					best_len = l;
+					best_off = (uint32_t)cand;
+				}
+			}
+		}
+
+		if (best_len < DIFF_MIN_MATCH) {
+			i++;
+			continue;
+		}
+
+		flush_insert(out, nw, lit, i);
+		buf_op(out, FW_DELTA_OP_COPY);
+		buf_varint(out, best_off);
+		buf_varint(out, best_len);
+		i += best_len;
+		best_off += best_len;
+
+		/*Extend with whole blocks where at least half of the bytes still match. A block that
+		  matches completely ends the extension, an exact COPY is cheaper from there on*/
+		uint32_t ext = 0;
+		while (i + ext + DIFF_ADD_BLOCK <= nlen && best_off + ext + DIFF_ADD_BLOCK <= olen) {
+			int same = 0;
+			for (int k = 0; k < DIFF_ADD_BLOCK; k++) {
+				same += nw[i + ext + k] == old[best_off + ext + k];
+			}
+			if (same < DIFF_ADD_BLOCK / 2 || same == DIFF_ADD_BLOCK) {
+				break;
+			}
+			ext += DIFF_ADD_BLOCK;
+		}
+
+		if (ext) {
+			buf_op(out, FW_DELTA_OP_ADD);
+			buf_varint(out, best_off);
+			buf_varint(out, ext);
+			for (uint32_t k = 0; k < ext; k++) {
+				uint8_t d = (uint8_t)(nw[i + k] - old[best_off + k]);
+				buf_put(out, &d, 1);
+			}
+			i += ext;
+		}
+
+		lit = i;
+	}
+
+	flush_insert(out, nw, lit, nlen);
+	buf_op(out, FW_DELTA_OP_END);
+
+	free(head);
+	free(prev);
+}
+
+/*RAM block device for the verification*/
+#define RAM_BLOCK_SIZE		2048
+#define RAM_BLOCK_COUNT		256
+static uint8_t ram_bd[RAM_BLOCK_SIZE * RAM_BLOCK_COUNT];
+
+static int ram_read(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, void *buf, lfs_size_t size)
+{
+	memcpy(buf, &ram_bd[b * c->block_size + off], size);
+	return 0;
+}
+
+static int ram_prog(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, const void *buf, lfs_size_t size)
+{
+	memcpy(&ram_bd[b * c->block_size + off], buf, size);
+	return 0;
+}
+
+static int ram_erase(const struct lfs_config *c, lfs_block_t b)
+{
+	memset(&ram_bd[b * c->block_size], 0xFF, c->block_size);
+	return 0;
+}
+
+static int ram_sync(const struct lfs_config *c)
+{
+	(void)c;
+	return 0;
+}
+
+/**
+ * @brief Places the old image in bank 1 of the FLASH model and the patch in a RAM
+ * backed littlefs, then runs fw_delta_apply().
+ * @retval The result of fw_delta_apply().
+ */
+static int apply(const uint8_t *old, uint32_t olen, const buf_t *patch)
+{
+	const struct lfs_config cfg = {
+		.read = ram_read, .prog = ram_prog, .erase = ram_erase, .sync = ram_sync,
+		.read_size = 256, .prog_size = 256, .block_size = RAM_BLOCK_SIZE,
+		.block_count = RAM_BLOCK_COUNT, .cache_size = 256, .lookahead_size = 32,
+		.block_cycles = 500,
+	};
+	fw_image_hdr_t hdr;
+	lfs_file_t file;
+	lfs_t lfs;
+	int res;
+
+	/*Running image in bank 1*/
+	flash_model_reset();
+	bl_flash_unlock();
+	for (uint32_t off = 0; off < olen; off += FLASH_PG_SIZE) {
+		bl_flash_page_erase(bl_flash_get_page(FLASH_BASE + off), bl_flash_get_bank(FLASH_BASE + off));
+		bl_flash_program(FLASH_BASE + off, old + off, (olen - off < FLASH_PG_SIZE) ? olen - off : FLASH_PG_SIZE);
+	}
+	bl_flash_lock();
+
+	/*Patch in littlefs*/
+	lfs_format(&lfs, &cfg);
+	lfs_mount(&lfs, &cfg);
+	lfs_file_open(&lfs, &file, "patch", LFS_O_WRONLY | LFS_O_CREAT);
+	lfs_file_write(&lfs, &file, patch->data, patch->len);
+	lfs_file_close(&lfs, &file);
+
+	res = fw_delta_apply(&lfs, "patch", &hdr);
+	lfs_unmount(&lfs);
+
+	return res;
+}
+
+static int verify(const uint8_t *old, uint32_t olen, const uint8_t *nw, uint32_t nlen, const buf_t *patch)
+{
+	int res = apply(old, olen, patch);
+
+	if (res != FW_UPDATE_OK) {
+		fprintf(stderr, "fw_delta_apply failed (%d)\n", res);
+		return 1;
+	}
+	if (memcmp(flash_model_ptr(FW_UPDATE_BANK_ADDR), nw, nlen) != 0) {
+		fprintf(stderr, "inactive bank does not match the new image\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Builds the patch of new against old, header and op stream.
+ */
+static void make_patch(const uint8_t *old, uint32_t olen, const uint8_t *nw, uint32_t nlen, buf_t *patch)
+{
+	fw_delta_hdr_t hdr;
+
+	hdr.magic         = FW_DELTA_MAGIC;
+	hdr.old_size      = olen;
+	hdr.old_crc       = lfs_crc(0xFFFFFFFF, old, olen);
+	hdr.image.magic   = FW_UPDATE_MAGIC;
+	hdr.image.size    = nlen;
+	hdr.image.crc     = lfs_crc(0xFFFFFFFF, nw, nlen);
+	hdr.image.version = 0;
+	patch->len = 0;
+	buf_put(patch, &hdr, sizeof(hdr));
+
+	diff(old, olen, nw, nlen, patch);
+}
+
+/**
+ * @brief A change between the old and the new build of a generated image.
+ */
+typedef struct {
+	const char *name;
+	uint32_t seed;			/*Program, a different one is a rebuild from other sources*/
+	int32_t grow_fn;		/*Function that grows, -1 for none*/
+	uint32_t grow;			/*Bytes added in its middle*/
+	int32_t edit_fn;		/*Function with a constant changed, -1 for none*/
+	uint32_t append;		/*Constant data appended*/
+}test_build_t;
+
+static const test_build_t test_old = { "old", 1, -1, 0, -1, 0 };
+
+static const test_build_t test_new[] = {
+	{ "identical",     1,  -1,   0,  -1,    0 },
+	{ "constant",      1,  -1,   0, 200,    0 },
+	{ "grow",          1, 120, 180,  -1,    0 },
+	{ "grow+constant", 1,  40,  64, 300,    0 },
+	{ "append",        1,  -1,   0,  -1, 4096 },
+	{ "rebuild",       2,  -1,   0,  -1,    0 },
+};
+
+static uint32_t test_rand(uint32_t *state)
+{
+	/*xorshift32, the images are the same on every host*/
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static void test_put32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+/**
+ * @brief Links a generated build: vector table, functions and constant data.
+ * @retval The size of the image.
+ */
+static uint32_t test_link(uint8_t *img, const test_build_t *b)
+{
+	static uint32_t addr[TEST_FUNCS];
+	static uint32_t size[TEST_FUNCS];
+	uint32_t pos = TEST_VECTORS * 4;
+	uint32_t rng;
+
+	/*Layout*/
+	for (uint32_t f = 0; f < TEST_FUNCS; f++) {
+		rng = b->seed * 0x9E3779B9U + f + 1;
+		size[f] = 64 + (test_rand(&rng) % 384) / 4 * 4;
+		if ((int32_t)f == b->grow_fn) {
+			size[f] += b->grow;
+		}
+		addr[f] = pos;
+		pos += size[f];
+	}
+
+	for (uint32_t i = 0; i < TEST_VECTORS; i++) {
+		test_put32(img + i*4, (FLASH_BASE + addr[(i * 3) % TEST_FUNCS]) | 1);
+	}
+
+	/*Code, the instructions come from the function, the added ones from elsewhere*/
+	for (uint32_t f = 0; f < TEST_FUNCS; f++) {
+		uint8_t *p = img + addr[f];
+		uint32_t code = size[f] - TEST_POOL*4;
+		uint32_t mid = ((int32_t)f == b->grow_fn) ? (code - b->grow) / 2 : code;
+
+		rng = b->seed * 0x85EBCA6BU + f + 1;
+		for (uint32_t i = 0; i < code; i += 2) {
+			uint32_t r;
+
+			if (i >= mid && i < mid + b->grow) {
+				uint32_t g = 0xC2B2AE35U + i;
+				r = test_rand(&g);
+			} else {
+				r = test_rand(&rng);
+			}
+			p[i]     = (uint8_t)r;
+			p[i + 1] = (uint8_t)(r >> 8);
+		}
+		if ((int32_t)f == b->edit_fn) {
+			p[8] ^= 0x5A;
+		}
+
+		for (uint32_t k = 0; k < TEST_POOL; k++) {
+			test_put32(p + code + k*4, (FLASH_BASE + addr[(f * 13 + k * 7) % TEST_FUNCS]) | 1);
+		}
+	}
+
+	/*Constant data, text that compresses like format strings*/
+	rng = b->seed * 0x27D4EB2FU;
+	for (uint32_t i = 0; i < TEST_RODATA + b->append; i++) {
+		img[pos + i] = (uint8_t)("abcdefghij %d\n\r"[test_rand(&rng) % 16]);
+	}
+
+	return pos + TEST_RODATA + b->append;
+}
+
+/**
+ * @brief Self check of -t, see the header of the file.
+ */
+static int self_test(void)
+{
+	uint8_t *old = malloc(TEST_SIZE_MAX);
+	uint8_t *nw = malloc(TEST_SIZE_MAX);
+	buf_t patch = {0};
+	uint32_t olen;
+	uint32_t nlen;
+	int fails = 0;
+	int res;
+
+	olen = test_link(old, &test_old);
+	printf("%-14s %7s %7s %7s %6s\n", "build", "old", "new", "patch", "%new");
+	for (uint32_t t = 0; t < sizeof(test_new) / sizeof(test_new[0]); t++) {
+		nlen = test_link(nw, &test_new[t]);
+		make_patch(old, olen, nw, nlen, &patch);
+		res = verify(old, olen, nw, nlen, &patch);
+		printf("%-14s %7u %7u %7u %6.1f %s\n", test_new[t].name, (unsigned)olen, (unsigned)nlen,
+			   (unsigned)patch.len, 100.0 * patch.len / nlen, res ? "FAIL" : "ok");
+		fails += res;
+	}
+
+	/*A corrupted patch, the appended data is the INSERT before the END op*/
+	nlen = test_link(nw, &test_new[4]);
+	make_patch(old, olen, nw, nlen, &patch);
+	patch.data[patch.len - 2] ^= 0x01;
+	res = apply(old, olen, &patch);
+	printf("%-14s %s (%d)\n", "corrupted", (res == FW_UPDATE_ERR_CRC) ? "rejected" : "FAIL", res);
+	fails += (res != FW_UPDATE_ERR_CRC);
+
+	/*The patch of another running image*/
+	patch.data[patch.len - 2] ^= 0x01;
+	nlen = test_link(nw, &test_new[1]);
+	res = apply(nw, nlen, &patch);
+	printf("%-14s %s (%d)\n", "wrong base", (res == FW_UPDATE_ERR_HEADER) ? "rejected" : "FAIL", res);
+	fails += (res != FW_UPDATE_ERR_HEADER);
+
+	free(patch.data);
+	free(old);
+	free(nw);
+
+	return fails ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	buf_t patch = {0};
+	uint32_t olen;
+	uint32_t nlen;
+	uint8_t *old;
+	uint8_t *nw;
+	FILE *f;
+
+	if (argc == 2 && strcmp(argv[1], "-t") == 0) {
+		return self_test();
+	}
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <old.bin> <new.bin> <patch.bin> [-v]\n       %s -t\n", argv[0], argv[0]);
+		return 2;
+	}
+
+	old = load(argv[1], &olen);
+	nw  = load(argv[2], &nlen);
+
+	if (olen > FW_UPDATE_MAX_SIZE || nlen > FW_UPDATE_MAX_SIZE || nlen == 0) {
+		fprintf(stderr, "images must be 1..%u bytes\n", (unsigned)FW_UPDATE_MAX_SIZE);
+		return 1;
+	}
+
+	make_patch(old, olen, nw, nlen, &patch);
+
+	f = fopen(argv[3], "wb");
+	if (!f || fwrite(patch.data, 1, patch.len, f) != patch.len) {
+		perror(argv[3]);
+		return 1;
+	}
+	fclose(f);
+
+	printf("old %u bytes, new %u bytes, patch %u bytes (%.1f%% of new)\n",
+		   (unsigned)olen, (unsigned)nlen, (unsigned)patch.len, 100.0 * patch.len / nlen);
+
+	if (argc > 4 && strcmp(argv[4], "-v") == 0) {
+		if (verify(old, olen, nw, nlen, &patch)) {
+			return 1;
+		}
+		printf("verified with fw_delta_apply()\n");
+	}
+
+	return 0;
+}
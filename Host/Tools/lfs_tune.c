@@ -0,0 +1,212 @@
+/*
+ * lfs_tune.c
+ *
+ *  Sweep of the littlefs tuning parameters of the AT45 file system (cache_size,
+ *  lookahead_size, block_cycles) on the AT45 model, with the block device counters
+ *  and latency histograms of littlefs (built with LFS_STATS).
+ *
+ *  usage: lfs_tune [-max]
+ *
+ *  For every combination the same workload runs on a new device: a mount, log
+ *  appends with a sync each, rewrites of small configuration files and a 32KB file
+ *  written and read back. One CSV line per combination gives the virtual time of
+ *  the workload, the block device counters of lfs_stats() and, per API call, the
+ *  p50 and p99 (upper edge of the histogram bucket) and the maximum latency. The
+ *  latencies are bus and device time, the CPU time of littlefs is not counted.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+
+#ifndef LFS_STATS
+#error "lfs_tune needs the statistics of littlefs, build with -DLFS_STATS"
+#endif
+
+#define TUNE_HZ				80000000U
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static const lfs_size_t tune_cache[]     = { 256, 512, 1024, 2048 };
+static const lfs_size_t tune_lookahead[] = { 8, 32 };
+static const int32_t    tune_cycles[]    = { 100, 500, -1 };
+
+static const char *const tune_ops[LFS_STATS_OPS] = {
+	"mount", "open", "read", "write", "sync", "close", "remove", "rename"
+};
+
+static const at45_model_timing_t tune_max = {
+	400U, AT45_TEP_US, 4000U, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+};
+
+static int max_timing;
+static lfs_t lfs;
+static lfs_file_t file;
+static uint8_t buf[512];
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+/**
+ * @brief Upper edge of the histogram bucket that holds the given fraction of the calls.
+ */
+static uint32_t percentile_us(const struct lfs_stats *st, int op, uint32_t permille)
+{
+	uint32_t want = (st->calls[op] * permille + 999U) / 1000U;
+	uint32_t seen = 0;
+
+	for (uint32_t b = 0; b < LFS_STATS_BUCKETS; b++) {
+		seen += st->hist[op][b];
+		if (seen >= want && seen) {
+			return (b == 0) ? 0 : (1U << b) - 1U;
+		}
+	}
+	return st->max_us[op];
+}
+
+static int workload(void)
+{
+	char name[16];
+	lfs_ssize_t n;
+	int res;
+
+	res = lfs_file_open(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+	if (res < 0) {
+		return fail("log open", res);
+	}
+	for (uint32_t i = 0; i < 300U; i++) {
+		memset(buf, (int)i, 40U);
+		if (lfs_file_write(&lfs, &file, buf, 40U) != 40 || lfs_file_sync(&lfs, &file) < 0) {
+			return fail("log append", LFS_ERR_IO);
+		}
+	}
+	lfs_file_close(&lfs, &file);
+
+	for (uint32_t i = 0; i < 100U; i++) {
+		snprintf(name, sizeof(name), "cfg%u", i % 6U);
+		res = lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+		if (res < 0) {
+			return fail("cfg open", res);
+		}
+		memset(buf, (int)i, 96U);
+		lfs_file_write(&lfs, &file, buf, 96U);
+		lfs_file_close(&lfs, &file);
+	}
+
+	res = lfs_file_open(&lfs, &file, "blob", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+	if (res < 0) {
+		return fail("blob open", res);
+	}
+	for (uint32_t off = 0; off < 32768U; off += sizeof(buf)) {
+		memset(buf, (int)(off >> 9), sizeof(buf));
+		if (lfs_file_write(&lfs, &file, buf, sizeof(buf)) != (lfs_ssize_t)sizeof(buf)) {
+			return fail("blob write", LFS_ERR_IO);
+		}
+	}
+	lfs_file_close(&lfs, &file);
+
+	res = lfs_file_open(&lfs, &file, "blob", LFS_O_RDONLY);
+	if (res < 0) {
+		return fail("blob open", res);
+	}
+	while ((n = lfs_file_read(&lfs, &file, buf, 100U)) > 0) {
+		;
+	}
+	lfs_file_close(&lfs, &file);
+	if (n < 0) {
+		return fail("blob read", (int)n);
+	}
+
+	res = lfs_rename(&lfs, "cfg0", "cfg0.old");
+	if (res < 0) {
+		return fail("rename", res);
+	}
+	return (lfs_remove(&lfs, "cfg0.old") < 0) ? fail("remove", LFS_ERR_IO) : 0;
+}
+
+static int run(lfs_size_t cache, lfs_size_t lookahead, int32_t cycles)
+{
+	struct lfs_config cfg = lfs_at45_cfg;
+	struct lfs_stats st;
+	uint64_t t0;
+	int res;
+
+	clock_model_reset();
+	clock_model_set_hz(TUNE_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&tune_max);
+	}
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+
+	cfg.cache_size       = cache;
+	cfg.lookahead_size   = lookahead;
+	cfg.block_cycles     = cycles;
+	cfg.read_buffer      = malloc(cache);
+	cfg.prog_buffer      = malloc(cache);
+	cfg.lookahead_buffer = malloc(lookahead);
+
+	res = lfs_format(&lfs, &cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("format", res);
+	}
+	t0 = clock_model_cycles();
+	res = lfs_mount(&lfs, &cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("mount", res);
+	}
+	if (workload()) {
+		return 1;
+	}
+	lfs_stats(&lfs, &st);
+	lfs_unmount(&lfs);
+
+	printf("%u,%u,%d,%llu,%u,%u,%u,%u,%u,%llu,%u,%llu,%u,%u,%u,%u,%llu",
+		   cache, lookahead, cycles,
+		   (unsigned long long)((clock_model_cycles() - t0) / (SystemCoreClock / 1000000U)),
+		   st.read_calls, st.read_pcache_hits, st.read_rcache_hits, st.read_bypasses, st.read_fills,
+		   (unsigned long long)st.read_dev_bytes, st.flush_progs, (unsigned long long)st.flush_bytes,
+		   st.erase_calls, st.commit_calls, st.compact_calls, st.cmp_calls, (unsigned long long)st.cmp_bytes);
+	for (int op = 0; op < LFS_STATS_OPS; op++) {
+		printf(",%u,%u,%u", percentile_us(&st, op, 500U), percentile_us(&st, op, 990U), st.max_us[op]);
+	}
+	printf("\n");
+
+	free(cfg.read_buffer);
+	free(cfg.prog_buffer);
+	free(cfg.lookahead_buffer);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	max_timing = (argc > 1 && strcmp(argv[1], "-max") == 0);
+
+	printf("cache_size,lookahead_size,block_cycles,virtual_us,read_calls,pcache_hits,rcache_hits,"
+		   "bypasses,fills,dev_read_bytes,progs,prog_bytes,erases,commits,compacts,cmp_calls,cmp_bytes");
+	for (int op = 0; op < LFS_STATS_OPS; op++) {
+		printf(",%s_p50_us,%s_p99_us,%s_max_us", tune_ops[op], tune_ops[op], tune_ops[op]);
+	}
+	printf("\n");
+
+	for (uint32_t c = 0; c < sizeof(tune_cache)/sizeof(tune_cache[0]); c++) {
+		for (uint32_t l = 0; l < sizeof(tune_lookahead)/sizeof(tune_lookahead[0]); l++) {
+			for (uint32_t b = 0; b < sizeof(tune_cycles)/sizeof(tune_cycles[0]); b++) {
+				if (run(tune_cache[c], tune_lookahead[l], tune_cycles[b])) {
+					return 1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,415 @@
+/*
+ * log_append.c
+ *
+ *  Write amplification of a synced log on the AT45 model, with and without
+ *  LFS_O_LOG.
+ *
+ *  usage: log_append [records] [record_size] [-max]
+ *
+ *  A new file system gets one log file, opened with LFS_O_APPEND, and [records]
+ *  (default 1000) records of [record_size] (default 64) bytes are appended to it,
+ *  each followed by lfs_file_sync(). Without LFS_O_LOG the first append after a sync
+ *  copies the last block of the file to a new one; with it the append continues in
+ *  that block and only its last page is programmed again. For each mode the bytes
+ *  programmed (AT45 pages x 256) and the block erases per appended byte and per
+ *  record are printed, with the p50, p99 and p100 of the append (write and sync)
+ *  time. The log is read back after a remount and checked. The times are bus and
+ *  device time at 80MHz, the CPU time of littlefs is not counted.
+ *
+ *  Two more cases check when the append stays in the last block. A log truncated in
+ *  the middle of a page gets more records with LFS_O_LOG, on the same file and after
+ *  a reopen: no program may change a byte that is already programmed. And a log with
+ *  LFS_O_LOG on lfs_iflash.c over the FLASH model, where a double-word can only be
+ *  programmed once, gets 40 synced records of 13 bytes: the flag is ignored there and
+ *  every record must be written. Exit status 1 on a failure.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "lfs_iflash.h"
+#include "mem_pool.h"
+
+#define LA_HZ				80000000U
+#define LA_RECORD_MAX		1024U
+#define LA_TRUNC_RECORDS	40U			/*Records of 64 bytes before the truncate, over a block*/
+#define LA_TRUNC_RECORD		64U
+#define LA_TRUNC_SIZE		2300U		/*Size it truncates to, inside a page*/
+#define LA_HOT_RECORDS		40U
+#define LA_HOT_SIZE			13U
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static const at45_model_timing_t la_max = {
+	400U, AT45_TEP_US, AT45_TP_US, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+};
+
+static int max_timing;
+static lfs_t lfs;
+static lfs_file_t file;
+static uint32_t overwrites;
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)(clock_model_cycles() / (SystemCoreClock / 1000000U));
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t pct(uint32_t *v, uint32_t n, uint32_t permille)
+{
+	return n ? v[((uint64_t)(n - 1U) * permille) / 1000U] : 0U;
+}
+
+/**
+ * @brief Content of a record, different for each one.
+ */
+static void record(uint8_t *rec, uint32_t size, uint32_t n)
+{
+	for (uint32_t i = 0; i < size; i++) {
+		rec[i] = (uint8_t)(n * 7U + i);
+	}
+}
+
+/**
+ * @brief Reads the log back after a remount.
+ */
+static int check(uint32_t records, uint32_t size)
+{
+	uint8_t rec[LA_RECORD_MAX], got[LA_RECORD_MAX];
+	int res;
+
+	res = lfs_mount(&lfs, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("remount", res);
+	}
+	res = lfs_file_open(&lfs, &file, "log", LFS_O_RDONLY);
+	if (res < 0) {
+		return fail("reopen", res);
+	}
+	for (uint32_t n = 0; n < records; n++) {
+		record(rec, size, n);
+		res = lfs_file_read(&lfs, &file, got, size);
+		if (res != (int)size || memcmp(rec, got, size) != 0) {
+			return fail("record", (int)n);
+		}
+	}
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+
+	return 0;
+}
+
+/**
+ * @brief Page program of lfs_at45.c that counts the programmed bytes it would change:
+ * a program again of a page may only add bytes after the programmed ones.
+ */
+static int la_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer,
+				   lfs_size_t size)
+{
+	uint8_t old[LFS_AT45_PAGE_SIZE];
+	const uint8_t *data = buffer;
+
+	for (lfs_size_t i = 0; i < size; i += sizeof(old)) {
+		lfs_at45_read(c, block, off + i, old, sizeof(old));
+		for (uint32_t j = 0; j < sizeof(old); j++) {
+			if (old[j] != 0xFF && old[j] != data[i + j]) {
+				overwrites++;
+				break;
+			}
+		}
+	}
+
+	return lfs_at45_prog(c, block, off, buffer, size);
+}
+
+/**
+ * @brief Compares len bytes of the log at off with the start of record n.
+ */
+static int check_record(lfs_file_t *f, uint32_t off, uint32_t n, uint32_t len, uint32_t size)
+{
+	uint8_t rec[LA_RECORD_MAX], got[LA_RECORD_MAX];
+
+	record(rec, size, n);
+	if (lfs_file_seek(&lfs, f, (lfs_soff_t)off, LFS_SEEK_SET) != (lfs_soff_t)off ||
+		lfs_file_read(&lfs, f, got, len) != (lfs_ssize_t)len) {
+		return 1;
+	}
+
+	return memcmp(rec, got, len) != 0;
+}
+
+static void board(void)
+{
+	clock_model_reset();
+	clock_model_set_hz(LA_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&la_max);
+	}
+	flash_model_reset();
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+}
+
+/**
+ * @brief Appends n records with LFS_O_LOG from record first, each synced.
+ */
+static int append(lfs_file_t *f, uint32_t first, uint32_t n, uint32_t size)
+{
+	uint8_t rec[LA_RECORD_MAX];
+	int res;
+
+	for (uint32_t i = first; i < first + n; i++) {
+		record(rec, size, i);
+		res = lfs_file_write(&lfs, f, rec, size);
+		if (res != (int)size) {
+			return (res < 0) ? res : LFS_ERR_IO;
+		}
+		res = lfs_file_sync(&lfs, f);
+		if (res < 0) {
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief A log truncated inside a page, then appended to on the same file and after a
+ * reopen. The bytes past the new size are programmed, the appends must not program
+ * the page again in place.
+ */
+static int check_truncate(void)
+{
+	struct lfs_config cfg = lfs_at45_cfg;
+	const int flags = LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND | LFS_O_LOG;
+	const uint32_t size = LA_TRUNC_RECORD;
+	const uint32_t end = LA_TRUNC_SIZE;
+	int res;
+
+	board();
+	cfg.prog = la_prog;
+	res = lfs_format(&lfs, &cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &cfg);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &file, "log", flags);
+	}
+	if (res == LFS_ERR_OK) {
+		res = append(&file, 0, LA_TRUNC_RECORDS, size);
+	}
+	if (res < 0) {
+		return fail("truncate: log", res);
+	}
+
+	overwrites = 0;
+	/*The truncate leaves the position past the end, an append would fill up to it*/
+	res = lfs_file_truncate(&lfs, &file, end);
+	if (res == LFS_ERR_OK) {
+		res = (int)lfs_file_seek(&lfs, &file, 0, LFS_SEEK_END);
+	}
+	if (res >= 0) {
+		res = append(&file, 100U, 2U, size);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_close(&lfs, &file);
+	}
+	if (res < 0) {
+		return fail("truncate: append on the same file", res);
+	}
+
+	res = lfs_file_open(&lfs, &file, "log", flags);
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_truncate(&lfs, &file, end + size + 10U);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_close(&lfs, &file);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &file, "log", flags);
+	}
+	if (res == LFS_ERR_OK) {
+		res = append(&file, 200U, 2U, size);
+	}
+	if (res < 0) {
+		return fail("truncate: append after a reopen", res);
+	}
+
+	/*The records up to the truncate, one after it, ten bytes of the next one, two more*/
+	if (lfs_file_size(&lfs, &file) != (lfs_soff_t)(end + 3U * size + 10U)) {
+		return fail("truncate: size", (int)lfs_file_size(&lfs, &file));
+	}
+	for (uint32_t off = 0; off < end; off += size) {
+		res |= check_record(&file, off, off / size, lfs_min(size, end - off), size);
+	}
+	res |= check_record(&file, end, 100U, size, size);
+	res |= check_record(&file, end + size, 101U, 10U, size);
+	res |= check_record(&file, end + size + 10U, 200U, size, size);
+	res |= check_record(&file, end + 2U * size + 10U, 201U, size, size);
+	if (res) {
+		return fail("truncate: content", res);
+	}
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+
+	printf("truncate: %u records truncated to %u bytes, appended, truncated and appended again: "
+		   "%u programs change programmed bytes\n", LA_TRUNC_RECORDS, end, overwrites);
+	if (overwrites) {
+		return fail("truncate: programmed bytes changed", (int)overwrites);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief A log with LFS_O_LOG on the internal flash, which cannot program a double-word
+ * twice: the flag does not apply and the records go through the default path.
+ */
+static int check_hot_tier(void)
+{
+	uint8_t rec[LA_RECORD_MAX], got[LA_RECORD_MAX];
+	int res;
+
+	board();
+	res = lfs_format(&lfs, &lfs_iflash_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_iflash_cfg);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND | LFS_O_LOG);
+	}
+	if (res == LFS_ERR_OK) {
+		res = append(&file, 0, LA_HOT_RECORDS, LA_HOT_SIZE);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_close(&lfs, &file);
+	}
+	if (res < 0) {
+		return fail("hot tier: log", res);
+	}
+	lfs_unmount(&lfs);
+
+	res = lfs_mount(&lfs, &lfs_iflash_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &file, "log", LFS_O_RDONLY);
+	}
+	if (res < 0 || lfs_file_size(&lfs, &file) != (lfs_soff_t)(LA_HOT_RECORDS * LA_HOT_SIZE)) {
+		return fail("hot tier: reopen", res);
+	}
+	for (uint32_t n = 0; n < LA_HOT_RECORDS; n++) {
+		record(rec, LA_HOT_SIZE, n);
+		if (lfs_file_read(&lfs, &file, got, LA_HOT_SIZE) != (lfs_ssize_t)LA_HOT_SIZE ||
+			memcmp(rec, got, LA_HOT_SIZE) != 0) {
+			return fail("hot tier: record", (int)n);
+		}
+	}
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+
+	printf("hot tier: %u records of %u bytes with LFS_O_LOG written and read back\n",
+		   LA_HOT_RECORDS, LA_HOT_SIZE);
+
+	return 0;
+}
+
+static int run(int log, uint32_t records, uint32_t size)
+{
+	uint32_t *us = malloc(sizeof(uint32_t) * records);
+	uint8_t rec[LA_RECORD_MAX];
+	at45_model_stats_t st;
+	uint64_t appended, programmed;
+	uint32_t t0;
+	int res;
+
+	board();
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+	res = lfs_file_open(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND | (log ? LFS_O_LOG : 0));
+	if (res < 0) {
+		return fail("open", res);
+	}
+
+	at45_model_clear_stats();
+	for (uint32_t n = 0; n < records; n++) {
+		record(rec, size, n);
+		t0 = now_us();
+		res = lfs_file_write(&lfs, &file, rec, size);
+		if (res != (int)size) {
+			return fail("append", res);
+		}
+		res = lfs_file_sync(&lfs, &file);
+		if (res < 0) {
+			return fail("sync", res);
+		}
+		us[n] = now_us() - t0;
+	}
+	at45_model_get_stats(&st);
+
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+	if (check(records, size)) {
+		return 1;
+	}
+
+	appended   = (uint64_t)records * size;
+	programmed = (uint64_t)st.page_programs * LFS_AT45_PAGE_SIZE;
+	qsort(us, records, sizeof(uint32_t), cmp_u32);
+	printf("%-8s %10llu %10llu %8.2f %8.1f %8u %8.3f %8u %8u %8u\n", log ? "log" : "default",
+		   (unsigned long long)appended, (unsigned long long)programmed,
+		   (double)programmed / (double)appended, (double)programmed / (double)records,
+		   st.block_erases, (double)st.block_erases / (double)records,
+		   pct(us, records, 500), pct(us, records, 990), pct(us, records, 1000));
+
+	free(us);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t records = 1000U, size = 64U;
+	int n = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (n++ == 0) {
+			records = (uint32_t)strtoul(argv[i], NULL, 0);
+		} else {
+			size = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+	if (records == 0 || size == 0 || size > LA_RECORD_MAX) {
+		fprintf(stderr, "usage: log_append [records] [record_size 1..%u] [-max]\n", LA_RECORD_MAX);
+		return 1;
+	}
+
+	printf("%-8s %10s %10s %8s %8s %8s %8s %8s %8s %8s\n", "mode", "appended", "programmed",
+		   "prog/B", "prog/rec", "erases", "er/rec", "us50", "us99", "us100");
+	if (run(0, records, size) || run(1, records, size) || check_truncate() || check_hot_tier()) {
+		return 1;
+	}
+
+	return 0;
+}
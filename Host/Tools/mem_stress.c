@@ -0,0 +1,210 @@
+/*
+ * mem_stress.c
+ *
+ *  Host stress test of the littlefs allocator (Src/mem_pool.c).
+ *
+ *  usage: mem_stress [iterations] [seed]
+ *
+ *  Part 1 mounts a littlefs with the AT45 geometry on a RAM block device without
+ *  static buffers, so the caches, the lookahead buffer and every file cache are
+ *  allocated through LFS_MALLOC. Files are opened, appended and closed in a
+ *  random order with up to 6 open at the same time.
+ *
+ *  Part 2 allocates and frees random sizes (1 to 1024 bytes) with up to 24 live
+ *  blocks, about the size of the arena, which stresses the split and merge of the TLSF arena.
+ *
+ *  The consistency of the allocator is checked after every operation; at the end
+ *  the high-water marks and the worst fragmentation seen are printed. Exit status 1 on an
+ *  inconsistency or a leak.
+ */
+
+#include <stdlib.h>
+#include "lfs.h"
+#include "lfs_at45.h"
+
+#define STRESS_OPEN_MAX		6U
+#define STRESS_LIVE_MAX		24U
+
+static uint8_t ram_bd[LFS_AT45_BLOCK_SIZE * LFS_AT45_BLOCK_COUNT];
+static uint32_t rnd_state;
+static uint32_t worst_frag;
+
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245U + 12345U;
+	return rnd_state >> 8;
+}
+
+static int ram_read(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, void *buf, lfs_size_t size)
+{
+	memcpy(buf, &ram_bd[b * c->block_size + off], size);
+	return 0;
+}
+
+static int ram_prog(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, const void *buf, lfs_size_t size)
+{
+	memcpy(&ram_bd[b * c->block_size + off], buf, size);
+	return 0;
+}
+
+static int ram_erase(const struct lfs_config *c, lfs_block_t b)
+{
+	memset(&ram_bd[b * c->block_size], 0xFF, c->block_size);
+	return 0;
+}
+
+static int ram_sync(const struct lfs_config *c)
+{
+	(void)c;
+	return 0;
+}
+
+static int check(const char *where, uint32_t it)
+{
+	int err = mem_pool_check();
+
+	if (err) {
+		printf("%s: allocator inconsistent (%d) at iteration %u\n", where, err, it);
+	}
+	return err;
+}
+
+static int churn_lfs(uint32_t iterations)
+{
+	const struct lfs_config cfg = {
+		.read = ram_read, .prog = ram_prog, .erase = ram_erase, .sync = ram_sync,
+		.read_size = 1, .prog_size = LFS_AT45_PAGE_SIZE, .block_size = LFS_AT45_BLOCK_SIZE,
+		.block_count = LFS_AT45_BLOCK_COUNT, .cache_size = LFS_AT45_CACHE_SIZE,
+		.lookahead_size = LFS_AT45_LOOKAHEAD_SIZE, .block_cycles = LFS_AT45_BLOCK_CYCLES,
+	};
+	lfs_file_t files[STRESS_OPEN_MAX];
+	uint8_t open[STRESS_OPEN_MAX] = { 0 };
+	uint8_t data[100];
+	char name[16];
+	lfs_t lfs;
+	uint32_t slot;
+
+	memset(ram_bd, 0xFF, sizeof(ram_bd));
+	if (lfs_format(&lfs, &cfg) || lfs_mount(&lfs, &cfg)) {
+		printf("lfs: mount failed\n");
+		return -1;
+	}
+
+	for (uint32_t it = 0; it < iterations; it++) {
+		slot = rnd() % STRESS_OPEN_MAX;
+
+		if (!open[slot]) {
+			snprintf(name, sizeof(name), "f%u", rnd() % 32U);
+			if (lfs_file_open(&lfs, &files[slot], name, LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND) < 0) {
+				printf("lfs: open failed at iteration %u\n", it);
+				return -1;
+			}
+			open[slot] = 1;
+		} else if (rnd() % 2U) {
+			memset(data, (int)it, sizeof(data));
+			lfs_file_write(&lfs, &files[slot], data, 1U + rnd() % sizeof(data));
+		} else {
+			lfs_file_close(&lfs, &files[slot]);
+			open[slot] = 0;
+
+			/*Keep the files small, the churn is in the buffers*/
+			if (rnd() % 4U == 0) {
+				lfs_remove(&lfs, name);
+			}
+		}
+
+		if (check("lfs", it)) {
+			return -1;
+		}
+	}
+
+	for (slot = 0; slot < STRESS_OPEN_MAX; slot++) {
+		if (open[slot]) {
+			lfs_file_close(&lfs, &files[slot]);
+		}
+	}
+	lfs_unmount(&lfs);
+
+	return check("lfs", iterations);
+}
+
+static int churn_sizes(uint32_t iterations)
+{
+	void *live[STRESS_LIVE_MAX] = { 0 };
+	uint32_t slot;
+
+	for (uint32_t it = 0; it < iterations; it++) {
+		slot = rnd() % STRESS_LIVE_MAX;
+
+		if (live[slot]) {
+			mem_pool_free(live[slot]);
+			live[slot] = NULL;
+		} else {
+			live[slot] = mem_pool_alloc(1U + rnd() % 1024U);
+		}
+
+		if (check("sizes", it)) {
+			return -1;
+		}
+
+		if (it % 256U == 0) {
+			mem_pool_stats_t st;
+
+			mem_pool_get_stats(&st);
+			if (st.fragmentation > worst_frag) {
+				worst_frag = st.fragmentation;
+			}
+		}
+	}
+
+	for (slot = 0; slot < STRESS_LIVE_MAX; slot++) {
+		mem_pool_free(live[slot]);
+	}
+
+	return check("sizes", iterations);
+}
+
+static void report(const char *phase)
+{
+	mem_pool_stats_t st;
+
+	mem_pool_get_stats(&st);
+
+	printf("%s: allocs %u frees %u failures %u\n", phase, st.allocs, st.frees, st.failures);
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		printf("  class %4u: %u/%u in use, high water %u\n", st.cls[i].block_size,
+			   st.cls[i].used, st.cls[i].blocks, st.cls[i].high_water);
+	}
+	printf("  tlsf: %u/%u in use, high water %u, %u free blocks, largest %u, fragmentation %u/1000\n",
+		   st.tlsf_used, st.tlsf_size, st.tlsf_high_water, st.tlsf_free_blocks,
+		   st.tlsf_largest_free, st.fragmentation);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000U;
+	mem_pool_stats_t st;
+
+	rnd_state = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 1U;
+
+	if (churn_lfs(iterations)) {
+		return 1;
+	}
+	report("lfs open/close churn");
+
+	if (churn_sizes(iterations)) {
+		return 1;
+	}
+	report("random size churn");
+	printf("  worst fragmentation during the churn %u/1000\n", worst_frag);
+
+	/*Everything was freed: the arena must be one block again*/
+	mem_pool_get_stats(&st);
+	if (st.tlsf_used != 0 || st.tlsf_free_blocks != 1 || st.allocs != st.frees) {
+		printf("leak: %u bytes in use, %u free blocks\n", st.tlsf_used, st.tlsf_free_blocks);
+		return 1;
+	}
+
+	printf("ok\n");
+	return 0;
+}
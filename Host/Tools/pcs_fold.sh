@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# pcs_fold.sh
+#
+#  Symbolises a dump of the PC-sampling profiler (pc_sample_dump(), Src/pc_sample.c)
+#  against the ELF and prints folded stacks, "caller;function count" per line, the
+#  input of flamegraph.pl. The caller comes from the LR when the dump has it and is
+#  dropped when it resolves to the function itself (the LR of a non-leaf function).
+#
+#  usage: pcs_fold.sh <firmware.elf> [dump.txt] > folded.txt
+#
+#  The dump is read from the file or stdin, the lines that do not start with "pcs"
+#  (the rest of the console output) are skipped. CROSS_COMPILE selects the toolchain
+#  prefix (default arm-none-eabi-, set it empty for a host program).
+
+ELF="$1"
+ADDR2LINE="${CROSS_COMPILE-arm-none-eabi-}addr2line"
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+	echo "usage: $0 <firmware.elf> [dump.txt]" >&2
+	exit 1
+fi
+shift
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# Samples as "pc lr", the LR without the Thumb bit and moved back into the call
+tr -d '\r' < "${1:-/dev/stdin}" | awk '
+	function hex(s,    i, v) {
+		v = 0
+		s = tolower(s)
+		for (i = 1; i <= length(s); i++) {
+			v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+		}
+		return v
+	}
+	$1 == "pcs" && $2 == "begin" { print > "/dev/stderr"; next }
+	$1 == "pcs" && NF == 3 && $2 ~ /^[0-9a-fA-F]+$/ {
+		lr = hex($3)
+		# 0 is not recorded, 0xFxxxxxxx is an EXC_RETURN value
+		lr = (lr == 0 || lr >= 4026531840) ? 0 : lr - lr % 2 - 2
+		printf "%x %x\n", hex($2), lr
+	}' > "$TMP/samples"
+
+if [ ! -s "$TMP/samples" ]; then
+	echo "no samples in the dump" >&2
+	exit 1
+fi
+
+# One addr2line run for every distinct address
+awk '{ print $1; if ($2 != "0") print $2 }' "$TMP/samples" | sort -u > "$TMP/addrs"
+sed 's/^/0x/' "$TMP/addrs" | "$ADDR2LINE" -f -e "$ELF" | awk 'NR % 2 == 1' > "$TMP/funcs" || exit 1
+
+awk -v addrs="$TMP/addrs" -v funcs="$TMP/funcs" '
+	BEGIN {
+		while ((getline a < addrs) > 0) {
+			getline f < funcs
+			name[a] = (f == "??") ? "0x" a : f
+		}
+	}
+	{
+		stack = name[$1]
+		if ($2 != "0" && name[$2] != stack) {
+			stack = name[$2] ";" stack
+		}
+		count[stack]++
+		total++
+	}
+	END {
+		for (s in count) {
+			print s, count[s]
+		}
+		printf "%d samples\n", total > "/dev/stderr"
+	}' "$TMP/samples" | sort -k2,2nr
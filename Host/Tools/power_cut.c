@@ -0,0 +1,788 @@
+/*
+ * power_cut.c
+ *
+ *  Power-loss test of littlefs on the AT45: a workload of file rewrites, replaces
+ *  through a rename from another directory, removes, directory create/remove, log
+ *  appends (half of them with LFS_O_LOG), group updates with lfs_file_syncgroup()
+ *  (two files of one directory, or those and a file of another one through the
+ *  journal) and idle steps of lfs_fs_gcstep() (erases in advance for a reservoir of
+ *  PC_RESERVE blocks, compactions one erase or commit at a time) runs on lfs_at45.c
+ *  over the AT45 model, and the supply is cut at every Nth SPI command that writes
+ *  the device (buffer write, program, erase). A cut on a program or erase stops it
+ *  part way (the amount done is random), so torn buffer-to-main programs and block
+ *  erases are part of the run.
+ *
+ *  usage: power_cut [every] [cuts] [-csv] [-max]
+ *
+ *  After each cut the board reboots: lfs_mount() and lfs_fs_mkconsistent() (the
+ *  orphan and move fix-ups littlefs otherwise does at the first write) are timed on
+ *  the virtual clock, then every file is compared with the model of the workload:
+ *  a file holds its last committed content, or the content of the operation the
+ *  cut interrupted, nothing else, and the files of a group update are all old or
+ *  all new. A user file named .lfs-txn in the root must keep its content, the
+ *  journal is an attribute of the superblock and lfs_mount() must not take the file
+ *  for it. The distributions of the mount, fix-up and boot
+ *  (both) times are printed, with -csv one line per cut too. Exit status 1 when a
+ *  file does not match or the file system does not mount.
+ *
+ *  The times are bus and device time (SYSCLK at 80MHz), the CPU time of littlefs
+ *  is not counted.
+ *
+ *  The files are opened with buffers of their own, and with -DLFS_NO_MALLOC the
+ *  journal and the reservoir get theirs too (txn_buffer, reserve_buffer), so the
+ *  replay of a journal at mount is also run without a heap.
+ */
+
+#include <stdlib.h>
+#include <setjmp.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+
+#define PC_HZ				80000000U
+#define PC_FILES			8U
+#define PC_GROUP			3U			/*g/c0, g/c1 and h/m, after the files of d/*/
+#define PC_LOG_MAX			16384U
+#define PC_BOOT_US			1000U		/*Reset to the mount call, not counted*/
+#define PC_RESERVE			4U			/*reserve_count of the configuration*/
+#define PC_TXN_FILE			".lfs-txn"	/*A user file, not the journal*/
+
+/**
+ * @brief State of a file: present or not, and the version of its content. A file
+ * created by lfs_file_open() exists, empty, before its content is committed.
+ */
+typedef struct {
+	uint8_t present;
+	uint8_t empty;
+	uint32_t version;
+}pc_state_t;
+
+/**
+ * @brief A file of the model: the last committed state, and the state of the
+ * operation running on it, if any.
+ */
+typedef struct {
+	pc_state_t committed;
+	pc_state_t inflight;
+	uint8_t busy;
+}pc_file_t;
+
+/**
+ * @brief One reboot.
+ */
+typedef struct {
+	uint32_t mount_us;
+	uint32_t fix_us;
+	uint32_t boot_us;
+}pc_sample_t;
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static const uint32_t pc_sizes[] = { 24, 100, 600, 1500, 3000, 6000 };
+
+static jmp_buf reboot;
+static struct lfs_config pc_cfg;
+static lfs_t lfs;
+static lfs_file_t file;
+static pc_file_t files[PC_FILES];
+static uint32_t log_len, log_inflight;
+static uint8_t log_busy;
+static lfs_file_t group[PC_GROUP];
+static uint8_t file_buf[LFS_AT45_CACHE_SIZE];
+static uint8_t group_buf[PC_GROUP][LFS_AT45_CACHE_SIZE];
+static const struct lfs_file_config file_cfg = { .buffer = file_buf };
+static struct lfs_file_config group_cfg[PC_GROUP];
+#ifdef LFS_NO_MALLOC
+static uint8_t txn_buf[LFS_AT45_CACHE_SIZE];
+static struct lfs_reserved reserve_buf[PC_RESERVE];
+#endif
+static uint32_t group_committed[PC_GROUP], group_inflight[PC_GROUP];
+static uint32_t group_busy;				/*Files of the group update running, a bit each*/
+static uint8_t buf[512];
+static const char pc_txn_data[] = "a user file, not a group sync journal";
+static uint32_t rnd_state = 0x2545F491U;
+static uint32_t failures;
+static uint32_t cut;
+
+/*Options and totals of the run. main() longjmps back from every cut, so they are not locals*/
+static uint32_t every, cuts, fixed;
+static int csv;
+
+
+static uint32_t rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)(clock_model_cycles() / (SystemCoreClock / 1000000U));
+}
+
+static void power_lost(void)
+{
+	longjmp(reboot, 1);
+}
+
+static uint32_t file_size(uint32_t f, uint32_t version)
+{
+	return pc_sizes[(f * 3U + version) % (sizeof(pc_sizes) / sizeof(pc_sizes[0]))];
+}
+
+static uint8_t file_byte(uint32_t f, uint32_t version, uint32_t i)
+{
+	return (uint8_t)(f * 73U + version * 31U + i * 7U + (i >> 8));
+}
+
+static uint8_t log_byte(uint32_t i)
+{
+	return (uint8_t)(i * 13U + (i >> 7));
+}
+
+static void file_path(char *path, size_t len, uint32_t f)
+{
+	if (f < PC_FILES) {
+		snprintf(path, len, "d/f%u", f);
+	} else if (f < PC_FILES + 2U) {
+		snprintf(path, len, "g/c%u", f - PC_FILES);
+	} else {
+		snprintf(path, len, "h/m");
+	}
+}
+
+/**
+ * @brief A fault that is not a power cut: the run cannot go on.
+ */
+static void fatal(const char *what, int res)
+{
+	printf("FAIL: cut %u: %s (%d)\n", cut, what, res);
+	exit(1);
+}
+
+static void mismatch(const char *what, uint32_t f)
+{
+	printf("FAIL: cut %u: %s %u\n", cut, what, f);
+	failures++;
+}
+
+/**
+ * @brief Rewrites a whole file with its next version.
+ */
+static void op_rewrite(uint32_t f)
+{
+	pc_file_t *pf = &files[f];
+	uint32_t v = pf->committed.version + 1U;
+	uint32_t size = file_size(f, v);
+	char path[16];
+	int res;
+
+	pf->inflight.present = 1;
+	pf->inflight.empty   = 0;
+	pf->inflight.version = v;
+	pf->busy = 1;
+
+	file_path(path, sizeof(path), f);
+	res = lfs_file_opencfg(&lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC, &file_cfg);
+	if (res < 0) {
+		fatal("open", res);
+	}
+	for (uint32_t off = 0; off < size; off += sizeof(buf)) {
+		uint32_t len = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+
+		for (uint32_t i = 0; i < len; i++) {
+			buf[i] = file_byte(f, v, off + i);
+		}
+		if (lfs_file_write(&lfs, &file, buf, len) != (lfs_ssize_t)len) {
+			fatal("write", LFS_ERR_IO);
+		}
+	}
+	res = lfs_file_close(&lfs, &file);
+	if (res < 0) {
+		fatal("close", res);
+	}
+
+	pf->committed = pf->inflight;
+	pf->busy = 0;
+}
+
+/**
+ * @brief Writes the next version of a file in t/, then renames it over the old one:
+ * the rename moves the entry between two directories.
+ */
+static void op_replace(uint32_t f)
+{
+	pc_file_t *pf = &files[f];
+	uint32_t v = pf->committed.version + 1U;
+	uint32_t size = file_size(f, v);
+	char path[16], tmp[16];
+	int res;
+
+	pf->inflight.present = 1;
+	pf->inflight.empty   = 0;
+	pf->inflight.version = v;
+	pf->busy = 1;
+
+	snprintf(tmp, sizeof(tmp), "t/f%u", f);
+	res = lfs_file_opencfg(&lfs, &file, tmp, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC, &file_cfg);
+	if (res < 0) {
+		fatal("tmp open", res);
+	}
+	for (uint32_t off = 0; off < size; off += sizeof(buf)) {
+		uint32_t len = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+
+		for (uint32_t i = 0; i < len; i++) {
+			buf[i] = file_byte(f, v, off + i);
+		}
+		if (lfs_file_write(&lfs, &file, buf, len) != (lfs_ssize_t)len) {
+			fatal("tmp write", LFS_ERR_IO);
+		}
+	}
+	res = lfs_file_close(&lfs, &file);
+	if (res < 0) {
+		fatal("tmp close", res);
+	}
+
+	file_path(path, sizeof(path), f);
+	res = lfs_rename(&lfs, tmp, path);
+	if (res < 0) {
+		fatal("rename", res);
+	}
+
+	pf->committed = pf->inflight;
+	pf->busy = 0;
+}
+
+/**
+ * @brief Creates and removes a directory, the remove leaves an orphan until it is done.
+ */
+static void op_dir(void)
+{
+	int res = lfs_mkdir(&lfs, "t/sub");
+
+	if (res < 0 && res != LFS_ERR_EXIST) {
+		fatal("mkdir", res);
+	}
+	res = lfs_remove(&lfs, "t/sub");
+	if (res < 0) {
+		fatal("rmdir", res);
+	}
+}
+
+static void op_remove(uint32_t f)
+{
+	pc_file_t *pf = &files[f];
+	char path[16];
+	int res;
+
+	if (!pf->committed.present) {
+		op_rewrite(f);
+		return;
+	}
+
+	pf->inflight.present = 0;
+	pf->inflight.empty   = 0;
+	pf->inflight.version = pf->committed.version;
+	pf->busy = 1;
+
+	file_path(path, sizeof(path), f);
+	res = lfs_remove(&lfs, path);
+	if (res < 0) {
+		fatal("remove", res);
+	}
+
+	pf->committed = pf->inflight;
+	pf->busy = 0;
+}
+
+/**
+ * @brief Appends a record to the log, or starts it again when it is full.
+ */
+static void op_append(void)
+{
+	uint32_t len = 16U + rnd() % 112U;
+	int flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND;
+
+	/*Every other record goes in place to the last block (LFS_O_LOG)*/
+	if (rnd() & 1U) {
+		flags |= LFS_O_LOG;
+	}
+	int res;
+
+	if (log_len + len > PC_LOG_MAX) {
+		flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC;
+		log_inflight = len;
+	} else {
+		log_inflight = log_len + len;
+	}
+	log_busy = 1;
+
+	for (uint32_t i = 0; i < len; i++) {
+		buf[i] = log_byte(log_inflight - len + i);
+	}
+	res = lfs_file_opencfg(&lfs, &file, "log", flags, &file_cfg);
+	if (res < 0) {
+		fatal("log open", res);
+	}
+	if (lfs_file_write(&lfs, &file, buf, len) != (lfs_ssize_t)len) {
+		fatal("log write", LFS_ERR_IO);
+	}
+	res = lfs_file_close(&lfs, &file);
+	if (res < 0) {
+		fatal("log close", res);
+	}
+
+	log_len = log_inflight;
+	log_busy = 0;
+}
+
+/**
+ * @brief Opens a file of the group and writes a version of it, nothing is committed.
+ */
+static void group_write(uint32_t g, uint32_t v, int flags)
+{
+	uint32_t f = PC_FILES + g;
+	uint32_t size = file_size(f, v);
+	char path[16];
+	int res;
+
+	file_path(path, sizeof(path), f);
+	res = lfs_file_opencfg(&lfs, &group[g], path, flags, &group_cfg[g]);
+	if (res < 0) {
+		fatal("group open", res);
+	}
+	for (uint32_t off = 0; off < size; off += sizeof(buf)) {
+		uint32_t len = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+
+		for (uint32_t i = 0; i < len; i++) {
+			buf[i] = file_byte(f, v, off + i);
+		}
+		if (lfs_file_write(&lfs, &group[g], buf, len) != (lfs_ssize_t)len) {
+			fatal("group write", LFS_ERR_IO);
+		}
+	}
+}
+
+/**
+ * @brief Rewrites the two files of g/ (one commit), or those and h/m (the journal),
+ * and makes them visible together with lfs_file_syncgroup().
+ */
+static void op_group(void)
+{
+	uint32_t n = (rnd() & 1U) ? PC_GROUP : 2U;
+	lfs_file_t *list[PC_GROUP];
+	int res;
+
+	group_busy = (1U << n) - 1U;
+	for (uint32_t g = 0; g < n; g++) {
+		group_inflight[g] = group_committed[g] + 1U;
+		group_write(g, group_inflight[g], LFS_O_WRONLY | LFS_O_TRUNC);
+		list[g] = &group[g];
+	}
+	res = lfs_file_syncgroup(&lfs, list, n);
+	if (res < 0) {
+		fatal("group sync", res);
+	}
+	for (uint32_t g = 0; g < n; g++) {
+		lfs_file_close(&lfs, &group[g]);
+		group_committed[g] = group_inflight[g];
+	}
+	group_busy = 0;
+}
+
+/**
+ * @brief Idle time of the application: a few bounded steps of lfs_fs_gcstep().
+ */
+static void op_gc(void)
+{
+	int res;
+
+	for (uint32_t i = rnd() % 4U; i < 4U; i++) {
+		res = lfs_fs_gcstep(&lfs);
+		if (res < 0) {
+			fatal("gcstep", res);
+		}
+		if (res == 0) {
+			break;
+		}
+	}
+}
+
+static void workload_step(void)
+{
+	uint32_t r = rnd() % 12U;
+
+	if (r < 3U) {
+		op_rewrite(rnd() % PC_FILES);
+	} else if (r < 5U) {
+		op_replace(rnd() % PC_FILES);
+	} else if (r < 6U) {
+		op_remove(rnd() % PC_FILES);
+	} else if (r < 7U) {
+		op_dir();
+	} else if (r < 8U) {
+		op_group();
+	} else if (r < 9U) {
+		op_gc();
+	} else {
+		op_append();
+	}
+}
+
+/**
+ * @brief Compares a file with one state of the model.
+ * @retval 1 when it matches.
+ */
+static int file_matches(uint32_t f, const pc_state_t *s, const struct lfs_info *info)
+{
+	uint32_t size = s->empty ? 0 : file_size(f, s->version);
+	char path[16];
+	int ok = 1;
+
+	if (!s->present || info->size != size) {
+		return 0;
+	}
+
+	file_path(path, sizeof(path), f);
+	if (lfs_file_opencfg(&lfs, &file, path, LFS_O_RDONLY, &file_cfg) < 0) {
+		return 0;
+	}
+	for (uint32_t off = 0; ok && off < size; off += sizeof(buf)) {
+		uint32_t len = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+
+		if (lfs_file_read(&lfs, &file, buf, len) != (lfs_ssize_t)len) {
+			ok = 0;
+			break;
+		}
+		for (uint32_t i = 0; i < len; i++) {
+			if (buf[i] != file_byte(f, s->version, off + i)) {
+				ok = 0;
+				break;
+			}
+		}
+	}
+	lfs_file_close(&lfs, &file);
+
+	return ok;
+}
+
+/**
+ * @brief Checks every file against the model, then commits what was found.
+ */
+static void verify(void)
+{
+	struct lfs_info info;
+	lfs_dir_t dir;
+	char path[16];
+	uint32_t present = 0;
+	uint32_t entries = 0;
+	int res;
+
+	for (uint32_t f = 0; f < PC_FILES; f++) {
+		pc_file_t *pf = &files[f];
+
+		file_path(path, sizeof(path), f);
+		res = lfs_stat(&lfs, path, &info);
+		if (res == LFS_ERR_NOENT) {
+			if (!pf->committed.present) {
+				;
+			} else if (pf->busy && !pf->inflight.present) {
+				pf->committed = pf->inflight;
+			} else {
+				mismatch("lost file", f);
+			}
+		} else if (res < 0) {
+			mismatch("stat error on file", f);
+		} else if (file_matches(f, &pf->committed, &info)) {
+			;
+		} else if (pf->busy && file_matches(f, &pf->inflight, &info)) {
+			pf->committed = pf->inflight;
+		} else if (pf->busy && !pf->committed.present && pf->inflight.present && info.size == 0) {
+			/*Created, the cut came before the close*/
+			pf->committed.present = 1;
+			pf->committed.empty   = 1;
+		} else {
+			mismatch("wrong content in file", f);
+		}
+		pf->busy = 0;
+		present += pf->committed.present;
+	}
+
+	/*Nothing else in the directory*/
+	res = lfs_dir_open(&lfs, &dir, "d");
+	if (res < 0) {
+		fatal("dir open", res);
+	}
+	while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+		entries += (info.type == LFS_TYPE_REG);
+	}
+	lfs_dir_close(&lfs, &dir);
+	if (entries != present) {
+		mismatch("unexpected entries in d:", entries);
+	}
+
+	/*The files of the group update are all at the old version or all at the new one*/
+	uint32_t newer = 0;
+
+	for (uint32_t g = 0; g < PC_GROUP; g++) {
+		pc_state_t old = { 1, 0, group_committed[g] };
+		pc_state_t new = { 1, 0, group_inflight[g] };
+
+		file_path(path, sizeof(path), PC_FILES + g);
+		res = lfs_stat(&lfs, path, &info);
+		if (res < 0) {
+			mismatch("lost group file", g);
+		} else if (file_matches(PC_FILES + g, &old, &info)) {
+			;
+		} else if ((group_busy & (1U << g)) && file_matches(PC_FILES + g, &new, &info)) {
+			group_committed[g] = group_inflight[g];
+			newer |= 1U << g;
+		} else {
+			mismatch("wrong content in group file", g);
+		}
+	}
+	if (newer && newer != group_busy) {
+		mismatch("group update seen in part, files", newer);
+	}
+	group_busy = 0;
+
+	/*The log is as long as one of the appends left it, and its bytes follow the pattern*/
+	res = lfs_stat(&lfs, "log", &info);
+	if (res == LFS_ERR_NOENT) {
+		info.size = 0;
+	} else if (res < 0) {
+		fatal("log stat", res);
+	}
+	if (info.size != log_len && !(log_busy && info.size == log_inflight)) {
+		mismatch("wrong log size", info.size);
+	} else if (info.size) {
+		lfs_file_opencfg(&lfs, &file, "log", LFS_O_RDONLY, &file_cfg);
+		for (uint32_t off = 0; off < info.size; off += sizeof(buf)) {
+			uint32_t len = (info.size - off < sizeof(buf)) ? info.size - off : sizeof(buf);
+
+			lfs_file_read(&lfs, &file, buf, len);
+			for (uint32_t i = 0; i < len; i++) {
+				if (buf[i] != log_byte(off + i)) {
+					mismatch("wrong log byte at", off + i);
+					off = info.size;
+					break;
+				}
+			}
+		}
+		lfs_file_close(&lfs, &file);
+	}
+	log_len = info.size;
+	log_busy = 0;
+
+	/*Drop what the cut left in t/, the next operations start from nothing there*/
+	for (uint32_t f = 0; f < PC_FILES; f++) {
+		snprintf(path, sizeof(path), "t/f%u", f);
+		lfs_remove(&lfs, path);
+	}
+	lfs_remove(&lfs, "t/sub");
+
+	/*The user file with the name of a journal is left alone*/
+	res = lfs_file_opencfg(&lfs, &file, PC_TXN_FILE, LFS_O_RDONLY, &file_cfg);
+	if (res < 0) {
+		mismatch("lost user file " PC_TXN_FILE ":", (uint32_t)-res);
+	} else {
+		res = lfs_file_read(&lfs, &file, buf, sizeof(buf));
+		lfs_file_close(&lfs, &file);
+		if (res != (int)sizeof(pc_txn_data) || memcmp(buf, pc_txn_data, sizeof(pc_txn_data)) != 0) {
+			mismatch("wrong content in " PC_TXN_FILE ", size", (uint32_t)res);
+		}
+	}
+}
+
+/**
+ * @brief The MCU restarts: peripherals and heap from reset, the flash powered again.
+ */
+static void board_reboot(void)
+{
+	at45_model_power_up();
+	clock_model_advance_us(PC_BOOT_US);
+	spi_model_reset();
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Prints min, percentiles and max of one field of the samples.
+ */
+static void print_dist(const char *name, uint32_t *v, uint32_t n)
+{
+	uint64_t sum = 0;
+
+	qsort(v, n, sizeof(v[0]), cmp_u32);
+	for (uint32_t i = 0; i < n; i++) {
+		sum += v[i];
+	}
+	printf("%-6s us: min %u, p50 %u, p90 %u, p99 %u, max %u, mean %llu\n", name,
+		   v[0], v[n / 2U], v[(n * 9U) / 10U], v[(n * 99U) / 100U], v[n - 1U],
+		   (unsigned long long)(sum / n));
+}
+
+int main(int argc, char **argv)
+{
+	static at45_model_timing_t t_max = {
+		400U, AT45_TEP_US, 4000U, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+	};
+	uint32_t torn = 0;
+	int max_timing = 0;
+	pc_sample_t *samples;
+	uint32_t *v;
+	at45_model_stats_t st;
+	uint32_t programs, t0;
+	int res;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-csv") == 0) {
+			csv = 1;
+		} else if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (!every) {
+			every = (uint32_t)strtoul(argv[i], NULL, 0);
+		} else {
+			cuts = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+	every = every ? every : 37U;
+	cuts  = cuts ? cuts : 500U;
+
+	pc_cfg = lfs_at45_cfg;
+	pc_cfg.reserve_count = PC_RESERVE;
+#ifdef LFS_NO_MALLOC
+	pc_cfg.txn_buffer = txn_buf;
+	pc_cfg.reserve_buffer = reserve_buf;
+#endif
+	for (uint32_t g = 0; g < PC_GROUP; g++) {
+		group_cfg[g].buffer = group_buf[g];
+	}
+
+	samples = calloc(cuts, sizeof(*samples));
+	v = calloc(cuts, sizeof(*v));
+	if (!samples || !v) {
+		return 1;
+	}
+
+	clock_model_reset();
+	clock_model_set_hz(PC_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&t_max);
+	}
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+
+	res = lfs_format(&lfs, &pc_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &pc_cfg);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "d");
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "t");
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "g");
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "h");
+	}
+	if (res != LFS_ERR_OK) {
+		fatal("format", res);
+	}
+	for (uint32_t g = 0; g < PC_GROUP; g++) {
+		group_write(g, 0, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL);
+		res = lfs_file_close(&lfs, &group[g]);
+		if (res < 0) {
+			fatal("group create", res);
+		}
+	}
+	res = lfs_file_opencfg(&lfs, &file, PC_TXN_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL, &file_cfg);
+	if (res == LFS_ERR_OK) {
+		lfs_file_write(&lfs, &file, pc_txn_data, sizeof(pc_txn_data));
+		res = lfs_file_close(&lfs, &file);
+	}
+	if (res < 0) {
+		fatal(PC_TXN_FILE " create", res);
+	}
+
+	if (csv) {
+		printf("cut,torn,mount_us,fix_us,boot_us\n");
+	}
+
+	for (cut = 0; cut < cuts; cut++) {
+		at45_model_get_stats(&st);
+		torn = st.torn;
+
+		if (setjmp(reboot) == 0) {
+			at45_model_cut_after(every, rnd() % 1000U, power_lost);
+			for (;;) {
+				workload_step();
+			}
+		}
+
+		/*Power is back*/
+		board_reboot();
+		at45_model_get_stats(&st);
+		torn = st.torn - torn;
+
+		t0 = now_us();
+		res = lfs_mount(&lfs, &pc_cfg);
+		if (res != LFS_ERR_OK) {
+			fatal("mount after the cut", res);
+		}
+		samples[cut].mount_us = now_us() - t0;
+
+		at45_model_get_stats(&st);
+		programs = st.page_programs + st.block_erases;
+		t0 = now_us();
+		res = lfs_fs_mkconsistent(&lfs);
+		if (res != LFS_ERR_OK) {
+			fatal("mkconsistent", res);
+		}
+		samples[cut].fix_us = now_us() - t0;
+		samples[cut].boot_us = samples[cut].mount_us + samples[cut].fix_us;
+		at45_model_get_stats(&st);
+		fixed += (st.page_programs + st.block_erases != programs);
+
+		verify();
+
+		if (csv) {
+			printf("%u,%u,%u,%u,%u\n", cut, torn, samples[cut].mount_us, samples[cut].fix_us, samples[cut].boot_us);
+		}
+	}
+
+	at45_model_get_stats(&st);
+	printf("%u cuts every %u SPI commands: %u torn program/erase, %u needed a fix-up, %u failures\n",
+		   cuts, every, st.torn, fixed, failures);
+	for (uint32_t i = 0; i < cuts; i++) {
+		v[i] = samples[i].mount_us;
+	}
+	print_dist("mount", v, cuts);
+	for (uint32_t i = 0; i < cuts; i++) {
+		v[i] = samples[i].fix_us;
+	}
+	print_dist("fix", v, cuts);
+	for (uint32_t i = 0; i < cuts; i++) {
+		v[i] = samples[i].boot_us;
+	}
+	print_dist("boot", v, cuts);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * ramfunc_bench.c
+ *
+ *  Host benchmark of the functions placed in SRAM2 with RAMFUNC (Inc/ramfunc.h).
+ *
+ *  usage: ramfunc_bench [files] [file_size]
+ *
+ *  A littlefs workload (write, sync, read back and remove files) runs on a RAM
+ *  block device with the AT45 geometry of lfs_at45.h. The work done on each hot
+ *  path is measured: bytes through lfs_crc (wrapped with -Wl,--wrap=lfs_crc),
+ *  lfs_bd_read calls that reach the device, and bytes the AT45 driver would move
+ *  with SPIx_receive and SPIx_transmit.
+ *
+ *  The counts are turned into cycles with a counter model of the Cortex-M4 at
+ *  80MHz: every function has a cost at zero wait states per unit of work and a
+ *  number of taken branches per unit. Executing from flash adds the 4 wait states
+ *  to every branch whose target misses the ART instruction cache; from SRAM2 the
+ *  fetch never stalls. The SPI loops also wait for the bus, 8 SCK periods per byte
+ *  at 5MHz, which is the same for both placements. Results are printed as CSV for
+ *  a warm cache (every branch hits) and a thrashed cache (every branch misses),
+ *  the two ends of what the hardware does.
+ */
+
+#include <stdlib.h>
+#include "lfs.h"
+#include "lfs_at45.h"
+
+#define BENCH_HZ				80000000U
+#define BENCH_FLASH_WS			4U
+#define BENCH_SPI_HZ			5000000U
+#define BENCH_CMD_BYTES			4U			/*Opcode and address of a read or program*/
+
+/**
+ * @brief Counter model of a hot function.
+ */
+typedef struct {
+	const char *name;
+	const char *unit;
+	uint32_t cycles_0ws;		//Cycles per unit at zero wait states
+	uint32_t branches;			//Taken branches per unit
+	uint32_t wire_cycles;		//Cycles per unit spent waiting for the peripheral
+	uint64_t units;
+}bench_fn_t;
+
+/*
+ * Cycle counts from the Cortex-M4 instruction timings of the loop bodies. SPIx_receive
+ * waits for every byte before it sends the next one, so its loop adds to the wire time;
+ * SPIx_transmit fills the TX FIFO ahead of the wire, which hides its loop completely.
+ */
+static bench_fn_t bench_fn[] = {
+	{ "lfs_crc",           "byte", 14U, 1U, 0U, 0 },
+	{ "lfs_bd_read",       "call", 60U, 8U, 0U, 0 },
+	{ "SPIx_receive",      "byte", 18U, 3U, (8U * BENCH_HZ) / BENCH_SPI_HZ, 0 },
+	{ "SPIx_transmit",     "byte", 0U,  0U, (8U * BENCH_HZ) / BENCH_SPI_HZ, 0 },
+};
+
+enum { FN_CRC, FN_BD_READ, FN_SPI_RX, FN_SPI_TX };
+
+static uint8_t ram_bd[LFS_AT45_BLOCK_SIZE * LFS_AT45_BLOCK_COUNT];
+
+uint32_t __real_lfs_crc(uint32_t crc, const void *buffer, size_t size);
+
+uint32_t __wrap_lfs_crc(uint32_t crc, const void *buffer, size_t size)
+{
+	bench_fn[FN_CRC].units += size;
+
+	return __real_lfs_crc(crc, buffer, size);
+}
+
+static int ram_read(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, void *buf, lfs_size_t size)
+{
+	bench_fn[FN_BD_READ].units++;
+	bench_fn[FN_SPI_RX].units += size;
+
+	memcpy(buf, &ram_bd[b * c->block_size + off], size);
+	return 0;
+}
+
+static int ram_prog(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, const void *buf, lfs_size_t size)
+{
+	/*One buffer load per page, each with its command*/
+	bench_fn[FN_SPI_TX].units += size + (size / c->prog_size) * BENCH_CMD_BYTES;
+
+	memcpy(&ram_bd[b * c->block_size + off], buf, size);
+	return 0;
+}
+
+static int ram_erase(const struct lfs_config *c, lfs_block_t b)
+{
+	bench_fn[FN_SPI_TX].units += BENCH_CMD_BYTES;
+
+	memset(&ram_bd[b * c->block_size], 0xFF, c->block_size);
+	return 0;
+}
+
+static int ram_sync(const struct lfs_config *c)
+{
+	(void)c;
+	return 0;
+}
+
+static int workload(uint32_t files, uint32_t file_size)
+{
+	static uint8_t rbuf[LFS_AT45_CACHE_SIZE], pbuf[LFS_AT45_CACHE_SIZE], lbuf[LFS_AT45_LOOKAHEAD_SIZE];
+	const struct lfs_config cfg = {
+		.read = ram_read, .prog = ram_prog, .erase = ram_erase, .sync = ram_sync,
+		.read_size = 1, .prog_size = LFS_AT45_PAGE_SIZE, .block_size = LFS_AT45_BLOCK_SIZE,
+		.block_count = LFS_AT45_BLOCK_COUNT, .cache_size = LFS_AT45_CACHE_SIZE,
+		.lookahead_size = LFS_AT45_LOOKAHEAD_SIZE, .block_cycles = LFS_AT45_BLOCK_CYCLES,
+		.read_buffer = rbuf, .prog_buffer = pbuf, .lookahead_buffer = lbuf,
+	};
+	uint8_t chunk[64];
+	char name[16];
+	lfs_t lfs;
+	lfs_file_t file;
+
+	memset(ram_bd, 0xFF, sizeof(ram_bd));
+	if (lfs_format(&lfs, &cfg) || lfs_mount(&lfs, &cfg)) {
+		return -1;
+	}
+
+	/*Log style writes: small appends with a sync after each*/
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "log%03u", f);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) {
+			return -1;
+		}
+		for (uint32_t off = 0; off < file_size; off += sizeof(chunk)) {
+			memset(chunk, (int)(f + off), sizeof(chunk));
+			lfs_file_write(&lfs, &file, chunk, sizeof(chunk));
+			lfs_file_sync(&lfs, &file);
+		}
+		lfs_file_close(&lfs, &file);
+	}
+
+	/*Read everything back, then remove it*/
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "log%03u", f);
+		if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) < 0) {
+			return -1;
+		}
+		while (lfs_file_read(&lfs, &file, chunk, sizeof(chunk)) > 0) {}
+		lfs_file_close(&lfs, &file);
+		lfs_remove(&lfs, name);
+	}
+
+	return lfs_unmount(&lfs);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t files = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 32U;
+	uint32_t file_size = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 4096U;
+	uint64_t base, flash_hit, flash_miss, sram2;
+
+	if (workload(files, file_size)) {
+		fprintf(stderr, "workload failed\n");
+		return 1;
+	}
+
+	printf("function,unit,units,sram2_cycles,flash_warm_cycles,flash_cold_cycles,cold_speedup_permille\n");
+	for (uint32_t i = 0; i < sizeof(bench_fn) / sizeof(bench_fn[0]); i++) {
+		bench_fn_t *fn = &bench_fn[i];
+
+		base       = fn->units * (fn->cycles_0ws + fn->wire_cycles);
+		sram2      = base;
+		flash_hit  = base;
+		flash_miss = base + fn->units * fn->branches * BENCH_FLASH_WS;
+
+		printf("%s,%s,%llu,%llu,%llu,%llu,%llu\n", fn->name, fn->unit,
+			   (unsigned long long)fn->units, (unsigned long long)sram2,
+			   (unsigned long long)flash_hit, (unsigned long long)flash_miss,
+			   (unsigned long long)(sram2 ? (flash_miss * 1000U) / sram2 : 0));
+	}
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# ramfunc_report.sh
+#
+#  Lists the functions linked in the .ramfunc section (RAMFUNC, Inc/ramfunc.h)
+#  with their sizes, and the total SRAM2 they take.
+#
+#  usage: ramfunc_report.sh <firmware.elf>
+#
+#  Run it as a post-build step of the firmware. CROSS_COMPILE selects the
+#  toolchain prefix (default arm-none-eabi-).
+
+ELF="$1"
+NM="${CROSS_COMPILE:-arm-none-eabi-}nm"
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+	echo "usage: $0 <firmware.elf>" >&2
+	exit 1
+fi
+
+"$NM" -S -n "$ELF" | awk '
+	function hex(s,    i, v) {
+		v = 0
+		s = tolower(s)
+		for (i = 1; i <= length(s); i++) {
+			v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+		}
+		return v
+	}
+	$NF == "_sramfunc" { start = hex($1) }
+	$NF == "_eramfunc" { end = hex($1) }
+	NF == 4 && ($3 == "t" || $3 == "T") { addr[n] = hex($1); size[n] = hex($2); name[n] = $4; n++ }
+	END {
+		if (end == 0) {
+			print "no .ramfunc section in the image" > "/dev/stderr"
+			exit 1
+		}
+		printf "%-32s %10s %8s\n", "function", "address", "size"
+		for (i = 0; i < n; i++) {
+			if (addr[i] >= start && addr[i] < end) {
+				printf "%-32s 0x%08x %8d\n", name[i], addr[i], size[i]
+			}
+		}
+		printf "%-32s %10s %8d\n", ".ramfunc total", "", end - start
+	}'
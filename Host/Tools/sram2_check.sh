@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# sram2_check.sh
+#
+#  Checks that the buffers placed with SRAM2_BSS (Inc/mem_config.h) are linked in
+#  SRAM2, and prints how much of SRAM2 is used. A buffer that lost its attribute
+#  lands in .bss in RAM; the check then exits with status 1, so as a post-build
+#  step it fails the build.
+#
+#  usage: sram2_check.sh <firmware.elf>
+#
+#  CROSS_COMPILE selects the toolchain prefix (default arm-none-eabi-).
+
+ELF="$1"
+NM="${CROSS_COMPILE:-arm-none-eabi-}nm"
+
+# Buffers that must be in SRAM2
+SYMBOLS="lfs_at45_read_buf lfs_at45_prog_buf lfs_at45_lookahead_buf
+lfs_iflash_read_buf lfs_iflash_prog_buf lfs_iflash_lookahead_buf
+SPI_REC_BUF pool_mem tlsf_mem"
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+	echo "usage: $0 <firmware.elf>" >&2
+	exit 1
+fi
+
+"$NM" -S "$ELF" | awk -v symbols="$SYMBOLS" '
+	function hex(s,    i, v) {
+		v = 0
+		s = tolower(s)
+		for (i = 1; i <= length(s); i++) {
+			v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+		}
+		return v
+	}
+	BEGIN {
+		n = split(symbols, want)
+		lo = hex("10000000"); hi = hex("10008000")
+	}
+	NF == 4 { addr[$4] = hex($1); size[$4] = hex($2) }
+	NF == 3 { addr[$3] = hex($1) }
+	END {
+		err = 0
+		for (i = 1; i <= n; i++) {
+			s = want[i]
+			if (!(s in addr)) {
+				printf "%-28s missing\n", s
+				err = 1
+			} else if (addr[s] < lo || addr[s] >= hi) {
+				printf "%-28s 0x%08x %6d  NOT IN SRAM2\n", s, addr[s], size[s]
+				err = 1
+			} else {
+				printf "%-28s 0x%08x %6d\n", s, addr[s], size[s]
+			}
+		}
+		used = (addr["_eramfunc"] - addr["_sramfunc"]) + (addr["_esram2_bss"] - addr["_ssram2_bss"]) + \
+			   (addr["_esram2"] - addr["_ssram2"])
+		printf "SRAM2 used %d of 32768 bytes\n", used
+		exit err
+	}'
@@ -0,0 +1,154 @@
+/*
+ * stack_probe.c
+ *
+ *  Host run of the stack and heap probes (Src/mem_probe.c) on littlefs workloads.
+ *
+ *  usage: stack_probe [files] [file_size]
+ *
+ *  A littlefs with the AT45 geometry of lfs_at45.h runs on a RAM block device with
+ *  its buffers allocated through LFS_MALLOC. Every littlefs API call is wrapped in
+ *  MEM_PROBE: format and mount, directories, files written in small appends with a
+ *  sync after each, read back, renamed, listed and removed, then a remount with the
+ *  files in place and a filesystem traversal. The report of mem_probe_report() is
+ *  printed at the end.
+ *
+ *  The depths are those of the host compiler (x86-64 frames and calling convention);
+ *  they rank the littlefs calls the same way as on the target but are not the
+ *  Cortex-M4 numbers, run the same probes on the target for those.
+ */
+
+#include <stdlib.h>
+#include "lfs.h"
+#include "lfs_at45.h"
+#include "mem_probe.h"
+
+static uint8_t ram_bd[LFS_AT45_BLOCK_SIZE * LFS_AT45_BLOCK_COUNT];
+
+static int ram_read(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, void *buf, lfs_size_t size)
+{
+	memcpy(buf, &ram_bd[b * c->block_size + off], size);
+	return 0;
+}
+
+static int ram_prog(const struct lfs_config *c, lfs_block_t b, lfs_off_t off, const void *buf, lfs_size_t size)
+{
+	memcpy(&ram_bd[b * c->block_size + off], buf, size);
+	return 0;
+}
+
+static int ram_erase(const struct lfs_config *c, lfs_block_t b)
+{
+	memset(&ram_bd[b * c->block_size], 0xFF, c->block_size);
+	return 0;
+}
+
+static int ram_sync(const struct lfs_config *c)
+{
+	(void)c;
+	return 0;
+}
+
+static int count_block(void *data, lfs_block_t block)
+{
+	(void)block;
+	(*(uint32_t *)data)++;
+	return 0;
+}
+
+static int workload(uint32_t files, uint32_t file_size)
+{
+	const struct lfs_config cfg = {
+		.read = ram_read, .prog = ram_prog, .erase = ram_erase, .sync = ram_sync,
+		.read_size = 1, .prog_size = LFS_AT45_PAGE_SIZE, .block_size = LFS_AT45_BLOCK_SIZE,
+		.block_count = LFS_AT45_BLOCK_COUNT, .cache_size = LFS_AT45_CACHE_SIZE,
+		.lookahead_size = LFS_AT45_LOOKAHEAD_SIZE, .block_cycles = LFS_AT45_BLOCK_CYCLES,
+	};
+	struct lfs_info info;
+	uint8_t chunk[64];
+	char name[32], dest[32];
+	lfs_file_t file;
+	lfs_dir_t dir;
+	lfs_t lfs;
+	uint32_t blocks = 0;
+	int err = 0;
+
+	memset(ram_bd, 0xFF, sizeof(ram_bd));
+	MEM_PROBE("lfs_format", err = lfs_format(&lfs, &cfg));
+	MEM_PROBE("lfs_mount", err |= lfs_mount(&lfs, &cfg));
+	MEM_PROBE("lfs_mkdir", err |= lfs_mkdir(&lfs, "log"));
+	if (err) {
+		return -1;
+	}
+
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "log/%03u", f);
+		MEM_PROBE("lfs_file_open", err = lfs_file_open(&lfs, &file, name,
+					LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND));
+		if (err < 0) {
+			return -1;
+		}
+		for (uint32_t off = 0; off < file_size; off += sizeof(chunk)) {
+			memset(chunk, (int)(f + off), sizeof(chunk));
+			MEM_PROBE("lfs_file_write", lfs_file_write(&lfs, &file, chunk, sizeof(chunk)));
+			MEM_PROBE("lfs_file_sync", lfs_file_sync(&lfs, &file));
+		}
+		MEM_PROBE("lfs_file_close", lfs_file_close(&lfs, &file));
+	}
+
+	/*Remount with the files in place, then walk the filesystem*/
+	MEM_PROBE("lfs_unmount", lfs_unmount(&lfs));
+	MEM_PROBE("lfs_mount", err = lfs_mount(&lfs, &cfg));
+	if (err) {
+		return -1;
+	}
+	MEM_PROBE("lfs_fs_traverse", lfs_fs_traverse(&lfs, count_block, &blocks));
+	MEM_PROBE("lfs_fs_size", lfs_fs_size(&lfs));
+
+	MEM_PROBE("lfs_dir_open", err = lfs_dir_open(&lfs, &dir, "log"));
+	if (err) {
+		return -1;
+	}
+	do {
+		MEM_PROBE("lfs_dir_read", err = lfs_dir_read(&lfs, &dir, &info));
+	} while (err > 0);
+	MEM_PROBE("lfs_dir_close", lfs_dir_close(&lfs, &dir));
+
+	for (uint32_t f = 0; f < files; f++) {
+		snprintf(name, sizeof(name), "log/%03u", f);
+		snprintf(dest, sizeof(dest), "log/old%03u", f);
+		MEM_PROBE("lfs_stat", lfs_stat(&lfs, name, &info));
+		MEM_PROBE("lfs_file_open", err = lfs_file_open(&lfs, &file, name, LFS_O_RDONLY));
+		if (err < 0) {
+			return -1;
+		}
+		do {
+			MEM_PROBE("lfs_file_read", err = lfs_file_read(&lfs, &file, chunk, sizeof(chunk)));
+		} while (err > 0);
+		MEM_PROBE("lfs_file_close", lfs_file_close(&lfs, &file));
+		MEM_PROBE("lfs_rename", lfs_rename(&lfs, name, dest));
+		MEM_PROBE("lfs_remove", lfs_remove(&lfs, dest));
+	}
+	MEM_PROBE("lfs_remove", lfs_remove(&lfs, "log"));
+
+	MEM_PROBE("lfs_unmount", err = lfs_unmount(&lfs));
+	printf("workload: %u files of %u bytes, %u blocks in use before the removal\n",
+		   files, file_size, blocks);
+
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t files = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 32U;
+	uint32_t file_size = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 4096U;
+
+	mem_probe_paint();
+
+	if (workload(files, file_size)) {
+		printf("workload failed\n");
+		return 1;
+	}
+
+	mem_probe_report();
+	return 0;
+}
@@ -0,0 +1,648 @@
+/*
+ * storage_bench.c
+ *
+ *  End-to-end benchmark of the storage stack: littlefs over lfs_at45.c, at45db041.c
+ *  and spi.c on the AT45DB041E model, plus the internal flash users (lfs_iflash.c,
+ *  eeprom.c, fw_update.c) on the FLASH model.
+ *
+ *  usage: storage_bench [-json] [-max] [workload...]
+ *
+ *  Each named workload starts from a reset device, prepares its files, then measures
+ *  its operations only. For every workload one row is printed (CSV, or JSON with
+ *  -json): operations, payload bytes, virtual time, ops/s, bytes/s, SPI bytes, AT45
+ *  programs and erases, AT45 busy time, internal flash programs and erases.
+ *
+ *  The virtual time is the time of the bus and of the devices (SCK at the prescaler
+ *  of SPIx_init() with SYSCLK at 80MHz, the datasheet program and erase times, the
+ *  polling of the driver), not the CPU time of littlefs, which the models do not
+ *  count. The device times are the typical ones of the datasheet; -max uses the
+ *  maxima, the worst case the driver timeouts are sized for. The workloads are
+ *  deterministic, so two runs of the same tree print the same numbers: diff the
+ *  output of two commits to track a regression. Reads of the internal flash are
+ *  memory mapped, they cost the flash wait states at 80MHz (4) per double-word.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "lfs_tier.h"
+#include "eeprom.h"
+#include "fw_update.h"
+
+#define BENCH_HZ				80000000U
+#define BENCH_FW_SIZE			(128U * 1024U)
+#define BENCH_CHUNK				256U
+
+/*Datasheet maxima of the operations that at45db041.h has no constant for*/
+#define BENCH_MAX_XFR_US		400U
+#define BENCH_MAX_P_US			4000U
+#define BENCH_MAX_PE_US			35000U
+
+/**
+ * @brief Counters of the models when a measurement starts, and the result.
+ */
+typedef struct {
+	uint64_t t0;
+	spi_model_stats_t spi;
+	at45_model_stats_t at45;
+	flash_model_stats_t iflash;
+}bench_mark_t;
+
+typedef struct {
+	const char *name;
+	int (*run)(void);
+}bench_workload_t;
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static int json;
+static int max_timing;
+static uint32_t rows;
+static bench_mark_t mark;
+static lfs_t lfs;
+static lfs_file_t file;
+static uint8_t buf[BENCH_CHUNK];
+static uint32_t rnd_state;
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+static uint32_t rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static uint64_t cycles_to_us(uint64_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000U);
+}
+
+/**
+ * @brief Powers up a new board: both flash arrays erased, AT45 in binary page size.
+ */
+static void bench_reset(void)
+{
+	at45_model_timing_t t = {
+		BENCH_MAX_XFR_US, AT45_TEP_US, BENCH_MAX_P_US, BENCH_MAX_PE_US,
+		AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+	};
+
+	clock_model_reset();
+	clock_model_set_hz(BENCH_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&t);
+	}
+	flash_model_reset();
+	MODIFY_REG(FLASH->ACR, FLASH_ACR_LATENCY, FLASH_ACR_LATENCY_4WS);	/*As rcc_set_profile() at 80MHz*/
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+	rnd_state = 0x12345678U;
+}
+
+static void bench_begin(void)
+{
+	mark.t0 = clock_model_cycles();
+	spi_model_get_stats(&mark.spi);
+	at45_model_get_stats(&mark.at45);
+	flash_model_get_stats(&mark.iflash);
+}
+
+/**
+ * @brief Prints the row of a workload, from the counters since bench_begin().
+ */
+static void bench_end(const char *name, uint32_t ops, uint64_t bytes)
+{
+	spi_model_stats_t spi;
+	at45_model_stats_t at45;
+	flash_model_stats_t iflash;
+	uint64_t us = cycles_to_us(clock_model_cycles() - mark.t0);
+	double ops_s = 0.0;
+	double bytes_s = 0.0;
+
+	spi_model_get_stats(&spi);
+	at45_model_get_stats(&at45);
+	flash_model_get_stats(&iflash);
+
+	/*A row that took no virtual time has no rate*/
+	if (us != 0) {
+		ops_s   = ops / ((double)us / 1e6);
+		bytes_s = bytes / ((double)us / 1e6);
+	}
+
+	if (json) {
+		printf("%s\n  {\"workload\": \"%s\", \"ops\": %u, \"bytes\": %llu, \"virtual_us\": %llu, "
+			   "\"ops_per_s\": %.1f, \"bytes_per_s\": %.0f, \"spi_bytes\": %llu, "
+			   "\"at45_programs\": %u, \"at45_page_erases\": %u, \"at45_block_erases\": %u, "
+			   "\"at45_busy_us\": %llu, \"iflash_programs\": %u, \"iflash_erases\": %u}",
+			   rows ? "," : "[", name, ops, (unsigned long long)bytes, (unsigned long long)us,
+			   ops_s, bytes_s, (unsigned long long)(spi.bytes - mark.spi.bytes),
+			   at45.page_programs - mark.at45.page_programs, at45.page_erases - mark.at45.page_erases,
+			   at45.block_erases - mark.at45.block_erases,
+			   (unsigned long long)(at45.busy_us - mark.at45.busy_us),
+			   (iflash.dword_programs + iflash.row_programs) - (mark.iflash.dword_programs + mark.iflash.row_programs),
+			   iflash.page_erases - mark.iflash.page_erases);
+	} else {
+		if (!rows) {
+			printf("workload,ops,bytes,virtual_us,ops_per_s,bytes_per_s,spi_bytes,at45_programs,"
+				   "at45_page_erases,at45_block_erases,at45_busy_us,iflash_programs,iflash_erases\n");
+		}
+		printf("%s,%u,%llu,%llu,%.1f,%.0f,%llu,%u,%u,%u,%llu,%u,%u\n",
+			   name, ops, (unsigned long long)bytes, (unsigned long long)us,
+			   ops_s, bytes_s, (unsigned long long)(spi.bytes - mark.spi.bytes),
+			   at45.page_programs - mark.at45.page_programs, at45.page_erases - mark.at45.page_erases,
+			   at45.block_erases - mark.at45.block_erases,
+			   (unsigned long long)(at45.busy_us - mark.at45.busy_us),
+			   (iflash.dword_programs + iflash.row_programs) - (mark.iflash.dword_programs + mark.iflash.row_programs),
+			   iflash.page_erases - mark.iflash.page_erases);
+	}
+	rows++;
+}
+
+static int lfs_setup(void)
+{
+	int res;
+
+	bench_reset();
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+	}
+	return (res != LFS_ERR_OK) ? fail("lfs format/mount", res) : 0;
+}
+
+/**
+ * @brief Writes a whole file, in chunks of BENCH_CHUNK bytes.
+ */
+static int write_file(lfs_t *fs, const char *path, uint32_t size, uint8_t seed)
+{
+	int res = lfs_file_open(fs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+
+	if (res < 0) {
+		return fail(path, res);
+	}
+	for (uint32_t off = 0; off < size; off += BENCH_CHUNK) {
+		uint32_t len = (size - off < BENCH_CHUNK) ? size - off : BENCH_CHUNK;
+
+		memset(buf, seed + (int)(off / BENCH_CHUNK), len);
+		if (lfs_file_write(fs, &file, buf, len) != (lfs_ssize_t)len) {
+			lfs_file_close(fs, &file);
+			return fail(path, LFS_ERR_IO);
+		}
+	}
+	res = lfs_file_close(fs, &file);
+	return (res < 0) ? fail(path, res) : 0;
+}
+
+/*Format of an erased device*/
+static int wl_format(void)
+{
+	int res;
+
+	bench_reset();
+	bench_begin();
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("lfs format", res);
+	}
+	bench_end("format", 1, 0);
+	return 0;
+}
+
+/*Mount and unmount of a populated file system*/
+static int wl_mount(void)
+{
+	char name[24];
+	int res;
+
+	if (lfs_setup()) {
+		return 1;
+	}
+	for (uint32_t i = 0; i < 32U; i++) {
+		snprintf(name, sizeof(name), "m%02u", i);
+		if (write_file(&lfs, name, 1024U, (uint8_t)i)) {
+			return 1;
+		}
+	}
+	lfs_unmount(&lfs);
+
+	bench_begin();
+	for (uint32_t i = 0; i < 10U; i++) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+		if (res != LFS_ERR_OK) {
+			return fail("lfs mount", res);
+		}
+		lfs_unmount(&lfs);
+	}
+	bench_end("mount", 10, 0);
+	return 0;
+}
+
+/*Creation of small files*/
+static int wl_file_create(void)
+{
+	char name[24];
+
+	if (lfs_setup()) {
+		return 1;
+	}
+
+	bench_begin();
+	for (uint32_t i = 0; i < 100U; i++) {
+		snprintf(name, sizeof(name), "s%03u", i);
+		if (write_file(&lfs, name, 64U, (uint8_t)i)) {
+			return 1;
+		}
+	}
+	bench_end("file_create", 100, 100U * 64U);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Sensor logging: 32 bytes records appended to one file, each one synced*/
+static int wl_sensor_log(void)
+{
+	int res;
+
+	if (lfs_setup()) {
+		return 1;
+	}
+	res = lfs_file_open(&lfs, &file, "log", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+	if (res < 0) {
+		return fail("log open", res);
+	}
+
+	bench_begin();
+	for (uint32_t i = 0; i < 2000U; i++) {
+		memset(buf, (int)i, 32U);
+		if (lfs_file_write(&lfs, &file, buf, 32U) != 32 || lfs_file_sync(&lfs, &file) < 0) {
+			return fail("log append", LFS_ERR_IO);
+		}
+	}
+	bench_end("sensor_log", 2000, 2000U * 32U);
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Config churn: a few small files rewritten over and over*/
+static int wl_config_churn(void)
+{
+	char name[24];
+
+	if (lfs_setup()) {
+		return 1;
+	}
+	for (uint32_t i = 0; i < 8U; i++) {
+		snprintf(name, sizeof(name), "cfg%u", i);
+		if (write_file(&lfs, name, 64U, (uint8_t)i)) {
+			return 1;
+		}
+	}
+
+	bench_begin();
+	for (uint32_t i = 0; i < 400U; i++) {
+		snprintf(name, sizeof(name), "cfg%u", rnd() % 8U);
+		if (write_file(&lfs, name, 64U, (uint8_t)i)) {
+			return 1;
+		}
+	}
+	bench_end("config_churn", 400, 400U * 64U);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/**
+ * @brief Stages a firmware image: the fw_update.c header, then the image in chunks.
+ */
+static int stage_image(fw_image_hdr_t *hdr)
+{
+	static uint8_t image[BENCH_FW_SIZE];
+	int res;
+
+	for (uint32_t i = 0; i < BENCH_FW_SIZE; i++) {
+		image[i] = (uint8_t)rnd();
+	}
+	hdr->magic   = FW_UPDATE_MAGIC;
+	hdr->size    = BENCH_FW_SIZE;
+	hdr->crc     = lfs_crc(0xFFFFFFFF, image, BENCH_FW_SIZE);
+	hdr->version = 1;
+
+	res = lfs_file_open(&lfs, &file, "fw.bin", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+	if (res < 0) {
+		return fail("fw open", res);
+	}
+	if (lfs_file_write(&lfs, &file, hdr, sizeof(*hdr)) != (lfs_ssize_t)sizeof(*hdr)) {
+		return fail("fw header", LFS_ERR_IO);
+	}
+	for (uint32_t off = 0; off < BENCH_FW_SIZE; off += BENCH_CHUNK) {
+		if (lfs_file_write(&lfs, &file, &image[off], BENCH_CHUNK) != (lfs_ssize_t)BENCH_CHUNK) {
+			return fail("fw write", LFS_ERR_IO);
+		}
+	}
+	res = lfs_file_close(&lfs, &file);
+	return (res < 0) ? fail("fw close", res) : 0;
+}
+
+/*Firmware staging: sequential write of an image*/
+static int wl_fw_staging(void)
+{
+	fw_image_hdr_t hdr;
+
+	if (lfs_setup()) {
+		return 1;
+	}
+	bench_begin();
+	if (stage_image(&hdr)) {
+		return 1;
+	}
+	bench_end("fw_staging", BENCH_FW_SIZE / BENCH_CHUNK + 1U, BENCH_FW_SIZE + sizeof(hdr));
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Sequential read of the staged image*/
+static int wl_seq_read(void)
+{
+	fw_image_hdr_t hdr;
+	uint32_t ops = 0;
+	lfs_ssize_t n;
+	int res;
+
+	if (lfs_setup() || stage_image(&hdr)) {
+		return 1;
+	}
+	res = lfs_file_open(&lfs, &file, "fw.bin", LFS_O_RDONLY);
+	if (res < 0) {
+		return fail("fw open", res);
+	}
+
+	bench_begin();
+	while ((n = lfs_file_read(&lfs, &file, buf, BENCH_CHUNK)) > 0) {
+		ops++;
+	}
+	if (n < 0) {
+		return fail("fw read", (int)n);
+	}
+	bench_end("seq_read", ops, BENCH_FW_SIZE + sizeof(hdr));
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Random reads of 64 bytes inside the staged image*/
+static int wl_random_read(void)
+{
+	fw_image_hdr_t hdr;
+	int res;
+
+	if (lfs_setup() || stage_image(&hdr)) {
+		return 1;
+	}
+	res = lfs_file_open(&lfs, &file, "fw.bin", LFS_O_RDONLY);
+	if (res < 0) {
+		return fail("fw open", res);
+	}
+
+	bench_begin();
+	for (uint32_t i = 0; i < 1000U; i++) {
+		lfs_file_seek(&lfs, &file, (lfs_soff_t)(rnd() % (BENCH_FW_SIZE - 64U)), LFS_SEEK_SET);
+		if (lfs_file_read(&lfs, &file, buf, 64U) != 64) {
+			return fail("random read", LFS_ERR_IO);
+		}
+	}
+	bench_end("random_read", 1000, 1000U * 64U);
+	lfs_file_close(&lfs, &file);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Install of the staged image into the other bank, the overlapped erase included*/
+static int wl_fw_install(void)
+{
+	fw_image_hdr_t hdr;
+	fw_update_err_t err;
+
+	if (lfs_setup() || stage_image(&hdr)) {
+		return 1;
+	}
+
+	bench_begin();
+	err = fw_update_install(&lfs, "fw.bin", &hdr);
+	if (err != FW_UPDATE_OK) {
+		return fail("fw install", (int)err);
+	}
+	bench_end("fw_install", 1, BENCH_FW_SIZE);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/*Directory scan: listing of 4 directories of 16 files, with a stat of each one*/
+static int wl_dir_scan(void)
+{
+	struct lfs_info info;
+	char path[LFS_NAME_MAX + 8];
+	lfs_dir_t dir;
+	uint32_t ops = 0;
+	int res;
+
+	if (lfs_setup()) {
+		return 1;
+	}
+	for (uint32_t d = 0; d < 4U; d++) {
+		snprintf(path, sizeof(path), "d%u", d);
+		lfs_mkdir(&lfs, path);
+		for (uint32_t f = 0; f < 16U; f++) {
+			snprintf(path, sizeof(path), "d%u/f%02u", d, f);
+			if (write_file(&lfs, path, 128U, (uint8_t)f)) {
+				return 1;
+			}
+		}
+	}
+	lfs_unmount(&lfs);
+	res = lfs_mount(&lfs, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("lfs mount", res);
+	}
+
+	bench_begin();
+	for (uint32_t d = 0; d < 4U; d++) {
+		snprintf(path, sizeof(path), "d%u", d);
+		res = lfs_dir_open(&lfs, &dir, path);
+		if (res < 0) {
+			return fail("dir open", res);
+		}
+		while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+			if (info.type != LFS_TYPE_REG) {
+				continue;
+			}
+			snprintf(path, sizeof(path), "d%u/%s", d, info.name);
+			res = lfs_stat(&lfs, path, &info);
+			if (res < 0) {
+				return fail("stat", res);
+			}
+			ops++;
+		}
+		lfs_dir_close(&lfs, &dir);
+	}
+	bench_end("dir_scan", ops, 0);
+	lfs_unmount(&lfs);
+	return 0;
+}
+
+/**
+ * @brief Small file latency of one tier: writes, then reads, of 50 files of 32 bytes.
+ */
+static int tier_small_files(const char *dir, const char *write_name, const char *read_name)
+{
+	lfs_tier_t tier;
+	lfs_tier_file_t tf;
+	char path[32];
+	int res;
+
+	bench_reset();
+	res = lfs_tier_mount(&tier);
+	if (res != LFS_ERR_OK) {
+		return fail("tier mount", res);
+	}
+	lfs_tier_mkdir(&tier, dir);
+
+	bench_begin();
+	for (uint32_t i = 0; i < 50U; i++) {
+		snprintf(path, sizeof(path), "%s/k%02u", dir, i);
+		memset(buf, (int)i, 32U);
+		if (lfs_tier_file_open(&tier, &tf, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0 ||
+			lfs_tier_file_write(&tf, buf, 32U) != 32 || lfs_tier_file_close(&tf) < 0) {
+			return fail(path, LFS_ERR_IO);
+		}
+	}
+	bench_end(write_name, 50, 50U * 32U);
+
+	bench_begin();
+	for (uint32_t i = 0; i < 50U; i++) {
+		snprintf(path, sizeof(path), "%s/k%02u", dir, i);
+		if (lfs_tier_file_open(&tier, &tf, path, LFS_O_RDONLY) < 0 ||
+			lfs_tier_file_read(&tf, buf, 32U) != 32 || lfs_tier_file_close(&tf) < 0) {
+			return fail(path, LFS_ERR_IO);
+		}
+	}
+	bench_end(read_name, 50, 50U * 32U);
+
+	lfs_tier_unmount(&tier);
+	return 0;
+}
+
+static int wl_tier_hot(void)
+{
+	return tier_small_files("/cfg", "tier_hot_write", "tier_hot_read");
+}
+
+static int wl_tier_cold(void)
+{
+	return tier_small_files("/data", "tier_cold_write", "tier_cold_read");
+}
+
+/*Update of a 32 bits counter: emulated EEPROM against a file on each tier*/
+static int wl_counter(void)
+{
+	lfs_tier_t tier;
+	lfs_tier_file_t tf;
+	static const char *const paths[] = { "/cfg/counter", "/counter" };
+	static const char *const names[] = { "counter_lfs_iflash", "counter_lfs_at45" };
+	int res;
+
+	bench_reset();
+	if (ee_init() != EE_OK) {
+		return fail("ee init", 0);
+	}
+	bench_begin();
+	for (uint32_t i = 0; i < 500U; i++) {
+		if (ee_write(1, i) != EE_OK) {
+			return fail("ee write", 0);
+		}
+	}
+	bench_end("counter_eeprom", 500, 500U * 4U);
+
+	res = lfs_tier_mount(&tier);
+	if (res != LFS_ERR_OK) {
+		return fail("tier mount", res);
+	}
+	for (uint32_t p = 0; p < 2U; p++) {
+		bench_begin();
+		for (uint32_t i = 0; i < 500U; i++) {
+			if (lfs_tier_file_open(&tier, &tf, paths[p], LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0 ||
+				lfs_tier_file_write(&tf, &i, sizeof(i)) != sizeof(i) || lfs_tier_file_close(&tf) < 0) {
+				return fail(paths[p], LFS_ERR_IO);
+			}
+		}
+		bench_end(names[p], 500, 500U * 4U);
+	}
+	lfs_tier_unmount(&tier);
+	return 0;
+}
+
+static const bench_workload_t workloads[] = {
+	{ "format",			wl_format		},
+	{ "mount",			wl_mount		},
+	{ "file_create",	wl_file_create	},
+	{ "sensor_log",		wl_sensor_log	},
+	{ "config_churn",	wl_config_churn	},
+	{ "fw_staging",		wl_fw_staging	},
+	{ "seq_read",		wl_seq_read		},
+	{ "random_read",	wl_random_read	},
+	{ "fw_install",		wl_fw_install	},
+	{ "dir_scan",		wl_dir_scan		},
+	{ "tier_hot",		wl_tier_hot		},
+	{ "tier_cold",		wl_tier_cold	},
+	{ "counter",		wl_counter		},
+};
+
+static int selected(const char *name, int argc, char **argv)
+{
+	int any = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-') {
+			continue;
+		}
+		any = 1;
+		if (strcmp(argv[i], name) == 0) {
+			return 1;
+		}
+	}
+	return !any;
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-json") == 0) {
+			json = 1;
+		} else if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "usage: %s [-json] [-max] [workload...]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (uint32_t w = 0; w < sizeof(workloads)/sizeof(workloads[0]); w++) {
+		if (selected(workloads[w].name, argc, argv) && workloads[w].run()) {
+			return 1;
+		}
+	}
+
+	if (json) {
+		printf("%s\n", rows ? "\n]" : "[]");
+	}
+	return 0;
+}
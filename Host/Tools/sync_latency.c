@@ -0,0 +1,408 @@
+/*
+ * sync_latency.c
+ *
+ *  Latency of lfs_file_write() and lfs_file_sync() on the AT45 model, with the
+ *  metadata compaction left to the API calls, done by lfs_fs_gc() or done in bounded
+ *  steps by lfs_fs_gcstep() between them, and with or without a reservoir of erased
+ *  blocks.
+ *
+ *  usage: sync_latency [iterations] [steps] [-r reserve] [-max]
+ *
+ *  The workload is a data logger: each iteration appends a 24 byte record to one of
+ *  four log files that stay open and syncs it, and every tenth one rewrites a small
+ *  configuration file. An append after a sync goes to a new block, which the write
+ *  erases unless it takes one from the reservoir. It runs five times on a new file
+ *  system with compact_thresh at half a block:
+ *    inline  nothing runs between the iterations, a commit that finds its metadata
+ *            pair full compacts it (erase and rewrite) inside the call,
+ *    gc      lfs_fs_gc() runs every 25 iterations, it compacts every pair over the
+ *            threshold in one call,
+ *    gcstep  up to [steps] (default 3) calls of lfs_fs_gcstep() run after each
+ *            iteration, as the idle time of the logger would,
+ *  and gc+res, gcstep+res: the same with a reservoir of [reserve] (default 8) erased
+ *  blocks (reserve_count), which lfs_fs_gc() and lfs_fs_gcstep() fill.
+ *  For each run the p50, p99 and p100 of the write and sync calls are printed, with
+ *  the p99 and p100 of the close calls and of the work done between the iterations,
+ *  the block erases and the virtual time. The times are bus and device time at
+ *  80MHz, the CPU time of littlefs is not counted.
+ *
+ *  A last case fills the file system with one block files, removes six of them and
+ *  runs lfs_fs_gc() with the reservoir, first with every erase failing as a bad block
+ *  (the call must return with the reservoir empty), then on the model, which erases
+ *  the freed blocks into it. A new directory and a two block file must still fit, the
+ *  reservoir hands its blocks back when nothing else is free, and the file must read
+ *  back after a remount.
+ *  Exit status 1 on a failed call.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+
+#define SL_HZ				80000000U
+#define SL_LOGS				4U
+#define SL_GC_EVERY			25U
+#define SL_RESERVE_MAX		64U
+#define SL_FULL_FREED		6U
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+typedef enum {
+	SL_INLINE = 0,
+	SL_GC,
+	SL_GCSTEP,
+}sl_mode_t;
+
+static const char *const sl_names[] = { "inline", "gc", "gcstep" };
+
+/**
+ * @brief A run: how the compaction is done and the reservoir size.
+ */
+typedef struct {
+	sl_mode_t mode;
+	uint8_t reserve;
+}sl_run_t;
+
+static const sl_run_t sl_runs[] = {
+	{ SL_INLINE, 0 }, { SL_GC, 0 }, { SL_GCSTEP, 0 }, { SL_GC, 1 }, { SL_GCSTEP, 1 },
+};
+
+static const at45_model_timing_t sl_max = {
+	400U, AT45_TEP_US, 4000U, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+};
+
+static int max_timing;
+static lfs_t lfs;
+static lfs_file_t logs[SL_LOGS];
+static lfs_file_t cfg_file;
+static struct lfs_reserved reserve_buf[SL_RESERVE_MAX];
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)(clock_model_cycles() / (SystemCoreClock / 1000000U));
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t pct(uint32_t *v, uint32_t n, uint32_t permille)
+{
+	return n ? v[((uint64_t)(n - 1U) * permille) / 1000U] : 0U;
+}
+
+/**
+ * @brief Work between two iterations, returns its duration.
+ */
+static int idle(sl_mode_t mode, uint32_t it, uint32_t steps, uint32_t *us)
+{
+	uint32_t t0 = now_us();
+	int res = 0;
+
+	if (mode == SL_GC && (it % SL_GC_EVERY) == SL_GC_EVERY - 1U) {
+		res = lfs_fs_gc(&lfs);
+	} else if (mode == SL_GCSTEP) {
+		for (uint32_t s = 0; s < steps; s++) {
+			res = lfs_fs_gcstep(&lfs);
+			if (res <= 0) {
+				break;
+			}
+		}
+	}
+	*us = now_us() - t0;
+
+	return (res < 0) ? res : 0;
+}
+
+/**
+ * @brief The board at 80MHz with a new memory pool.
+ */
+static void board(void)
+{
+	clock_model_reset();
+	clock_model_set_hz(SL_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&sl_max);
+	}
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+}
+
+/**
+ * @brief Writes a file of size bytes, the content follows the seed.
+ */
+static int write_file(const char *name, uint32_t size, uint32_t seed)
+{
+	uint8_t buf[64];
+	int res, err;
+
+	res = lfs_file_open(&lfs, &cfg_file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+	if (res < 0) {
+		return res;
+	}
+	for (uint32_t off = 0; off < size && res >= 0; off += sizeof(buf)) {
+		memset(buf, (int)(seed + off / sizeof(buf)), sizeof(buf));
+		res = lfs_file_write(&lfs, &cfg_file, buf, sizeof(buf));
+	}
+	err = lfs_file_close(&lfs, &cfg_file);
+
+	return (res < 0) ? res : err;
+}
+
+/**
+ * @brief A block device that reports every erase as a bad block.
+ */
+static int bad_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	(void)c;
+	(void)block;
+
+	return LFS_ERR_CORRUPT;
+}
+
+/**
+ * @brief Fills the file system, frees a few blocks into the reservoir and checks that
+ * they can still be allocated.
+ */
+static int near_full(uint32_t reserve)
+{
+	struct lfs_config cfg = lfs_at45_cfg;
+	uint32_t files, reserved;
+	lfs_ssize_t used;
+	uint8_t buf[64];
+	char name[16];
+	int res;
+
+	board();
+	cfg.reserve_count  = reserve;
+	cfg.reserve_buffer = reserve_buf;
+
+	res = lfs_format(&lfs, &cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &cfg);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+
+	/*One block per file until nothing is left*/
+	for (files = 0; ; files++) {
+		snprintf(name, sizeof(name), "fill%u", files);
+		res = write_file(name, cfg.block_size, files);
+		if (res == LFS_ERR_NOSPC) {
+			lfs_remove(&lfs, name);
+			break;
+		}
+		if (res < 0) {
+			return fail("fill", res);
+		}
+	}
+	if (files < SL_FULL_FREED) {
+		return fail("fill: too few files", (int)files);
+	}
+
+	for (uint32_t i = 0; i < SL_FULL_FREED; i++) {
+		snprintf(name, sizeof(name), "fill%u", i);
+		res = lfs_remove(&lfs, name);
+		if (res < 0) {
+			return fail("remove", res);
+		}
+	}
+	/*Every free block is bad: the fill of the reservoir must give up, not loop*/
+	cfg.erase = bad_erase;
+	res = lfs_fs_gc(&lfs);
+	cfg.erase = lfs_at45_cfg.erase;
+	if (res < 0 || lfs.reserve.count != 0) {
+		return fail("gc with bad blocks", res);
+	}
+
+	res = lfs_fs_gc(&lfs);
+	if (res < 0) {
+		return fail("gc", res);
+	}
+	reserved = lfs.reserve.count;
+
+	res = lfs_mkdir(&lfs, "dir");
+	if (res < 0) {
+		return fail("mkdir near full", res);
+	}
+	res = write_file("dir/after", 2U * cfg.block_size, 7U);
+	if (res < 0) {
+		return fail("write near full", res);
+	}
+	used = lfs_fs_size(&lfs);
+	lfs_unmount(&lfs);
+
+	res = lfs_mount(&lfs, &cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &cfg_file, "dir/after", LFS_O_RDONLY);
+	}
+	if (res < 0) {
+		return fail("remount", res);
+	}
+	for (uint32_t off = 0; off < 2U * cfg.block_size; off += sizeof(buf)) {
+		res = lfs_file_read(&lfs, &cfg_file, buf, sizeof(buf));
+		if (res != (int)sizeof(buf) || buf[0] != (uint8_t)(7U + off / sizeof(buf)) ||
+			buf[sizeof(buf) - 1U] != buf[0]) {
+			return fail("read back", res);
+		}
+	}
+	lfs_file_close(&lfs, &cfg_file);
+	lfs_unmount(&lfs);
+
+	printf("near-full: %u one block files, %u removed, %u blocks in the reservoir after gc, "
+		   "mkdir and a two block file fit, %d of %u blocks used\n", files, SL_FULL_FREED, reserved,
+		   (int)used, cfg.block_count);
+
+	return 0;
+}
+
+static int run(const sl_run_t *r, uint32_t iterations, uint32_t steps, uint32_t reserve)
+{
+	struct lfs_config cfg = lfs_at45_cfg;
+	uint32_t *write_us = malloc(sizeof(uint32_t) * iterations);
+	uint32_t *sync_us = malloc(sizeof(uint32_t) * iterations);
+	uint32_t *close_us = malloc(sizeof(uint32_t) * iterations);
+	uint32_t *idle_us = malloc(sizeof(uint32_t) * iterations);
+	uint32_t nclose = 0, t0, start;
+	at45_model_stats_t st;
+	uint8_t rec[24], conf[64];
+	char name[16];
+	int res;
+
+	board();
+
+	cfg.compact_thresh = cfg.block_size / 2U;
+	if (r->reserve) {
+		cfg.reserve_count  = reserve;
+		cfg.reserve_buffer = reserve_buf;
+	}
+
+	res = lfs_format(&lfs, &cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &cfg);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+	for (uint32_t i = 0; i < SL_LOGS; i++) {
+		snprintf(name, sizeof(name), "log%u", i);
+		res = lfs_file_open(&lfs, &logs[i], name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+		if (res < 0) {
+			return fail("log open", res);
+		}
+	}
+
+	at45_model_clear_stats();
+	start = now_us();
+	for (uint32_t it = 0; it < iterations; it++) {
+		lfs_file_t *f = &logs[it % SL_LOGS];
+
+		memset(rec, (int)it, sizeof(rec));
+		t0 = now_us();
+		res = lfs_file_write(&lfs, f, rec, sizeof(rec));
+		write_us[it] = now_us() - t0;
+		if (res != (int)sizeof(rec)) {
+			return fail("append", res);
+		}
+		t0 = now_us();
+		res = lfs_file_sync(&lfs, f);
+		sync_us[it] = now_us() - t0;
+		if (res < 0) {
+			return fail("sync", res);
+		}
+
+		if ((it % 10U) == 9U) {
+			snprintf(name, sizeof(name), "cfg%u", (it / 10U) % 3U);
+			memset(conf, (int)it, sizeof(conf));
+			res = lfs_file_open(&lfs, &cfg_file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+			if (res < 0) {
+				return fail("cfg open", res);
+			}
+			lfs_file_write(&lfs, &cfg_file, conf, sizeof(conf));
+			t0 = now_us();
+			res = lfs_file_close(&lfs, &cfg_file);
+			close_us[nclose++] = now_us() - t0;
+			if (res < 0) {
+				return fail("cfg close", res);
+			}
+		}
+
+		res = idle(r->mode, it, steps, &idle_us[it]);
+		if (res < 0) {
+			return fail("gc", res);
+		}
+	}
+	at45_model_get_stats(&st);
+
+	for (uint32_t i = 0; i < SL_LOGS; i++) {
+		lfs_file_close(&lfs, &logs[i]);
+	}
+	lfs_unmount(&lfs);
+
+	qsort(write_us, iterations, sizeof(uint32_t), cmp_u32);
+	qsort(sync_us, iterations, sizeof(uint32_t), cmp_u32);
+	qsort(close_us, nclose, sizeof(uint32_t), cmp_u32);
+	qsort(idle_us, iterations, sizeof(uint32_t), cmp_u32);
+	snprintf(name, sizeof(name), "%s%s", sl_names[r->mode], r->reserve ? "+res" : "");
+	printf("%-10s %7u %7u %7u %7u %7u %7u %7u %7u %7u %7u %6u %10u\n", name,
+		   pct(write_us, iterations, 500), pct(write_us, iterations, 990), pct(write_us, iterations, 1000),
+		   pct(sync_us, iterations, 500), pct(sync_us, iterations, 990), pct(sync_us, iterations, 1000),
+		   pct(close_us, nclose, 990), pct(close_us, nclose, 1000),
+		   pct(idle_us, iterations, 990), pct(idle_us, iterations, 1000),
+		   st.block_erases, now_us() - start);
+
+	free(write_us);
+	free(sync_us);
+	free(close_us);
+	free(idle_us);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t iterations = 2000U, steps = 3U, reserve = 8U;
+	int n = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			reserve = (uint32_t)strtoul(argv[++i], NULL, 0);
+			if (reserve == 0 || reserve > SL_RESERVE_MAX) {
+				fprintf(stderr, "reserve: 1 to %u blocks\n", SL_RESERVE_MAX);
+				return 1;
+			}
+		} else if (n++ == 0) {
+			iterations = (uint32_t)strtoul(argv[i], NULL, 0);
+		} else {
+			steps = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+
+	printf("%-10s %7s %7s %7s %7s %7s %7s %7s %7s %7s %7s %6s %10s\n", "mode", "write50",
+		   "write99", "write100", "sync50", "sync99", "sync100", "close99", "close100", "idle99",
+		   "idle100", "erases", "total_us");
+	for (uint32_t i = 0; i < sizeof(sl_runs) / sizeof(sl_runs[0]); i++) {
+		if (run(&sl_runs[i], iterations, steps, reserve)) {
+			return 1;
+		}
+	}
+
+	return near_full(reserve);
+}
@@ -0,0 +1,302 @@
+/*
+ * txn_bench.c
+ *
+ *  Metadata commits and programs of a group update on the AT45 model: configuration
+ *  files and their checksum manifest rewritten together, with one lfs_file_sync()
+ *  per file or with one lfs_file_syncgroup().
+ *
+ *  usage: txn_bench [batches] [files] [size] [-max]
+ *
+ *  Each of [batches] (default 500) batches rewrites [files] (default 2, 2 to 8) open
+ *  files in place: [files]-1 configuration files of [size] (default 48) bytes and a
+ *  manifest with their CRC-32s, which carries the batch number in a user attribute.
+ *  It runs four times on a new file system:
+ *    sync        all the files in cfg/, one lfs_file_sync() per file,
+ *    group       the same, one lfs_file_syncgroup() per batch,
+ *    sync/dirs   the configuration files in cfg/ and the manifest in sys/,
+ *    group/dirs  the same, one lfs_file_syncgroup() through the journal.
+ *  For each run the metadata commits and compactions, the bytes programmed (AT45
+ *  pages x 256) and the block erases per batch are printed, with the p50 and p99 of
+ *  the batch time. After a remount the manifest is checked against the files. A user
+ *  file named .lfs-txn sits in the root and must come through every run unchanged, and
+ *  the attribute type of the journal (LFS_TXN_ATTR) must be refused. Build with
+ *  -DLFS_STATS. The times are bus and device time at 80MHz, the CPU time of
+ *  littlefs is not counted.
+ */
+
+#include <stdlib.h>
+#include "at45db041.h"
+#include "lfs_at45.h"
+#include "mem_pool.h"
+
+#define TB_HZ				80000000U
+#define TB_FILES_MAX		8U
+#define TB_SIZE_MAX			4096U
+#define TB_ATTR_VERSION		'v'
+#define TB_TXN_FILE			".lfs-txn"	/*A user file, not the journal*/
+
+/*Information structure of the driver, defined by the application*/
+at45db_t AT45DB;
+
+static const at45_model_timing_t tb_max = {
+	400U, AT45_TEP_US, AT45_TP_US, 35000U, AT45_TBE_US, AT45_TSE_US, AT45_TCE_US
+};
+
+static int max_timing;
+static lfs_t lfs;
+static lfs_file_t files[TB_FILES_MAX];
+static uint32_t version;
+static struct lfs_attr manifest_attr = { TB_ATTR_VERSION, &version, sizeof(version) };
+static const struct lfs_file_config manifest_cfg = { .attrs = &manifest_attr, .attr_count = 1 };
+static uint8_t buf[TB_SIZE_MAX];
+static const char tb_txn_data[] = "a user file, not a group sync journal";
+
+
+static int fail(const char *what, int res)
+{
+	fprintf(stderr, "FAIL: %s (%d)\n", what, res);
+	return 1;
+}
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)(clock_model_cycles() / (SystemCoreClock / 1000000U));
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t pct(uint32_t *v, uint32_t n, uint32_t permille)
+{
+	return n ? v[((uint64_t)(n - 1U) * permille) / 1000U] : 0U;
+}
+
+/**
+ * @brief Path of file f, the manifest is the last one.
+ */
+static void path_of(char *path, size_t len, uint32_t f, uint32_t n, int dirs)
+{
+	if (f + 1U < n) {
+		snprintf(path, len, "cfg/c%u", f);
+	} else {
+		snprintf(path, len, "%s/manifest", dirs ? "sys" : "cfg");
+	}
+}
+
+/**
+ * @brief Content of a configuration file in a batch.
+ */
+static void content(uint8_t *data, uint32_t size, uint32_t f, uint32_t batch)
+{
+	for (uint32_t i = 0; i < size; i++) {
+		data[i] = (uint8_t)(batch * 31U + f * 7U + i);
+	}
+}
+
+/**
+ * @brief Reads the files back after a remount: the manifest matches them and
+ * holds the last batch.
+ */
+static int check(uint32_t n, uint32_t size, int dirs, uint32_t batches)
+{
+	uint32_t crcs[TB_FILES_MAX], got = 0, v = 0;
+	char path[32];
+	int res;
+
+	res = lfs_mount(&lfs, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		return fail("remount", res);
+	}
+	for (uint32_t f = 0; f + 1U < n; f++) {
+		path_of(path, sizeof(path), f, n, dirs);
+		res = lfs_file_open(&lfs, &files[f], path, LFS_O_RDONLY);
+		if (res < 0 || lfs_file_read(&lfs, &files[f], buf, size) != (lfs_ssize_t)size) {
+			return fail("read back", (int)f);
+		}
+		lfs_file_close(&lfs, &files[f]);
+		crcs[f] = lfs_crc(0xffffffffU, buf, size);
+	}
+	path_of(path, sizeof(path), n - 1U, n, dirs);
+	res = lfs_file_open(&lfs, &files[0], path, LFS_O_RDONLY);
+	if (res < 0) {
+		return fail("manifest open", res);
+	}
+	for (uint32_t f = 0; f + 1U < n; f++) {
+		if (lfs_file_read(&lfs, &files[0], &got, sizeof(got)) != sizeof(got) || got != crcs[f]) {
+			return fail("manifest entry", (int)f);
+		}
+	}
+	lfs_file_close(&lfs, &files[0]);
+	res = lfs_getattr(&lfs, path, TB_ATTR_VERSION, &v, sizeof(v));
+	if (res != sizeof(v) || v != batches - 1U) {
+		return fail("manifest version", (int)v);
+	}
+
+	res = lfs_file_open(&lfs, &files[0], TB_TXN_FILE, LFS_O_RDONLY);
+	if (res < 0) {
+		return fail(TB_TXN_FILE " open", res);
+	}
+	res = lfs_file_read(&lfs, &files[0], buf, sizeof(buf));
+	lfs_file_close(&lfs, &files[0]);
+	if (res != (int)sizeof(tb_txn_data) || memcmp(buf, tb_txn_data, sizeof(tb_txn_data)) != 0) {
+		return fail(TB_TXN_FILE " content", res);
+	}
+	res = lfs_setattr(&lfs, "/", LFS_TXN_ATTR, &v, sizeof(v));
+	if (res != LFS_ERR_INVAL || lfs_getattr(&lfs, "/", LFS_TXN_ATTR, &v, sizeof(v)) != LFS_ERR_INVAL ||
+		lfs_removeattr(&lfs, "/", LFS_TXN_ATTR) != LFS_ERR_INVAL) {
+		return fail("journal attribute open to the user", res);
+	}
+	lfs_unmount(&lfs);
+
+	return 0;
+}
+
+static int run(int group, int dirs, uint32_t batches, uint32_t n, uint32_t size)
+{
+	uint32_t *us = malloc(sizeof(uint32_t) * batches);
+	lfs_file_t *list[TB_FILES_MAX];
+	uint32_t crcs[TB_FILES_MAX];
+	struct lfs_stats ls;
+	at45_model_stats_t st;
+	char path[32], name[16];
+	uint32_t t0;
+	int res;
+
+	clock_model_reset();
+	clock_model_set_hz(TB_HZ);
+	spi_model_reset();
+	at45_model_reset();
+	if (max_timing) {
+		at45_model_set_timing(&tb_max);
+	}
+	mem_pool_init();
+	SPIx_init(SPI_PERIPH, GPIO_SPIx);
+	at45db_page_size_conf(2);
+
+	res = lfs_format(&lfs, &lfs_at45_cfg);
+	if (res == LFS_ERR_OK) {
+		res = lfs_mount(&lfs, &lfs_at45_cfg);
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "cfg");
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_mkdir(&lfs, "sys");
+	}
+	if (res == LFS_ERR_OK) {
+		res = lfs_file_open(&lfs, &files[0], TB_TXN_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL);
+	}
+	if (res == LFS_ERR_OK) {
+		lfs_file_write(&lfs, &files[0], tb_txn_data, sizeof(tb_txn_data));
+		res = lfs_file_close(&lfs, &files[0]);
+	}
+	if (res != LFS_ERR_OK) {
+		return fail("format/mount", res);
+	}
+	for (uint32_t f = 0; f < n; f++) {
+		path_of(path, sizeof(path), f, n, dirs);
+		if (f + 1U < n) {
+			res = lfs_file_open(&lfs, &files[f], path, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+		} else {
+			res = lfs_file_opencfg(&lfs, &files[f], path, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC,
+								   &manifest_cfg);
+		}
+		if (res < 0) {
+			return fail("open", res);
+		}
+		list[f] = &files[f];
+	}
+
+	lfs_stats_reset(&lfs);
+	at45_model_clear_stats();
+	for (uint32_t b = 0; b < batches; b++) {
+		t0 = now_us();
+		for (uint32_t f = 0; f + 1U < n; f++) {
+			content(buf, size, f, b);
+			crcs[f] = lfs_crc(0xffffffffU, buf, size);
+			lfs_file_rewind(&lfs, &files[f]);
+			if (lfs_file_write(&lfs, &files[f], buf, size) != (lfs_ssize_t)size) {
+				return fail("write", (int)f);
+			}
+		}
+		version = b;
+		lfs_file_rewind(&lfs, &files[n - 1U]);
+		res = lfs_file_write(&lfs, &files[n - 1U], crcs, sizeof(uint32_t) * (n - 1U));
+		if (res != (int)(sizeof(uint32_t) * (n - 1U))) {
+			return fail("manifest write", res);
+		}
+
+		if (group) {
+			res = lfs_file_syncgroup(&lfs, list, n);
+		} else {
+			for (uint32_t f = 0; f < n && res >= 0; f++) {
+				res = lfs_file_sync(&lfs, &files[f]);
+			}
+		}
+		if (res < 0) {
+			return fail("sync", res);
+		}
+		us[b] = now_us() - t0;
+	}
+	lfs_stats(&lfs, &ls);
+	at45_model_get_stats(&st);
+
+	for (uint32_t f = 0; f < n; f++) {
+		lfs_file_close(&lfs, &files[f]);
+	}
+	lfs_unmount(&lfs);
+	if (check(n, size, dirs, batches)) {
+		return 1;
+	}
+
+	qsort(us, batches, sizeof(uint32_t), cmp_u32);
+	snprintf(name, sizeof(name), "%s%s", group ? "group" : "sync", dirs ? "/dirs" : "");
+	printf("%-11s %8.2f %8.3f %9.0f %8.3f %8u %8u\n", name,
+		   (double)ls.commit_calls / batches, (double)ls.compact_calls / batches,
+		   (double)st.page_programs * LFS_AT45_PAGE_SIZE / batches, (double)st.block_erases / batches,
+		   pct(us, batches, 500), pct(us, batches, 990));
+
+	free(us);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t batches = 500U, n = 2U, size = 48U;
+	int k = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-max") == 0) {
+			max_timing = 1;
+		} else if (k == 0) {
+			batches = (uint32_t)strtoul(argv[i], NULL, 0);
+			k++;
+		} else if (k == 1) {
+			n = (uint32_t)strtoul(argv[i], NULL, 0);
+			k++;
+		} else {
+			size = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+	if (batches == 0 || n < 2U || n > TB_FILES_MAX || size == 0 || size > TB_SIZE_MAX) {
+		fprintf(stderr, "usage: txn_bench [batches] [files 2..%u] [size 1..%u] [-max]\n",
+				TB_FILES_MAX, TB_SIZE_MAX);
+		return 1;
+	}
+
+	printf("%-11s %8s %8s %9s %8s %8s %8s\n", "mode", "commits", "compacts", "prog_B",
+		   "erases", "us50", "us99");
+	for (int dirs = 0; dirs < 2; dirs++) {
+		for (int group = 0; group < 2; group++) {
+			if (run(group, dirs, batches, n, size)) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
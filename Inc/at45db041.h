@@ -10,7 +10,7 @@
 
 #include "main.h"			//Common headers
 #include "spi.h"			//Access SPI functions
-#include "system_init.h"	//Access delay_ms function
+#include "system_init.h"	//Access delay and time base functions
 
 /*Define the page size*/
 #define BINARY_PAGE_SIZE
@@ -52,7 +52,9 @@
 #define DISABLE_SECTOR_PROTECTION_4		0x9A
 #define INTERNAL_BUFFER_1				0x84
 #define SECTOR_ERASE					0x7C
+#define BLOCK_ERASE						0x50
 #define BUFFER_TO_MAIN_1				0x83
+#define BUFFER_TO_MAIN_NOERASE_1		0x88
 #define BUFFER_TO_MAIN_2				0x86
 #define PAGE_ERASE_CMD					0x81
 #define BIN_PG_SIZE_1					0x3D
@@ -60,6 +62,19 @@
 #define BIN_PG_SIZE_3					0x80
 #define BIN_PG_SIZE_4					0xA6
 #define BUFFER_2_READ_BINARY			0xD6
+/*Timings in microseconds (AT45DB041E datasheet, maximum values)*/
+#define AT45_TDP_US						3U			/*CS high to deep power-down*/
+#define AT45_TRDPD_US					35U			/*CS high to standby, resume from deep power-down*/
+#define AT45_TUDPD_US					3U			/*CS high to ultra-deep power-down*/
+#define AT45_TCSLU_US					1U			/*CS low pulse to exit ultra-deep power-down (20ns)*/
+#define AT45_TXUDPD_US					120U		/*Exit ultra-deep power-down to standby*/
+#define AT45_TEP_US						35000U		/*Page erase and programming*/
+#define AT45_TP_US						4000U		/*Page programming*/
+#define AT45_TBE_US						50000U		/*Block erase*/
+#define AT45_TSE_US						1300000U	/*Sector erase*/
+#define AT45_TCE_US						17000000U	/*Chip erase*/
+/*Status polling period of the asynchronous operations*/
+#define AT45_POLL_US					250U
 
 /**
  * @brief Enumerators about MAN ID.
@@ -95,6 +110,7 @@ dev_id_t at45db_read_manID(void);
 void at45db_chip_erase(void);
 void at45db_sector_erase(uint8_t sector_num);
 void at45db_page_erase(uint16_t page);
+void at45db_block_erase(uint16_t block);
 void at45db_deep_sleep(at45db_t *info);
 void at45db_page_size_conf(uint16_t mode);
 uint16_t at45db_wake_up_from_deep_sleep(at45db_t info);
@@ -102,8 +118,12 @@ void at45db_ultra_deep_sleep(at45db_t info);
 uint16_t at45db_wake_up_from_ultra_deep_sleep(at45db_t info);
 void at45db_read_data(uint32_t address, uint8_t *data, uint16_t size);
 int at45db_IsReady(void);
+int at45db_wait_ready(uint32_t timeout_us);
 uint16_t at45db_fault_check(void);
 void at45db_program(uint32_t addr, uint8_t *buffer, uint16_t size);
+void at45db_program_noerase(uint32_t addr, const uint8_t *buffer, uint16_t size);
+int at45db_program_async(uint32_t addr, const uint8_t *buffer, uint16_t size, ev_handler_t handler, void *arg);
+int at45db_notify_ready(uint32_t timeout_us, ev_handler_t handler, void *arg);
 void at45db_read_status(uint8_t *status_reg);
 void at45db_read_continuous(uint32_t addr, uint8_t *buffer, uint32_t size);
 int is_device_busy(void);
@@ -0,0 +1,58 @@
+/*
+ * eeprom.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      Emulated EEPROM for small values that change often (counters, state flags).
+ *      Two internal flash pages (FLASH_EE_PAGES at the top of the data region) are
+ *      used as a log: every update appends one double-word record to the active page,
+ *      and a RAM index keeps the latest value of each key. When the active page is
+ *      full, the latest values are copied into the other page (compaction).
+ *
+ *      Page layout (double-words):
+ *        0     : EE_PAGE_MAGIC << 32 | sequence number (compaction started)
+ *        1     : EE_PAGE_VALID (compaction finished, the page can be used)
+ *        2..3  : reserved
+ *        4..   : records, key[15:0] | value[47:16] | check[63:48]
+ */
+
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+#include "main.h"	//Common headers
+#include "flash.h"	//Internal flash primitives
+
+#define EE_MAX_KEYS						128			/*Keys are 0..EE_MAX_KEYS-1*/
+#define EE_PAGE_MAGIC					0x45455047U	/*"GPEE"*/
+#define EE_PAGE_VALID					0x56414C4944504745ULL
+#define EE_HEADER_DWORDS				4
+#define EE_RECORDS						(FLASH_PAGE_SIZE / 8 - EE_HEADER_DWORDS)
+
+/**
+ * @brief Result of an EEPROM operation.
+ */
+typedef enum {
+	EE_OK		  = 0,
+	EE_NOT_FOUND  = 1, /*The key has never been written*/
+	EE_BAD_KEY	  = 2, /*Key out of range*/
+	EE_FLASH_ERR  = 3, /*Program or erase failure*/
+}ee_status_t;
+
+/**
+ * @brief Counters, for comparing the cost with a littlefs file.
+ */
+typedef struct ee_stats_ {
+	uint32_t writes;		/*Records appended*/
+	uint32_t skipped;		/*Writes of an unchanged value*/
+	uint32_t compactions;
+	uint32_t erases;
+}ee_stats_t;
+
+/*Function prototypes*/
+ee_status_t ee_init(void);
+ee_status_t ee_format(void);
+ee_status_t ee_read(uint16_t key, uint32_t *value);
+ee_status_t ee_write(uint16_t key, uint32_t value);
+void ee_get_stats(ee_stats_t *stats);
+#endif /* EEPROM_H_ */
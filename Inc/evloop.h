@@ -0,0 +1,119 @@
+/*
+ * evloop.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef EVLOOP_H_
+#define EVLOOP_H_
+
+#include "main.h"		//Common headers
+#include "timebase.h"	//Microsecond time base
+
+/*
+ * Run-to-completion scheduler. Handlers run one at a time from evloop_run_once(),
+ * never from an interrupt, so they do not need locks between them. Interrupt handlers
+ * and drivers hand their completions over with evloop_post(), timers fire from the
+ * time base, and tasks are stackless coroutines (protothreads) resumed by events.
+ */
+
+/*Number of pending events, a power of two*/
+#ifndef EVLOOP_QUEUE_SIZE
+#define EVLOOP_QUEUE_SIZE		32U
+#endif
+
+/*
+ * Called when there is nothing to run, with the microseconds until the next timer
+ * (UINT32_MAX without timers). The timers poll the cycle counter, which does not
+ * raise interrupts, so the target keeps spinning; the host build advances the
+ * virtual clock instead.
+ */
+#ifndef EVLOOP_IDLE
+#define EVLOOP_IDLE(us)			((void)(us))
+#endif
+
+/**
+ * @brief Event handler.
+ * @param arg  : The argument given when the event was posted or the timer started.
+ * @param data : A value of the poster (a result, a length, a flag).
+ */
+typedef void (*ev_handler_t)(void *arg, uint32_t data);
+
+/**
+ * @brief A one-shot or periodic timer. The structure is owned by the caller.
+ */
+typedef struct ev_timer_ {
+	struct ev_timer_ *next;
+	deadline_t expiry;
+	uint32_t period_us;			//0 for a one-shot timer
+	ev_handler_t handler;
+	void *arg;
+	uint8_t active;
+}ev_timer_t;
+
+/*
+ * Protothreads: the state of a task is the line it waits at, so a task needs no stack
+ * of its own. Local variables do not survive a wait, keep them in the task structure.
+ */
+typedef struct {
+	uint16_t lc;
+}pt_t;
+
+#define PT_WAITING				0
+#define PT_ENDED				1
+
+#define PT_INIT(pt)				((pt)->lc = 0)
+#define PT_BEGIN(pt)			switch ((pt)->lc) { case 0:
+#define PT_FALLTHROUGH			__attribute__((fallthrough))	/*Into the case of the wait*/
+#define PT_WAIT_UNTIL(pt, cond)	do { (pt)->lc = __LINE__; PT_FALLTHROUGH; case __LINE__: \
+									 if (!(cond)) { return PT_WAITING; } } while (0)
+#define PT_YIELD(pt)			do { (pt)->lc = __LINE__; return PT_WAITING; PT_FALLTHROUGH; case __LINE__:; } while (0)
+#define PT_END(pt)				} (pt)->lc = 0; return PT_ENDED
+
+/**
+ * @brief A task: a protothread resumed every time it is signalled.
+ */
+typedef struct ev_task_ {
+	pt_t pt;
+	int (*run)(struct ev_task_ *task);	//Returns PT_WAITING or PT_ENDED
+	ev_timer_t timer;					//Used by EV_TASK_SLEEP
+	uint32_t data;						//Data of the last evloop_task_signal_handler() event
+	uint8_t timer_fired;
+	uint8_t queued;						//A resume event is pending
+	uint8_t done;
+}ev_task_t;
+
+/*Wait inside a task body for a number of microseconds, other handlers run meanwhile*/
+#define EV_TASK_SLEEP(task, us)	do { (task)->timer_fired = 0; evloop_task_wake_in((task), (us)); \
+									 PT_WAIT_UNTIL(&(task)->pt, (task)->timer_fired); } while (0)
+
+/**
+ * @brief Peripheral busy-time accounting, for utilisation measurements.
+ */
+typedef struct ev_resource_ {
+	const char *name;
+	uint32_t busy_since;
+	uint64_t busy_us;
+	uint32_t ops;
+	uint8_t busy;
+}ev_resource_t;
+
+/*Function prototypes*/
+void evloop_init(void);
+int evloop_post(ev_handler_t handler, void *arg, uint32_t data);
+void evloop_timer_start(ev_timer_t *timer, uint32_t delay_us, uint32_t period_us, ev_handler_t handler, void *arg);
+void evloop_timer_stop(ev_timer_t *timer);
+uint32_t evloop_run_once(void);
+void evloop_run(void);
+void evloop_run_until(const volatile uint8_t *flag);
+void evloop_task_start(ev_task_t *task, int (*run)(ev_task_t *task));
+void evloop_task_signal(ev_task_t *task);
+void evloop_task_signal_handler(void *arg, uint32_t data);
+void evloop_task_wake_in(ev_task_t *task, uint32_t us);
+void evloop_resource_begin(ev_resource_t *res);
+void evloop_resource_end(ev_resource_t *res);
+uint32_t evloop_resource_permille(const ev_resource_t *res, uint32_t elapsed_us);
+uint32_t evloop_dropped(void);
+
+#endif /* EVLOOP_H_ */
@@ -21,17 +21,55 @@
 #define PACKET_SIZE					       512
 #define PACKETS						       347
 #define FLASH_PG_SIZE				       2048
+#define FLASH_DATA_PAGES			       16     /* Data pages kept at the top of physical bank 2 */
+#define FLASH_DATA_SIZE				       (FLASH_DATA_PAGES * FLASH_PAGE_SIZE)
+#define FLASH_EE_PAGES				       2      /* Last pages of the data region, emulated EEPROM */
+#define FLASH_ROW_SIZE				       256    /* Fast programming row, 32 double-words */
+#define FLASH_ROW_DWORDS			       (FLASH_ROW_SIZE / 8)
+#define FLASH_STR_SPAN(len)			       (((uint32_t)(len) + 7U) & ~7U) /* Flash used by bl_flash_write64_str */
+#define FLASH_SR_ERRORS				       (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | \
+										FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_PGSERR | \
+										FLASH_SR_MISERR | FLASH_SR_FASTERR)
+
+/*
+ * Access hooks for the flash controller and array. The target uses the registers
+ * directly; the host build (Host/Inc/main.h) replaces them with the register model.
+ */
+#ifndef BL_FLASH_WAIT_BSY
+#define BL_FLASH_WAIT_BSY()				   while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+#endif
+#ifndef BL_FLASH_WRITE32
+#define BL_FLASH_WRITE32(addr, data)	   (*(__IO uint32_t *)(addr) = (uint32_t)(data))
+#endif
+#ifndef BL_FLASH_CLEAR_SR
+#define BL_FLASH_CLEAR_SR(flags)		   WRITE_REG(FLASH->SR, (flags)) /* Write 1 to clear */
+#endif
+#ifndef BL_FLASH_PTR
+#define BL_FLASH_PTR(addr)				   ((const uint8_t *)(addr))
+#endif
+#ifndef BL_FLASH_READ
+#define BL_FLASH_READ(buf, addr, len)	   memcpy((buf), BL_FLASH_PTR(addr), (len))
+#endif
 
 /*Function definitions*/
 uint16_t bl_flash_unlock(void);
 void bl_flash_lock(void);
 uint16_t bl_flash_page_erase(uint32_t page, uint16_t bank);
+uint16_t bl_flash_page_erase_start(uint32_t page, uint16_t bank);
+uint16_t bl_flash_is_busy(void);
+uint16_t bl_flash_end_op(void);
 uint16_t bl_flash_mass_erase_bank(uint16_t bank);
 void bl_flash_mass_erase(void);
 void bl_flash_clear_status_flags(void);
 void bl_flash_write64(uint32_t address, uint64_t data);
-void bl_flash_write64_str(uint32_t start_addr, uint8_t *pBuf, uint16_t len);
-void bl_flash_program(uint32_t start_addr, const uint8_t *str, uint16_t len);
+uint16_t bl_flash_write64_str(uint32_t start_addr, const uint8_t *pBuf, uint16_t len);
+void bl_flash_read_str(uint32_t start_addr, uint8_t *pBuf, uint16_t len);
+void bl_flash_read64_str_sparse(uint32_t start_addr, uint8_t *pBuf, uint16_t len);
+uint16_t bl_flash_check_errors(void);
+uint16_t bl_flash_program_row(uint32_t address, const uint64_t *row);
+uint16_t bl_flash_program(uint32_t start_addr, const uint8_t *str, uint16_t len);
 uint32_t bl_flash_get_bank(uint32_t addr);
 uint32_t bl_flash_get_page(uint32_t addr);
+uint16_t bl_flash_swap_bank(void);
+uint32_t bl_flash_data_base(void);
 #endif /* FLASH_H_ */
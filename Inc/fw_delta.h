@@ -0,0 +1,44 @@
+/*
+ * fw_delta.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      Delta firmware update. A patch stored in littlefs is applied against the running
+ *      bank and the new image is streamed into the inactive bank, see fw_update.h.
+ *
+ *      Patch layout (all integers little endian):
+ *        fw_delta_hdr_t
+ *        op stream, every op is a tag byte followed by LEB128 varints:
+ *          FW_DELTA_OP_COPY   <old offset> <len>          copy from the running image
+ *          FW_DELTA_OP_ADD    <old offset> <len> <bytes>  running image + byte-wise delta
+ *          FW_DELTA_OP_INSERT <len> <bytes>               literal bytes
+ *          FW_DELTA_OP_END
+ */
+
+#ifndef FW_DELTA_H_
+#define FW_DELTA_H_
+
+#include "main.h"		//Common headers
+#include "fw_update.h"	//Inactive bank, image header and error codes
+
+#define FW_DELTA_MAGIC					0x50445746 /*"FWDP"*/
+#define FW_DELTA_IN_SIZE				256        /*Patch read buffer*/
+#define FW_DELTA_OP_END					0x00
+#define FW_DELTA_OP_COPY				0x01
+#define FW_DELTA_OP_ADD					0x02
+#define FW_DELTA_OP_INSERT				0x03
+
+/**
+ * @brief Header of a patch file.
+ */
+typedef struct fw_delta_hdr_ {
+	uint32_t magic;			/*FW_DELTA_MAGIC*/
+	uint32_t old_size;		/*Image the patch applies to*/
+	uint32_t old_crc;
+	fw_image_hdr_t image;	/*Image the patch produces*/
+}fw_delta_hdr_t;
+
+/*Function prototypes*/
+fw_update_err_t fw_delta_apply(lfs_t *lfs, const char *path, fw_image_hdr_t *hdr);
+#endif /* FW_DELTA_H_ */
@@ -0,0 +1,49 @@
+/*
+ * fw_update.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      Dual bank firmware update. An image stored in littlefs (external flash) is
+ *      streamed into the inactive bank, verified and then activated with a bank swap.
+ */
+
+#ifndef FW_UPDATE_H_
+#define FW_UPDATE_H_
+
+#include "main.h"	//Common headers
+#include "flash.h"	//Internal flash primitives
+#include "lfs.h"	//Image source
+
+/*The inactive bank is always mapped right after the running one*/
+#define FW_UPDATE_BANK_ADDR				(FLASH_BASE + FLASH_BANK_SIZE)
+#define FW_UPDATE_MAX_SIZE				(FLASH_BANK_SIZE - FLASH_DATA_SIZE)
+#define FW_UPDATE_CHUNK_SIZE			FLASH_PG_SIZE
+#define FW_UPDATE_MAGIC					0x55504657 /*"WFPU"*/
+
+/**
+ * @brief Header in front of the raw image inside the littlefs file.
+ */
+typedef struct fw_image_hdr_ {
+	uint32_t magic;		/*FW_UPDATE_MAGIC*/
+	uint32_t size;		/*Size of the image that follows, in bytes*/
+	uint32_t crc;		/*lfs_crc(0xFFFFFFFF, image, size)*/
+	uint32_t version;	/*Free for the application*/
+}fw_image_hdr_t;
+
+/**
+ * @brief Result of an install.
+ */
+typedef enum {
+	FW_UPDATE_OK 		 = 0,
+	FW_UPDATE_ERR_IO 	 = 1, /*littlefs could not open/read the image*/
+	FW_UPDATE_ERR_HEADER = 2, /*Bad magic or the image does not fit into a bank*/
+	FW_UPDATE_ERR_FLASH  = 3, /*Erase or program failure*/
+	FW_UPDATE_ERR_CRC 	 = 4, /*The programmed bank does not match the header*/
+}fw_update_err_t;
+
+/*Function prototypes*/
+fw_update_err_t fw_update_install(lfs_t *lfs, const char *path, fw_image_hdr_t *hdr);
+uint16_t fw_update_verify(const fw_image_hdr_t *hdr);
+uint16_t fw_update_activate(void);
+#endif /* FW_UPDATE_H_ */
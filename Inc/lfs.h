@@ -65,6 +65,51 @@ typedef uint32_t lfs_block_t;
 #define LFS_ATTR_MAX 1022
 #endif
 
+// Custom attribute type of the superblock entry that holds the journal
+// lfs_file_syncgroup keeps while it updates files of more than one
+// directory. It only exists during the call, or after a power loss until
+// lfs_mount replays it, and is not available to the user.
+#ifndef LFS_TXN_ATTR
+#define LFS_TXN_ATTR 0xfe
+#endif
+
+// Maximum number of files lfs_file_syncgroup takes if LFS_NO_MALLOC is
+// defined, the arrays of its commits are then on the stack, 44 bytes per
+// file on a 32-bit target.
+#ifndef LFS_GROUP_MAX
+#define LFS_GROUP_MAX 8
+#endif
+
+// Custom attribute type that marks a compressed file, see zchunk in
+// lfs_file_config. It holds the chunk size, the size of the file data and
+// the offset of its last frame, and is not available to the user. Defining
+// LFS_NO_COMPRESS leaves the codec and the per-file state out, a file that
+// has this attribute then fails to open with LFS_ERR_INVAL.
+#ifndef LFS_ZATTR
+#define LFS_ZATTR 0xff
+#endif
+
+// Entries of the hash table the compressor looks for matches with, as a
+// power of two. More find more matches but take 2 bytes each.
+#ifndef LFS_ZHASH_BITS
+#define LFS_ZHASH_BITS 9
+#endif
+
+// Frames of a compressed file whose offsets are kept in lfs_file_t, 4 bytes
+// each, a power of two. A seek walks the frame headers from the nearest one.
+#ifndef LFS_ZMARKS
+#define LFS_ZMARKS 8
+#endif
+
+// Limits of the chunk size of compressed files, the offsets in a chunk
+// are 16-bit
+#define LFS_ZCHUNK_MIN 64
+#define LFS_ZCHUNK_MAX 32768
+
+// Size of the buffer of a compressed file: the data of one chunk, its
+// compressed frame and, when the file is writable, the hash table
+#define LFS_ZBUFFER_SIZE(chunk) (2*(chunk) + (2 << LFS_ZHASH_BITS))
+
 // Possible error codes, these are negative to allow
 // valid positive return values
 enum lfs_error {
@@ -131,6 +176,7 @@ enum lfs_open_flags {
     LFS_O_EXCL   = 0x0200,    // Fail if a file already exists
     LFS_O_TRUNC  = 0x0400,    // Truncate the existing file to zero size
     LFS_O_APPEND = 0x0800,    // Move to end of file on every write
+    LFS_O_LOG    = 0x1000,    // Append in place to the last block, see below
 #endif
 
     // internally used flags
@@ -143,6 +189,9 @@ enum lfs_open_flags {
     LFS_F_ERRED   = 0x080000, // An error occurred during write
 #endif
     LFS_F_INLINE  = 0x100000, // Currently inlined in directory entry
+#ifndef LFS_READONLY
+    LFS_F_ZDIRTY  = 0x200000, // Compressed chunk has not been written out
+#endif
 };
 
 // File seek flags
@@ -229,17 +278,31 @@ struct lfs_config {
     // can track 8 blocks.
     lfs_size_t lookahead_size;
 
-    // Threshold for metadata compaction during lfs_fs_gc in bytes. Metadata
-    // pairs that exceed this threshold will be compacted during lfs_fs_gc.
-    // Defaults to ~88% block_size when zero, though the default may change
-    // in the future.
+    // Threshold for metadata compaction during lfs_fs_gc and lfs_fs_gcstep
+    // in bytes. Metadata pairs that exceed this threshold will be compacted
+    // during lfs_fs_gc or lfs_fs_gcstep. Defaults to ~88% block_size when
+    // zero, though the default may change in the future.
     //
-    // Note this only affects lfs_fs_gc. Normal compactions still only occur
-    // when full.
+    // Note this only affects lfs_fs_gc and lfs_fs_gcstep. Normal compactions
+    // still only occur when full.
     //
     // Set to -1 to disable metadata compaction during lfs_fs_gc.
     lfs_size_t compact_thresh;
 
+    // Number of free blocks lfs_fs_gc and lfs_fs_gcstep erase in advance
+    // and keep in a reservoir. Writes that need a new block take one from
+    // the reservoir first and skip its erase, after checking that its first
+    // prog_size bytes still read back as they did after the erase. The
+    // blocks stay free, they are only kept from other allocations. Zero
+    // disables the reservoir.
+    lfs_size_t reserve_count;
+
+    // Set if the block device can program a prog_size unit again, with its
+    // programmed bytes unchanged and new bytes after them, and keep them
+    // through a power loss: a NOR prog that only clears bits, without ECC
+    // or a built-in erase. LFS_O_LOG needs it and is ignored without it.
+    bool prog_rewrite;
+
     // Optional statically allocated read buffer. Must be cache_size.
     // By default lfs_malloc is used to allocate this buffer.
     void *read_buffer;
@@ -252,6 +315,17 @@ struct lfs_config {
     // By default lfs_malloc is used to allocate this buffer.
     void *lookahead_buffer;
 
+    // Optional statically allocated reservoir. Must be reserve_count
+    // entries of struct lfs_reserved (8 bytes each). By default lfs_malloc
+    // is used to allocate this buffer.
+    void *reserve_buffer;
+
+    // Optional statically allocated buffer for the journal of a group sync,
+    // see lfs_file_syncgroup, also used by lfs_mount to apply one left by a
+    // power loss. Must be cache_size. By default lfs_malloc is used to
+    // allocate this buffer, only when there is a journal.
+    void *txn_buffer;
+
     // Optional upper limit on length of file names in bytes. No downside for
     // larger names except the size of the info struct which is controlled by
     // the LFS_NAME_MAX define. Defaults to LFS_NAME_MAX or name_max stored on
@@ -363,6 +437,20 @@ struct lfs_file_config {
 
     // Number of custom attributes in the list
     lfs_size_t attr_count;
+
+#ifndef LFS_NO_COMPRESS
+    // Bytes of file data per chunk of a compressed file, LFS_ZCHUNK_MIN to
+    // LFS_ZCHUNK_MAX. When set, a file that is created, truncated with
+    // LFS_O_TRUNC or still empty is opened for writing as a compressed file.
+    // A file that is already compressed stays so with its own chunk size,
+    // whatever this is set to, and one that is not stays uncompressed.
+    lfs_size_t zchunk;
+
+    // Optional statically allocated buffer of a compressed file, must be
+    // LFS_ZBUFFER_SIZE(chunk) bytes for the chunk size of the file and
+    // 2-byte aligned. By default lfs_malloc is used to allocate this buffer.
+    void *zbuffer;
+#endif
 };
 
 
@@ -415,6 +503,23 @@ typedef struct lfs_file {
     lfs_cache_t cache;
 
     const struct lfs_file_config *cfg;
+
+#ifndef LFS_NO_COMPRESS
+    // compressed file state, chunk is zero for an uncompressed file
+    struct lfs_zfile {
+        uint8_t *buffer;
+        lfs_size_t chunk;
+        lfs_off_t pos;      // position in the file data
+        lfs_size_t size;    // size of the file data
+        lfs_off_t tail;     // frame of the chunk the file data ends in
+        lfs_size_t index;   // chunk held in buffer
+        lfs_off_t off;      // its frame
+        lfs_off_t next;     // the frame after it
+        lfs_size_t stride;  // chunks between the frames marked
+        lfs_size_t marks;
+        lfs_off_t mark[LFS_ZMARKS];
+    } z;
+#endif
 } lfs_file_t;
 
 typedef struct lfs_superblock {
@@ -431,6 +536,66 @@ typedef struct lfs_gstate {
     lfs_block_t pair[2];
 } lfs_gstate_t;
 
+#ifdef LFS_STATS
+// API calls with a latency histogram
+enum lfs_stats_op {
+    LFS_STATS_MOUNT  = 0,
+    LFS_STATS_OPEN   = 1,
+    LFS_STATS_READ   = 2,
+    LFS_STATS_WRITE  = 3,
+    LFS_STATS_SYNC   = 4,
+    LFS_STATS_CLOSE  = 5,
+    LFS_STATS_REMOVE = 6,
+    LFS_STATS_RENAME = 7,
+    LFS_STATS_OPS    = 8,
+};
+
+// Buckets of the latency histograms. Bucket 0 counts the calls that took
+// less than 1us, bucket i the calls of [2^(i-1), 2^i) us, the last one
+// everything longer.
+#ifndef LFS_STATS_BUCKETS
+#define LFS_STATS_BUCKETS 24
+#endif
+
+// Block device counters and API latencies, compiled in with LFS_STATS. They
+// count from lfs_mount (or lfs_format) and are returned by lfs_stats.
+struct lfs_stats {
+    // lfs_bd_read: calls, bytes asked for, and where each chunk came from
+    uint32_t read_calls;
+    uint64_t read_bytes;
+    uint32_t read_pcache_hits;
+    uint32_t read_rcache_hits;
+    uint32_t read_bypasses;     // read straight into the caller's buffer
+    uint32_t read_fills;        // read cache loads
+    uint64_t read_dev_bytes;    // bytes read from the device
+
+    // lfs_bd_prog: calls and bytes, and the programs of the device that
+    // lfs_bd_flush issued to write the cache out
+    uint32_t prog_calls;
+    uint64_t prog_bytes;
+    uint32_t flush_calls;
+    uint32_t flush_progs;
+    uint64_t flush_bytes;
+
+    uint32_t erase_calls;
+    uint32_t sync_calls;
+
+    // lfs_dir_commit calls, and the compactions (erase and rewrite of a
+    // metadata pair) they and the other metadata updates did
+    uint32_t commit_calls;
+    uint32_t compact_calls;
+
+    uint32_t cmp_calls;
+    uint64_t cmp_bytes;
+
+    // Latency of the API calls in us, on LFS_STATS_NOW
+    uint32_t calls[LFS_STATS_OPS];
+    uint32_t max_us[LFS_STATS_OPS];
+    uint64_t total_us[LFS_STATS_OPS];
+    uint32_t hist[LFS_STATS_OPS][LFS_STATS_BUCKETS];
+};
+#endif
+
 // The littlefs filesystem type
 typedef struct lfs {
     lfs_cache_t rcache;
@@ -467,6 +632,30 @@ typedef struct lfs {
 #ifdef LFS_MIGRATE
     struct lfs1 *lfs1;
 #endif
+
+#ifndef LFS_READONLY
+    struct lfs_gc {
+        lfs_block_t tail[2];
+        lfs_block_t erased;
+    } gc;
+
+    struct lfs_reserve {
+        struct lfs_reserved {
+            lfs_block_t block;
+            uint32_t crc;
+        } *buffer;
+        lfs_size_t count;
+    } reserve;
+
+    struct lfs_txn {
+        const uint8_t *journal;
+        lfs_size_t size;
+    } txn;
+#endif
+
+#ifdef LFS_STATS
+    struct lfs_stats stats;
+#endif
 } lfs_t;
 
 
@@ -531,7 +720,9 @@ int lfs_stat(lfs_t *lfs, const char *path, struct lfs_info *info);
 // to LFS_ATTR_MAX bytes. When read, if the stored attribute is smaller than
 // the buffer, it will be padded with zeros. If the stored attribute is larger,
 // then it will be silently truncated. If no attribute is found, the error
-// LFS_ERR_NOATTR is returned and the buffer is filled with zeros.
+// LFS_ERR_NOATTR is returned and the buffer is filled with zeros. The types
+// LFS_TXN_ATTR and LFS_ZATTR are reserved by littlefs and return
+// LFS_ERR_INVAL, here and in the attrs of lfs_file_opencfg.
 //
 // Returns the size of the attribute, or a negative error code on failure.
 // Note, the returned size is the size of the attribute on disk, irrespective
@@ -545,7 +736,8 @@ lfs_ssize_t lfs_getattr(lfs_t *lfs, const char *path,
 //
 // Custom attributes are uniquely identified by an 8-bit type and limited
 // to LFS_ATTR_MAX bytes. If an attribute is not found, it will be
-// implicitly created.
+// implicitly created. LFS_TXN_ATTR and LFS_ZATTR are reserved, see
+// lfs_getattr.
 //
 // Returns a negative error code on failure.
 int lfs_setattr(lfs_t *lfs, const char *path,
@@ -555,7 +747,8 @@ int lfs_setattr(lfs_t *lfs, const char *path,
 #ifndef LFS_READONLY
 // Removes a custom attribute
 //
-// If an attribute is not found, nothing happens.
+// If an attribute is not found, nothing happens. LFS_TXN_ATTR and LFS_ZATTR
+// are reserved, see lfs_getattr.
 //
 // Returns a negative error code on failure.
 int lfs_removeattr(lfs_t *lfs, const char *path, uint8_t type);
@@ -570,6 +763,15 @@ int lfs_removeattr(lfs_t *lfs, const char *path, uint8_t type);
 // The mode that the file is opened in is determined by the flags, which
 // are values from the enum lfs_open_flags that are bitwise-ored together.
 //
+// With LFS_O_LOG, a write at the end of the file after a sync continues in
+// the last block of the file instead of copying it to a new one. The
+// prog_size unit the file ends in is programmed again, with its programmed
+// bytes unchanged and the new bytes after them, so the flag is ignored
+// unless the config sets prog_rewrite. The rest of the last block must be
+// erased: with prog_rewrite a truncate that ends inside a block copies the
+// data left in it to a new block, and an append torn by a power loss is
+// caught by the readback of the program and moves to a new block.
+//
 // Returns a negative error code on failure.
 int lfs_file_open(lfs_t *lfs, lfs_file_t *file,
         const char *path, int flags);
@@ -578,6 +780,12 @@ int lfs_file_open(lfs_t *lfs, lfs_file_t *file,
 // thus use lfs_file_opencfg() with config.buffer set.
 #endif
 
+// if LFS_NO_MALLOC is defined, the journal of a group sync needs
+// txn_buffer set in lfs_config, without it lfs_file_syncgroup() of files in
+// more than one directory, and lfs_mount() of a filesystem with a journal
+// left by a power loss, fail with LFS_ERR_NOMEM. lfs_file_syncgroup() then
+// takes at most LFS_GROUP_MAX files and fails with LFS_ERR_INVAL for more.
+
 // Open a file with extra configuration
 //
 // The mode that the file is opened in is determined by the flags, which
@@ -587,6 +795,14 @@ int lfs_file_open(lfs_t *lfs, lfs_file_t *file,
 // above. The config struct must remain allocated while the file is open, and
 // the config struct must be zeroed for defaults and backwards compatibility.
 //
+// With zchunk set the file data is cut into chunks of zchunk bytes, each
+// stored as a frame compressed on its own, so a read after a seek only
+// decompresses the chunk it lands in. Reads, writes, seeks, truncates and
+// sizes work on the file data, and lfs_stat and lfs_dir_read report its
+// size as of the last sync. A compressed file is written at its end: a write before the
+// chunk it ends in returns LFS_ERR_INVAL. That last chunk is not full and
+// is stored again by every sync until it is, and LFS_O_LOG is ignored.
+//
 // Returns a negative error code on failure.
 int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
         const char *path, int flags,
@@ -606,6 +822,26 @@ int lfs_file_close(lfs_t *lfs, lfs_file_t *file);
 // Returns a negative error code on failure.
 int lfs_file_sync(lfs_t *lfs, lfs_file_t *file);
 
+// Synchronize a group of files on storage as one update
+//
+// Any pending writes of the files are written out and the new contents and
+// attributes of all of them become visible together: after a power loss
+// either every file of the group is updated or none is. Files that share a
+// metadata pair, those of one small directory, are updated by a single
+// commit. A group that spans directories is first recorded in a journal, the
+// LFS_TXN_ATTR attribute of the superblock, which is then applied with one
+// commit per directory and removed with the last of them. lfs_mount applies
+// a journal left by a power loss, and drops one whose crc doesn't match.
+//
+// The journal holds the path, struct and attributes of each file and a crc,
+// and must fit in inline_max and attr_max bytes, if it doesn't the inline
+// files of the group are moved to blocks first.
+//
+// Returns a negative error code on failure, LFS_ERR_NOSPC if the journal
+// does not fit.
+int lfs_file_syncgroup(lfs_t *lfs, lfs_file_t *const *files,
+        lfs_size_t count);
+
 // Read data from file
 //
 // Takes a buffer and size indicating where to store the read data.
@@ -751,6 +987,7 @@ int lfs_fs_mkconsistent(lfs_t *lfs);
 // 1. Calls mkconsistent if not already consistent
 // 2. Compacts metadata > compact_thresh
 // 3. Populates the block allocator
+// 4. Fills the reservoir of erased blocks, see reserve_count
 //
 // Though additional janitorial work may be added in the future.
 //
@@ -762,6 +999,27 @@ int lfs_fs_mkconsistent(lfs_t *lfs);
 int lfs_fs_gc(lfs_t *lfs);
 #endif
 
+#ifndef LFS_READONLY
+// Do one bounded step of the janitorial work of lfs_fs_gc
+//
+// While the reservoir of erased blocks is not full, each call erases one
+// free block into it. Otherwise it fetches the next metadata pair of a walk
+// over all of them and, if it exceeds compact_thresh, either erases the
+// block the compaction will write to or does the compaction, which then
+// skips the erase. A step costs at most one block erase or one compaction
+// (two if the pair has to be split), so calling it from idle time keeps
+// the pairs below the threshold and the commits of the API calls append
+// instead of compacting.
+//
+// The first call after mount also does the fix-ups of lfs_fs_mkconsistent,
+// call that after mount to keep them out of the idle time.
+//
+// Returns 1 while there is work left, 0 when the reservoir is full and the
+// walk has gone over every pair (the next call starts a new one), or a
+// negative error code on failure.
+int lfs_fs_gcstep(lfs_t *lfs);
+#endif
+
 #ifndef LFS_READONLY
 // Grows the filesystem to a new size, updating the superblock with the new
 // block count.
@@ -772,6 +1030,18 @@ int lfs_fs_gc(lfs_t *lfs);
 int lfs_fs_grow(lfs_t *lfs, lfs_size_t block_count);
 #endif
 
+#ifdef LFS_STATS
+// Copies the block device counters and the latency histograms
+//
+// Returns a negative error code on failure.
+int lfs_stats(lfs_t *lfs, struct lfs_stats *stats);
+
+// Clears the counters and the histograms
+//
+// Returns a negative error code on failure.
+int lfs_stats_reset(lfs_t *lfs);
+#endif
+
 #ifndef LFS_READONLY
 #ifdef LFS_MIGRATE
 // Attempts to migrate a previous version of littlefs
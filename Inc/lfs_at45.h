@@ -0,0 +1,32 @@
+/*
+ * lfs_at45.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      littlefs block device on the AT45DB041E (binary page size).
+ */
+
+#ifndef LFS_AT45_H_
+#define LFS_AT45_H_
+
+#include "main.h"		//Common headers
+#include "at45db041.h"	//External flash driver
+#include "lfs.h"		//File system
+#include "mem_config.h"	//Cache sizes and placement
+
+/*Geometry, one littlefs block is one AT45 block (8 pages)*/
+#define LFS_AT45_PAGE_SIZE				256
+#define LFS_AT45_BLOCK_SIZE				2048
+#define LFS_AT45_BLOCK_COUNT			256
+#define LFS_AT45_BLOCK_CYCLES			500
+
+/*littlefs configuration of the external flash*/
+extern const struct lfs_config lfs_at45_cfg;
+
+/*Function prototypes*/
+int lfs_at45_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+int lfs_at45_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+int lfs_at45_erase(const struct lfs_config *c, lfs_block_t block);
+int lfs_at45_sync(const struct lfs_config *c);
+#endif /* LFS_AT45_H_ */
@@ -0,0 +1,34 @@
+/*
+ * lfs_iflash.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      littlefs block device on the data region of the internal flash
+ *      (bl_flash_data_base(), FLASH_DATA_SIZE), below the emulated EEPROM pages.
+ *      One block is one 2KB page.
+ */
+
+#ifndef LFS_IFLASH_H_
+#define LFS_IFLASH_H_
+
+#include "main.h"	//Common headers
+#include "flash.h"	//Internal flash primitives
+#include "lfs.h"	//File system
+#include "mem_config.h"	//Cache sizes and placement
+
+#define LFS_IFLASH_BLOCK_SIZE			FLASH_PAGE_SIZE
+#define LFS_IFLASH_BLOCK_COUNT			(FLASH_DATA_PAGES - FLASH_EE_PAGES)
+#define LFS_IFLASH_PROG_SIZE			8	/*Double-word, the ECC granularity*/
+#define LFS_IFLASH_BLOCK_CYCLES			100	/*10k cycles endurance, spread the wear early*/
+#define LFS_IFLASH_FILE_MAX				1024	/*Only small files belong here*/
+
+/*littlefs configuration of the internal flash*/
+extern const struct lfs_config lfs_iflash_cfg;
+
+/*Function prototypes*/
+int lfs_iflash_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+int lfs_iflash_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+int lfs_iflash_erase(const struct lfs_config *c, lfs_block_t block);
+int lfs_iflash_sync(const struct lfs_config *c);
+#endif /* LFS_IFLASH_H_ */
@@ -0,0 +1,51 @@
+/*
+ * lfs_tier.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      Two tier storage. Small, frequently read files (configuration, calibration)
+ *      live in a littlefs on the internal flash (hot tier, memory mapped reads), the
+ *      bulk data in a littlefs on the AT45 (cold tier). The tier of a file is decided
+ *      by its top level directory, so a lookup touches only one file system.
+ */
+
+#ifndef LFS_TIER_H_
+#define LFS_TIER_H_
+
+#include "main.h"			//Common headers
+#include "lfs_iflash.h"		//Hot tier
+#include "lfs_at45.h"		//Cold tier
+
+/*Top level directories kept in the hot tier. Files there are limited to LFS_IFLASH_FILE_MAX*/
+#define LFS_TIER_HOT_DIRS				{ "/cfg", "/cal" }
+
+/**
+ * @brief The two file systems.
+ */
+typedef struct lfs_tier_ {
+	lfs_t hot;
+	lfs_t cold;
+}lfs_tier_t;
+
+/**
+ * @brief A file opened through the tier layer.
+ */
+typedef struct lfs_tier_file_ {
+	lfs_t *fs;
+	lfs_file_t file;
+}lfs_tier_file_t;
+
+/*Function prototypes*/
+int lfs_tier_mount(lfs_tier_t *tier);
+int lfs_tier_unmount(lfs_tier_t *tier);
+lfs_t *lfs_tier_route(lfs_tier_t *tier, const char *path);
+int lfs_tier_file_open(lfs_tier_t *tier, lfs_tier_file_t *file, const char *path, int flags);
+lfs_ssize_t lfs_tier_file_read(lfs_tier_file_t *file, void *buffer, lfs_size_t size);
+lfs_ssize_t lfs_tier_file_write(lfs_tier_file_t *file, const void *buffer, lfs_size_t size);
+int lfs_tier_file_sync(lfs_tier_file_t *file);
+int lfs_tier_file_close(lfs_tier_file_t *file);
+int lfs_tier_stat(lfs_tier_t *tier, const char *path, struct lfs_info *info);
+int lfs_tier_remove(lfs_tier_t *tier, const char *path);
+int lfs_tier_mkdir(lfs_tier_t *tier, const char *path);
+#endif /* LFS_TIER_H_ */
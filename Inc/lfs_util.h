@@ -215,6 +215,31 @@ static inline uint32_t lfs_tobe32(uint32_t a) {
     return lfs_frombe32(a);
 }
 
+// Attribute of the hot functions that should execute from RAM (lfs_crc,
+// lfs_bd_read), defaults to the RAMFUNC attribute of the firmware
+#ifndef LFS_RAMFUNC
+#include "ramfunc.h"
+#define LFS_RAMFUNC RAMFUNC
+#endif
+
+// Microsecond clock of the statistics (LFS_STATS), defaults to timebase_us()
+// of the firmware, which the host build runs on the virtual clock
+#if defined(LFS_STATS) && !defined(LFS_STATS_NOW)
+#include "timebase.h"
+#define LFS_STATS_NOW() timebase_us()
+#endif
+
+// Region markers of the firmware profiler (prof.h), compiled only with
+// PROF_ENABLE so littlefs does not depend on the firmware headers otherwise
+#ifdef PROF_ENABLE
+#include "prof.h"
+#define LFS_PROF_BEGIN(id) PROF_BEGIN(id)
+#define LFS_PROF_END(id) PROF_END(id)
+#else
+#define LFS_PROF_BEGIN(id) ((void)0)
+#define LFS_PROF_END(id) ((void)0)
+#endif
+
 // Calculate CRC-32 with polynomial = 0x04c11db7
 #ifdef LFS_CRC
 uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
@@ -224,6 +249,14 @@ uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
 uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size);
 #endif
 
+// Allocator of the buffers littlefs allocates itself, defaults to the
+// bounded-time pools of mem_pool.h instead of the newlib heap
+#if !defined(LFS_MALLOC) && !defined(LFS_NO_MALLOC)
+#include "mem_pool.h"
+#define LFS_MALLOC(size) mem_pool_alloc(size)
+#define LFS_FREE(p) mem_pool_free(p)
+#endif
+
 // Allocate memory, only used if buffers are not provided to littlefs
 //
 // littlefs current has no alignment requirements, as it only allocates
@@ -0,0 +1,60 @@
+/*
+ * mem_config.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *      Compile-time sizing of the file system and I/O buffers, and their placement.
+ */
+
+#ifndef MEM_CONFIG_H_
+#define MEM_CONFIG_H_
+
+/*
+ * The littlefs caches, the per-file caches of the allocator and the SPI buffer live in
+ * SRAM2 (32KB at 0x10000000, parity protected), away from the stack and the heap in RAM.
+ * SRAM2_BSS places zero initialized data in .sram2_bss, which the startup code clears
+ * (with parity enabled, a read of a never written SRAM2 word raises an NMI).
+ * Host/Tools/sram2_check.sh fails the build if one of them ends up in RAM.
+ * The host build has no SRAM2 and drops the attribute.
+ */
+#if defined(__arm__)
+#define SRAM2_BSS						__attribute__((section(".sram2_bss")))
+#else
+#define SRAM2_BSS
+#endif
+
+/*littlefs on the AT45: read/program caches, lookahead buffer, per-file caches*/
+#define LFS_AT45_CACHE_SIZE				256
+#define LFS_AT45_LOOKAHEAD_SIZE			32
+#define LFS_AT45_FILE_BUFFERS			8
+
+/*littlefs on the internal flash*/
+#define LFS_IFLASH_CACHE_SIZE			64
+#define LFS_IFLASH_LOOKAHEAD_SIZE		8
+#define LFS_IFLASH_FILE_BUFFERS			8
+
+/*SPI receive buffer*/
+#ifndef SPI_REC_BUFF_SIZE
+#define SPI_REC_BUFF_SIZE				256
+#endif
+
+/*
+ * Allocator (mem_pool.h): size classes (bytes, multiples of 8, ascending) and the blocks
+ * in each one. The per-file caches of both file systems are classes of their own, small
+ * requests take the 32 byte class. MEM_POOL_BYTES is the sum of size * blocks.
+ */
+#ifndef MEM_POOL_CLASSES
+#define MEM_POOL_CLASSES				{ 32, LFS_IFLASH_CACHE_SIZE, LFS_AT45_CACHE_SIZE }
+#define MEM_POOL_BLOCKS					{ 8,  LFS_IFLASH_FILE_BUFFERS, LFS_AT45_FILE_BUFFERS }
+#define MEM_POOL_NCLASSES				3U
+#define MEM_POOL_BYTES					(32U*8U + LFS_IFLASH_CACHE_SIZE*LFS_IFLASH_FILE_BUFFERS + \
+										 LFS_AT45_CACHE_SIZE*LFS_AT45_FILE_BUFFERS)
+#endif
+
+/*Size of the TLSF arena of the allocator, for the requests no class fits*/
+#ifndef MEM_POOL_TLSF_SIZE
+#define MEM_POOL_TLSF_SIZE				8192U
+#endif
+
+#endif /* MEM_CONFIG_H_ */
@@ -0,0 +1,56 @@
+/*
+ * mem_pool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef MEM_POOL_H_
+#define MEM_POOL_H_
+
+#include "main.h"  	//Common headers
+#include <stddef.h>		//size_t, offsetof
+#include "mem_config.h"	//Size classes and arena size
+
+/*
+ * Bounded-time allocator for the littlefs buffers (LFS_MALLOC/LFS_FREE in lfs_util.h).
+ * Requests that fit a size class come from fixed-block pools (a free list pop/push);
+ * the others, and the requests of an exhausted class, come from a TLSF arena
+ * (two-level segregated fit: a bitmap search and constant-time split and merge).
+ * Both live in static memory in SRAM2, the newlib heap (_sbrk) is not used.
+ */
+
+/**
+ * @brief Usage of one size class.
+ */
+typedef struct {
+	uint16_t block_size;
+	uint16_t blocks;
+	uint16_t used;
+	uint16_t high_water;		//Most blocks in use at the same time
+}mem_pool_class_stats_t;
+
+/**
+ * @brief Usage of the allocator.
+ */
+typedef struct {
+	mem_pool_class_stats_t cls[MEM_POOL_NCLASSES];
+	uint32_t tlsf_size;			//Bytes available to the TLSF arena
+	uint32_t tlsf_used;			//Bytes allocated from it, headers included
+	uint32_t tlsf_high_water;
+	uint32_t tlsf_free_blocks;
+	uint32_t tlsf_largest_free;
+	uint32_t fragmentation;		//1000 - 1000 * largest free block / free bytes
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t failures;			//Requests that could not be served
+}mem_pool_stats_t;
+
+/*Function prototypes*/
+void mem_pool_init(void);
+void *mem_pool_alloc(size_t size);
+void mem_pool_free(void *ptr);
+void mem_pool_get_stats(mem_pool_stats_t *stats);
+int mem_pool_check(void);
+
+#endif /* MEM_POOL_H_ */
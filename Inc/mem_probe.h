@@ -0,0 +1,55 @@
+/*
+ * mem_probe.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef MEM_PROBE_H_
+#define MEM_PROBE_H_
+
+#include "main.h"  	//Common headers
+
+/*
+ * Stack and heap instrumentation. mem_probe_paint() fills the free stack with a pattern
+ * at startup; the deepest word that no longer holds it is the stack high-water mark.
+ * MEM_PROBE() repaints the window below the current stack pointer, runs a call and
+ * records how deep the call went, per tag. mem_probe_report() prints everything,
+ * together with the newlib heap (_sbrk) and the littlefs allocator usage.
+ */
+
+#define MEM_PROBE_PATTERN		0xC5C5C5C5U
+
+/*Stack below the caller a probed call may use, and the number of tags recorded*/
+#ifndef MEM_PROBE_WINDOW
+#define MEM_PROBE_WINDOW		4096U
+#endif
+#ifndef MEM_PROBE_TAGS
+#define MEM_PROBE_TAGS			24U
+#endif
+
+/*Run a call and record its stack depth under a tag (a string literal)*/
+#define MEM_PROBE(tag, call)	do { uintptr_t mem_probe_sp_ = mem_probe_begin(); \
+									 call; mem_probe_end((tag), mem_probe_sp_); } while (0)
+
+/**
+ * @brief Stack depth recorded for a tag.
+ */
+typedef struct {
+	const char *tag;
+	uint32_t calls;
+	uint32_t max_bytes;			//Deepest use below the caller
+}mem_probe_tag_t;
+
+/*Function prototypes*/
+void mem_probe_paint(void);
+uint32_t mem_probe_stack_high_water(void);
+uint32_t mem_probe_stack_reserved(void);
+uint32_t mem_probe_heap_used(void);
+uintptr_t mem_probe_begin(void);
+void mem_probe_end(const char *tag, uintptr_t sp);
+const mem_probe_tag_t *mem_probe_tags(uint32_t *count);
+void mem_probe_reset(void);
+void mem_probe_report(void);
+
+#endif /* MEM_PROBE_H_ */
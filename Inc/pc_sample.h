@@ -0,0 +1,43 @@
+/*
+ * pc_sample.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef PC_SAMPLE_H_
+#define PC_SAMPLE_H_
+
+#include "main.h"  	//Common headers
+
+/*
+ * Statistical profiler. TIM7 interrupts at a fixed rate with the lowest priority and
+ * its handler takes the PC, and optionally the LR, of the interrupted code from the
+ * exception stack frame. The samples fill a RAM buffer; pc_sample_dump() prints it as
+ * text and Host/Tools/pcs_fold.sh symbolises it against the ELF into folded stacks for
+ * a flame graph. The LR gives the caller of a leaf function, in a function that has
+ * made a call it is the return address of that call, so the stacks are one caller
+ * deep and approximate. Code with interrupts disabled or in a higher priority handler
+ * is seen at the point it re-enables them.
+ *
+ * The host build samples with SIGPROF (setitimer) and records the PC only; link the
+ * host program with -no-pie so the addresses match the ELF.
+ */
+
+/*Words of the sample buffer, a sample takes one (PC) or two (PC and LR)*/
+#ifndef PC_SAMPLE_WORDS
+#define PC_SAMPLE_WORDS			2048U
+#endif
+
+/*Rate the timer counts at, the sampling period is a whole number of ticks*/
+#define PC_SAMPLE_TICK_HZ		1000000U
+
+/*Function prototypes*/
+int pc_sample_start(uint32_t hz, int with_lr);
+void pc_sample_stop(void);
+void pc_sample_reset(void);
+void pc_sample_set_clock(void);
+uint32_t pc_sample_count(void);
+void pc_sample_dump(void);
+
+#endif /* PC_SAMPLE_H_ */
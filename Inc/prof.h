@@ -0,0 +1,77 @@
+/*
+ * prof.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "main.h"  	//Common headers
+
+/*
+ * Cycle profiler. PROF_BEGIN(id) and PROF_END(id) mark a region of code with one of the
+ * static IDs below; every pass adds to the count, the total and the maximum ticks of the
+ * region in a RAM table, and prof_report() prints the table (printf, so over the UART).
+ * The markers compile to nothing unless PROF_ENABLE is defined.
+ *
+ * The target counts core cycles with the DWT CYCCNT (started by timebase_init()), the
+ * host counts nanoseconds of CLOCK_MONOTONIC, so the same markers profile the simulator
+ * runs. Define PROF_NOW() and PROF_UNIT to use another clock.
+ *
+ * The start time lives in a local of the enclosing block, so a region must begin and end
+ * in the same block, and nesting and recursion are allowed (a recursive region counts
+ * the inner passes in its total too). Keep the regions longer than a few hundred cycles,
+ * a pass costs about 20 cycles on the target.
+ */
+
+/*Region IDs, add a name to prof_name[] in prof.c for each new one*/
+typedef enum {
+	PROF_SPI_TX = 0,				//SPIx_transmit, polling of TXE and BSY
+	PROF_SPI_RX,					//SPIx_receive, polling of RXNE
+	PROF_AT45_WAIT,					//at45db_wait_ready, status polling of a program or erase
+	PROF_LFS_CRC,					//lfs_crc
+	PROF_LFS_COMMIT,				//lfs_dir_commit, metadata commit with compaction and relocation
+	PROF_LFS_ZCOMP,					//lfs_z_compress, a chunk of a compressed file
+	PROF_LFS_ZDECOMP,				//lfs_z_decompress
+	PROF_PRINTF,					//_write of newlib, characters out on the UART
+	PROF_NREGIONS
+}prof_id_t;
+
+#ifndef PROF_NOW
+#if defined(__arm__)
+#include "timebase.h"
+#define PROF_NOW()				((uint32_t)TIMEBASE_CYCCNT())
+#define PROF_UNIT				"cycles"
+#else
+#define PROF_NOW()				prof_host_now()
+#define PROF_UNIT				"ns"
+#endif
+#endif
+
+#ifdef PROF_ENABLE
+#define PROF_BEGIN(id)			uint32_t prof_t0_##id = PROF_NOW()
+#define PROF_END(id)			prof_record((id), PROF_NOW() - prof_t0_##id)
+#else
+#define PROF_BEGIN(id)			((void)0)
+#define PROF_END(id)			((void)0)
+#endif
+
+/**
+ * @brief Ticks accumulated by a region.
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t max;
+	uint64_t total;
+}prof_region_t;
+
+/*Function prototypes*/
+void prof_record(prof_id_t id, uint32_t ticks);
+const prof_region_t *prof_regions(void);
+void prof_reset(void);
+void prof_report(void);
+uint32_t prof_host_now(void);
+
+#endif /* PROF_H_ */
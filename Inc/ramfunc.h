@@ -0,0 +1,27 @@
+/*
+ * ramfunc.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+/*
+ * Functions marked RAMFUNC are linked in the .ramfunc section (STM32L476RETX_FLASH.ld),
+ * which executes from SRAM2 without flash wait states. SRAM2 sits on the I-Code/D-Code
+ * buses at 0x10000000, so fetching the code does not compete with data accesses to RAM.
+ * The startup code copies the section from flash before main() runs.
+ *
+ * Calls between flash and SRAM2 are out of range of a BL instruction, the linker inserts
+ * long branch veneers for them, so mark whole inner loops rather than small helpers.
+ * The host build has no SRAM2 and drops the attribute.
+ */
+#if defined(__arm__)
+#define RAMFUNC		__attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif /* RAMFUNC_H_ */
@@ -10,6 +10,27 @@
 
 #include "main.h" //Common headers
 #include "gpio.h" //For SPI GPIO pins
+#include "evloop.h" //Completion events of the asynchronous transfers
+#include "ramfunc.h" //The receive loop executes from SRAM2
+#include "mem_config.h" //Buffer size and placement
+#include "prof.h" //Region markers of the polling loops
+#include "spi_trace.h" //Transaction trace hooks
+
+/*Highest SCK frequency the slave device accepts*/
+#ifndef SPIx_MAX_CLK_HZ
+#define SPIx_MAX_CLK_HZ		5000000U
+#endif
+
+/*Data register and chip select access, a host build redirects them to a device model*/
+#ifndef SPIx_DR_WRITE
+#define SPIx_DR_WRITE(sSPIx, data)	(*((volatile uint8_t *) &(sSPIx)->DR) = (data))
+#endif
+#ifndef SPIx_DR_READ
+#define SPIx_DR_READ(sSPIx)			(*((volatile uint8_t *) &(sSPIx)->DR))
+#endif
+#ifndef SPIx_CS_CHANGED
+#define SPIx_CS_CHANGED(GPIOx)		((void)(GPIOx))
+#endif
 
 
 /**
@@ -19,6 +40,21 @@
  */
 void SPIx_init(SPI_TypeDef *sSPIx, GPIO_TypeDef *GPIOx);
 
+/**
+ * @brief Get the baud rate prescaler for a given peripheral clock.
+ * @param pclk   : The peripheral clock in Hz.
+ * @param max_hz : The highest allowed SCK frequency.
+ * @retval The BR field value of CR1 (SCK = pclk / 2^(BR+1)).
+ */
+uint32_t SPIx_prescaler(uint32_t pclk, uint32_t max_hz);
+
+/**
+ * @brief Reprogram the baud rate prescaler after a system clock change.
+ * @param sSPIx : Define the peripheral that you want to configure.
+ * @retval None.
+ */
+void SPIx_set_clock(SPI_TypeDef *sSPIx);
+
 /**
  * @brief Disable the SPI peripheral.
  * @param sSPIx : Define the peripheral that you want to initialize.
@@ -50,6 +86,28 @@ uint8_t SPIx_receive_byte(SPI_TypeDef *sSPIx);
  */
 void SPIx_receive(SPI_TypeDef *sSPIx, uint8_t *recBuf, uint32_t size);
 
+/**
+ * @brief Start a full-duplex transfer driven by the RXNE interrupt. The function returns
+ * at once; the handler is posted to the event loop with the size when the last byte
+ * has been received. The chip select is left to the caller.
+ * @param sSPIx   : The peripheral.
+ * @param tx      : The data to transmit, NULL to transmit 0xFF (receive only).
+ * @param rx      : The buffer for the received data, NULL to discard it (transmit only).
+ * @param size    : The size of data.
+ * @param handler : The completion handler.
+ * @param arg     : Its argument.
+ * @retval 1 if the transfer started, 0 if a transfer is already running on the peripheral.
+ */
+int SPIx_transfer_async(SPI_TypeDef *sSPIx, const uint8_t *tx, uint8_t *rx, uint32_t size, ev_handler_t handler, void *arg);
+
+/**
+ * @brief Interrupt service of the asynchronous transfers. Call it from the
+ * SPIx_IRQHandler of the peripheral.
+ * @param sSPIx : The peripheral.
+ * @retval None.
+ */
+void SPIx_irq_handler(SPI_TypeDef *sSPIx);
+
 /**
  * @brief Enables the slave device.
  * @param GPIOx	: Select the GPIO port you need (GPIOA/GPIOB/GPIOC/GPIOD).
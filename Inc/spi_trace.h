@@ -0,0 +1,78 @@
+/*
+ * spi_trace.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef SPI_TRACE_H_
+#define SPI_TRACE_H_
+
+#include "main.h"  	//Common headers
+
+/*
+ * Trace of the SPI transactions. spi.c records one entry per chip select cycle: the
+ * time of the select, how long the chip select was held low, the first bytes sent
+ * (the opcode and the 24-bit address of the AT45 commands) and the bytes sent and
+ * received. The entries go to a RAM ring that keeps the most recent SPI_TRACE_DEPTH of
+ * them. spi_trace_dump() writes the ring as a binary stream, a spi_trace_hdr_t followed
+ * by the entries oldest first, little endian; Host/Tools/at45_trace.c decodes it.
+ * The hooks compile to nothing unless SPI_TRACE_ENABLE is defined.
+ */
+
+#define SPI_TRACE_MAGIC			0x52545053U		/*"SPTR"*/
+#define SPI_TRACE_VERSION		1U
+#define SPI_TRACE_CMD_BYTES		4U				/*Opcode and 24-bit address*/
+
+/*Entries kept in the ring, 16 bytes each*/
+#ifndef SPI_TRACE_DEPTH
+#define SPI_TRACE_DEPTH			256U
+#endif
+
+#ifdef SPI_TRACE_ENABLE
+#define SPI_TRACE_SELECT()			spi_trace_select()
+#define SPI_TRACE_DESELECT()		spi_trace_deselect()
+#define SPI_TRACE_TX(data, size)	spi_trace_tx((data), (size))
+#define SPI_TRACE_RX(size)			(spi_trace_rx_bytes += (size))
+#else
+#define SPI_TRACE_SELECT()			((void)0)
+#define SPI_TRACE_DESELECT()		((void)0)
+#define SPI_TRACE_TX(data, size)	((void)0)
+#define SPI_TRACE_RX(size)			((void)0)
+#endif
+
+/**
+ * @brief One chip select cycle.
+ */
+typedef struct {
+	uint32_t start_us;					//timebase_us() at the select
+	uint32_t hold_cycles;				//Core cycles the chip select stayed low
+	uint8_t cmd[SPI_TRACE_CMD_BYTES];	//First bytes sent, the rest are not valid past tx_bytes
+	uint16_t tx_bytes;					//Bytes sent from a buffer
+	uint16_t rx_bytes;					//Bytes received into a buffer
+}spi_trace_rec_t;
+
+/**
+ * @brief Header of a dump.
+ */
+typedef struct {
+	uint32_t magic;						//SPI_TRACE_MAGIC
+	uint16_t version;					//SPI_TRACE_VERSION
+	uint16_t rec_size;					//sizeof(spi_trace_rec_t)
+	uint32_t core_hz;					//SystemCoreClock at the dump, the unit of hold_cycles
+	uint32_t records;					//Entries that follow
+	uint32_t lost;						//Entries overwritten before the dump
+}spi_trace_hdr_t;
+
+/*Bytes received in the running transaction, SPI_TRACE_RX adds to it*/
+extern uint32_t spi_trace_rx_bytes;
+
+/*Function prototypes*/
+void spi_trace_select(void);
+void spi_trace_deselect(void);
+void spi_trace_tx(const uint8_t *data, uint32_t size);
+void spi_trace_reset(void);
+uint32_t spi_trace_count(void);
+void spi_trace_dump(void (*out)(const void *data, uint32_t size));
+
+#endif /* SPI_TRACE_H_ */
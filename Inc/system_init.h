@@ -8,12 +8,28 @@
 #ifndef SYSTEM_INIT_H_
 #define SYSTEM_INIT_H_
 
-#include "main.h"  //Common headers
+#include "main.h"  	//Common headers
+#include "timebase.h"	//Microsecond time base
 
-/*SysTick CTRL registers*/
-#define SYSTICK_CTN_FLAG	(1U<<16) //It is raised every time the counter reaches 0 from reload value.
-#define SYSTICK_CLK_SRC		(1U<<2)  //Setting the clock source of the counter (internal=1, external=0).
-#define SYSTICK_ENABLE		(1U<<0)  //Enables the counter.
+/*Maximum SYSCLK for each flash wait state, voltage range 1 (RM0351 table 11)*/
+#define FLASH_WS_STEP_HZ	16000000U
+
+/*
+ * Wait for a clock or power flag. The target polls the register; the host build
+ * (Host/Inc/main.h) steps the RCC model first, which also checks the sequence.
+ */
+#ifndef RCC_WAIT_UNTIL
+#define RCC_WAIT_UNTIL(cond)	while (!(cond)) {}
+#endif
+
+/**
+ * @brief System clock profiles.
+ */
+typedef enum {
+	CLOCK_HSI_16MHZ = 0, //HSI16 directly, 0 wait states.
+	CLOCK_MSI_48MHZ = 1, //MSI range 11, 2 wait states.
+	CLOCK_PLL_80MHZ = 2, //PLL from HSI16 (M=1, N=10, R=2), 4 wait states.
+}clock_profile_t;
 
 /**
  * @brief Initialize the system clock at 16MHz.
@@ -21,7 +37,31 @@
 void rcc_init(void);
 
 /**
- * @brief Use the SysTick timer to generate delay in milliseconds.
+ * @brief Switch the system clock to a profile. The voltage range, the flash latency and
+ * the ART accelerator (prefetch, instruction and data caches) are set in the order required
+ * for raising or lowering the frequency. SystemCoreClock is updated, and the SPI and USART
+ * peripherals that are enabled are reprogrammed, so their bit rates do not change.
+ * @param profile : The clock profile.
+ * @retval 1 on success, 0 for an unknown profile.
+ */
+uint16_t rcc_set_profile(clock_profile_t profile);
+
+/**
+ * @brief Get the frequency of a clock profile.
+ * @param profile : The clock profile.
+ * @retval The SYSCLK frequency in Hz, 0 for an unknown profile.
+ */
+uint32_t rcc_profile_hz(clock_profile_t profile);
+
+/**
+ * @brief Get the flash wait states needed at a given SYSCLK (voltage range 1).
+ * @param hz : The SYSCLK frequency.
+ * @retval The LATENCY field value of FLASH_ACR.
+ */
+uint32_t rcc_flash_latency(uint32_t hz);
+
+/**
+ * @brief Busy-wait for a number of milliseconds on the microsecond time base.
  * @param delay : The milliseconds.
  * @retval None.
  */
@@ -0,0 +1,70 @@
+/*
+ * timebase.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include "main.h"  //Common headers
+
+/*
+ * Cycle counter hook. The target reads the DWT cycle counter; the host build
+ * (Host/Inc/main.h) replaces it with the virtual clock of the clock model.
+ */
+#ifndef TIMEBASE_CYCCNT
+#define TIMEBASE_CYCCNT()		(DWT->CYCCNT)
+#endif
+
+/**
+ * @brief A point in time of the microsecond clock, used as a timeout.
+ */
+typedef uint32_t deadline_t;
+
+/**
+ * @brief Start the free-running cycle counter (DWT CYCCNT) the time base is built on.
+ * @retval None.
+ */
+void timebase_init(void);
+
+/**
+ * @brief Get the microseconds elapsed since timebase_init(). The counter is extended in
+ * software, so it must be read at least once per CYCCNT wrap (53s at 80MHz). It wraps
+ * after 71 minutes, compare times with timebase_elapsed_us() or the deadline functions.
+ * Call it before SystemCoreClock changes, so the cycles counted so far are converted
+ * with the frequency they were counted at (rcc_set_profile() does it).
+ * @retval The microseconds.
+ */
+uint32_t timebase_us(void);
+
+/**
+ * @brief Get the microseconds elapsed since a time returned by timebase_us().
+ * @param since : The start time.
+ * @retval The microseconds.
+ */
+uint32_t timebase_elapsed_us(uint32_t since);
+
+/**
+ * @brief Get a deadline a number of microseconds from now.
+ * @param timeout_us : The timeout, up to 2^31 - 1 microseconds.
+ * @retval The deadline.
+ */
+deadline_t timebase_deadline(uint32_t timeout_us);
+
+/**
+ * @brief Check if a deadline has passed.
+ * @param deadline : The deadline returned by timebase_deadline().
+ * @retval 1 if it has passed, 0 otherwise.
+ */
+int timebase_expired(deadline_t deadline);
+
+/**
+ * @brief Busy-wait for a number of microseconds.
+ * @param us : The microseconds, up to 2^31 - 1.
+ * @retval None.
+ */
+void delay_us(uint32_t us);
+
+#endif /* TIMEBASE_H_ */
@@ -10,6 +10,7 @@
 
 #include "main.h" 	//Common headers
 #include "gpio.h"   //For accessing the USART GPIOs
+#include "evloop.h" //Completion events of the asynchronous transmissions
 
 
 
@@ -24,12 +25,30 @@
 void USARTx_init(USART_TypeDef * USARTx, GPIO_TypeDef *GPIOx, int USARTx_GPIO_RX_PIN, int USARTx_GPIO_TX_PIN);
 
 /**
- * @brief Calculates the usart_div value based on oversampling by 16.
+ * @brief Calculates the usart_div value based on oversampling by 16, for the current
+ * system clock (SystemCoreClock).
  * @param bd 	 : The desired baudrate. Change the value in the "main.h" file.
  * @retval A proper number for the BRR register to set the baudrate.
  */
 uint32_t calculate_u_div(uint32_t bd);
 
+/**
+ * @brief Reprogram the baudrate, e.g. after a system clock change.
+ * @param USARTx : The desired peripheral of USART.
+ * @param bd 	 : The desired baudrate.
+ * @param pclk 	 : The clock of the peripheral in Hz.
+ * @retval None.
+ */
+void USARTx_set_baudrate(USART_TypeDef * USARTx, uint32_t bd, uint32_t pclk);
+
+/**
+ * @brief Get the baudrate the peripheral was last programmed with by USARTx_init() or
+ * USARTx_set_baudrate(). BRR rounds it down, so it cannot be read back from there.
+ * @param USARTx : The desired peripheral of USART.
+ * @retval The baudrate, 0 if the driver has not programmed the peripheral.
+ */
+uint32_t USARTx_get_baudrate(USART_TypeDef * USARTx);
+
 /**
  * @brief Send a byte over USARTx peripheral.
  * @param USARTx : Define the peripheral that you want to initialize.
@@ -55,6 +74,27 @@ void USARTx_receive(USART_TypeDef * USARTx, char *data, uint16_t size);
  */
 void USARTx_transmit(USART_TypeDef * USARTx, char *data, uint16_t size);
 
+/**
+ * @brief Start a transmission driven by the TXE/TC interrupts. The function returns at
+ * once; the handler is posted to the event loop with the size when the last frame has
+ * left the shift register. The buffer must stay valid until then.
+ * @param USARTx  : The desired peripheral of USART.
+ * @param data    : The buffer that contains the data to transmit.
+ * @param size    : The size of data that will be transmitted over the TX line.
+ * @param handler : The completion handler.
+ * @param arg     : Its argument.
+ * @retval 1 if the transmission started, 0 if one is already running on the peripheral.
+ */
+int USARTx_transmit_async(USART_TypeDef * USARTx, const char *data, uint16_t size, ev_handler_t handler, void *arg);
+
+/**
+ * @brief Interrupt service of the asynchronous transmissions. Call it from the
+ * USARTx_IRQHandler of the peripheral.
+ * @param USARTx : The desired peripheral of USART.
+ * @retval None.
+ */
+void USARTx_irq_handler(USART_TypeDef * USARTx);
+
 /**
  * @brief Deinitialize USARTx peripheral.
  * @param USARTx : The desired peripheral of USART.
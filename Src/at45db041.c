@@ -15,6 +15,19 @@ extern uint8_t SPI_REC_BUF[SPI_REC_BUFF_SIZE];
 /*Information structure*/
 extern at45db_t AT45DB;
 
+/*State of the asynchronous operation, the device runs one program/erase at a time*/
+static struct {
+    uint32_t addr;
+    ev_handler_t handler;
+    void *arg;
+    ev_timer_t timer;
+    deadline_t deadline;
+    uint8_t busy;
+}at45_async;
+
+static void at45db_buffer_to_main(uint8_t opcode, uint32_t addr);
+static void at45db_buffer_load(const uint8_t *buffer, uint16_t size);
+
 
 /**
  * @brief Initialize the external flash, with basic parameters and checks its availability.
@@ -57,7 +70,8 @@ void at45db_init()
          printf("Correct device ID, external flash memory is accessible\r\n");
     }
 
-    delay_ms(100);
+    /*A program or erase started before a reset may still be running*/
+    at45db_wait_ready(AT45_TEP_US);
 
     /*Initializa information structure*/
 #ifdef BINARY_PAGE_SIZE
@@ -158,6 +172,9 @@ void at45db_chip_erase(void)
     /*Release the device*/
     SPIx_disable_slave(GPIO_SPIx);
 
+    /*Wait for the erase to finish*/
+    at45db_wait_ready(AT45_TCE_US);
+
     /*Check for fault operation*/
     res = at45db_fault_check();
 
@@ -210,6 +227,9 @@ void at45db_page_size_conf(uint16_t mode)
 	    /*Disable the slave device*/
 	    SPIx_disable_slave(GPIO_SPIx);
     }
+
+    /*The page size is a nonvolatile bit, wait for it to be programmed*/
+    at45db_wait_ready(AT45_TEP_US);
 }
 
 /**
@@ -269,6 +289,33 @@ void at45db_page_erase(uint16_t page)
     SPIx_disable_slave(GPIO_SPIx);
 }
 
+/**
+ * @brief Erases a block (8 pages, 2048 bytes in binary page size) of the main memory.
+ * 		  The function returns as soon as the command is sent, poll at45db_IsReady()
+ * 		  before the next program/erase operation.
+ * @param block : The number of the block (0-255).
+ * @retval None.
+ */
+void at45db_block_erase(uint16_t block)
+{
+    uint8_t cmd_buf[4];
+    uint32_t addr = (uint32_t)block << 11;
+
+    cmd_buf[0] = BLOCK_ERASE;
+    cmd_buf[1] = (addr >> 16) & 0xFF;
+    cmd_buf[2] = (addr >> 8) & 0xFF;
+    cmd_buf[3] = addr & 0xFF;
+
+    /*Enable slave device*/
+    SPIx_enable_slave(GPIO_SPIx);
+
+    /*Transmit the opcode and the block address*/
+    SPIx_transmit(SPI_PERIPH, cmd_buf, 4);
+
+    /*Disable slave device*/
+    SPIx_disable_slave(GPIO_SPIx);
+}
+
 /**
  * @brief Enter flash into deep sleep mode.
  * @param info : Structure information about the external flash operation.
@@ -284,14 +331,11 @@ void at45db_deep_sleep(at45db_t *info)
     /*Transmit the command the external FLASH memory*/
     SPIx_transmit(SPI_PERIPH, &opcode, 1);
 
-    /*Give some time to process*/
-    delay_ms(100);
-
-    /*Release the slave device*/
+    /*Release the slave device, the command starts on the rising edge of CS*/
     SPIx_disable_slave(GPIO_SPIx);
 
-    /*Give some time to the system*/
-    delay_ms(2);
+    /*Wait for the device to enter deep power-down*/
+    delay_us(AT45_TDP_US);
 
     /*Make the MISO pin analog, for power saving*/
     SET_BIT(GPIO_SPIx->MODER, (1U<<(SPIx_GPIO_MISO_PIN*2+1)));
@@ -318,6 +362,9 @@ uint16_t at45db_wake_up_from_deep_sleep(at45db_t info)
     /*Release the slave device*/
     SPIx_disable_slave(GPIO_SPIx);
 
+    /*Wait for the device to return to standby*/
+    delay_us(AT45_TRDPD_US);
+
     /*Return the MISO pin to its initial state*/
     SET_BIT(GPIO_SPIx->MODER, (1U<<(SPIx_GPIO_MISO_PIN*2+1)));
     CLEAR_BIT(GPIO_SPIx->MODER, (1U<<SPIx_GPIO_MISO_PIN*2));
@@ -348,12 +395,12 @@ void at45db_ultra_deep_sleep(at45db_t info)
     /*Transmit the proper opcode*/
     SPIx_transmit(SPI_PERIPH, &opcode, 1);
 
-    /*Give some time to the system*/
-    delay_ms(100);
-
-    /*Release the device*/
+    /*Release the device, the command starts on the rising edge of CS*/
     SPIx_disable_slave(GPIO_SPIx);
 
+    /*Wait for the device to enter ultra-deep power-down*/
+    delay_us(AT45_TUDPD_US);
+
     /*Make the MISO pin analog, for power saving*/
     SET_BIT(GPIO_SPIx->MODER, (1U<<(SPIx_GPIO_MISO_PIN*2+1)));
     SET_BIT(GPIO_SPIx->MODER, (1U<<(SPIx_GPIO_MISO_PIN*2)));
@@ -374,12 +421,15 @@ uint16_t at45db_wake_up_from_ultra_deep_sleep(at45db_t info)
     /*Select the device*/
     SPIx_enable_slave(GPIO_SPIx);
 
-    /*Delay*/
-    delay_ms(2);
+    /*A CS low pulse wakes up the device*/
+    delay_us(AT45_TCSLU_US);
 
     /*Release the device*/
     SPIx_disable_slave(GPIO_SPIx);
 
+    /*Wait for the device to return to standby*/
+    delay_us(AT45_TXUDPD_US);
+
     /*Return the MISO pin to its initial state*/
     SET_BIT(GPIO_SPIx->MODER, (1U<<(SPIx_GPIO_MISO_PIN*2+1)));
     CLEAR_BIT(GPIO_SPIx->MODER, (1U<<SPIx_GPIO_MISO_PIN*2));
@@ -421,8 +471,8 @@ void at45db_read_data(uint32_t address, uint8_t *data, uint16_t size)
     /*Select the device*/
     SPIx_enable_slave(GPIO_SPIx);
 
-    /*Transmit the address bytes*/
-    SPIx_transmit(SPI_PERIPH, address_bytes, 4);
+    /*Transmit the opcode, the address bytes and the dummy byte*/
+    SPIx_transmit(SPI_PERIPH, address_bytes, 5);
 
     /*Receive the data from the external flash memory*/
     SPIx_receive(SPI_PERIPH, data, size);
@@ -453,7 +503,7 @@ int at45db_IsReady(void)
     SPIx_disable_slave(GPIO_SPIx);
 
     /*Check the RDY/BSY bit*/
-	if ((status_register[0] & 0x80) == 0x00)
+	if ((status_register[0] & RDY_BIT) == RDY_BIT)
 	{
         /*External device is ready*/
         return 1;
@@ -465,6 +515,33 @@ int at45db_IsReady(void)
     }
 }
 
+/**
+ * @brief Waits until the external flash is ready or a timeout expires.
+ * @param timeout_us : The timeout in microseconds, use the datasheet time of the operation.
+ * @retval 1 if the device is ready, 0 on timeout.
+ */
+int at45db_wait_ready(uint32_t timeout_us)
+{
+    deadline_t deadline = timebase_deadline(timeout_us);
+    int ready = 1;
+
+    PROF_BEGIN(PROF_AT45_WAIT);
+
+    while (!at45db_IsReady())
+    {
+        if (timebase_expired(deadline))
+        {
+            /*Check once more, the device may have finished while the deadline expired*/
+            ready = at45db_IsReady();
+            break;
+        }
+    }
+
+    PROF_END(PROF_AT45_WAIT);
+
+    return ready;
+}
+
 /**
  * @brief Checks if a fault erased after an erase or program operation.
  * @retval 1 if an error is detected, 0 otherwise.
@@ -531,8 +608,47 @@ void at45db_read_status(uint8_t *status_reg)
 void at45db_program(uint32_t addr, uint8_t *buffer, uint16_t size)
 {
     /*Load data into Buffer 1*/
+    at45db_buffer_load(buffer, size);
+
+    /*Program the page from buffer 1*/
+    at45db_buffer_to_main(BUFFER_TO_MAIN_1, addr);
+
+    /*Wait for the page program to finish*/
+    at45db_wait_ready(AT45_TEP_US);
+
+}
+
+/**
+ * @brief This function programs a page of the main memory through the internal buffer 1
+ * without the built in erase: the page must be erased, or only bits that are 1 in it are
+ * cleared, the bytes sent as 0xFF leave the page as it is.
+ * @param addr  : The starting address of the main memory.
+ * @param buffer: The buffer that holds the data which will be stored inside the main memory.
+ * @param size  : The size of the data.
+ * @retval None.
+ */
+void at45db_program_noerase(uint32_t addr, const uint8_t *buffer, uint16_t size)
+{
+    /*Load data into Buffer 1*/
+    at45db_buffer_load(buffer, size);
+
+    /*Program the page from buffer 1*/
+    at45db_buffer_to_main(BUFFER_TO_MAIN_NOERASE_1, addr);
+
+    /*Wait for the page program to finish*/
+    at45db_wait_ready(AT45_TP_US);
+}
+
+/**
+ * @brief Writes data into the internal buffer 1, from its first byte.
+ * @param buffer: The data.
+ * @param size  : The size of the data.
+ * @retval None.
+ */
+static void at45db_buffer_load(const uint8_t *buffer, uint16_t size)
+{
     uint8_t loadCommand[4];
-    loadCommand[0] = 0x84; // Buffer 1 Write opcode
+    loadCommand[0] = INTERNAL_BUFFER_1; // Buffer 1 Write opcode
     loadCommand[1] = 0x00;			// Dummy byte
     loadCommand[2] = 0x00;			// Dummy byte
     loadCommand[3] = 0x00;			// Buffer starting address
@@ -546,10 +662,20 @@ void at45db_program(uint32_t addr, uint8_t *buffer, uint16_t size)
 
     /*Deselect the flash memory*/
     SPIx_disable_slave(GPIO_SPIx);
+}
 
-    /*Program Buffer 1 to Main Memory Page with Built-In Erase*/
+/**
+ * @brief Starts the programming of a main memory page from the internal buffer 1.
+ * The function returns as soon as the command is sent.
+ * @param opcode: BUFFER_TO_MAIN_1 (with built in erase) or BUFFER_TO_MAIN_NOERASE_1.
+ * @param addr  : The address of the page.
+ * @retval None.
+ */
+static void at45db_buffer_to_main(uint8_t opcode, uint32_t addr)
+{
+    /*Program Buffer 1 to Main Memory Page*/
     uint8_t programCommand[4];
-    programCommand[0] = 0x83;	// Buffer 1 to Main Memory Page Program with Built-In Erase opcode
+    programCommand[0] = opcode;
     programCommand[1] = (addr >> 16) & 0xFF;	// Address byte 1
     programCommand[2] = (addr >> 8) & 0xFF;		// Address byte 2
     programCommand[3] = addr & 0xFF;			// Address byte 3
@@ -562,12 +688,115 @@ void at45db_program(uint32_t addr, uint8_t *buffer, uint16_t size)
 
     /*Deselect the flash memory*/
     SPIx_disable_slave(GPIO_SPIx);
+}
+
+/**
+ * @brief Timer handler of at45db_notify_ready(), polls the status register.
+ */
+static void at45db_async_poll(void *arg, uint32_t data)
+{
+    (void)arg;
+    (void)data;
+
+    if (at45db_IsReady())
+    {
+        evloop_timer_stop(&at45_async.timer);
+        at45_async.busy = 0;
+
+        /*Report the EPE bit of the finished operation*/
+        evloop_post(at45_async.handler, at45_async.arg, at45db_fault_check() ? 0 : 1);
+    }
+    else if (timebase_expired(at45_async.deadline))
+    {
+        evloop_timer_stop(&at45_async.timer);
+        at45_async.busy = 0;
+
+        evloop_post(at45_async.handler, at45_async.arg, 0);
+    }
+}
+
+/**
+ * @brief Posts a handler to the event loop when the running program/erase operation ends.
+ * The status register is polled from a timer, so the loop runs other work meanwhile.
+ * Use it after at45db_block_erase(), at45db_page_erase() or at45db_sector_erase().
+ * @param timeout_us : The timeout in microseconds, use the datasheet time of the operation.
+ * @param handler    : The completion handler, data is 1 on success, 0 on failure or timeout.
+ * @param arg        : Its argument.
+ * @retval 1 if the wait started, 0 if an asynchronous operation is already running.
+ */
+int at45db_notify_ready(uint32_t timeout_us, ev_handler_t handler, void *arg)
+{
+    if (at45_async.busy)
+    {
+        return 0;
+    }
+
+    at45_async.handler  = handler;
+    at45_async.arg      = arg;
+    at45_async.deadline = timebase_deadline(timeout_us);
+    at45_async.busy     = 1;
+
+    evloop_timer_start(&at45_async.timer, AT45_POLL_US, AT45_POLL_US, at45db_async_poll, NULL);
+
+    return 1;
+}
+
+/**
+ * @brief Completion of the buffer load of at45db_program_async().
+ */
+static void at45db_async_loaded(void *arg, uint32_t data)
+{
+    (void)arg;
+    (void)data;
+
+    /*Deselect the flash memory*/
+    SPIx_disable_slave(GPIO_SPIx);
 
+    /*Program the page and poll for the end of the operation*/
+    at45db_buffer_to_main(BUFFER_TO_MAIN_1, at45_async.addr);
 
-    bool isReady = at45db_IsReady();
+    at45_async.deadline = timebase_deadline(AT45_TEP_US);
+    evloop_timer_start(&at45_async.timer, AT45_POLL_US, AT45_POLL_US, at45db_async_poll, NULL);
+}
 
-    while (!isReady) {}
+/**
+ * @brief Asynchronous version of at45db_program(). The data is loaded to buffer 1 by
+ * the SPI interrupt and the page program is polled from a timer, so the function returns
+ * at once and the event loop runs other work meanwhile.
+ * @param addr    : The starting address of the main memory.
+ * @param buffer  : The data, it must stay valid until the handler runs.
+ * @param size    : The size of the data.
+ * @param handler : The completion handler, data is 1 on success, 0 on failure or timeout.
+ * @param arg     : Its argument.
+ * @retval 1 if the operation started, 0 if an asynchronous operation is already running.
+ */
+int at45db_program_async(uint32_t addr, const uint8_t *buffer, uint16_t size, ev_handler_t handler, void *arg)
+{
+    uint8_t loadCommand[4] = { INTERNAL_BUFFER_1, 0x00, 0x00, 0x00 };
 
+    if (at45_async.busy)
+    {
+        return 0;
+    }
+
+    at45_async.addr    = addr;
+    at45_async.handler = handler;
+    at45_async.arg     = arg;
+    at45_async.busy    = 1;
+
+    /*Select the external flash memory and send the command*/
+    SPIx_enable_slave(GPIO_SPIx);
+    SPIx_transmit(SPI_PERIPH, loadCommand, 4);
+
+    /*The data follows from the SPI interrupt*/
+    if (!SPIx_transfer_async(SPI_PERIPH, buffer, NULL, size, at45db_async_loaded, NULL))
+    {
+        SPIx_disable_slave(GPIO_SPIx);
+        at45_async.busy = 0;
+        return 0;
+    }
+
+    return 1;
 }
 
 void at45db_read_continuous(uint32_t addr, uint8_t *buffer, uint32_t size)
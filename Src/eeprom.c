@@ -0,0 +1,316 @@
+/*
+ * eeprom.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "eeprom.h"
+
+
+/*RAM index, the latest value of every key*/
+static uint32_t ee_value[EE_MAX_KEYS];
+static uint8_t ee_present[(EE_MAX_KEYS + 7) / 8];
+
+static uint32_t ee_active;	/*Active page (0/1)*/
+static uint32_t ee_next;	/*Next free record of the active page*/
+static uint32_t ee_seq;		/*Sequence number of the active page*/
+static ee_stats_t ee_stats;
+
+
+/**
+ * @brief Address of an EEPROM page, the last FLASH_EE_PAGES of the data region.
+ */
+static uint32_t ee_page_addr(uint32_t page)
+{
+	return bl_flash_data_base() + (FLASH_DATA_PAGES - FLASH_EE_PAGES + page) * FLASH_PAGE_SIZE;
+}
+
+static uint32_t ee_record_addr(uint32_t page, uint32_t slot)
+{
+	return ee_page_addr(page) + (EE_HEADER_DWORDS + slot) * 8;
+}
+
+static uint64_t ee_dword(uint32_t addr)
+{
+	uint64_t dword;
+
+	memcpy(&dword, BL_FLASH_PTR(addr), 8);
+
+	return dword;
+}
+
+/**
+ * @brief CRC-16/CCITT of key and value, detects torn or corrupted records.
+ */
+static uint16_t ee_check(uint16_t key, uint32_t value)
+{
+	uint8_t data[6] = { key, key >> 8, value, value >> 8, value >> 16, value >> 24 };
+	uint16_t crc = 0xFFFF;
+
+	for (uint32_t i = 0; i < sizeof(data); i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (uint32_t j = 0; j < 8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+static uint64_t ee_record(uint16_t key, uint32_t value)
+{
+	return (uint64_t)key | ((uint64_t)value << 16) | ((uint64_t)ee_check(key, value) << 48);
+}
+
+/**
+ * @brief Programs a double-word and reads it back.
+ * @retval 1 on success, 0 otherwise.
+ */
+static uint16_t ee_program(uint32_t addr, uint64_t dword)
+{
+	uint16_t was_locked = bl_flash_unlock();
+
+	bl_flash_write64(addr, dword);
+
+	if (was_locked) {
+		bl_flash_lock();
+	}
+
+	return (ee_dword(addr) == dword) ? 1 : 0;
+}
+
+/**
+ * @brief Erases a page, unless it is erased already.
+ * @retval 1 on success, 0 otherwise.
+ */
+static uint16_t ee_erase(uint32_t page)
+{
+	uint32_t addr = ee_page_addr(page);
+	uint16_t was_locked;
+	uint32_t i;
+
+	for (i = 0; i < FLASH_PAGE_SIZE; i += 8) {
+		if (ee_dword(addr + i) != UINT64_MAX) {
+			break;
+		}
+	}
+	if (i == FLASH_PAGE_SIZE) {
+		return 1;
+	}
+
+	was_locked = bl_flash_unlock();
+	bl_flash_page_erase(bl_flash_get_page(addr), bl_flash_get_bank(addr));
+	if (was_locked) {
+		bl_flash_lock();
+	}
+
+	ee_stats.erases++;
+
+	return (ee_dword(addr) == UINT64_MAX) ? 1 : 0;
+}
+
+/**
+ * @brief Checks the header of a page.
+ * @retval 1 if the page is valid (seq holds its sequence number), 0 otherwise.
+ */
+static uint16_t ee_page_valid(uint32_t page, uint32_t *seq)
+{
+	uint64_t hdr = ee_dword(ee_page_addr(page));
+
+	if ((uint32_t)(hdr >> 32) != EE_PAGE_MAGIC || ee_dword(ee_page_addr(page) + 8) != EE_PAGE_VALID) {
+		return 0;
+	}
+
+	*seq = (uint32_t)hdr;
+
+	return 1;
+}
+
+/**
+ * @brief Rebuilds the RAM index from the log of a page.
+ */
+static void ee_load(uint32_t page)
+{
+	uint64_t rec;
+	uint16_t key;
+	uint32_t value;
+	uint32_t slot;
+
+	memset(ee_present, 0, sizeof(ee_present));
+
+	for (slot = 0; slot < EE_RECORDS; slot++) {
+		rec = ee_dword(ee_record_addr(page, slot));
+
+		/*The first erased slot is the end of the log*/
+		if (rec == UINT64_MAX) {
+			break;
+		}
+
+		key   = (uint16_t)rec;
+		value = (uint32_t)(rec >> 16);
+
+		/*Skip records torn by a reset*/
+		if (key < EE_MAX_KEYS && (uint16_t)(rec >> 48) == ee_check(key, value)) {
+			ee_value[key] = value;
+			ee_present[key / 8] |= (1U << (key % 8));
+		}
+	}
+
+	ee_active = page;
+	ee_next = slot;
+}
+
+/**
+ * @brief Copies the RAM index into the other page and makes it the active one. The old
+ * 		  page stays valid until the new one has its VALID marker, so a reset at any point
+ * 		  keeps either the old or the new set of values.
+ * @retval EE_OK on success, EE_FLASH_ERR otherwise.
+ */
+static ee_status_t ee_compact(void)
+{
+	uint32_t dst = ee_active ^ 1;
+	uint32_t slot = 0;
+
+	if (!ee_erase(dst) ||
+		!ee_program(ee_page_addr(dst), ((uint64_t)EE_PAGE_MAGIC << 32) | (ee_seq + 1))) {
+		return EE_FLASH_ERR;
+	}
+
+	for (uint16_t key = 0; key < EE_MAX_KEYS; key++) {
+		if (ee_present[key / 8] & (1U << (key % 8))) {
+			if (!ee_program(ee_record_addr(dst, slot), ee_record(key, ee_value[key]))) {
+				return EE_FLASH_ERR;
+			}
+			slot++;
+		}
+	}
+
+	if (!ee_program(ee_page_addr(dst) + 8, EE_PAGE_VALID)) {
+		return EE_FLASH_ERR;
+	}
+
+	/*The new page is complete, drop the old one*/
+	ee_erase(ee_active);
+
+	ee_active = dst;
+	ee_next = slot;
+	ee_seq++;
+	ee_stats.compactions++;
+
+	return EE_OK;
+}
+
+/**
+ * @brief Erases both pages and starts an empty EEPROM.
+ * @retval EE_OK on success, EE_FLASH_ERR otherwise.
+ */
+ee_status_t ee_format(void)
+{
+	memset(ee_present, 0, sizeof(ee_present));
+
+	if (!ee_erase(0) || !ee_erase(1) ||
+		!ee_program(ee_page_addr(0), ((uint64_t)EE_PAGE_MAGIC << 32) | 1) ||
+		!ee_program(ee_page_addr(0) + 8, EE_PAGE_VALID)) {
+		return EE_FLASH_ERR;
+	}
+
+	ee_active = 0;
+	ee_next = 0;
+	ee_seq = 1;
+
+	return EE_OK;
+}
+
+/**
+ * @brief Finds the active page, finishes an interrupted compaction and builds the RAM index.
+ * 		  Formats the EEPROM when no page is valid (first boot).
+ * @retval EE_OK on success, EE_FLASH_ERR otherwise.
+ */
+ee_status_t ee_init(void)
+{
+	uint32_t seq0 = 0;
+	uint32_t seq1 = 0;
+	uint16_t valid0 = ee_page_valid(0, &seq0);
+	uint16_t valid1 = ee_page_valid(1, &seq1);
+	uint32_t page;
+
+	if (!valid0 && !valid1) {
+		return ee_format();
+	}
+
+	/*Both valid: reset after a compaction, before the old page was erased*/
+	if (valid0 && valid1) {
+		page = ((int32_t)(seq1 - seq0) > 0) ? 1 : 0;
+	} else {
+		page = valid0 ? 0 : 1;
+	}
+
+	ee_seq = (page == 0) ? seq0 : seq1;
+	ee_load(page);
+
+	/*The other page is either old or a compaction that did not finish*/
+	if (!ee_erase(page ^ 1)) {
+		return EE_FLASH_ERR;
+	}
+
+	return EE_OK;
+}
+
+/**
+ * @brief Reads the latest value of a key, from the RAM index.
+ */
+ee_status_t ee_read(uint16_t key, uint32_t *value)
+{
+	if (key >= EE_MAX_KEYS) {
+		return EE_BAD_KEY;
+	}
+
+	if (!(ee_present[key / 8] & (1U << (key % 8)))) {
+		return EE_NOT_FOUND;
+	}
+
+	*value = ee_value[key];
+
+	return EE_OK;
+}
+
+/**
+ * @brief Stores a value. Costs one double-word program, plus a compaction (one page
+ * 		  erase and EE_MAX_KEYS programs at most) once every EE_RECORDS updates.
+ */
+ee_status_t ee_write(uint16_t key, uint32_t value)
+{
+	uint16_t res;
+
+	if (key >= EE_MAX_KEYS) {
+		return EE_BAD_KEY;
+	}
+
+	/*Nothing to do for an unchanged value*/
+	if ((ee_present[key / 8] & (1U << (key % 8))) && ee_value[key] == value) {
+		ee_stats.skipped++;
+		return EE_OK;
+	}
+
+	ee_value[key] = value;
+	ee_present[key / 8] |= (1U << (key % 8));
+	ee_stats.writes++;
+
+	/*Active page full, the compaction stores the new value too*/
+	if (ee_next >= EE_RECORDS) {
+		return ee_compact();
+	}
+
+	/*The slot is used even if the program fails*/
+	res = ee_program(ee_record_addr(ee_active, ee_next), ee_record(key, value));
+	ee_next++;
+
+	return res ? EE_OK : EE_FLASH_ERR;
+}
+
+void ee_get_stats(ee_stats_t *stats)
+{
+	*stats = ee_stats;
+}
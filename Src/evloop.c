@@ -0,0 +1,348 @@
+/*
+ * evloop.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "evloop.h"
+
+
+/**
+ * @brief A queued event.
+ */
+typedef struct {
+	ev_handler_t handler;
+	void *arg;
+	uint32_t data;
+}ev_entry_t;
+
+/*Event queue, written by evloop_post() (also from interrupts), read by the loop*/
+static ev_entry_t ev_queue[EVLOOP_QUEUE_SIZE];
+static volatile uint32_t ev_head;
+static volatile uint32_t ev_tail;
+static volatile uint32_t ev_dropped;
+
+/*Active timers, sorted by expiry*/
+static ev_timer_t *ev_timers;
+
+
+/**
+ * @brief Resets the queue and forgets every timer.
+ * @retval None.
+ */
+void evloop_init(void)
+{
+	ev_head    = 0;
+	ev_tail    = 0;
+	ev_dropped = 0;
+	ev_timers  = NULL;
+}
+
+/**
+ * @brief Queues an event. It can be called from an interrupt handler.
+ * @param handler : The function to run from the loop.
+ * @param arg     : Its argument.
+ * @param data    : A value passed to the handler.
+ * @retval 1 if the event was queued, 0 if the queue is full.
+ */
+int evloop_post(ev_handler_t handler, void *arg, uint32_t data)
+{
+	uint32_t primask;
+	int res = 0;
+
+	/*The loop and the interrupts post to the same queue*/
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if ((ev_head - ev_tail) < EVLOOP_QUEUE_SIZE) {
+		ev_queue[ev_head & (EVLOOP_QUEUE_SIZE - 1U)].handler = handler;
+		ev_queue[ev_head & (EVLOOP_QUEUE_SIZE - 1U)].arg     = arg;
+		ev_queue[ev_head & (EVLOOP_QUEUE_SIZE - 1U)].data    = data;
+		ev_head++;
+		res = 1;
+	} else {
+		ev_dropped++;
+	}
+
+	__set_PRIMASK(primask);
+
+	return res;
+}
+
+/**
+ * @brief Inserts a timer in the list, keeping the list sorted by expiry.
+ */
+static void evloop_timer_insert(ev_timer_t *timer)
+{
+	ev_timer_t **pp = &ev_timers;
+
+	/*Signed difference, it holds across the wrap of the time base*/
+	while (*pp && (int32_t)((*pp)->expiry - timer->expiry) <= 0) {
+		pp = &(*pp)->next;
+	}
+
+	timer->next = *pp;
+	*pp = timer;
+}
+
+/**
+ * @brief Starts (or restarts) a timer. The handler runs from the loop with data 0.
+ * @param timer     : The timer, it must stay valid while it is active.
+ * @param delay_us  : Microseconds until the first expiry.
+ * @param period_us : The period of a periodic timer, 0 for a one-shot timer.
+ * @param handler   : The function to run on expiry.
+ * @param arg       : Its argument.
+ * @retval None.
+ */
+void evloop_timer_start(ev_timer_t *timer, uint32_t delay_us, uint32_t period_us, ev_handler_t handler, void *arg)
+{
+	evloop_timer_stop(timer);
+
+	timer->expiry    = timebase_deadline(delay_us);
+	timer->period_us = period_us;
+	timer->handler   = handler;
+	timer->arg       = arg;
+	timer->active    = 1;
+
+	evloop_timer_insert(timer);
+}
+
+/**
+ * @brief Stops a timer. Stopping an inactive timer does nothing.
+ * @retval None.
+ */
+void evloop_timer_stop(ev_timer_t *timer)
+{
+	ev_timer_t **pp = &ev_timers;
+
+	if (!timer->active) {
+		return;
+	}
+
+	while (*pp && *pp != timer) {
+		pp = &(*pp)->next;
+	}
+	if (*pp) {
+		*pp = timer->next;
+	}
+
+	timer->active = 0;
+}
+
+/**
+ * @brief Runs the handlers of the expired timers and re-arms the periodic ones.
+ * @retval The number of handlers run.
+ */
+static uint32_t evloop_fire_timers(void)
+{
+	ev_timer_t *timer;
+	uint32_t fired = 0;
+
+	while (ev_timers && timebase_expired(ev_timers->expiry)) {
+		timer = ev_timers;
+		ev_timers = timer->next;
+		timer->active = 0;
+
+		if (timer->period_us) {
+			/*From the previous expiry, so the period does not drift*/
+			timer->expiry += timer->period_us;
+			timer->active  = 1;
+			evloop_timer_insert(timer);
+		}
+
+		timer->handler(timer->arg, 0);
+		fired++;
+	}
+
+	return fired;
+}
+
+/**
+ * @brief Runs the expired timers and the events queued so far. Events posted by the
+ * handlers run on the next call, so timers are not starved.
+ * @retval The number of handlers run, 0 if the loop was idle.
+ */
+uint32_t evloop_run_once(void)
+{
+	uint32_t n = evloop_fire_timers();
+	uint32_t pending = ev_head - ev_tail;
+	ev_entry_t ev;
+	int32_t next;
+
+	while (pending--) {
+		ev = ev_queue[ev_tail & (EVLOOP_QUEUE_SIZE - 1U)];
+		ev_tail++;
+
+		ev.handler(ev.arg, ev.data);
+		n++;
+	}
+
+	if (n == 0) {
+		next = ev_timers ? (int32_t)(ev_timers->expiry - timebase_us()) : INT32_MAX;
+		EVLOOP_IDLE((next > 0) ? (uint32_t)next : 0U);
+	}
+
+	return n;
+}
+
+/**
+ * @brief Runs the loop forever.
+ * @retval None.
+ */
+void evloop_run(void)
+{
+	for (;;) {
+		evloop_run_once();
+	}
+}
+
+/**
+ * @brief Runs the loop until a flag is set by a handler.
+ * @retval None.
+ */
+void evloop_run_until(const volatile uint8_t *flag)
+{
+	while (!*flag) {
+		evloop_run_once();
+	}
+}
+
+/**
+ * @brief Resumes a task from the loop.
+ */
+static void evloop_task_resume(void *arg, uint32_t data)
+{
+	ev_task_t *task = arg;
+
+	(void)data;
+
+	task->queued = 0;
+	if (task->done) {
+		return;
+	}
+
+	if (task->run(task) == PT_ENDED) {
+		task->done = 1;
+	}
+}
+
+/**
+ * @brief Starts a task. Its body runs for the first time from the loop.
+ * @param task : The task, it must stay valid until it ends.
+ * @param run  : The protothread body.
+ * @retval None.
+ */
+void evloop_task_start(ev_task_t *task, int (*run)(ev_task_t *task))
+{
+	PT_INIT(&task->pt);
+	task->run         = run;
+	task->data        = 0;
+	task->timer_fired = 0;
+	task->queued      = 0;
+	task->done        = 0;
+	task->timer.active = 0;
+
+	evloop_task_signal(task);
+}
+
+/**
+ * @brief Resumes a task, so it re-evaluates the condition it waits for. Signals sent
+ * while a resume is already pending are merged.
+ * @retval None.
+ */
+void evloop_task_signal(ev_task_t *task)
+{
+	if (task->queued || task->done) {
+		return;
+	}
+
+	task->queued = evloop_post(evloop_task_resume, task, 0) ? 1 : 0;
+}
+
+/**
+ * @brief Completion handler that signals a task, for drivers that post an ev_handler_t.
+ * The task finds the data of the completion in task->data.
+ * @param arg  : The task.
+ * @param data : The completion data.
+ * @retval None.
+ */
+void evloop_task_signal_handler(void *arg, uint32_t data)
+{
+	ev_task_t *task = arg;
+
+	task->data = data;
+	evloop_task_signal(task);
+}
+
+/**
+ * @brief Timer handler of EV_TASK_SLEEP.
+ */
+static void evloop_task_timer(void *arg, uint32_t data)
+{
+	ev_task_t *task = arg;
+
+	(void)data;
+
+	task->timer_fired = 1;
+	evloop_task_signal(task);
+}
+
+/**
+ * @brief Signals a task after a number of microseconds.
+ * @retval None.
+ */
+void evloop_task_wake_in(ev_task_t *task, uint32_t us)
+{
+	evloop_timer_start(&task->timer, us, 0, evloop_task_timer, task);
+}
+
+/**
+ * @brief Marks the start of an operation on a peripheral.
+ * @retval None.
+ */
+void evloop_resource_begin(ev_resource_t *res)
+{
+	res->busy_since = timebase_us();
+	res->busy = 1;
+	res->ops++;
+}
+
+/**
+ * @brief Marks the end of an operation on a peripheral.
+ * @retval None.
+ */
+void evloop_resource_end(ev_resource_t *res)
+{
+	if (res->busy) {
+		res->busy_us += timebase_elapsed_us(res->busy_since);
+		res->busy = 0;
+	}
+}
+
+/**
+ * @brief Gets the share of time a peripheral has been busy.
+ * @param res        : The peripheral.
+ * @param elapsed_us : The length of the measurement.
+ * @retval The utilisation in 1/1000.
+ */
+uint32_t evloop_resource_permille(const ev_resource_t *res, uint32_t elapsed_us)
+{
+	uint64_t busy = res->busy_us;
+
+	if (res->busy) {
+		busy += timebase_elapsed_us(res->busy_since);
+	}
+
+	return elapsed_us ? (uint32_t)((busy * 1000U) / elapsed_us) : 0;
+}
+
+/**
+ * @brief Gets the number of events lost because the queue was full.
+ * @retval The number of events.
+ */
+uint32_t evloop_dropped(void)
+{
+	return ev_dropped;
+}
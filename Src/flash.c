@@ -8,6 +8,9 @@
 
 #include "flash.h"
 
+/*Banks (bit 1 << bank) mass erased since reset without a page erase since, fast
+  programming is only allowed in them (RM0351 3.3.7)*/
+static uint32_t bl_flash_fast_banks;
 
 /**
  * @brief Unlock the flash memory of the boot-loader.
@@ -47,37 +50,40 @@ void bl_flash_clear_status_flags(void)
 	if (READ_BIT(FLASH->SR, FLASH_SR_PROGERR)) {
 		printf("Warning, Previously word written is not erased...\n\r");
 		/*Clear the error flag*/
-		SET_BIT(FLASH->SR, FLASH_SR_PROGERR);
+		BL_FLASH_CLEAR_SR(FLASH_SR_PROGERR);
 	}
 
 	/*Size error check*/
 	if (READ_BIT(FLASH->SR, FLASH_SR_SIZERR)){
 		printf("Warning, previous attempt to write half/byte word error detected...\n\r");
 		/*Clear the error flag*/
-		SET_BIT(FLASH->SR, FLASH_SR_SIZERR);
+		BL_FLASH_CLEAR_SR(FLASH_SR_SIZERR);
 	}
 
 	/*Fast programming miss data error check*/
 	if (READ_BIT(FLASH->SR, FLASH_SR_MISERR)) {
 		printf("Warning, previous fast programming data miss error detected...\n\r");
 		/*Clear the error flag*/
-		SET_BIT(FLASH->SR, FLASH_SR_MISERR);
+		BL_FLASH_CLEAR_SR(FLASH_SR_MISERR);
 	}
 
 	/*Programming alignment error check*/
 	if (READ_BIT(FLASH->SR, FLASH_SR_PGAERR)) {
 		printf("Warning, previous programming alignment error detected...\n\r");
 		/*Clear the error flag*/
-		SET_BIT(FLASH->SR, FLASH_SR_PGAERR);
+		BL_FLASH_CLEAR_SR(FLASH_SR_PGAERR);
 	}
 
 	/*Fast programming error check*/
 	if (READ_BIT(FLASH->SR, FLASH_SR_FASTERR)) {
 		printf("Warning, previous fast programming error detected...\n\r");
 		/*Clear the error flag*/
-		SET_BIT(FLASH->SR, FLASH_SR_FASTERR);
+		BL_FLASH_CLEAR_SR(FLASH_SR_FASTERR);
 	}
 
+	/*The flags without a warning are cleared as well*/
+	BL_FLASH_CLEAR_SR(FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGSERR);
+
 }
 
 /**
@@ -87,9 +93,33 @@ void bl_flash_clear_status_flags(void)
  * @retval 1 if page erased successfully, 0 otherwise due to undefined bank definition.
  */
 uint16_t bl_flash_page_erase(uint32_t page, uint16_t bank)
+{
+	/*Start the erase operation*/
+	if (!bl_flash_page_erase_start(page, bank)) {
+		return 0;
+	}
+
+	/*Wait the flash to finish its ongoing operation*/
+	BL_FLASH_WAIT_BSY();
+
+	/*Disable page operation*/
+	CLEAR_BIT(FLASH->CR, FLASH_CR_PER);
+
+	return 1;
+}
+
+/**
+ * @brief Starts the erase of a page and returns while the flash is still busy. The CPU
+ * 		  keeps running from the other bank, so it can do useful work (e.g. fetch the next
+ * 		  chunk from the external flash) and then finish with bl_flash_end_op().
+ * @param page  : The page that needs to be erased.
+ * @param bank  : Is the bank (1/2) of the flash memory.
+ * @retval 1 if the erase has started, 0 otherwise due to undefined bank definition.
+ */
+uint16_t bl_flash_page_erase_start(uint32_t page, uint16_t bank)
 {
 	/*Wait if any flash memory operation is ongoing*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Check if any error occurs due to previous programming*/
 	bl_flash_clear_status_flags();
@@ -106,6 +136,9 @@ uint16_t bl_flash_page_erase(uint32_t page, uint16_t bank)
 		return 0;
 	}
 
+	/*A bank with a page erased needs a mass erase before the next fast programming*/
+	bl_flash_fast_banks &= ~(1U << bank);
+
 	/*Define the page that must be erased*/
 	MODIFY_REG(FLASH->CR, FLASH_CR_PNB, (page << FLASH_CR_PNB_Pos));
 
@@ -115,16 +148,33 @@ uint16_t bl_flash_page_erase(uint32_t page, uint16_t bank)
 	/*Start the procedure*/
 	SET_BIT(FLASH->CR, FLASH_CR_STRT);
 
+	return 1;
+}
+
+/**
+ * @brief Checks if the flash controller is still executing an operation.
+ * @retval 1 if busy, 0 otherwise.
+ */
+uint16_t bl_flash_is_busy(void)
+{
+	return READ_BIT(FLASH->SR, FLASH_SR_BSY) ? 1 : 0;
+}
+
+/**
+ * @brief Waits for an operation started with bl_flash_page_erase_start() to finish.
+ * @retval 1 if the operation completed without errors, 0 otherwise.
+ */
+uint16_t bl_flash_end_op(void)
+{
 	/*Wait the flash to finish its ongoing operation*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Disable page operation*/
 	CLEAR_BIT(FLASH->CR, FLASH_CR_PER);
 
-	return 1;
+	return bl_flash_check_errors();
 }
 
-
 /**
  * @brief Performs mass erase into the selected bank.
  * @param bank  :  Is the bank (1/2) of the flash memory.
@@ -133,7 +183,7 @@ uint16_t bl_flash_page_erase(uint32_t page, uint16_t bank)
 uint16_t bl_flash_mass_erase_bank(uint16_t bank)
 {
 	/*Wait if any flash memory operation is ongoing*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Check if any error occurs due to previous programming*/
 	bl_flash_clear_status_flags();
@@ -156,8 +206,17 @@ uint16_t bl_flash_mass_erase_bank(uint16_t bank)
 	printf("Starting erase operation into bank%d\n\r", bank);
 
 	/*Wait flash to finish its ongoing operation*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
+
+	/*Stop the erase operation*/
+	CLEAR_BIT(FLASH->CR, FLASH_CR_MER1 | FLASH_CR_MER2);
 
+	if (!bl_flash_check_errors()) {
+		return 0;
+	}
+
+	/*The whole bank can now take fast programming rows*/
+	bl_flash_fast_banks |= (1U << bank);
 
 	return 1;
 }
@@ -170,7 +229,7 @@ uint16_t bl_flash_mass_erase_bank(uint16_t bank)
 void bl_flash_mass_erase(void)
 {
 	/*Wait if any flash memory operation is ongoing*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Select both banks*/
 	SET_BIT(FLASH->CR, FLASH_CR_MER1); /*Bank 1*/
@@ -182,11 +241,14 @@ void bl_flash_mass_erase(void)
 	printf("Starting mass erase operation into both banks\n\r");
 
 	/*Wait flash to finish its ongoing operation*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Stop the erase operation*/
-	CLEAR_BIT(FLASH->CR, FLASH_CR_STRT);
+	CLEAR_BIT(FLASH->CR, FLASH_CR_STRT | FLASH_CR_MER1 | FLASH_CR_MER2);
 
+	if (bl_flash_check_errors()) {
+		bl_flash_fast_banks = (1U << FLASH_BANK_1) | (1U << FLASH_BANK_2);
+	}
 }
 
 /*
@@ -202,7 +264,7 @@ void bl_flash_mass_erase(void)
 void bl_flash_write64(uint32_t address, uint64_t data)
 {
 	/*Wait if any flash memory operation is ongoing*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Check for previous programming errors, and clear them*/
 	bl_flash_clear_status_flags();
@@ -211,11 +273,11 @@ void bl_flash_write64(uint32_t address, uint64_t data)
 	SET_BIT(FLASH->CR, FLASH_CR_PG);
 
 	/*Program double-word*/
-	*(__IO uint32_t*) address = (uint32_t) data;
-	*(__IO uint32_t*)(address + 4) = (uint32_t)(data >> 32);
+	BL_FLASH_WRITE32(address, data);
+	BL_FLASH_WRITE32(address + 4, data >> 32);
 
 	/*Wait if any flash memory operation is ongoing*/
-	while (READ_BIT(FLASH->SR, FLASH_SR_BSY)) {}
+	BL_FLASH_WAIT_BSY();
 
 	/*Stop the programming operation*/
 	CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
@@ -223,33 +285,223 @@ void bl_flash_write64(uint32_t address, uint64_t data)
 
 /**
  * @brief Writes a string into the flash memory. It starts from a specific page address
- * 		  and keeps writing until its done.
- * @param start_addr  : Starting page address (0-255 = Bank 1, 256-511 = Bank 2) if the FLASH size defined in linker is 1MB.
+ * 		  and keeps writing until its done. The bytes are packed, 8 per double-word, and
+ * 		  only the last double-word is padded (0xFF), so the string takes FLASH_STR_SPAN(len)
+ * 		  bytes of flash. The flash is unlocked once for the whole span and it is locked
+ * 		  again on return if it was locked on entry.
+ * @param start_addr  : Starting address, double-word aligned (0-255 = Bank 1, 256-511 = Bank 2 pages) if the FLASH size defined in linker is 1MB.
  * 						For 512KB dual bank organization (0-127 = Bank 1, 256-383 = Bank 2).
  * 						For 256KB dual bank organization (0-63 = Bank 1, 256-319 = Bank 2).
  * @param pBuf		  : Pointer buffer, which contains the data that is going to be written into the flash memory.
  * @param len 		  : The length of the data (pBuf).
+ * @retval 	1 if the string is written successfully, 0 otherwise.
+ */
+uint16_t bl_flash_write64_str(uint32_t start_addr, const uint8_t *pBuf, uint16_t len)
+{
+	uint16_t was_locked;
+	uint16_t res;
+
+	/*Unlock once for the whole span*/
+	was_locked = bl_flash_unlock();
+
+	res = bl_flash_program(start_addr, pBuf, len);
+
+	/*Leave the flash as we found it*/
+	if (was_locked) {
+		bl_flash_lock();
+	}
+
+	return res;
+}
+
+/**
+ * @brief Reads back a string written by bl_flash_write64_str().
+ * @param start_addr  : Starting address of the string.
+ * @param pBuf		  : The buffer that will hold the string.
+ * @param len 		  : The length of the string.
  * @retval 	None.
  */
-void bl_flash_write64_str(uint32_t start_addr, uint8_t *pBuf, uint16_t len)
+void bl_flash_read_str(uint32_t start_addr, uint8_t *pBuf, uint16_t len)
 {
-	uint32_t addr = start_addr;
-	for (uint32_t i=0; i<len; i++) {
-		bl_flash_write64(addr, pBuf[i]);
-		addr = addr + 8;
+	BL_FLASH_READ(pBuf, start_addr, len);
+}
+
+/**
+ * @brief Reads a string stored with the old sparse layout, where every byte took a
+ * 		  whole double-word (the byte in the lowest address, the rest zero). Use it for
+ * 		  data written by firmware older than the packed bl_flash_write64_str().
+ * @param start_addr  : Starting address of the string.
+ * @param pBuf		  : The buffer that will hold the string.
+ * @param len 		  : The length of the string, in bytes (it spans len*8 bytes of flash).
+ * @retval 	None.
+ */
+void bl_flash_read64_str_sparse(uint32_t start_addr, uint8_t *pBuf, uint16_t len)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		pBuf[i] = *BL_FLASH_PTR(start_addr + i*8);
+	}
+}
+
+/**
+ * @brief Checks the status register once, after a batch of program operations, and
+ * 		  clears any error flag that has been raised. Unlike bl_flash_clear_status_flags(),
+ * 		  it does not print, so it is cheap enough for the programming loops.
+ * @retval 1 if no error flag was set, 0 otherwise.
+ */
+uint16_t bl_flash_check_errors(void)
+{
+	uint32_t errors = READ_BIT(FLASH->SR, FLASH_SR_ERRORS);
+
+	/*Clear the end of operation flag and any error flag (write 1 to clear)*/
+	BL_FLASH_CLEAR_SR(errors | FLASH_SR_EOP);
+
+	return (errors == 0) ? 1 : 0;
+}
+
+/**
+ * @brief Programs one row (32 double-words, 256 bytes) using the fast programming mode.
+ * 		  The row must be erased and the address aligned to FLASH_ROW_SIZE. Fast programming
+ * 		  needs a bank mass erased with bl_flash_mass_erase_bank(), after a page erase the
+ * 		  silicon rejects it with PGSERR (RM0351 3.3.7). The 64 words are
+ * 		  written back to back with interrupts masked, since any gap in the sequence aborts
+ * 		  the row with a MISERR.
+ * @param address : Row aligned address of the flash memory.
+ * @param row     : The 32 double-words that are going to be written.
+ * @retval 1 if the row is programmed successfully, 0 otherwise.
+ */
+uint16_t bl_flash_program_row(uint32_t address, const uint64_t *row)
+{
+	uint32_t primask;
+
+	/*Fast programming works on whole, aligned rows*/
+	if (address % FLASH_ROW_SIZE) {
+		return 0;
+	}
+
+	/*Wait if any flash memory operation is ongoing*/
+	BL_FLASH_WAIT_BSY();
+
+	/*Start from a clean status register*/
+	bl_flash_check_errors();
+
+	/*Enable fast programming operation*/
+	SET_BIT(FLASH->CR, FLASH_CR_FSTPG);
+
+	/*The row has to be fed without interruption*/
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (uint32_t i = 0; i < FLASH_ROW_DWORDS; i++) {
+		BL_FLASH_WRITE32(address + i*8, row[i]);
+		BL_FLASH_WRITE32(address + i*8 + 4, row[i] >> 32);
 	}
+
+	__set_PRIMASK(primask);
+
+	/*Wait the flash to finish the row*/
+	BL_FLASH_WAIT_BSY();
+
+	/*Stop the fast programming operation*/
+	CLEAR_BIT(FLASH->CR, FLASH_CR_FSTPG);
+
+	return bl_flash_check_errors();
 }
 
 /**
- * @brief Writes a data block into flash memory.
- * @param start_addr : Starting address from which the words are going to be stored into.
- * @param str		 : The buffer where
+ * @brief Programs a span with the standard double-word sequence. PG stays set for the
+ * 		  whole span and the status register is checked once per flash page, instead of
+ * 		  once per double-word. A partial last double-word is padded with 0xFF.
+ * @retval 1 on success, 0 if the flash reported an error.
  */
-void bl_flash_program(uint32_t start_addr, const uint8_t *str, uint16_t len)
+static uint16_t bl_flash_program_dwords(uint32_t address, const uint8_t *data, uint32_t len)
 {
+	uint16_t res = 1;
+	uint64_t dword;
+
+	/*Wait if any flash memory operation is ongoing*/
+	BL_FLASH_WAIT_BSY();
+
+	/*Start from a clean status register*/
+	bl_flash_check_errors();
+
+	/*Enable flash programming operation*/
+	SET_BIT(FLASH->CR, FLASH_CR_PG);
+
 	for (uint32_t i = 0; i < len; i += 8) {
-		bl_flash_write64(start_addr + i, *(uint64_t*)(str+i));
+		/*The source buffer has no alignment guarantee*/
+		dword = UINT64_MAX;
+		memcpy(&dword, data + i, ((len - i) < 8) ? (len - i) : 8);
+
+		/*Program double-word*/
+		BL_FLASH_WRITE32(address + i, dword);
+		BL_FLASH_WRITE32(address + i + 4, dword >> 32);
+
+		/*Wait the flash to finish the double-word*/
+		BL_FLASH_WAIT_BSY();
+
+		/*Check the errors once the end of a page has been reached*/
+		if (((address + i + 8) % FLASH_PAGE_SIZE) == 0) {
+			if (!bl_flash_check_errors()) {
+				res = 0;
+				break;
+			}
+		}
+	}
+
+	/*Stop the programming operation*/
+	CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+
+	if (res && !bl_flash_check_errors()) {
+		res = 0;
+	}
+
+	return res;
+}
+
+/**
+ * @brief Writes a data block into flash memory. In a bank mass erased since reset, whole
+ * 		  rows that start on a row boundary are written with fast programming, the
+ * 		  unaligned head and the tail with the double-word sequence. After a page erase the
+ * 		  whole block takes the double-word sequence. The destination must be erased.
+ * @param start_addr : Starting address (double-word aligned) from which the data are going to be stored into.
+ * @param str		 : The buffer which holds the data.
+ * @param len		 : The length of the data.
+ * @retval 1 if the block is programmed successfully, 0 otherwise.
+ */
+uint16_t bl_flash_program(uint32_t start_addr, const uint8_t *str, uint16_t len)
+{
+	uint64_t row[FLASH_ROW_DWORDS];
+	uint32_t addr = start_addr;
+	uint32_t i = 0;
+	uint32_t span;
+
+	while (i < len) {
+		if ((addr % FLASH_ROW_SIZE) == 0 && (len - i) >= FLASH_ROW_SIZE &&
+			(bl_flash_fast_banks & (1U << bl_flash_get_bank(addr)))) {
+			/*Whole row, use fast programming*/
+			memcpy(row, str + i, FLASH_ROW_SIZE);
+			if (!bl_flash_program_row(addr, row)) {
+				return 0;
+			}
+			span = FLASH_ROW_SIZE;
+		} else {
+			/*Program up to the next row boundary, or the end of the block*/
+			span = FLASH_ROW_SIZE - (addr % FLASH_ROW_SIZE);
+			if (span > (len - i)) {
+				span = len - i;
+			}
+			if (!bl_flash_program_dwords(addr, str + i, span)) {
+				return 0;
+			}
+			/*Keep the next span double-word aligned after a padded tail*/
+			span = (span + 7U) & ~7U;
+		}
+
+		addr += span;
+		i += span;
 	}
+
+	return 1;
 }
 
 /**
@@ -319,3 +571,64 @@ uint32_t bl_flash_get_bank(uint32_t addr)
 	return bank;
 }
 
+/**
+ * @brief Gets the address of the data region (FLASH_DATA_SIZE bytes at the top of the
+ * 		  physical bank 2). The region stays in the same bank across bank swaps, so the
+ * 		  data survive a firmware update. The application images never reach it.
+ * @retval The address the data region is mapped at.
+ */
+uint32_t bl_flash_data_base(void)
+{
+	uint32_t bank2;
+
+	/*Bank 2 is mapped at FLASH_BASE when the banks are swapped*/
+	if ((SYSCFG->MEMRMP & SYSCFG_MEMRMP_FB_MODE) == 0)
+	{
+		bank2 = FLASH_BASE + FLASH_BANK_SIZE;
+	}
+	else
+	{
+		bank2 = FLASH_BASE;
+	}
+
+	return bank2 + FLASH_BANK_SIZE - FLASH_DATA_SIZE;
+}
+
+/**
+ * @brief Toggles the BFB2 option bit, so that the next boot runs from the other bank,
+ * 		  and reloads the option bytes. The reload resets the device, so on success this
+ * 		  function does not return.
+ * @retval 0 if the option bytes could not be unlocked.
+ */
+uint16_t bl_flash_swap_bank(void)
+{
+	/*The option bytes need the flash memory unlocked first*/
+	bl_flash_unlock();
+
+	/*Unlock sequence to OPTKEYR register*/
+	if (READ_BIT(FLASH->CR, FLASH_CR_OPTLOCK)) {
+		FLASH->OPTKEYR = 0x08192A3B;
+		FLASH->OPTKEYR = 0x4C5D6E7F;
+	}
+
+	/*Wait if any flash memory operation is ongoing*/
+	BL_FLASH_WAIT_BSY();
+
+	if (READ_BIT(FLASH->CR, FLASH_CR_OPTLOCK)) {
+		return 0;
+	}
+
+	bl_flash_check_errors();
+
+	/*Boot from the other bank*/
+	FLASH->OPTR ^= FLASH_OPTR_BFB2;
+
+	/*Program the option bytes*/
+	SET_BIT(FLASH->CR, FLASH_CR_OPTSTRT);
+	BL_FLASH_WAIT_BSY();
+
+	/*Reload the option bytes, this generates a system reset*/
+	SET_BIT(FLASH->CR, FLASH_CR_OBL_LAUNCH);
+
+	return 1;
+}
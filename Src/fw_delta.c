@@ -0,0 +1,241 @@
+/*
+ * fw_delta.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ *
+ *  The whole working set is fw_delta_ctx_t: a FW_DELTA_IN_SIZE window of the patch
+ *  and one flash page of output. The running image is read in place from the flash.
+ */
+
+
+#include "fw_delta.h"
+
+
+/**
+ * @brief State of a patch being applied.
+ */
+typedef struct fw_delta_ctx_ {
+	lfs_t *lfs;
+	lfs_file_t *file;
+	uint8_t in[FW_DELTA_IN_SIZE];	/*Window of the patch file*/
+	uint32_t in_pos;
+	uint32_t in_len;
+	uint8_t out[FLASH_PG_SIZE];		/*Next page of the new image*/
+	uint32_t out_pos;
+	uint32_t written;				/*Bytes of the new image already in flash*/
+	uint32_t size;					/*Size of the new image*/
+	const uint8_t *old;				/*Running image*/
+	uint32_t old_size;
+	fw_update_err_t err;
+}fw_delta_ctx_t;
+
+static fw_delta_ctx_t fw_delta;
+
+
+/**
+ * @brief Returns the next byte of the patch, refilling the window when needed.
+ * @retval The byte, or -1 at the end of the file / on a read error.
+ */
+static int fw_delta_getc(fw_delta_ctx_t *ctx)
+{
+	lfs_ssize_t res;
+
+	if (ctx->in_pos == ctx->in_len) {
+		res = lfs_file_read(ctx->lfs, ctx->file, ctx->in, sizeof(ctx->in));
+		if (res <= 0) {
+			ctx->err = FW_UPDATE_ERR_IO;
+			return -1;
+		}
+		ctx->in_pos = 0;
+		ctx->in_len = (uint32_t)res;
+	}
+
+	return ctx->in[ctx->in_pos++];
+}
+
+/**
+ * @brief Decodes an unsigned LEB128 varint.
+ * @retval 1 on success, 0 on a truncated or oversized value.
+ */
+static uint16_t fw_delta_varint(fw_delta_ctx_t *ctx, uint32_t *value)
+{
+	int c;
+
+	*value = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 7) {
+		c = fw_delta_getc(ctx);
+		if (c < 0) {
+			return 0;
+		}
+		*value |= (uint32_t)(c & 0x7F) << shift;
+		if (!(c & 0x80)) {
+			return 1;
+		}
+	}
+
+	ctx->err = FW_UPDATE_ERR_HEADER;
+	return 0;
+}
+
+/**
+ * @brief Erases the next page of the inactive bank and programs the output buffer into it.
+ * @retval 1 on success, 0 otherwise.
+ */
+static uint16_t fw_delta_flush(fw_delta_ctx_t *ctx)
+{
+	uint32_t addr = FW_UPDATE_BANK_ADDR + ctx->written;
+
+	if (ctx->out_pos == 0) {
+		return 1;
+	}
+
+	if (!bl_flash_page_erase(bl_flash_get_page(addr), bl_flash_get_bank(addr)) ||
+		!bl_flash_program(addr, ctx->out, ctx->out_pos)) {
+		ctx->err = FW_UPDATE_ERR_FLASH;
+		return 0;
+	}
+
+	ctx->written += ctx->out_pos;
+	ctx->out_pos = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Appends a byte of the new image, flushing every full page.
+ * @retval 1 on success, 0 otherwise.
+ */
+static uint16_t fw_delta_putc(fw_delta_ctx_t *ctx, uint8_t byte)
+{
+	if (ctx->written + ctx->out_pos >= ctx->size) {
+		/*The patch produces more than the header announced*/
+		ctx->err = FW_UPDATE_ERR_HEADER;
+		return 0;
+	}
+
+	ctx->out[ctx->out_pos++] = byte;
+
+	if (ctx->out_pos == sizeof(ctx->out)) {
+		return fw_delta_flush(ctx);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Executes the op stream until FW_DELTA_OP_END.
+ * @retval 1 on success, 0 otherwise (ctx->err holds the reason).
+ */
+static uint16_t fw_delta_run(fw_delta_ctx_t *ctx)
+{
+	uint32_t off;
+	uint32_t len;
+	int op;
+	int c;
+
+	while (1) {
+		op = fw_delta_getc(ctx);
+		if (op < 0) {
+			return 0;
+		}
+
+		if (op == FW_DELTA_OP_END) {
+			return fw_delta_flush(ctx);
+		}
+
+		if (op == FW_DELTA_OP_COPY || op == FW_DELTA_OP_ADD) {
+			if (!fw_delta_varint(ctx, &off) || !fw_delta_varint(ctx, &len)) {
+				return 0;
+			}
+			if (off > ctx->old_size || len > ctx->old_size - off) {
+				ctx->err = FW_UPDATE_ERR_HEADER;
+				return 0;
+			}
+			for (uint32_t i = 0; i < len; i++) {
+				c = 0;
+				if (op == FW_DELTA_OP_ADD && (c = fw_delta_getc(ctx)) < 0) {
+					return 0;
+				}
+				if (!fw_delta_putc(ctx, (uint8_t)(ctx->old[off + i] + c))) {
+					return 0;
+				}
+			}
+		} else if (op == FW_DELTA_OP_INSERT) {
+			if (!fw_delta_varint(ctx, &len)) {
+				return 0;
+			}
+			for (uint32_t i = 0; i < len; i++) {
+				if ((c = fw_delta_getc(ctx)) < 0 || !fw_delta_putc(ctx, (uint8_t)c)) {
+					return 0;
+				}
+			}
+		} else {
+			/*Unknown op*/
+			ctx->err = FW_UPDATE_ERR_HEADER;
+			return 0;
+		}
+	}
+}
+
+/**
+ * @brief Rebuilds a new image from a patch and the running bank, into the inactive bank.
+ * 		  The running image must match the one the patch was made against (size and CRC).
+ * 		  Activate the result with fw_update_activate().
+ * @param lfs  : Mounted littlefs instance that holds the patch.
+ * @param path : Path of the patch file.
+ * @param hdr  : Filled with the header of the new image.
+ * @retval FW_UPDATE_OK if the inactive bank holds the new image and its CRC matches.
+ */
+fw_update_err_t fw_delta_apply(lfs_t *lfs, const char *path, fw_image_hdr_t *hdr)
+{
+	fw_delta_ctx_t *ctx = &fw_delta;
+	fw_delta_hdr_t dhdr;
+	lfs_file_t file;
+
+	/*Open the patch*/
+	if (lfs_file_open(lfs, &file, path, LFS_O_RDONLY) < 0) {
+		return FW_UPDATE_ERR_IO;
+	}
+
+	if (lfs_file_read(lfs, &file, &dhdr, sizeof(dhdr)) != sizeof(dhdr)) {
+		lfs_file_close(lfs, &file);
+		return FW_UPDATE_ERR_IO;
+	}
+
+	/*The patch must target the running image and produce something that fits a bank*/
+	if (dhdr.magic != FW_DELTA_MAGIC || dhdr.image.magic != FW_UPDATE_MAGIC ||
+		dhdr.old_size > FW_UPDATE_MAX_SIZE || dhdr.image.size == 0 ||
+		dhdr.image.size > FW_UPDATE_MAX_SIZE ||
+		lfs_crc(0xFFFFFFFF, BL_FLASH_PTR(FLASH_BASE), dhdr.old_size) != dhdr.old_crc) {
+		lfs_file_close(lfs, &file);
+		return FW_UPDATE_ERR_HEADER;
+	}
+
+	*hdr = dhdr.image;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->lfs      = lfs;
+	ctx->file     = &file;
+	ctx->size     = dhdr.image.size;
+	ctx->old      = BL_FLASH_PTR(FLASH_BASE);
+	ctx->old_size = dhdr.old_size;
+	ctx->err      = FW_UPDATE_OK;
+
+	bl_flash_unlock();
+	fw_delta_run(ctx);
+	bl_flash_lock();
+
+	lfs_file_close(lfs, &file);
+
+	if (ctx->err != FW_UPDATE_OK) {
+		return ctx->err;
+	}
+
+	/*The op stream must have produced the whole image*/
+	if (ctx->written != ctx->size || !fw_update_verify(hdr)) {
+		return FW_UPDATE_ERR_CRC;
+	}
+
+	return FW_UPDATE_OK;
+}
@@ -0,0 +1,153 @@
+/*
+ * fw_update.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "fw_update.h"
+
+
+/*Ping-pong buffers, one is programmed while the other one is filled from littlefs*/
+static uint8_t fw_chunk[2][FW_UPDATE_CHUNK_SIZE];
+
+
+/**
+ * @brief Reads the next chunk of the image from littlefs.
+ * @retval The number of bytes read, or a negative littlefs error.
+ */
+static lfs_ssize_t fw_update_fetch(lfs_t *lfs, lfs_file_t *file, uint8_t *buf, uint32_t remaining)
+{
+	lfs_size_t size = (remaining < FW_UPDATE_CHUNK_SIZE) ? remaining : FW_UPDATE_CHUNK_SIZE;
+	lfs_ssize_t res = lfs_file_read(lfs, file, buf, size);
+
+	if (res >= 0 && (lfs_size_t)res != size) {
+		/*Truncated image*/
+		return LFS_ERR_CORRUPT;
+	}
+
+	return res;
+}
+
+/**
+ * @brief Streams an image from a littlefs file into the inactive bank.
+ *
+ * The loop works one flash page at a time. The erase of the page under the write pointer
+ * is started first, and while the controller is busy (the CPU keeps executing from the
+ * running bank) the next chunk is read from the external flash. Then the current chunk is
+ * programmed. With a 2KB page the SPI transfer is hidden behind the erase time.
+ *
+ * @param lfs  : Mounted littlefs instance that holds the image.
+ * @param path : Path of the image file.
+ * @param hdr  : Filled with the header of the image.
+ * @retval FW_UPDATE_OK if the inactive bank holds the image and its CRC matches.
+ */
+fw_update_err_t fw_update_install(lfs_t *lfs, const char *path, fw_image_hdr_t *hdr)
+{
+	fw_update_err_t err = FW_UPDATE_OK;
+	lfs_file_t file;
+	uint32_t addr;
+	uint32_t done = 0;
+	uint32_t len;
+	lfs_ssize_t res;
+	int cur = 0;
+
+	/*Open the image*/
+	if (lfs_file_open(lfs, &file, path, LFS_O_RDONLY) < 0) {
+		return FW_UPDATE_ERR_IO;
+	}
+
+	/*Read and check the header*/
+	res = lfs_file_read(lfs, &file, hdr, sizeof(*hdr));
+	if (res != sizeof(*hdr)) {
+		lfs_file_close(lfs, &file);
+		return FW_UPDATE_ERR_IO;
+	}
+
+	if (hdr->magic != FW_UPDATE_MAGIC || hdr->size == 0 || hdr->size > FW_UPDATE_MAX_SIZE ||
+		(lfs_soff_t)(hdr->size + sizeof(*hdr)) > lfs_file_size(lfs, &file)) {
+		lfs_file_close(lfs, &file);
+		return FW_UPDATE_ERR_HEADER;
+	}
+
+	/*Prime the pipeline with the first chunk*/
+	res = fw_update_fetch(lfs, &file, fw_chunk[cur], hdr->size);
+	if (res < 0) {
+		lfs_file_close(lfs, &file);
+		return FW_UPDATE_ERR_IO;
+	}
+
+	bl_flash_unlock();
+
+	while (done < hdr->size) {
+		addr = FW_UPDATE_BANK_ADDR + done;
+		len  = (uint32_t)res;
+
+		/*Erase the page under the write pointer, without waiting for it*/
+		if (!bl_flash_page_erase_start(bl_flash_get_page(addr), bl_flash_get_bank(addr))) {
+			err = FW_UPDATE_ERR_FLASH;
+			break;
+		}
+
+		/*Meanwhile, fetch the next chunk over SPI*/
+		if (done + len < hdr->size) {
+			res = fw_update_fetch(lfs, &file, fw_chunk[cur ^ 1], hdr->size - (done + len));
+			if (res < 0) {
+				bl_flash_end_op();
+				err = FW_UPDATE_ERR_IO;
+				break;
+			}
+		}
+
+		/*Finish the erase and program the current chunk*/
+		if (!bl_flash_end_op() || !bl_flash_program(addr, fw_chunk[cur], len)) {
+			err = FW_UPDATE_ERR_FLASH;
+			break;
+		}
+
+		done += len;
+		cur ^= 1;
+	}
+
+	bl_flash_lock();
+	lfs_file_close(lfs, &file);
+
+	if (err != FW_UPDATE_OK) {
+		return err;
+	}
+
+	/*Check what really ended up into the bank*/
+	if (!fw_update_verify(hdr)) {
+		return FW_UPDATE_ERR_CRC;
+	}
+
+	return FW_UPDATE_OK;
+}
+
+/**
+ * @brief Computes the CRC of the inactive bank, over the size given by the header.
+ * @retval 1 if it matches the header, 0 otherwise.
+ */
+uint16_t fw_update_verify(const fw_image_hdr_t *hdr)
+{
+	uint32_t crc;
+
+	if (hdr->size > FW_UPDATE_MAX_SIZE) {
+		return 0;
+	}
+
+	crc = lfs_crc(0xFFFFFFFF, BL_FLASH_PTR(FW_UPDATE_BANK_ADDR), hdr->size);
+
+	return (crc == hdr->crc) ? 1 : 0;
+}
+
+/**
+ * @brief Boots into the bank written by fw_update_install(). Call it only after a
+ * 		  successful install, it resets the device.
+ * @retval 0 if the option bytes could not be programmed.
+ */
+uint16_t fw_update_activate(void)
+{
+	return bl_flash_swap_bank();
+}
@@ -26,6 +26,30 @@ enum {
 };
 
 
+/// Statistics (LFS_STATS), nothing is compiled in without it ///
+#ifdef LFS_STATS
+#define LFS_STATS_ADD(lfs, field, n) ((lfs)->stats.field += (n))
+#define LFS_STATS_BEGIN() uint32_t lfs_stats_t0 = LFS_STATS_NOW()
+#define LFS_STATS_END(lfs, op) \
+    lfs_stats_record(lfs, op, LFS_STATS_NOW() - lfs_stats_t0)
+
+static void lfs_stats_record(lfs_t *lfs, enum lfs_stats_op op, uint32_t us) {
+    // log2 bucket, [2^(i-1), 2^i) us
+    uint32_t bucket = us ? lfs_npw2(us + 1) : 0;
+    bucket = lfs_min(bucket, LFS_STATS_BUCKETS-1);
+
+    lfs->stats.calls[op] += 1;
+    lfs->stats.total_us[op] += us;
+    lfs->stats.max_us[op] = lfs_max(lfs->stats.max_us[op], us);
+    lfs->stats.hist[op][bucket] += 1;
+}
+#else
+#define LFS_STATS_ADD(lfs, field, n)
+#define LFS_STATS_BEGIN()
+#define LFS_STATS_END(lfs, op)
+#endif
+
+
 /// Caching block device operations ///
 
 static inline void lfs_cache_drop(lfs_t *lfs, lfs_cache_t *rcache) {
@@ -41,7 +65,7 @@ static inline void lfs_cache_zero(lfs_t *lfs, lfs_cache_t *pcache) {
     pcache->block = LFS_BLOCK_NULL;
 }
 
-static int lfs_bd_read(lfs_t *lfs,
+LFS_RAMFUNC static int lfs_bd_read(lfs_t *lfs,
         const lfs_cache_t *pcache, lfs_cache_t *rcache, lfs_size_t hint,
         lfs_block_t block, lfs_off_t off,
         void *buffer, lfs_size_t size) {
@@ -50,6 +74,8 @@ static int lfs_bd_read(lfs_t *lfs,
             || (lfs->block_count && block >= lfs->block_count)) {
         return LFS_ERR_CORRUPT;
     }
+    LFS_STATS_ADD(lfs, read_calls, 1);
+    LFS_STATS_ADD(lfs, read_bytes, size);
 
     while (size > 0) {
         lfs_size_t diff = size;
@@ -60,6 +86,7 @@ static int lfs_bd_read(lfs_t *lfs,
                 // is already in pcache?
                 diff = lfs_min(diff, pcache->size - (off-pcache->off));
                 memcpy(data, &pcache->buffer[off-pcache->off], diff);
+                LFS_STATS_ADD(lfs, read_pcache_hits, 1);
 
                 data += diff;
                 off += diff;
@@ -77,6 +104,7 @@ static int lfs_bd_read(lfs_t *lfs,
                 // is already in rcache?
                 diff = lfs_min(diff, rcache->size - (off-rcache->off));
                 memcpy(data, &rcache->buffer[off-rcache->off], diff);
+                LFS_STATS_ADD(lfs, read_rcache_hits, 1);
 
                 data += diff;
                 off += diff;
@@ -96,6 +124,8 @@ static int lfs_bd_read(lfs_t *lfs,
             if (err) {
                 return err;
             }
+            LFS_STATS_ADD(lfs, read_bypasses, 1);
+            LFS_STATS_ADD(lfs, read_dev_bytes, diff);
 
             data += diff;
             off += diff;
@@ -119,6 +149,8 @@ static int lfs_bd_read(lfs_t *lfs,
         if (err) {
             return err;
         }
+        LFS_STATS_ADD(lfs, read_fills, 1);
+        LFS_STATS_ADD(lfs, read_dev_bytes, rcache->size);
     }
 
     return 0;
@@ -130,6 +162,8 @@ static int lfs_bd_cmp(lfs_t *lfs,
         const void *buffer, lfs_size_t size) {
     const uint8_t *data = buffer;
     lfs_size_t diff = 0;
+    LFS_STATS_ADD(lfs, cmp_calls, 1);
+    LFS_STATS_ADD(lfs, cmp_bytes, size);
 
     for (lfs_off_t i = 0; i < size; i += diff) {
         uint8_t dat[8];
@@ -175,15 +209,22 @@ static int lfs_bd_crc(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_bd_flush(lfs_t *lfs,
         lfs_cache_t *pcache, lfs_cache_t *rcache, bool validate) {
+    LFS_STATS_ADD(lfs, flush_calls, 1);
     if (pcache->block != LFS_BLOCK_NULL && pcache->block != LFS_BLOCK_INLINE) {
         LFS_ASSERT(pcache->block < lfs->block_count);
         lfs_size_t diff = lfs_alignup(pcache->size, lfs->cfg->prog_size);
+        // a block erased in advance by lfs_fs_gcstep is no longer erased
+        if (pcache->block == lfs->gc.erased) {
+            lfs->gc.erased = LFS_BLOCK_NULL;
+        }
         int err = lfs->cfg->prog(lfs->cfg, pcache->block,
                 pcache->off, pcache->buffer, diff);
         LFS_ASSERT(err <= 0);
         if (err) {
             return err;
         }
+        LFS_STATS_ADD(lfs, flush_progs, 1);
+        LFS_STATS_ADD(lfs, flush_bytes, diff);
 
         if (validate) {
             // check data on disk
@@ -210,6 +251,7 @@ static int lfs_bd_flush(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_bd_sync(lfs_t *lfs,
         lfs_cache_t *pcache, lfs_cache_t *rcache, bool validate) {
+    LFS_STATS_ADD(lfs, sync_calls, 1);
     lfs_cache_drop(lfs, rcache);
 
     int err = lfs_bd_flush(lfs, pcache, rcache, validate);
@@ -231,6 +273,8 @@ static int lfs_bd_prog(lfs_t *lfs,
     const uint8_t *data = buffer;
     LFS_ASSERT(block == LFS_BLOCK_INLINE || block < lfs->block_count);
     LFS_ASSERT(off + size <= lfs->cfg->block_size);
+    LFS_STATS_ADD(lfs, prog_calls, 1);
+    LFS_STATS_ADD(lfs, prog_bytes, size);
 
     while (size > 0) {
         if (block == pcache->block &&
@@ -274,12 +318,22 @@ static int lfs_bd_prog(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_bd_erase(lfs_t *lfs, lfs_block_t block) {
     LFS_ASSERT(block < lfs->block_count);
+    LFS_STATS_ADD(lfs, erase_calls, 1);
     int err = lfs->cfg->erase(lfs->cfg, block);
     LFS_ASSERT(err <= 0);
     return err;
 }
 #endif
 
+#ifndef LFS_READONLY
+// the metadata list changed, a block of the pair lfs_fs_gcstep was about to
+// visit may have been freed, so restart its walk from the superblock
+static void lfs_fs_gcrewind(lfs_t *lfs) {
+    lfs->gc.tail[0] = 0;
+    lfs->gc.tail[1] = 1;
+}
+#endif
+
 
 /// Small type-level utilities ///
 // operations on block pairs
@@ -471,6 +525,51 @@ static void lfs_ctz_tole32(struct lfs_ctz *ctz) {
 }
 #endif
 
+// attribute of a compressed file
+struct lfs_zattr {
+    lfs_size_t chunk;
+    lfs_size_t size;
+    lfs_off_t tail;
+};
+
+static void lfs_zattr_fromle32(struct lfs_zattr *zattr) {
+    zattr->chunk = lfs_fromle32(zattr->chunk);
+    zattr->size = lfs_fromle32(zattr->size);
+    zattr->tail = lfs_fromle32(zattr->tail);
+}
+
+#if !defined(LFS_READONLY) && !defined(LFS_NO_COMPRESS)
+static void lfs_zattr_tole32(struct lfs_zattr *zattr) {
+    zattr->chunk = lfs_tole32(zattr->chunk);
+    zattr->size = lfs_tole32(zattr->size);
+    zattr->tail = lfs_tole32(zattr->tail);
+}
+#endif
+
+#ifndef LFS_READONLY
+// the attribute an open file commits with its struct, false if the file
+// isn't compressed
+static bool lfs_file_zattr(const lfs_file_t *file, struct lfs_zattr *zattr) {
+#ifndef LFS_NO_COMPRESS
+    if (file->z.chunk) {
+        *zattr = (struct lfs_zattr){
+                file->z.chunk, file->z.size, file->z.tail};
+        lfs_zattr_tole32(zattr);
+        return true;
+    }
+#else
+    (void)file;
+    (void)zattr;
+#endif
+    return false;
+}
+#endif
+
+// custom attribute types littlefs keeps for itself
+static inline bool lfs_attr_isreserved(uint8_t type) {
+    return type == LFS_TXN_ATTR || type == LFS_ZATTR;
+}
+
 static inline void lfs_superblock_fromle32(lfs_superblock_t *superblock) {
     superblock->version     = lfs_fromle32(superblock->version);
     superblock->block_size  = lfs_fromle32(superblock->block_size);
@@ -555,6 +654,7 @@ static lfs_ssize_t lfs_file_write_(lfs_t *lfs, lfs_file_t *file,
 static int lfs_file_sync_(lfs_t *lfs, lfs_file_t *file);
 static int lfs_file_outline(lfs_t *lfs, lfs_file_t *file);
 static int lfs_file_flush(lfs_t *lfs, lfs_file_t *file);
+static int lfs_file_zflush(lfs_t *lfs, lfs_file_t *file);
 
 static int lfs_fs_deorphan(lfs_t *lfs, bool powerloss);
 static int lfs_fs_preporphans(lfs_t *lfs, int8_t orphans);
@@ -565,6 +665,8 @@ static int lfs_fs_pred(lfs_t *lfs, const lfs_block_t dir[2],
 static lfs_stag_t lfs_fs_parent(lfs_t *lfs, const lfs_block_t dir[2],
         lfs_mdir_t *parent);
 static int lfs_fs_forceconsistency(lfs_t *lfs);
+static int lfs_fs_txnreplay(lfs_t *lfs);
+static lfs_tag_t lfs_txn_tag(const uint8_t *journal, lfs_size_t off);
 #endif
 
 static void lfs_fs_prepsuperblock(lfs_t *lfs, bool needssuperblock);
@@ -582,6 +684,7 @@ static lfs_ssize_t lfs_file_read_(lfs_t *lfs, lfs_file_t *file,
         void *buffer, lfs_size_t size);
 static int lfs_file_close_(lfs_t *lfs, lfs_file_t *file);
 static lfs_soff_t lfs_file_size_(lfs_t *lfs, lfs_file_t *file);
+static int lfs_file_zopen(lfs_t *lfs, lfs_file_t *file);
 
 static lfs_ssize_t lfs_fs_size_(lfs_t *lfs);
 static int lfs_fs_traverse_(lfs_t *lfs,
@@ -645,12 +748,20 @@ static int lfs_alloc_scan(lfs_t *lfs) {
         return err;
     }
 
+    // blocks in the reservoir are free, but the lookahead must not hand
+    // them out, lfs_alloc_erased takes them first and lfs_alloc only once
+    // the lookahead has nothing left
+    for (lfs_size_t i = 0; i < lfs->reserve.count; i++) {
+        lfs_alloc_lookahead(lfs, lfs->reserve.buffer[i].block);
+    }
+
     return 0;
 }
 #endif
 
 #ifndef LFS_READONLY
-static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
+// allocate a free block from the lookahead, never from the reservoir
+static int lfs_alloc_free(lfs_t *lfs, lfs_block_t *block) {
     while (true) {
         // scan our lookahead buffer for free blocks
         while (lfs->lookahead.next < lfs->lookahead.size) {
@@ -686,9 +797,6 @@ static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
         // the filesystem as out of storage.
         //
         if (lfs->lookahead.ckpoint <= 0) {
-            LFS_ERROR("No more free space 0x%"PRIx32,
-                    (lfs->lookahead.start + lfs->lookahead.next)
-                        % lfs->block_count);
             return LFS_ERR_NOSPC;
         }
 
@@ -702,6 +810,112 @@ static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
 }
 #endif
 
+#ifndef LFS_READONLY
+static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
+    int err = lfs_alloc_free(lfs, block);
+    if (err != LFS_ERR_NOSPC) {
+        return err;
+    }
+
+    // the last free blocks may be in the reservoir, a near full filesystem
+    // gives them back rather than fail, the caller erases the block anyway
+    if (lfs->reserve.count > 0) {
+        lfs->reserve.count -= 1;
+        *block = lfs->reserve.buffer[lfs->reserve.count].block;
+        if (lfs->rcache.block == *block) {
+            lfs_cache_drop(lfs, &lfs->rcache);
+        }
+        return 0;
+    }
+
+    LFS_ERROR("No more free space 0x%"PRIx32,
+            (lfs->lookahead.start + lfs->lookahead.next)
+                % lfs->block_count);
+    return LFS_ERR_NOSPC;
+}
+#endif
+
+#ifndef LFS_READONLY
+// allocate a block the caller is about to erase, taking it from the
+// reservoir first, erased is set if the block still reads back as it did
+// after its erase and the caller can skip the erase
+static int lfs_alloc_erased(lfs_t *lfs, lfs_block_t *block, bool *erased) {
+    *erased = false;
+    if (lfs->reserve.count == 0) {
+        return lfs_alloc(lfs, block);
+    }
+
+    lfs->reserve.count -= 1;
+    struct lfs_reserved *r = &lfs->reserve.buffer[lfs->reserve.count];
+    *block = r->block;
+
+    // a cheap check of the erased state, the same one an fcrc does
+    uint32_t crc = 0xffffffff;
+    int err = lfs_bd_crc(lfs,
+            NULL, &lfs->rcache, lfs->cfg->prog_size,
+            r->block, 0, lfs->cfg->prog_size, &crc);
+    if (err && err != LFS_ERR_CORRUPT) {
+        return err;
+    }
+    *erased = (!err && crc == r->crc);
+
+    // the caller is going to write it, don't leave it in our cache
+    if (lfs->rcache.block == r->block) {
+        lfs_cache_drop(lfs, &lfs->rcache);
+    }
+
+    return 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+// erase a free block into the reservoir, returns 1 if it added one, 0 if
+// the reservoir is full, there are no free blocks left or the block is bad
+static int lfs_alloc_reserve(lfs_t *lfs) {
+    if (lfs->reserve.count >= lfs->cfg->reserve_count) {
+        return 0;
+    }
+
+    // this is only called between operations, when every allocated block
+    // is tracked by the filesystem or an open file
+    lfs_alloc_ckpoint(lfs);
+
+    // never from the reservoir itself
+    lfs_block_t block;
+    int err = lfs_alloc_free(lfs, &block);
+    if (err) {
+        return (err == LFS_ERR_NOSPC) ? 0 : err;
+    }
+
+    if (lfs->rcache.block == block) {
+        lfs_cache_drop(lfs, &lfs->rcache);
+    }
+
+    err = lfs_bd_erase(lfs, block);
+    if (err) {
+        // a bad block stays free, the write that allocates it relocates;
+        // stop here, the next free block may well be the same one
+        return (err == LFS_ERR_CORRUPT) ? 0 : err;
+    }
+
+    // remember what the start of the erased block reads as
+    uint32_t crc = 0xffffffff;
+    err = lfs_bd_crc(lfs,
+            NULL, &lfs->rcache, lfs->cfg->prog_size,
+            block, 0, lfs->cfg->prog_size, &crc);
+    if (err) {
+        return (err == LFS_ERR_CORRUPT) ? 0 : err;
+    }
+
+    lfs->reserve.buffer[lfs->reserve.count] = (struct lfs_reserved){
+        .block = block,
+        .crc = crc,
+    };
+    lfs->reserve.count += 1;
+    return 1;
+}
+#endif
+
 /// Metadata pair and directory operations ///
 static lfs_stag_t lfs_dir_getslice(lfs_t *lfs, const lfs_mdir_t *dir,
         lfs_tag_t gmask, lfs_tag_t gtag,
@@ -1428,6 +1642,20 @@ static int lfs_dir_getinfo(lfs_t *lfs, lfs_mdir_t *dir,
         info->size = lfs_tag_size(tag);
     }
 
+    // a compressed file reports the size of its data, not of its frames
+    if (info->type == LFS_TYPE_REG) {
+        struct lfs_zattr zattr;
+        tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x7ff, 0x3ff, 0),
+                LFS_MKTAG(LFS_TYPE_USERATTR + LFS_ZATTR, id, sizeof(zattr)),
+                &zattr);
+        if (tag >= 0) {
+            lfs_zattr_fromle32(&zattr);
+            info->size = zattr.size;
+        } else if (tag != LFS_ERR_NOENT) {
+            return (int)tag;
+        }
+    }
+
     return 0;
 }
 
@@ -1924,6 +2152,8 @@ static bool lfs_dir_needsrelocation(lfs_t *lfs, lfs_mdir_t *dir) {
 static int lfs_dir_compact(lfs_t *lfs,
         lfs_mdir_t *dir, const struct lfs_mattr *attrs, int attrcount,
         lfs_mdir_t *source, uint16_t begin, uint16_t end) {
+    LFS_STATS_ADD(lfs, compact_calls, 1);
+
     // save some state in case block is bad
     bool relocated = false;
     bool tired = lfs_dir_needsrelocation(lfs, dir);
@@ -1949,6 +2179,7 @@ static int lfs_dir_compact(lfs_t *lfs,
     }
 
     // begin loop to commit compaction to blocks until a compact sticks
+    bool erased = false;
     while (true) {
         {
             // setup commit state
@@ -1963,8 +2194,16 @@ static int lfs_dir_compact(lfs_t *lfs,
                     lfs->cfg->metadata_max : lfs->cfg->block_size) - 8,
             };
 
-            // erase block to write to
-            int err = lfs_bd_erase(lfs, dir->pair[1]);
+            // erase block to write to, unless lfs_fs_gcstep erased it in
+            // advance and nothing was programmed to it since, or it came
+            // erased from the reservoir
+            int err = 0;
+            if (dir->pair[1] == lfs->gc.erased) {
+                lfs->gc.erased = LFS_BLOCK_NULL;
+            } else if (!erased) {
+                err = lfs_bd_erase(lfs, dir->pair[1]);
+            }
+            erased = false;
             if (err) {
                 if (err == LFS_ERR_CORRUPT) {
                     goto relocate;
@@ -2056,6 +2295,10 @@ static int lfs_dir_compact(lfs_t *lfs,
             dir->count = end - begin;
             dir->off = commit.off;
             dir->etag = commit.ptag;
+            // the rest of the block is erased, a refetch would find the
+            // same, so the next commit appends even if we were asked to
+            // compact through erased = false
+            dir->erased = true;
             // update gstate
             lfs->gdelta = (lfs_gstate_t){0};
             if (!relocated) {
@@ -2068,6 +2311,7 @@ relocate:
         // commit was corrupted, drop caches and prepare to relocate block
         relocated = true;
         lfs_cache_drop(lfs, &lfs->pcache);
+        lfs_fs_gcrewind(lfs);
         if (!tired) {
             LFS_DEBUG("Bad block at 0x%"PRIx32, dir->pair[1]);
         }
@@ -2080,7 +2324,7 @@ relocate:
         }
 
         // relocate half of pair
-        int err = lfs_alloc(lfs, &dir->pair[1]);
+        int err = lfs_alloc_erased(lfs, &dir->pair[1], &erased);
         if (err && (err != LFS_ERR_NOSPC || !tired)) {
             return err;
         }
@@ -2222,12 +2466,13 @@ static int lfs_dir_relocatingcommit(lfs_t *lfs, lfs_mdir_t *dir,
             dir->tail[1] = ((lfs_block_t*)attrs[i].buffer)[1];
             dir->split = (lfs_tag_chunk(attrs[i].tag) & 1);
             lfs_pair_fromle32(dir->tail);
+            lfs_fs_gcrewind(lfs);
         }
     }
 
-    // should we actually drop the directory block?
-    if (hasdelete && dir->count == 0) {
-        LFS_ASSERT(pdir);
+    // should we actually drop the directory block? not from the fix-ups
+    // of a relocation (no pdir), an emptied predecessor is kept as it is
+    if (hasdelete && dir->count == 0 && pdir) {
         int err = lfs_fs_pred(lfs, dir->pair, pdir);
         if (err && err != LFS_ERR_NOENT) {
             return err;
@@ -2570,22 +2815,18 @@ static int lfs_dir_orphaningcommit(lfs_t *lfs, lfs_mdir_t *dir,
 #ifndef LFS_READONLY
 static int lfs_dir_commit(lfs_t *lfs, lfs_mdir_t *dir,
         const struct lfs_mattr *attrs, int attrcount) {
-    int orphans = lfs_dir_orphaningcommit(lfs, dir, attrs, attrcount);
-    if (orphans < 0) {
-        return orphans;
-    }
-
-    if (orphans) {
+    LFS_PROF_BEGIN(PROF_LFS_COMMIT);
+    LFS_STATS_ADD(lfs, commit_calls, 1);
+    int err = lfs_dir_orphaningcommit(lfs, dir, attrs, attrcount);
+    if (err > 0) {
         // make sure we've removed all orphans, this is a noop if there
         // are none, but if we had nested blocks failures we may have
         // created some
-        int err = lfs_fs_deorphan(lfs, false);
-        if (err) {
-            return err;
-        }
+        err = lfs_fs_deorphan(lfs, false);
     }
 
-    return 0;
+    LFS_PROF_END(PROF_LFS_COMMIT);
+    return err;
 }
 #endif
 
@@ -2895,13 +3136,16 @@ static int lfs_ctz_extend(lfs_t *lfs,
     while (true) {
         // go ahead and grab a block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        bool erased;
+        int err = lfs_alloc_erased(lfs, &nblock, &erased);
         if (err) {
             return err;
         }
 
         {
-            err = lfs_bd_erase(lfs, nblock);
+            if (!erased) {
+                err = lfs_bd_erase(lfs, nblock);
+            }
             if (err) {
                 if (err == LFS_ERR_CORRUPT) {
                     goto relocate;
@@ -3051,9 +3295,19 @@ static int lfs_file_opencfg_(lfs_t *lfs, lfs_file_t *file,
     int err;
     file->cfg = cfg;
     file->flags = flags;
+#ifndef LFS_READONLY
+    if (!lfs->cfg->prog_rewrite) {
+        // the device can't program the unit a log ends in again
+        file->flags &= ~LFS_O_LOG;
+    }
+#endif
     file->pos = 0;
     file->off = 0;
     file->cache.buffer = NULL;
+#ifndef LFS_NO_COMPRESS
+    file->z.buffer = NULL;
+    file->z.chunk = 0;
+#endif
 
     // allocate entry for file if it doesn't exist
     lfs_stag_t tag = lfs_dir_find(lfs, &file->m, &path, &file->id);
@@ -3124,6 +3378,11 @@ static int lfs_file_opencfg_(lfs_t *lfs, lfs_file_t *file,
 
     // fetch attrs
     for (unsigned i = 0; i < file->cfg->attr_count; i++) {
+        if (lfs_attr_isreserved(file->cfg->attrs[i].type)) {
+            err = LFS_ERR_INVAL;
+            goto cleanup;
+        }
+
         // if opened for read / read-write operations
         if ((file->flags & LFS_O_RDONLY) == LFS_O_RDONLY) {
             lfs_stag_t res = lfs_dir_get(lfs, &file->m,
@@ -3187,6 +3446,12 @@ static int lfs_file_opencfg_(lfs_t *lfs, lfs_file_t *file,
         }
     }
 
+    // compressed file?
+    err = lfs_file_zopen(lfs, file);
+    if (err) {
+        goto cleanup;
+    }
+
     return 0;
 
 cleanup:
@@ -3222,6 +3487,12 @@ static int lfs_file_close_(lfs_t *lfs, lfs_file_t *file) {
         lfs_free(file->cache.buffer);
     }
 
+#ifndef LFS_NO_COMPRESS
+    if (!file->cfg->zbuffer) {
+        lfs_free(file->z.buffer);
+    }
+#endif
+
     return err;
 }
 
@@ -3231,12 +3502,15 @@ static int lfs_file_relocate(lfs_t *lfs, lfs_file_t *file) {
     while (true) {
         // just relocate what exists into new block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        bool erased;
+        int err = lfs_alloc_erased(lfs, &nblock, &erased);
         if (err) {
             return err;
         }
 
-        err = lfs_bd_erase(lfs, nblock);
+        if (!erased) {
+            err = lfs_bd_erase(lfs, nblock);
+        }
         if (err) {
             if (err == LFS_ERR_CORRUPT) {
                 goto relocate;
@@ -3297,6 +3571,32 @@ relocate:
 }
 #endif
 
+#ifndef LFS_READONLY
+// continue writing the last block of a log at off, the start of the
+// prog_size unit off is in is read back into the cache so the next flush
+// programs it again with the same bytes
+static int lfs_file_appendtail(lfs_t *lfs, lfs_file_t *file, lfs_off_t off) {
+    file->cache.block = file->block;
+    file->cache.off = lfs_aligndown(off, lfs->cfg->prog_size);
+    file->cache.size = off - file->cache.off;
+
+    if (lfs->rcache.block == file->block) {
+        lfs_cache_drop(lfs, &lfs->rcache);
+    }
+    int err = lfs_bd_read(lfs,
+            NULL, &lfs->rcache, file->cache.size,
+            file->block, file->cache.off,
+            file->cache.buffer, file->cache.size);
+    if (err) {
+        lfs_cache_zero(lfs, &file->cache);
+        return err;
+    }
+
+    file->off = off;
+    return 0;
+}
+#endif
+
 #ifndef LFS_READONLY
 static int lfs_file_outline(lfs_t *lfs, lfs_file_t *file) {
     file->off = file->pos;
@@ -3398,7 +3698,13 @@ static int lfs_file_sync_(lfs_t *lfs, lfs_file_t *file) {
         return 0;
     }
 
-    int err = lfs_file_flush(lfs, file);
+    int err = lfs_file_zflush(lfs, file);
+    if (err) {
+        file->flags |= LFS_F_ERRED;
+        return err;
+    }
+
+    err = lfs_file_flush(lfs, file);
     if (err) {
         file->flags |= LFS_F_ERRED;
         return err;
@@ -3436,9 +3742,16 @@ static int lfs_file_sync_(lfs_t *lfs, lfs_file_t *file) {
             size = sizeof(ctz);
         }
 
+        // a compressed file keeps where its data ends next to it
+        struct lfs_zattr zattr;
+        bool zip = lfs_file_zattr(file, &zattr);
+
         // commit file data and attributes
         err = lfs_dir_commit(lfs, &file->m, LFS_MKATTRS(
                 {LFS_MKTAG(type, file->id, size), buffer},
+                {LFS_MKTAG_IF(zip,
+                    LFS_TYPE_USERATTR + LFS_ZATTR, file->id,
+                    sizeof(zattr)), &zattr},
                 {LFS_MKTAG(LFS_FROM_USERATTRS, file->id,
                     file->cfg->attr_count), file->cfg->attrs}));
         if (err) {
@@ -3453,128 +3766,593 @@ static int lfs_file_sync_(lfs_t *lfs, lfs_file_t *file) {
 }
 #endif
 
-static lfs_ssize_t lfs_file_flushedread(lfs_t *lfs, lfs_file_t *file,
-        void *buffer, lfs_size_t size) {
-    uint8_t *data = buffer;
-    lfs_size_t nsize = size;
+#ifndef LFS_READONLY
+// files of a group sync that have something to commit
+static bool lfs_file_ingroup(const lfs_file_t *file) {
+    return !(file->flags & LFS_F_ERRED) && (file->flags & LFS_F_DIRTY) &&
+            !lfs_pair_isnull(file->m.pair);
+}
+
+// commit the files of a group that are in the metadata pair of dir, the
+// struct and user attributes of each, as one commit, optionally with the
+// removal of the journal when dir is the superblock pair
+static int lfs_file_groupcommit(lfs_t *lfs, lfs_file_t *const *files,
+        lfs_size_t count, lfs_mdir_t *dir, bool txn,
+        struct lfs_mattr *attrs, struct lfs_ctz *ctzs,
+        struct lfs_zattr *zattrs) {
+    int n = 0;
+    for (lfs_size_t i = 0; i < count; i++) {
+        lfs_file_t *f = files[i];
+        if (!lfs_file_ingroup(f) || lfs_pair_cmp(f->m.pair, dir->pair) != 0) {
+            continue;
+        }
 
-    if (file->pos >= file->ctz.size) {
-        // eof if past end
+        if (f->flags & LFS_F_INLINE) {
+            attrs[n++] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_TYPE_INLINESTRUCT, f->id, f->ctz.size),
+                    f->cache.buffer};
+        } else {
+            // copy ctz so alloc will work during a relocate
+            ctzs[i] = f->ctz;
+            lfs_ctz_tole32(&ctzs[i]);
+            attrs[n++] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_TYPE_CTZSTRUCT, f->id, sizeof(ctzs[i])),
+                    &ctzs[i]};
+        }
+        if (lfs_file_zattr(f, &zattrs[i])) {
+            attrs[n++] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_TYPE_USERATTR + LFS_ZATTR, f->id,
+                        sizeof(zattrs[i])),
+                    &zattrs[i]};
+        }
+        attrs[n++] = (struct lfs_mattr){
+                LFS_MKTAG(LFS_FROM_USERATTRS, f->id, f->cfg->attr_count),
+                f->cfg->attrs};
+    }
+
+    if (txn) {
+        attrs[n++] = (struct lfs_mattr){
+                LFS_MKTAG(LFS_TYPE_USERATTR + LFS_TXN_ATTR, 0, 0x3ff), NULL};
+    }
+
+    if (n == 0) {
         return 0;
     }
 
-    size = lfs_min(size, file->ctz.size - file->pos);
-    nsize = size;
+    // the files share the pair, committing through dir updates all of them
+    // in the mlist
+    lfs_block_t pair[2] = {dir->pair[0], dir->pair[1]};
+    int err = lfs_dir_commit(lfs, dir, attrs, n);
+    for (lfs_size_t i = 0; i < count; i++) {
+        lfs_file_t *f = files[i];
+        if (!lfs_file_ingroup(f) || (lfs_pair_cmp(f->m.pair, pair) != 0 &&
+                lfs_pair_cmp(f->m.pair, dir->pair) != 0)) {
+            continue;
+        }
 
-    while (nsize > 0) {
-        // check if we need a new block
-        if (!(file->flags & LFS_F_READING) ||
-                file->off == lfs->cfg->block_size) {
-            if (!(file->flags & LFS_F_INLINE)) {
-                int err = lfs_ctz_find(lfs, NULL, &file->cache,
-                        file->ctz.head, file->ctz.size,
-                        file->pos, &file->block, &file->off);
-                if (err) {
-                    return err;
-                }
-            } else {
-                file->block = LFS_BLOCK_INLINE;
-                file->off = file->pos;
-            }
+        if (err) {
+            f->flags |= LFS_F_ERRED;
+        } else {
+            f->flags &= ~LFS_F_DIRTY;
+        }
+    }
 
-            file->flags |= LFS_F_READING;
+    return err;
+}
+
+// path of an open file from the root, "/dir/name", built backwards from
+// the name of the file and those of the directories above it, returns its
+// size with the terminating null
+static lfs_ssize_t lfs_file_path(lfs_t *lfs, const lfs_file_t *file,
+        char *path, lfs_size_t size) {
+    if (size == 0) {
+        return LFS_ERR_NOSPC;
+    }
+
+    lfs_size_t off = size - 1;
+    path[off] = '\0';
+    lfs_mdir_t dir = file->m;
+    uint16_t id = file->id;
+    while (true) {
+        // prepend "/name"
+        lfs_stag_t tag = lfs_dir_get(lfs, &dir, LFS_MKTAG(0x780, 0x3ff, 0),
+                LFS_MKTAG(LFS_TYPE_NAME, id, 0), path);
+        if (tag < 0) {
+            return tag;
         }
 
-        // read as much as we can in current block
-        lfs_size_t diff = lfs_min(nsize, lfs->cfg->block_size - file->off);
-        if (file->flags & LFS_F_INLINE) {
-            int err = lfs_dir_getread(lfs, &file->m,
-                    NULL, &file->cache, lfs->cfg->block_size,
-                    LFS_MKTAG(0xfff, 0x1ff, 0),
-                    LFS_MKTAG(LFS_TYPE_INLINESTRUCT, file->id, 0),
-                    file->off, data, diff);
-            if (err) {
-                return err;
+        lfs_size_t nlen = lfs_tag_size(tag);
+        if (off < nlen+1) {
+            return LFS_ERR_NOSPC;
+        }
+        off -= nlen;
+        tag = lfs_dir_get(lfs, &dir, LFS_MKTAG(0x780, 0x3ff, 0),
+                LFS_MKTAG(LFS_TYPE_NAME, id, nlen), &path[off]);
+        if (tag < 0) {
+            return tag;
+        }
+        path[--off] = '/';
+
+        // up to the entry of the directory in its parent, a pair that has
+        // no parent is a tail of a directory split over several pairs, go
+        // back to its first one
+        lfs_mdir_t parent;
+        tag = LFS_ERR_NOENT;
+        while (lfs_pair_cmp(dir.pair, lfs->root) != 0) {
+            tag = lfs_fs_parent(lfs, dir.pair, &parent);
+            if (tag != LFS_ERR_NOENT) {
+                break;
             }
-        } else {
-            int err = lfs_bd_read(lfs,
-                    NULL, &file->cache, lfs->cfg->block_size,
-                    file->block, file->off, data, diff);
+
+            int err = lfs_fs_pred(lfs, dir.pair, &parent);
             if (err) {
                 return err;
             }
+            dir = parent;
         }
 
-        file->pos += diff;
-        file->off += diff;
-        data += diff;
-        nsize -= diff;
+        if (lfs_pair_cmp(dir.pair, lfs->root) == 0) {
+            break;
+        } else if (tag < 0) {
+            return tag;
+        }
+        dir = parent;
+        id = lfs_tag_id(tag);
     }
 
-    return size;
+    memmove(path, &path[off], size - off);
+    return size - off;
 }
 
-static lfs_ssize_t lfs_file_read_(lfs_t *lfs, lfs_file_t *file,
-        void *buffer, lfs_size_t size) {
-    LFS_ASSERT((file->flags & LFS_O_RDONLY) == LFS_O_RDONLY);
-
-#ifndef LFS_READONLY
-    if (file->flags & LFS_F_WRITING) {
-        // flush out any writes
-        int err = lfs_file_flush(lfs, file);
-        if (err) {
-            return err;
-        }
+// append a tag and its data to a journal, the tag in little-endian
+static int lfs_txn_push(uint8_t *journal, lfs_size_t size, lfs_size_t *off,
+        lfs_tag_t tag, const void *buffer) {
+    if (*off + sizeof(tag) + lfs_tag_size(tag) > size) {
+        return LFS_ERR_NOSPC;
     }
-#endif
 
-    return lfs_file_flushedread(lfs, file, buffer, size);
+    lfs_tag_t letag = lfs_tole32(tag);
+    memcpy(&journal[*off], &letag, sizeof(letag));
+    if (buffer) {
+        memcpy(&journal[*off + sizeof(tag)], buffer, lfs_tag_size(tag));
+    }
+    *off += sizeof(tag) + lfs_tag_size(tag);
+    return 0;
 }
 
+// the journal of a group sync, for each file a REG tag with its path, its
+// struct and its user attributes, the same tags the commit would write with
+// the ids left out, the files of a pair one after the other
+static lfs_ssize_t lfs_txn_build(lfs_t *lfs, lfs_file_t *const *files,
+        lfs_size_t count, uint8_t *journal, lfs_size_t size) {
+    lfs_size_t off = 0;
+    for (lfs_size_t i = 0; i < count; i++) {
+        if (!lfs_file_ingroup(files[i])) {
+            continue;
+        }
 
-#ifndef LFS_READONLY
-static lfs_ssize_t lfs_file_flushedwrite(lfs_t *lfs, lfs_file_t *file,
-        const void *buffer, lfs_size_t size) {
-    const uint8_t *data = buffer;
-    lfs_size_t nsize = size;
-
-    if ((file->flags & LFS_F_INLINE) &&
-            lfs_max(file->pos+nsize, file->ctz.size) > lfs->inline_max) {
-        // inline file doesn't fit anymore
-        int err = lfs_file_outline(lfs, file);
-        if (err) {
-            file->flags |= LFS_F_ERRED;
-            return err;
+        // already there with an earlier file of its pair?
+        bool seen = false;
+        for (lfs_size_t j = 0; j < i && !seen; j++) {
+            seen = lfs_file_ingroup(files[j]) &&
+                    lfs_pair_cmp(files[j]->m.pair, files[i]->m.pair) == 0;
+        }
+        if (seen) {
+            continue;
         }
-    }
 
-    while (nsize > 0) {
-        // check if we need a new block
-        if (!(file->flags & LFS_F_WRITING) ||
-                file->off == lfs->cfg->block_size) {
-            if (!(file->flags & LFS_F_INLINE)) {
+        // the path of the first file is looked up, the others of the pair
+        // take its directory part
+        lfs_size_t doff = off + sizeof(lfs_tag_t);
+        lfs_size_t dlen = 0;
+        for (lfs_size_t k = i; k < count; k++) {
+            lfs_file_t *f = files[k];
+            if (!lfs_file_ingroup(f) ||
+                    lfs_pair_cmp(f->m.pair, files[i]->m.pair) != 0) {
+                continue;
+            }
+
+            lfs_size_t poff = off + sizeof(lfs_tag_t);
+            if (poff > size) {
+                return LFS_ERR_NOSPC;
+            }
+
+            lfs_ssize_t plen;
+            if (k == i) {
+                plen = lfs_file_path(lfs, f, (char*)&journal[poff],
+                        size - poff);
+                if (plen < 0) {
+                    return plen;
+                }
+                for (lfs_size_t c = 0; c < (lfs_size_t)plen; c++) {
+                    dlen = (journal[poff + c] == '/') ? c : dlen;
+                }
+            } else {
+                if (poff + dlen + 2 > size) {
+                    return LFS_ERR_NOSPC;
+                }
+                memcpy(&journal[poff], &journal[doff], dlen);
+                journal[poff + dlen] = '/';
+                lfs_size_t nmax = size - (poff + dlen + 2);
+                lfs_stag_t tag = lfs_dir_get(lfs, &f->m,
+                        LFS_MKTAG(0x780, 0x3ff, 0),
+                        LFS_MKTAG(LFS_TYPE_NAME, f->id, nmax),
+                        &journal[poff + dlen + 1]);
+                if (tag < 0) {
+                    return tag;
+                } else if (lfs_tag_size(tag) > nmax) {
+                    return LFS_ERR_NOSPC;
+                }
+                plen = dlen + 1 + lfs_tag_size(tag) + 1;
+                journal[poff + plen-1] = '\0';
+            }
+
+            int err = lfs_txn_push(journal, size, &off,
+                    LFS_MKTAG(LFS_TYPE_REG, 0, plen), NULL);
+            if (err) {
+                return err;
+            }
+
+            if (f->flags & LFS_F_INLINE) {
+                err = lfs_txn_push(journal, size, &off,
+                        LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, f->ctz.size),
+                        f->cache.buffer);
+            } else {
+                struct lfs_ctz ctz = f->ctz;
+                lfs_ctz_tole32(&ctz);
+                err = lfs_txn_push(journal, size, &off,
+                        LFS_MKTAG(LFS_TYPE_CTZSTRUCT, 0, sizeof(ctz)), &ctz);
+            }
+            if (err) {
+                return err;
+            }
+
+            struct lfs_zattr zattr;
+            if (lfs_file_zattr(f, &zattr)) {
+                err = lfs_txn_push(journal, size, &off,
+                        LFS_MKTAG(LFS_TYPE_USERATTR + LFS_ZATTR, 0,
+                            sizeof(zattr)), &zattr);
+                if (err) {
+                    return err;
+                }
+            }
+
+            for (lfs_size_t j = 0; j < f->cfg->attr_count; j++) {
+                const struct lfs_attr *a = &f->cfg->attrs[j];
+                err = lfs_txn_push(journal, size, &off,
+                        LFS_MKTAG(LFS_TYPE_USERATTR + a->type, 0, a->size),
+                        a->buffer);
+                if (err) {
+                    return err;
+                }
+            }
+        }
+    }
+
+    return off;
+}
+
+static int lfs_file_syncgroup_(lfs_t *lfs, lfs_file_t *const *files,
+        lfs_size_t count) {
+#ifdef LFS_NO_MALLOC
+    // without a heap the arrays of the commits are on the stack
+    if (count > LFS_GROUP_MAX) {
+        return LFS_ERR_INVAL;
+    }
+#endif
+
+    // write out pending data, and find out if the files share a pair
+    lfs_file_t *head = NULL;
+    bool single = true;
+    bool data = false;
+    for (lfs_size_t i = 0; i < count; i++) {
+        lfs_file_t *f = files[i];
+        if (f->flags & LFS_F_ERRED) {
+            // it's not safe to do anything if our file errored
+            continue;
+        }
+
+        int err = lfs_file_zflush(lfs, f);
+        if (!err) {
+            err = lfs_file_flush(lfs, f);
+        }
+        if (err) {
+            f->flags |= LFS_F_ERRED;
+            return err;
+        }
+
+        if (lfs_file_ingroup(f)) {
+            data = data || !(f->flags & LFS_F_INLINE);
+            if (!head) {
+                head = f;
+            } else if (lfs_pair_cmp(f->m.pair, head->m.pair) != 0) {
+                single = false;
+            }
+        }
+    }
+
+    if (!head) {
+        return 0;
+    }
+
+#ifdef LFS_NO_MALLOC
+    struct lfs_mattr attrs[3*LFS_GROUP_MAX+1];
+    struct lfs_ctz ctzs[LFS_GROUP_MAX];
+    struct lfs_zattr zattrs[LFS_GROUP_MAX];
+#else
+    struct lfs_mattr *attrs = lfs_malloc((3*count+1)*sizeof(*attrs));
+    struct lfs_ctz *ctzs = lfs_malloc(count*sizeof(*ctzs));
+    struct lfs_zattr *zattrs = lfs_malloc(count*sizeof(*zattrs));
+#endif
+    uint8_t *journal = NULL;
+    int err = LFS_ERR_NOMEM;
+#ifndef LFS_NO_MALLOC
+    if (!attrs || !ctzs || !zattrs) {
+        goto cleanup;
+    }
+#endif
+
+    if (!single) {
+        // files in more than one pair, record the group in a journal first,
+        // if it doesn't fit with the inline files in it move them to blocks,
+        // a crc of the records follows them
+        lfs_size_t jmax = lfs_min(lfs->inline_max, lfs->attr_max);
+        if (jmax <= sizeof(uint32_t)) {
+            err = LFS_ERR_NOSPC;
+            goto cleanup;
+        }
+
+        journal = (lfs->cfg->txn_buffer) ? lfs->cfg->txn_buffer
+                : lfs_malloc(jmax);
+        if (!journal) {
+            goto cleanup;
+        }
+        jmax -= sizeof(uint32_t);
+
+        lfs_ssize_t jsize = lfs_txn_build(lfs, files, count,
+                journal, jmax);
+        if (jsize == LFS_ERR_NOSPC) {
+            for (lfs_size_t i = 0; i < count; i++) {
+                lfs_file_t *f = files[i];
+                if (!lfs_file_ingroup(f) || !(f->flags & LFS_F_INLINE)) {
+                    continue;
+                }
+
+                // all of the file goes to the block, not just what is
+                // before pos
+                lfs_off_t pos = f->pos;
+                f->pos = f->ctz.size;
+                err = lfs_file_outline(lfs, f);
+                if (!err) {
+                    err = lfs_file_flush(lfs, f);
+                }
+                f->pos = pos;
+                if (err) {
+                    f->flags |= LFS_F_ERRED;
+                    goto cleanup;
+                }
+            }
+
+            jsize = lfs_txn_build(lfs, files, count,
+                    journal, jmax);
+        }
+        if (jsize < 0) {
+            err = jsize;
+            goto cleanup;
+        }
+
+        uint32_t jcrc = lfs_tole32(lfs_crc(0xffffffff, journal, jsize));
+        memcpy(&journal[jsize], &jcrc, sizeof(jcrc));
+        jsize += sizeof(jcrc);
+
+        // before we commit metadata, we need sync the disk to make sure
+        // data writes don't complete after metadata writes
+        err = lfs_bd_sync(lfs, &lfs->pcache, &lfs->rcache, false);
+        if (err) {
+            goto cleanup;
+        }
+
+        // the journal is an attribute of the superblock entry, out of the
+        // namespace, from this commit on the group is applied, if not here
+        // then by lfs_mount
+        lfs_mdir_t jdir;
+        err = lfs_dir_fetch(lfs, &jdir, lfs->root);
+        if (err) {
+            goto cleanup;
+        }
+
+        err = lfs_dir_commit(lfs, &jdir, LFS_MKATTRS(
+                {LFS_MKTAG(LFS_TYPE_USERATTR + LFS_TXN_ATTR, 0, jsize),
+                    journal}));
+        if (err) {
+            goto cleanup;
+        }
+
+        // one commit per pair, the pair of the journal last
+        for (lfs_size_t i = 0; i < count; i++) {
+            lfs_file_t *f = files[i];
+            if (!lfs_file_ingroup(f) ||
+                    lfs_pair_cmp(f->m.pair, jdir.pair) == 0) {
+                continue;
+            }
+
+            err = lfs_file_groupcommit(lfs, files, count, &f->m, false,
+                    attrs, ctzs, zattrs);
+            if (err) {
+                goto cleanup;
+            }
+        }
+
+        // the superblock pair stays where it is, but the commits above may
+        // have changed it, its removal goes in the commit of the files next
+        // to it or in one of its own
+        err = lfs_dir_fetch(lfs, &jdir, lfs->root);
+        if (err) {
+            goto cleanup;
+        }
+
+        err = lfs_file_groupcommit(lfs, files, count, &jdir, true,
+                attrs, ctzs, zattrs);
+    } else {
+        if (data) {
+            err = lfs_bd_sync(lfs, &lfs->pcache, &lfs->rcache, false);
+            if (err) {
+                goto cleanup;
+            }
+        }
+
+        err = lfs_file_groupcommit(lfs, files, count, &head->m, false,
+                attrs, ctzs, zattrs);
+    }
+
+cleanup:
+    if (!lfs->cfg->txn_buffer) {
+        lfs_free(journal);
+    }
+#ifndef LFS_NO_MALLOC
+    lfs_free(zattrs);
+    lfs_free(ctzs);
+    lfs_free(attrs);
+#endif
+    return err;
+}
+#endif
+
+static lfs_ssize_t lfs_file_flushedread(lfs_t *lfs, lfs_file_t *file,
+        void *buffer, lfs_size_t size) {
+    uint8_t *data = buffer;
+    lfs_size_t nsize = size;
+
+    if (file->pos >= file->ctz.size) {
+        // eof if past end
+        return 0;
+    }
+
+    size = lfs_min(size, file->ctz.size - file->pos);
+    nsize = size;
+
+    while (nsize > 0) {
+        // check if we need a new block
+        if (!(file->flags & LFS_F_READING) ||
+                file->off == lfs->cfg->block_size) {
+            if (!(file->flags & LFS_F_INLINE)) {
+                int err = lfs_ctz_find(lfs, NULL, &file->cache,
+                        file->ctz.head, file->ctz.size,
+                        file->pos, &file->block, &file->off);
+                if (err) {
+                    return err;
+                }
+            } else {
+                file->block = LFS_BLOCK_INLINE;
+                file->off = file->pos;
+            }
+
+            file->flags |= LFS_F_READING;
+        }
+
+        // read as much as we can in current block
+        lfs_size_t diff = lfs_min(nsize, lfs->cfg->block_size - file->off);
+        if (file->flags & LFS_F_INLINE) {
+            int err = lfs_dir_getread(lfs, &file->m,
+                    NULL, &file->cache, lfs->cfg->block_size,
+                    LFS_MKTAG(0xfff, 0x1ff, 0),
+                    LFS_MKTAG(LFS_TYPE_INLINESTRUCT, file->id, 0),
+                    file->off, data, diff);
+            if (err) {
+                return err;
+            }
+        } else {
+            int err = lfs_bd_read(lfs,
+                    NULL, &file->cache, lfs->cfg->block_size,
+                    file->block, file->off, data, diff);
+            if (err) {
+                return err;
+            }
+        }
+
+        file->pos += diff;
+        file->off += diff;
+        data += diff;
+        nsize -= diff;
+    }
+
+    return size;
+}
+
+static lfs_ssize_t lfs_file_read_(lfs_t *lfs, lfs_file_t *file,
+        void *buffer, lfs_size_t size) {
+    LFS_ASSERT((file->flags & LFS_O_RDONLY) == LFS_O_RDONLY);
+
+#ifndef LFS_READONLY
+    if (file->flags & LFS_F_WRITING) {
+        // flush out any writes
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            return err;
+        }
+    }
+#endif
+
+    return lfs_file_flushedread(lfs, file, buffer, size);
+}
+
+
+#ifndef LFS_READONLY
+static lfs_ssize_t lfs_file_flushedwrite(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size) {
+    const uint8_t *data = buffer;
+    lfs_size_t nsize = size;
+
+    if ((file->flags & LFS_F_INLINE) &&
+            lfs_max(file->pos+nsize, file->ctz.size) > lfs->inline_max) {
+        // inline file doesn't fit anymore
+        int err = lfs_file_outline(lfs, file);
+        if (err) {
+            file->flags |= LFS_F_ERRED;
+            return err;
+        }
+    }
+
+    while (nsize > 0) {
+        // check if we need a new block
+        if (!(file->flags & LFS_F_WRITING) ||
+                file->off == lfs->cfg->block_size) {
+            if (!(file->flags & LFS_F_INLINE)) {
+                lfs_off_t noff = lfs->cfg->block_size;
                 if (!(file->flags & LFS_F_WRITING) && file->pos > 0) {
                     // find out which block we're extending from
                     int err = lfs_ctz_find(lfs, NULL, &file->cache,
                             file->ctz.head, file->ctz.size,
-                            file->pos-1, &file->block, &(lfs_off_t){0});
+                            file->pos-1, &file->block, &noff);
                     if (err) {
                         file->flags |= LFS_F_ERRED;
                         return err;
                     }
+                    noff += 1;
 
                     // mark cache as dirty since we may have read data into it
                     lfs_cache_zero(lfs, &file->cache);
                 }
 
-                // extend file with new blocks
-                lfs_alloc_ckpoint(lfs);
-                int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
-                        file->block, file->pos,
-                        &file->block, &file->off);
-                if (err) {
-                    file->flags |= LFS_F_ERRED;
-                    return err;
+                if ((file->flags & LFS_O_LOG)
+                        && file->pos == file->ctz.size
+                        && noff < lfs->cfg->block_size) {
+                    // a log appends in place while its last block has room
+                    int err = lfs_file_appendtail(lfs, file, noff);
+                    if (err) {
+                        file->flags |= LFS_F_ERRED;
+                        return err;
+                    }
+                } else {
+                    // extend file with new blocks
+                    lfs_alloc_ckpoint(lfs);
+                    int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
+                            file->block, file->pos,
+                            &file->block, &file->off);
+                    if (err) {
+                        file->flags |= LFS_F_ERRED;
+                        return err;
+                    }
                 }
             } else {
                 file->block = LFS_BLOCK_INLINE;
@@ -3767,9 +4545,10 @@ static int lfs_file_truncate_(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             }
 
             // lookup new head in ctz skip list
+            lfs_off_t noff;
             err = lfs_ctz_find(lfs, NULL, &file->cache,
                     file->ctz.head, file->ctz.size,
-                    size-1, &file->block, &(lfs_off_t){0});
+                    size-1, &file->block, &noff);
             if (err) {
                 return err;
             }
@@ -3780,6 +4559,24 @@ static int lfs_file_truncate_(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             file->ctz.head = file->block;
             file->ctz.size = size;
             file->flags |= LFS_F_DIRTY | LFS_F_READING;
+
+            // a log appends in place after the last byte of its last block,
+            // which must leave the rest of that block erased, copy what is
+            // left of it to a new block
+            if (lfs->cfg->prog_rewrite && noff+1 < lfs->cfg->block_size) {
+                lfs_cache_zero(lfs, &file->cache);
+                lfs_alloc_ckpoint(lfs);
+                err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
+                        file->block, file->pos,
+                        &file->block, &file->off);
+                if (err) {
+                    file->flags |= LFS_F_ERRED;
+                    return err;
+                }
+
+                file->flags &= ~LFS_F_READING;
+                file->flags |= LFS_F_WRITING;
+            }
         }
     } else if (size > oldsize) {
         // flush+seek if not already at end
@@ -3797,41 +4594,743 @@ static int lfs_file_truncate_(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
         }
     }
 
-    // restore pos
-    lfs_soff_t res = lfs_file_seek_(lfs, file, pos, LFS_SEEK_SET);
-    if (res < 0) {
-      return (int)res;
+    // restore pos
+    lfs_soff_t res = lfs_file_seek_(lfs, file, pos, LFS_SEEK_SET);
+    if (res < 0) {
+      return (int)res;
+    }
+
+    return 0;
+}
+#endif
+
+static lfs_soff_t lfs_file_tell_(lfs_t *lfs, lfs_file_t *file) {
+    (void)lfs;
+    return file->pos;
+}
+
+static int lfs_file_rewind_(lfs_t *lfs, lfs_file_t *file) {
+    lfs_soff_t res = lfs_file_seek_(lfs, file, 0, LFS_SEEK_SET);
+    if (res < 0) {
+        return (int)res;
+    }
+
+    return 0;
+}
+
+static lfs_soff_t lfs_file_size_(lfs_t *lfs, lfs_file_t *file) {
+    (void)lfs;
+
+#ifndef LFS_READONLY
+    if (file->flags & LFS_F_WRITING) {
+        return lfs_max(file->pos, file->ctz.size);
+    }
+#endif
+
+    return file->ctz.size;
+}
+
+
+/// Compressed files ///
+#ifndef LFS_NO_COMPRESS
+
+// A compressed file stores one frame per chunk of z.chunk bytes of file
+// data: a header with the le16 size of the frame data and the le16 size of
+// the chunk, then the chunk compressed on its own, or as it is when that
+// isn't smaller. Every chunk but the last is full. The last one has its
+// frame at z.tail and is written there again until it is full, the
+// LFS_ZATTR attribute committed with the struct of the file has z.chunk,
+// z.size and z.tail.
+//
+// Chunks are compressed with an LZ77 code laid out like LZ4, the window is
+// the chunk itself. Each sequence is a token, the literals and a match:
+//   token   literal length << 4 | match length - 4, a 15 in either half is
+//           followed by bytes added to it, up to the first below 255
+//   le16    offset of the match back from the end of the literals
+// The last sequence has no match and ends with the frame.
+#define LFS_ZHEADER 4
+#define LFS_ZMATCH_MIN 4
+#define LFS_ZNONE 0xffffffff
+
+static inline uint32_t lfs_z_hash(const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+            | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 2654435761U) >> (32 - LFS_ZHASH_BITS);
+}
+
+static inline lfs_size_t lfs_z_le16(const uint8_t *p) {
+    return (lfs_size_t)p[0] | ((lfs_size_t)p[1] << 8);
+}
+
+#ifndef LFS_READONLY
+// bytes a length of a token takes after it
+static inline lfs_size_t lfs_z_extsize(lfs_size_t len) {
+    return (len >= 15) ? (len - 15)/255 + 1 : 0;
+}
+
+static lfs_size_t lfs_z_putext(uint8_t *dst, lfs_size_t op, lfs_size_t len) {
+    if (len >= 15) {
+        len -= 15;
+        while (len >= 255) {
+            dst[op++] = 255;
+            len -= 255;
+        }
+        dst[op++] = len;
+    }
+
+    return op;
+}
+
+// compress size bytes of src into dst, returns the compressed size, or 0 if
+// it would not be below limit
+static lfs_size_t lfs_z_compress(const uint8_t *src, lfs_size_t size,
+        uint8_t *dst, lfs_size_t limit, uint16_t *hash) {
+    memset(hash, 0, sizeof(uint16_t) << LFS_ZHASH_BITS);
+
+    lfs_size_t ip = 0;
+    lfs_size_t anchor = 0;
+    lfs_size_t op = 0;
+    while (true) {
+        // look for a match, the last position with the same hash
+        lfs_size_t mlen = 0;
+        lfs_size_t moff = 0;
+        while (ip + LFS_ZMATCH_MIN <= size) {
+            uint32_t h = lfs_z_hash(&src[ip]);
+            lfs_size_t cand = hash[h];
+            hash[h] = ip;
+            if (cand < ip && memcmp(&src[cand], &src[ip],
+                    LFS_ZMATCH_MIN) == 0) {
+                mlen = LFS_ZMATCH_MIN;
+                while (ip + mlen < size && src[cand + mlen] == src[ip + mlen]) {
+                    mlen += 1;
+                }
+                moff = ip - cand;
+                break;
+            }
+
+            ip += 1;
+        }
+
+        if (mlen == 0) {
+            ip = size;
+        }
+
+        lfs_size_t llen = ip - anchor;
+        lfs_size_t need = 1 + lfs_z_extsize(llen) + llen;
+        if (mlen) {
+            need += 2 + lfs_z_extsize(mlen - LFS_ZMATCH_MIN);
+        }
+        if (op + need >= limit) {
+            return 0;
+        }
+
+        dst[op++] = (lfs_min(llen, 15) << 4)
+                | (mlen ? lfs_min(mlen - LFS_ZMATCH_MIN, 15) : 0);
+        op = lfs_z_putext(dst, op, llen);
+        memcpy(&dst[op], &src[anchor], llen);
+        op += llen;
+        if (mlen == 0) {
+            return op;
+        }
+
+        dst[op++] = moff & 0xff;
+        dst[op++] = moff >> 8;
+        op = lfs_z_putext(dst, op, mlen - LFS_ZMATCH_MIN);
+
+        // positions in the match can start later matches
+        for (lfs_size_t i = ip + 1;
+                i < ip + mlen && i + LFS_ZMATCH_MIN <= size; i++) {
+            hash[lfs_z_hash(&src[i])] = i;
+        }
+
+        ip += mlen;
+        anchor = ip;
+    }
+}
+#endif
+
+static int lfs_z_getext(const uint8_t *src, lfs_size_t size,
+        lfs_size_t *ip, lfs_size_t *len) {
+    if (*len == 15) {
+        uint8_t b;
+        do {
+            if (*ip >= size) {
+                return LFS_ERR_CORRUPT;
+            }
+            b = src[(*ip)++];
+            *len += b;
+        } while (b == 255);
+    }
+
+    return 0;
+}
+
+// decompress size bytes of src, which must give dsize bytes in dst
+static int lfs_z_decompress(const uint8_t *src, lfs_size_t size,
+        uint8_t *dst, lfs_size_t dsize) {
+    lfs_size_t ip = 0;
+    lfs_size_t op = 0;
+    while (ip < size) {
+        uint8_t token = src[ip++];
+        lfs_size_t llen = token >> 4;
+        int err = lfs_z_getext(src, size, &ip, &llen);
+        if (err) {
+            return err;
+        }
+
+        if (llen > size - ip || llen > dsize - op) {
+            return LFS_ERR_CORRUPT;
+        }
+        memcpy(&dst[op], &src[ip], llen);
+        ip += llen;
+        op += llen;
+        if (ip == size) {
+            break;
+        }
+
+        if (size - ip < 2) {
+            return LFS_ERR_CORRUPT;
+        }
+        lfs_size_t moff = lfs_z_le16(&src[ip]);
+        ip += 2;
+        lfs_size_t mlen = token & 0xf;
+        err = lfs_z_getext(src, size, &ip, &mlen);
+        if (err) {
+            return err;
+        }
+        mlen += LFS_ZMATCH_MIN;
+
+        if (moff == 0 || moff > op || mlen > dsize - op) {
+            return LFS_ERR_CORRUPT;
+        }
+        if (moff >= mlen) {
+            memcpy(&dst[op], &dst[op - moff], mlen);
+            op += mlen;
+        } else {
+            // overlapping, a run
+            for (lfs_size_t i = 0; i < mlen; i++) {
+                dst[op] = dst[op - moff];
+                op += 1;
+            }
+        }
+    }
+
+    return (op == dsize) ? 0 : LFS_ERR_CORRUPT;
+}
+
+static int lfs_file_zopen(lfs_t *lfs, lfs_file_t *file) {
+    struct lfs_zattr zattr;
+    lfs_stag_t tag = lfs_dir_get(lfs, &file->m, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_USERATTR + LFS_ZATTR, file->id, sizeof(zattr)),
+            &zattr);
+    if (tag < 0 && tag != LFS_ERR_NOENT) {
+        return tag;
+    }
+
+#ifndef LFS_READONLY
+    bool writable = (file->flags & LFS_O_WRONLY) == LFS_O_WRONLY;
+#else
+    bool writable = false;
+#endif
+    lfs_size_t zchunk = (writable) ? file->cfg->zchunk : 0;
+    LFS_ASSERT(zchunk == 0 ||
+            (zchunk >= LFS_ZCHUNK_MIN && zchunk <= LFS_ZCHUNK_MAX));
+
+    if (tag >= 0) {
+        lfs_zattr_fromle32(&zattr);
+        if (zattr.chunk < LFS_ZCHUNK_MIN || zattr.chunk > LFS_ZCHUNK_MAX ||
+                zattr.tail > file->ctz.size) {
+            return LFS_ERR_CORRUPT;
+        }
+
+        file->z.chunk = zattr.chunk;
+        file->z.size = zattr.size;
+        file->z.tail = zattr.tail;
+        if (file->ctz.size == 0) {
+            // truncated, may take a new chunk size
+            file->z.size = 0;
+            file->z.tail = 0;
+#ifndef LFS_READONLY
+            if (zchunk && zchunk != file->z.chunk) {
+                file->z.chunk = zchunk;
+                file->flags |= LFS_F_DIRTY;
+            }
+#endif
+        }
+    } else if (zchunk && file->ctz.size == 0) {
+#ifndef LFS_READONLY
+        // a new or empty file becomes a compressed one on its next sync
+        file->z.chunk = zchunk;
+        file->z.size = 0;
+        file->z.tail = 0;
+        file->flags |= LFS_F_DIRTY;
+#endif
+    } else {
+        return 0;
+    }
+
+#ifndef LFS_READONLY
+    // a chunk is written again until it is full, not in place
+    file->flags &= ~LFS_O_LOG;
+#endif
+    file->z.pos = 0;
+    file->z.index = LFS_ZNONE;
+    file->z.stride = 1;
+    file->z.marks = 1;
+    file->z.mark[0] = 0;
+
+    // allocate buffer if needed, readers need no hash table
+    if (file->cfg->zbuffer) {
+        if (file->z.chunk > file->cfg->zchunk) {
+            return LFS_ERR_NOMEM;
+        }
+        file->z.buffer = file->cfg->zbuffer;
+    } else {
+        file->z.buffer = lfs_malloc((writable)
+                ? LFS_ZBUFFER_SIZE(file->z.chunk)
+                : 2*file->z.chunk);
+        if (!file->z.buffer) {
+            return LFS_ERR_NOMEM;
+        }
+    }
+
+    return 0;
+}
+
+// read size bytes of the stored file at off
+static int lfs_file_zget(lfs_t *lfs, lfs_file_t *file,
+        lfs_off_t off, void *buffer, lfs_size_t size) {
+    // frame headers are walked forward, most are in the block being read,
+    // stay in it rather than finding it again from the head of the file
+    lfs_off_t noff = off;
+    if ((file->flags & (LFS_F_READING | LFS_F_INLINE)) == LFS_F_READING
+#ifndef LFS_READONLY
+            && !(file->flags & LFS_F_WRITING)
+#endif
+            && off >= file->pos
+            && file->off < lfs->cfg->block_size
+            && lfs_ctz_index(lfs, &noff)
+                == lfs_ctz_index(lfs, &(lfs_off_t){file->pos})) {
+        file->pos = off;
+        file->off = noff;
+    } else {
+        lfs_soff_t res = lfs_file_seek_(lfs, file, off, LFS_SEEK_SET);
+        if (res < 0) {
+            return res;
+        }
+    }
+
+#ifndef LFS_READONLY
+    if (file->flags & LFS_F_WRITING) {
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            return err;
+        }
+    }
+#endif
+
+    lfs_soff_t res = lfs_file_flushedread(lfs, file, buffer, size);
+    if (res < 0) {
+        return res;
+    }
+
+    return ((lfs_size_t)res == size) ? 0 : LFS_ERR_CORRUPT;
+}
+
+// note the frame of chunk k if it is the next to mark, the marks are every
+// stride chunks and the stride doubles when they run out
+static void lfs_file_zmark(lfs_file_t *file, lfs_size_t k, lfs_off_t off) {
+    if (k % file->z.stride != 0 || k / file->z.stride != file->z.marks) {
+        return;
+    }
+
+    if (file->z.marks == LFS_ZMARKS) {
+        for (lfs_size_t j = 0; j < LFS_ZMARKS/2; j++) {
+            file->z.mark[j] = file->z.mark[2*j];
+        }
+        file->z.marks = LFS_ZMARKS/2;
+        file->z.stride *= 2;
+        if (k % file->z.stride != 0) {
+            return;
+        }
+    }
+
+    file->z.mark[file->z.marks] = off;
+    file->z.marks += 1;
+}
+
+// offset of the frame of chunk k, the frames are walked from the nearest
+// one marked or the one after the chunk held if that is nearer
+static int lfs_file_zfind(lfs_t *lfs, lfs_file_t *file,
+        lfs_size_t k, lfs_off_t *off) {
+    if (k == file->z.size / file->z.chunk) {
+        *off = file->z.tail;
+        return 0;
+    }
+
+    lfs_size_t j = lfs_min(k / file->z.stride, file->z.marks - 1);
+    lfs_size_t i = j * file->z.stride;
+    *off = file->z.mark[j];
+    if (file->z.index != LFS_ZNONE && file->z.index < k
+            && file->z.index >= i) {
+        i = file->z.index + 1;
+        *off = file->z.next;
+    }
+
+    while (i < k) {
+        uint8_t header[LFS_ZHEADER];
+        int err = lfs_file_zget(lfs, file, *off, header, sizeof(header));
+        if (err) {
+            return err;
+        }
+
+        if (lfs_z_le16(&header[2]) != file->z.chunk) {
+            return LFS_ERR_CORRUPT;
+        }
+
+        *off += LFS_ZHEADER + lfs_z_le16(&header[0]);
+        i += 1;
+        lfs_file_zmark(file, i, *off);
+    }
+
+    return 0;
+}
+
+#ifndef LFS_READONLY
+// write the chunk held, the one the file data ends in, to its frame at
+// z.tail, once it is full the next frame starts after it
+static int lfs_file_zemit(lfs_t *lfs, lfs_file_t *file) {
+    lfs_size_t chunk = file->z.chunk;
+    uint8_t *data = file->z.buffer;
+    lfs_size_t len = lfs_min(chunk, file->z.size - file->z.index*chunk);
+    LFS_PROF_BEGIN(PROF_LFS_ZCOMP);
+    lfs_size_t size = lfs_z_compress(data, len, &data[chunk], len,
+            (uint16_t*)&data[2*chunk]);
+    LFS_PROF_END(PROF_LFS_ZCOMP);
+    const uint8_t *frame = &data[chunk];
+    if (size == 0) {
+        // doesn't compress, store as it is
+        size = len;
+        frame = data;
+    }
+
+    // the earlier frame of a chunk that was not full is replaced
+    if ((lfs_size_t)lfs_file_size_(lfs, file) > file->z.tail) {
+        int err = lfs_file_truncate_(lfs, file, file->z.tail);
+        if (err) {
+            return err;
+        }
+    }
+
+    lfs_soff_t res = lfs_file_seek_(lfs, file, file->z.tail, LFS_SEEK_SET);
+    if (res < 0) {
+        return res;
+    }
+
+    uint8_t header[LFS_ZHEADER] = {
+            size & 0xff, size >> 8, len & 0xff, len >> 8};
+    res = lfs_file_write_(lfs, file, header, sizeof(header));
+    if (res >= 0) {
+        res = lfs_file_write_(lfs, file, frame, size);
+    }
+    if (res < 0) {
+        return res;
+    }
+
+    file->z.off = file->z.tail;
+    file->z.next = file->z.tail + LFS_ZHEADER + size;
+    if (len == chunk) {
+        file->z.tail = file->z.next;
+        lfs_file_zmark(file, file->z.index + 1, file->z.tail);
+    }
+    file->flags &= ~LFS_F_ZDIRTY;
+    return 0;
+}
+
+static int lfs_file_zflush(lfs_t *lfs, lfs_file_t *file) {
+    if (!(file->flags & LFS_F_ZDIRTY)) {
+        return 0;
+    }
+
+    return lfs_file_zemit(lfs, file);
+}
+#endif
+
+// bring chunk k into the buffer
+static int lfs_file_zload(lfs_t *lfs, lfs_file_t *file, lfs_size_t k) {
+    if (file->z.index == k) {
+        return 0;
+    }
+
+#ifndef LFS_READONLY
+    // the last chunk is written out before its data is replaced
+    int err = lfs_file_zflush(lfs, file);
+    if (err) {
+        return err;
+    }
+#else
+    int err;
+#endif
+
+    lfs_off_t off;
+    err = lfs_file_zfind(lfs, file, k, &off);
+    if (err) {
+        return err;
+    }
+
+    uint8_t header[LFS_ZHEADER];
+    err = lfs_file_zget(lfs, file, off, header, sizeof(header));
+    if (err) {
+        return err;
+    }
+
+    lfs_size_t chunk = file->z.chunk;
+    lfs_size_t size = lfs_z_le16(&header[0]);
+    lfs_size_t len = lfs_z_le16(&header[2]);
+    if (len != lfs_min(chunk, file->z.size - k*chunk) || size > len) {
+        return LFS_ERR_CORRUPT;
+    }
+
+    uint8_t *data = file->z.buffer;
+    file->z.index = LFS_ZNONE;
+    if (size == len) {
+        err = lfs_file_zget(lfs, file, off + LFS_ZHEADER, data, len);
+    } else {
+        err = lfs_file_zget(lfs, file, off + LFS_ZHEADER, &data[chunk], size);
+        if (!err) {
+            LFS_PROF_BEGIN(PROF_LFS_ZDECOMP);
+            err = lfs_z_decompress(&data[chunk], size, data, len);
+            LFS_PROF_END(PROF_LFS_ZDECOMP);
+        }
+    }
+    if (err) {
+        return err;
+    }
+
+    file->z.index = k;
+    file->z.off = off;
+    file->z.next = off + LFS_ZHEADER + size;
+    return 0;
+}
+
+static lfs_ssize_t lfs_file_zread(lfs_t *lfs, lfs_file_t *file,
+        void *buffer, lfs_size_t size) {
+    LFS_ASSERT((file->flags & LFS_O_RDONLY) == LFS_O_RDONLY);
+
+    uint8_t *data = buffer;
+    if (file->z.pos >= file->z.size) {
+        // eof if past end
+        return 0;
+    }
+
+    size = lfs_min(size, file->z.size - file->z.pos);
+    lfs_size_t nsize = size;
+    while (nsize > 0) {
+        lfs_size_t k = file->z.pos / file->z.chunk;
+        int err = lfs_file_zload(lfs, file, k);
+        if (err) {
+            return err;
+        }
+
+        lfs_off_t coff = file->z.pos - k*file->z.chunk;
+        lfs_size_t diff = lfs_min(nsize, file->z.chunk - coff);
+        memcpy(data, &file->z.buffer[coff], diff);
+
+        file->z.pos += diff;
+        data += diff;
+        nsize -= diff;
+    }
+
+    return size;
+}
+
+#ifndef LFS_READONLY
+// put size bytes of data, zeros if NULL, at off in the chunk the file data
+// ends in or right after the data, each chunk that fills up is written out
+static int lfs_file_zput(lfs_t *lfs, lfs_file_t *file,
+        lfs_off_t off, const uint8_t *data, lfs_size_t size) {
+    lfs_size_t chunk = file->z.chunk;
+    while (size > 0) {
+        lfs_size_t k = off / chunk;
+        if (file->z.index != k) {
+            if (file->z.size > k*chunk) {
+                // continue a chunk that was written out before it was full
+                int err = lfs_file_zload(lfs, file, k);
+                if (err) {
+                    return err;
+                }
+            } else {
+                file->z.index = k;
+                file->z.off = file->z.tail;
+            }
+        }
+
+        lfs_off_t coff = off - k*chunk;
+        lfs_size_t diff = lfs_min(size, chunk - coff);
+        if (data) {
+            memcpy(&file->z.buffer[coff], data, diff);
+            data += diff;
+        } else {
+            memset(&file->z.buffer[coff], 0, diff);
+        }
+
+        off += diff;
+        size -= diff;
+        file->z.size = lfs_max(file->z.size, off);
+        file->flags |= LFS_F_ZDIRTY;
+
+        if (coff + diff == chunk) {
+            int err = lfs_file_zemit(lfs, file);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static lfs_ssize_t lfs_file_zwrite(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size) {
+    LFS_ASSERT((file->flags & LFS_O_WRONLY) == LFS_O_WRONLY);
+
+    if ((file->flags & LFS_O_APPEND) && file->z.pos < file->z.size) {
+        file->z.pos = file->z.size;
+    }
+
+    if (file->z.pos + size > lfs->file_max) {
+        // Larger than file limit?
+        return LFS_ERR_FBIG;
+    }
+
+    if (file->z.pos < lfs_aligndown(file->z.size, file->z.chunk)) {
+        // only the last chunk can be written again
+        return LFS_ERR_INVAL;
+    }
+
+    if (file->z.pos > file->z.size) {
+        // fill with zeros
+        int err = lfs_file_zput(lfs, file, file->z.size, NULL,
+                file->z.pos - file->z.size);
+        if (err) {
+            return err;
+        }
+    }
+
+    int err = lfs_file_zput(lfs, file, file->z.pos, buffer, size);
+    if (err) {
+        return err;
+    }
+
+    file->z.pos += size;
+    return size;
+}
+
+static int lfs_file_ztruncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
+    LFS_ASSERT((file->flags & LFS_O_WRONLY) == LFS_O_WRONLY);
+
+    if (size > LFS_FILE_MAX) {
+        return LFS_ERR_INVAL;
+    }
+
+    if (size > file->z.size) {
+        // fill with zeros
+        return lfs_file_zput(lfs, file, file->z.size, NULL,
+                size - file->z.size);
+    } else if (size == file->z.size) {
+        return 0;
+    }
+
+    lfs_size_t k = size / file->z.chunk;
+    if (file->z.index != LFS_ZNONE && file->z.index > k) {
+        // the chunk held is cut off
+        file->flags &= ~LFS_F_ZDIRTY;
+        file->z.index = LFS_ZNONE;
+    }
+    // frames up to chunk k stay where they are
+    file->z.marks = lfs_min(file->z.marks, k / file->z.stride + 1);
+
+    lfs_off_t off;
+    if (size % file->z.chunk) {
+        // the chunk size falls in is now the last one, written out again
+        int err = lfs_file_zload(lfs, file, k);
+        if (err) {
+            return err;
+        }
+        off = file->z.off;
+        file->flags |= LFS_F_ZDIRTY;
+    } else {
+        // the frames from chunk k on go
+        int err = lfs_file_zfind(lfs, file, k, &off);
+        if (err) {
+            return err;
+        }
+        err = lfs_file_truncate_(lfs, file, off);
+        if (err) {
+            return err;
+        }
+        file->flags &= ~LFS_F_ZDIRTY;
+        file->flags |= LFS_F_DIRTY;
+    }
+
+    file->z.size = size;
+    file->z.tail = off;
+    return 0;
+}
+#endif
+
+static lfs_soff_t lfs_file_zseek(lfs_t *lfs, lfs_file_t *file,
+        lfs_soff_t off, int whence) {
+    // find new pos, nothing is read until the next read
+    lfs_off_t npos = file->z.pos;
+    if (whence == LFS_SEEK_SET) {
+        npos = off;
+    } else if (whence == LFS_SEEK_CUR) {
+        if ((lfs_soff_t)file->z.pos + off < 0) {
+            return LFS_ERR_INVAL;
+        } else {
+            npos = file->z.pos + off;
+        }
+    } else if (whence == LFS_SEEK_END) {
+        lfs_soff_t res = file->z.size + off;
+        if (res < 0) {
+            return LFS_ERR_INVAL;
+        } else {
+            npos = res;
+        }
+    }
+
+    if (npos > lfs->file_max) {
+        // file position out of range
+        return LFS_ERR_INVAL;
     }
 
-    return 0;
-}
-#endif
-
-static lfs_soff_t lfs_file_tell_(lfs_t *lfs, lfs_file_t *file) {
-    (void)lfs;
-    return file->pos;
+    file->z.pos = npos;
+    return npos;
 }
-
-static int lfs_file_rewind_(lfs_t *lfs, lfs_file_t *file) {
-    lfs_soff_t res = lfs_file_seek_(lfs, file, 0, LFS_SEEK_SET);
-    if (res < 0) {
-        return (int)res;
+#else
+// without the codec a compressed file can't be opened, its data would read
+// as frames
+static int lfs_file_zopen(lfs_t *lfs, lfs_file_t *file) {
+    struct lfs_zattr zattr;
+    lfs_stag_t tag = lfs_dir_get(lfs, &file->m, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_USERATTR + LFS_ZATTR, file->id, sizeof(zattr)),
+            &zattr);
+    if (tag < 0) {
+        return (tag == LFS_ERR_NOENT) ? 0 : tag;
     }
 
-    return 0;
+    return LFS_ERR_INVAL;
 }
 
-static lfs_soff_t lfs_file_size_(lfs_t *lfs, lfs_file_t *file) {
-    (void)lfs;
-
 #ifndef LFS_READONLY
-    if (file->flags & LFS_F_WRITING) {
-        return lfs_max(file->pos, file->ctz.size);
-    }
-#endif
-
-    return file->ctz.size;
+static int lfs_file_zflush(lfs_t *lfs, lfs_file_t *file) {
+    (void)lfs;
+    (void)file;
+    return 0;
 }
+#endif
+#endif
 
 
 /// General fs operations ///
@@ -4064,6 +5563,10 @@ static int lfs_rename_(lfs_t *lfs, const char *oldpath, const char *newpath) {
 
 static lfs_ssize_t lfs_getattr_(lfs_t *lfs, const char *path,
         uint8_t type, void *buffer, lfs_size_t size) {
+    if (lfs_attr_isreserved(type)) {
+        return LFS_ERR_INVAL;
+    }
+
     lfs_mdir_t cwd;
     lfs_stag_t tag = lfs_dir_find(lfs, &cwd, &path, NULL);
     if (tag < 0) {
@@ -4122,6 +5625,10 @@ static int lfs_commitattr(lfs_t *lfs, const char *path,
 #ifndef LFS_READONLY
 static int lfs_setattr_(lfs_t *lfs, const char *path,
         uint8_t type, const void *buffer, lfs_size_t size) {
+    if (lfs_attr_isreserved(type)) {
+        return LFS_ERR_INVAL;
+    }
+
     if (size > lfs->attr_max) {
         return LFS_ERR_NOSPC;
     }
@@ -4132,6 +5639,10 @@ static int lfs_setattr_(lfs_t *lfs, const char *path,
 
 #ifndef LFS_READONLY
 static int lfs_removeattr_(lfs_t *lfs, const char *path, uint8_t type) {
+    if (lfs_attr_isreserved(type)) {
+        return LFS_ERR_INVAL;
+    }
+
     return lfs_commitattr(lfs, path, type, NULL, 0x3ff);
 }
 #endif
@@ -4158,6 +5669,10 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->block_count = cfg->block_count;  // May be 0
     int err = 0;
 
+#ifdef LFS_STATS
+    memset(&lfs->stats, 0, sizeof(lfs->stats));
+#endif
+
 #ifdef LFS_MULTIVERSION
     // this driver only supports minor version < current minor version
     LFS_ASSERT(!lfs->cfg->disk_version || (
@@ -4248,6 +5763,22 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
         }
     }
 
+#ifndef LFS_READONLY
+    // setup the reservoir of erased blocks
+    lfs->reserve.count = 0;
+    lfs->reserve.buffer = NULL;
+    if (lfs->cfg->reserve_buffer) {
+        lfs->reserve.buffer = lfs->cfg->reserve_buffer;
+    } else if (lfs->cfg->reserve_count > 0) {
+        lfs->reserve.buffer = lfs_malloc(
+                lfs->cfg->reserve_count*sizeof(struct lfs_reserved));
+        if (!lfs->reserve.buffer) {
+            err = LFS_ERR_NOMEM;
+            goto cleanup;
+        }
+    }
+#endif
+
     // check that the size limits are sane
     LFS_ASSERT(lfs->cfg->name_max <= LFS_NAME_MAX);
     lfs->name_max = lfs->cfg->name_max;
@@ -4298,6 +5829,12 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->gdisk = (lfs_gstate_t){0};
     lfs->gstate = (lfs_gstate_t){0};
     lfs->gdelta = (lfs_gstate_t){0};
+#ifndef LFS_READONLY
+    lfs_fs_gcrewind(lfs);
+    lfs->gc.erased = LFS_BLOCK_NULL;
+    lfs->txn.journal = NULL;
+    lfs->txn.size = 0;
+#endif
 #ifdef LFS_MIGRATE
     lfs->lfs1 = NULL;
 #endif
@@ -4323,6 +5860,12 @@ static int lfs_deinit(lfs_t *lfs) {
         lfs_free(lfs->lookahead.buffer);
     }
 
+#ifndef LFS_READONLY
+    if (!lfs->cfg->reserve_buffer) {
+        lfs_free(lfs->reserve.buffer);
+    }
+#endif
+
     return 0;
 }
 
@@ -4561,6 +6104,15 @@ static int lfs_mount_(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->lookahead.start = lfs->seed % lfs->block_count;
     lfs_alloc_drop(lfs);
 
+#ifndef LFS_READONLY
+    // finish a group sync cut by a power loss before anything reads the
+    // files, see lfs_file_syncgroup
+    err = lfs_fs_txnreplay(lfs);
+    if (err) {
+        goto cleanup;
+    }
+#endif
+
     return 0;
 
 cleanup:
@@ -4716,6 +6268,24 @@ int lfs_fs_traverse_(lfs_t *lfs,
             }
         }
     }
+
+    // files of a group sync being replayed, their blocks are only in the
+    // journal until it is applied
+    for (lfs_size_t off = 0; off < lfs->txn.size;) {
+        lfs_tag_t tag = lfs_txn_tag(lfs->txn.journal, off);
+        if (lfs_tag_type3(tag) == LFS_TYPE_CTZSTRUCT) {
+            struct lfs_ctz ctz;
+            memcpy(&ctz, &lfs->txn.journal[off + sizeof(tag)], sizeof(ctz));
+            lfs_ctz_fromle32(&ctz);
+            int err = lfs_ctz_traverse(lfs, NULL, &lfs->rcache,
+                    ctz.head, ctz.size, cb, data);
+            if (err) {
+                return err;
+            }
+        }
+
+        off += sizeof(tag) + lfs_tag_size(tag);
+    }
 #endif
 
     return 0;
@@ -5078,6 +6648,171 @@ static int lfs_fs_forceconsistency(lfs_t *lfs) {
 }
 #endif
 
+#ifndef LFS_READONLY
+// tag of a journal at off, the tags are little-endian
+static lfs_tag_t lfs_txn_tag(const uint8_t *journal, lfs_size_t off) {
+    lfs_tag_t tag;
+    memcpy(&tag, &journal[off], sizeof(tag));
+    return lfs_fromle32(tag);
+}
+
+// checks a journal read back from the superblock entry before trusting it:
+// the crc must match, every tag must be whole, a record starts with a null
+// terminated path and has a struct, returns the size of its records
+static lfs_ssize_t lfs_txn_check(const uint8_t *journal, lfs_size_t size) {
+    uint32_t jcrc;
+    if (size < sizeof(lfs_tag_t) + sizeof(jcrc)) {
+        return LFS_ERR_CORRUPT;
+    }
+    size -= sizeof(jcrc);
+    memcpy(&jcrc, &journal[size], sizeof(jcrc));
+    if (lfs_fromle32(jcrc) != lfs_crc(0xffffffff, journal, size)) {
+        return LFS_ERR_CORRUPT;
+    }
+
+    for (lfs_size_t off = 0; off < size;) {
+        if (off + sizeof(lfs_tag_t) > size) {
+            return LFS_ERR_CORRUPT;
+        }
+
+        lfs_tag_t jtag = lfs_txn_tag(journal, off);
+        lfs_size_t jsize = lfs_tag_size(jtag);
+        if (off + sizeof(jtag) + jsize > size ||
+                (off == 0 && lfs_tag_type3(jtag) != LFS_TYPE_REG) ||
+                (lfs_tag_type3(jtag) == LFS_TYPE_REG &&
+                    (jsize == 0 ||
+                        journal[off + sizeof(jtag) + jsize-1] != '\0')) ||
+                (lfs_tag_type3(jtag) == LFS_TYPE_CTZSTRUCT &&
+                    jsize != sizeof(struct lfs_ctz))) {
+            return LFS_ERR_CORRUPT;
+        }
+
+        off += sizeof(jtag) + jsize;
+    }
+
+    return size;
+}
+
+// a commit per file of a journal, a path that no longer resolves to a file
+// is left out, applying a record twice does no harm, so a file with more
+// attributes than fit in attrs takes more than one commit, its struct and
+// zattr come first and go in the first of them
+static int lfs_txn_apply(lfs_t *lfs, const uint8_t *journal,
+        lfs_size_t size) {
+    for (lfs_size_t off = 0; off < size;) {
+        lfs_tag_t jtag = lfs_txn_tag(journal, off);
+        const char *path = (const char*)&journal[off + sizeof(jtag)];
+        off += sizeof(jtag) + lfs_tag_size(jtag);
+
+        lfs_mdir_t fdir;
+        uint16_t fid;
+        lfs_stag_t tag = lfs_dir_find(lfs, &fdir, &path, &fid);
+        if (tag < 0 && tag != LFS_ERR_NOENT) {
+            return tag;
+        }
+
+        struct lfs_mattr attrs[4];
+        int n = 0;
+        while (true) {
+            bool end = off >= size || lfs_tag_type3(
+                    jtag = lfs_txn_tag(journal, off)) == LFS_TYPE_REG;
+            if (!end) {
+                attrs[n++] = (struct lfs_mattr){
+                        LFS_MKTAG(lfs_tag_type3(jtag), fid,
+                            lfs_tag_size(jtag)),
+                        &journal[off + sizeof(jtag)]};
+                off += sizeof(jtag) + lfs_tag_size(jtag);
+            }
+
+            if ((end || n == (int)(sizeof(attrs)/sizeof(attrs[0]))) &&
+                    n > 0) {
+                if (tag >= 0 && lfs_tag_type3(tag) == LFS_TYPE_REG) {
+                    int err = lfs_dir_commit(lfs, &fdir, attrs, n);
+                    if (err) {
+                        return err;
+                    }
+                }
+                n = 0;
+            }
+
+            if (end) {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// applies the journal of a group sync cut by a power loss, see
+// lfs_file_syncgroup, and removes it
+static int lfs_fs_txnreplay(lfs_t *lfs) {
+    lfs_mdir_t root;
+    int err = lfs_dir_fetch(lfs, &root, lfs->root);
+    if (err) {
+        return err;
+    }
+
+    // there is rarely a journal, look for it before taking a buffer
+    lfs_stag_t tag = lfs_dir_get(lfs, &root, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_USERATTR + LFS_TXN_ATTR, 0, 0), NULL);
+    if (tag < 0) {
+        return (tag == LFS_ERR_NOENT) ? 0 : tag;
+    }
+
+    LFS_DEBUG("Found pending group sync in {0x%"PRIx32", 0x%"PRIx32"}",
+            root.pair[0], root.pair[1]);
+    lfs_size_t jsize = lfs_min(lfs_tag_size(tag), lfs->cfg->cache_size);
+    uint8_t *journal = lfs->cfg->txn_buffer;
+    if (!journal) {
+        journal = lfs_malloc(jsize);
+        if (!journal) {
+            return LFS_ERR_NOMEM;
+        }
+    }
+
+    tag = lfs_dir_get(lfs, &root, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_USERATTR + LFS_TXN_ATTR, 0, jsize), journal);
+    if (tag < 0) {
+        err = tag;
+        goto cleanup;
+    }
+
+    lfs_ssize_t size = lfs_txn_check(journal, jsize);
+    if (size < 0) {
+        // only lfs_file_syncgroup writes it, but don't let a bad one keep
+        // the filesystem from mounting
+        LFS_WARN("Dropping invalid group sync journal");
+    } else {
+        // its ctz lists are only referenced here until applied, see
+        // lfs_fs_traverse_
+        lfs->txn.journal = journal;
+        lfs->txn.size = size;
+        err = lfs_txn_apply(lfs, journal, size);
+        lfs->txn.journal = NULL;
+        lfs->txn.size = 0;
+        if (err) {
+            goto cleanup;
+        }
+    }
+
+    // and the journal goes
+    err = lfs_dir_fetch(lfs, &root, lfs->root);
+    if (err) {
+        goto cleanup;
+    }
+
+    err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_USERATTR + LFS_TXN_ATTR, 0, 0x3ff), NULL}));
+
+cleanup:
+    if (!lfs->cfg->txn_buffer) {
+        lfs_free(journal);
+    }
+    return err;
+}
+#endif
+
 #ifndef LFS_READONLY
 static int lfs_fs_mkconsistent_(lfs_t *lfs) {
     // lfs_fs_forceconsistency does most of the work here
@@ -5127,6 +6862,13 @@ static lfs_ssize_t lfs_fs_size_(lfs_t *lfs) {
 
 // explicit garbage collection
 #ifndef LFS_READONLY
+static bool lfs_fs_gc_needscompact(lfs_t *lfs, const lfs_mdir_t *mdir) {
+    // not erased? exceeds our compaction threshold?
+    return !mdir->erased || ((lfs->cfg->compact_thresh == 0)
+            ? mdir->off > lfs->cfg->block_size - lfs->cfg->block_size/8
+            : mdir->off > lfs->cfg->compact_thresh);
+}
+
 static int lfs_fs_gc_(lfs_t *lfs) {
     // force consistency, even if we're not necessarily going to write,
     // because this function is supposed to take care of janitorial work
@@ -5149,10 +6891,7 @@ static int lfs_fs_gc_(lfs_t *lfs) {
                 return err;
             }
 
-            // not erased? exceeds our compaction threshold?
-            if (!mdir.erased || ((lfs->cfg->compact_thresh == 0)
-                    ? mdir.off > lfs->cfg->block_size - lfs->cfg->block_size/8
-                    : mdir.off > lfs->cfg->compact_thresh)) {
+            if (lfs_fs_gc_needscompact(lfs, &mdir)) {
                 // the easiest way to trigger a compaction is to mark
                 // the mdir as unerased and add an empty commit
                 mdir.erased = false;
@@ -5172,7 +6911,80 @@ static int lfs_fs_gc_(lfs_t *lfs) {
         }
     }
 
-    return 0;
+    // fill the reservoir of erased blocks
+    while (true) {
+        err = lfs_alloc_reserve(lfs);
+        if (err <= 0) {
+            return err;
+        }
+    }
+}
+
+static int lfs_fs_gcstep_(lfs_t *lfs) {
+    // an unfinished move or orphans left by a power loss are fixed up
+    // here the first time, this is the one step that is not bounded
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        return err;
+    }
+
+    // a block for the reservoir first, writes need them more often than
+    // a compaction
+    err = lfs_alloc_reserve(lfs);
+    if (err) {
+        return err;
+    }
+
+    // compaction disabled, or nothing it could gain
+    if (lfs->cfg->compact_thresh
+            >= lfs->cfg->block_size - lfs->cfg->prog_size) {
+        return 0;
+    }
+
+    lfs_mdir_t mdir;
+    err = lfs_dir_fetch(lfs, &mdir, lfs->gc.tail);
+    if (err) {
+        return err;
+    }
+
+    if (lfs_fs_gc_needscompact(lfs, &mdir)) {
+        // first step, erase the block the compaction will write to, a
+        // commit in the meantime still appends to the other one; a pair
+        // due for relocation gets a new block instead
+        if (mdir.pair[1] != lfs->gc.erased
+                && !lfs_dir_needsrelocation(lfs, &mdir)) {
+            if (lfs->rcache.block == mdir.pair[1]) {
+                lfs_cache_drop(lfs, &lfs->rcache);
+            }
+            err = lfs_bd_erase(lfs, mdir.pair[1]);
+            if (err) {
+                return err;
+            }
+            lfs->gc.erased = mdir.pair[1];
+            return 1;
+        }
+
+        // second step, compact into it, this is the commit lfs_fs_gc uses
+        mdir.erased = false;
+        err = lfs_dir_commit(lfs, &mdir, NULL, 0);
+        if (err) {
+            return err;
+        }
+
+        // the commit may have rewound the walk
+        if (lfs_pair_cmp(lfs->gc.tail, mdir.pair) != 0) {
+            return 1;
+        }
+    }
+
+    // on to the next pair, or back to the superblock after the last one
+    if (lfs_pair_isnull(mdir.tail)) {
+        lfs_fs_gcrewind(lfs);
+        return 0;
+    }
+    lfs->gc.tail[0] = mdir.tail[0];
+    lfs->gc.tail[1] = mdir.tail[1];
+    return 1;
 }
 #endif
 
@@ -5933,7 +7745,9 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
             cfg->name_max, cfg->file_max, cfg->attr_max);
 
+    LFS_STATS_BEGIN();
     err = lfs_mount_(lfs, cfg);
+    LFS_STATS_END(lfs, LFS_STATS_MOUNT);
 
     LFS_TRACE("lfs_mount -> %d", err);
     LFS_UNLOCK(cfg);
@@ -5962,7 +7776,9 @@ int lfs_remove(lfs_t *lfs, const char *path) {
     }
     LFS_TRACE("lfs_remove(%p, \"%s\")", (void*)lfs, path);
 
+    LFS_STATS_BEGIN();
     err = lfs_remove_(lfs, path);
+    LFS_STATS_END(lfs, LFS_STATS_REMOVE);
 
     LFS_TRACE("lfs_remove -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -5978,7 +7794,9 @@ int lfs_rename(lfs_t *lfs, const char *oldpath, const char *newpath) {
     }
     LFS_TRACE("lfs_rename(%p, \"%s\", \"%s\")", (void*)lfs, oldpath, newpath);
 
+    LFS_STATS_BEGIN();
     err = lfs_rename_(lfs, oldpath, newpath);
+    LFS_STATS_END(lfs, LFS_STATS_RENAME);
 
     LFS_TRACE("lfs_rename -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6060,7 +7878,9 @@ int lfs_file_open(lfs_t *lfs, lfs_file_t *file, const char *path, int flags) {
             (void*)lfs, (void*)file, path, flags);
     LFS_ASSERT(!lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
     err = lfs_file_open_(lfs, file, path, flags);
+    LFS_STATS_END(lfs, LFS_STATS_OPEN);
 
     LFS_TRACE("lfs_file_open -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6075,13 +7895,24 @@ int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
     if (err) {
         return err;
     }
+#ifndef LFS_NO_COMPRESS
+    LFS_TRACE("lfs_file_opencfg(%p, %p, \"%s\", %x, %p {"
+                 ".buffer=%p, .attrs=%p, .attr_count=%"PRIu32", "
+                 ".zchunk=%"PRIu32", .zbuffer=%p})",
+            (void*)lfs, (void*)file, path, flags,
+            (void*)cfg, cfg->buffer, (void*)cfg->attrs, cfg->attr_count,
+            cfg->zchunk, cfg->zbuffer);
+#else
     LFS_TRACE("lfs_file_opencfg(%p, %p, \"%s\", %x, %p {"
                  ".buffer=%p, .attrs=%p, .attr_count=%"PRIu32"})",
             (void*)lfs, (void*)file, path, flags,
             (void*)cfg, cfg->buffer, (void*)cfg->attrs, cfg->attr_count);
+#endif
     LFS_ASSERT(!lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
     err = lfs_file_opencfg_(lfs, file, path, flags, cfg);
+    LFS_STATS_END(lfs, LFS_STATS_OPEN);
 
     LFS_TRACE("lfs_file_opencfg -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6096,7 +7927,9 @@ int lfs_file_close(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_close(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
     err = lfs_file_close_(lfs, file);
+    LFS_STATS_END(lfs, LFS_STATS_CLOSE);
 
     LFS_TRACE("lfs_file_close -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6112,7 +7945,9 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_sync(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
     err = lfs_file_sync_(lfs, file);
+    LFS_STATS_END(lfs, LFS_STATS_SYNC);
 
     LFS_TRACE("lfs_file_sync -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6120,6 +7955,29 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file) {
 }
 #endif
 
+#ifndef LFS_READONLY
+int lfs_file_syncgroup(lfs_t *lfs, lfs_file_t *const *files,
+        lfs_size_t count) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_file_syncgroup(%p, %p, %"PRIu32")",
+            (void*)lfs, (void*)files, count);
+    for (lfs_size_t i = 0; i < count; i++) {
+        LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)files[i]));
+    }
+
+    LFS_STATS_BEGIN();
+    err = lfs_file_syncgroup_(lfs, files, count);
+    LFS_STATS_END(lfs, LFS_STATS_SYNC);
+
+    LFS_TRACE("lfs_file_syncgroup -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
 lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
         void *buffer, lfs_size_t size) {
     int err = LFS_LOCK(lfs->cfg);
@@ -6130,7 +7988,15 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, buffer, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
+#ifndef LFS_NO_COMPRESS
+    lfs_ssize_t res = (file->z.chunk)
+            ? lfs_file_zread(lfs, file, buffer, size)
+            : lfs_file_read_(lfs, file, buffer, size);
+#else
     lfs_ssize_t res = lfs_file_read_(lfs, file, buffer, size);
+#endif
+    LFS_STATS_END(lfs, LFS_STATS_READ);
 
     LFS_TRACE("lfs_file_read -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6148,7 +8014,15 @@ lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, buffer, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_STATS_BEGIN();
+#ifndef LFS_NO_COMPRESS
+    lfs_ssize_t res = (file->z.chunk)
+            ? lfs_file_zwrite(lfs, file, buffer, size)
+            : lfs_file_write_(lfs, file, buffer, size);
+#else
     lfs_ssize_t res = lfs_file_write_(lfs, file, buffer, size);
+#endif
+    LFS_STATS_END(lfs, LFS_STATS_WRITE);
 
     LFS_TRACE("lfs_file_write -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6166,7 +8040,13 @@ lfs_soff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, off, whence);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+#ifndef LFS_NO_COMPRESS
+    lfs_soff_t res = (file->z.chunk)
+            ? lfs_file_zseek(lfs, file, off, whence)
+            : lfs_file_seek_(lfs, file, off, whence);
+#else
     lfs_soff_t res = lfs_file_seek_(lfs, file, off, whence);
+#endif
 
     LFS_TRACE("lfs_file_seek -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6183,7 +8063,13 @@ int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             (void*)lfs, (void*)file, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+#ifndef LFS_NO_COMPRESS
+    err = (file->z.chunk)
+            ? lfs_file_ztruncate(lfs, file, size)
+            : lfs_file_truncate_(lfs, file, size);
+#else
     err = lfs_file_truncate_(lfs, file, size);
+#endif
 
     LFS_TRACE("lfs_file_truncate -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6199,7 +8085,13 @@ lfs_soff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_tell(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+#ifndef LFS_NO_COMPRESS
+    lfs_soff_t res = (file->z.chunk)
+            ? (lfs_soff_t)file->z.pos
+            : lfs_file_tell_(lfs, file);
+#else
     lfs_soff_t res = lfs_file_tell_(lfs, file);
+#endif
 
     LFS_TRACE("lfs_file_tell -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6213,7 +8105,15 @@ int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file) {
     }
     LFS_TRACE("lfs_file_rewind(%p, %p)", (void*)lfs, (void*)file);
 
+#ifndef LFS_NO_COMPRESS
+    if (file->z.chunk) {
+        file->z.pos = 0;
+    } else {
+        err = lfs_file_rewind_(lfs, file);
+    }
+#else
     err = lfs_file_rewind_(lfs, file);
+#endif
 
     LFS_TRACE("lfs_file_rewind -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6228,7 +8128,13 @@ lfs_soff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_size(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+#ifndef LFS_NO_COMPRESS
+    lfs_soff_t res = (file->z.chunk)
+            ? (lfs_soff_t)file->z.size
+            : lfs_file_size_(lfs, file);
+#else
     lfs_soff_t res = lfs_file_size_(lfs, file);
+#endif
 
     LFS_TRACE("lfs_file_size -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6413,6 +8319,22 @@ int lfs_fs_gc(lfs_t *lfs) {
 }
 #endif
 
+#ifndef LFS_READONLY
+int lfs_fs_gcstep(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_gcstep(%p)", (void*)lfs);
+
+    err = lfs_fs_gcstep_(lfs);
+
+    LFS_TRACE("lfs_fs_gcstep -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
 #ifndef LFS_READONLY
 int lfs_fs_grow(lfs_t *lfs, lfs_size_t block_count) {
     int err = LFS_LOCK(lfs->cfg);
@@ -6429,6 +8351,36 @@ int lfs_fs_grow(lfs_t *lfs, lfs_size_t block_count) {
 }
 #endif
 
+#ifdef LFS_STATS
+int lfs_stats(lfs_t *lfs, struct lfs_stats *stats) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_stats(%p, %p)", (void*)lfs, (void*)stats);
+
+    memcpy(stats, &lfs->stats, sizeof(*stats));
+
+    LFS_TRACE("lfs_stats -> %d", 0);
+    LFS_UNLOCK(lfs->cfg);
+    return 0;
+}
+
+int lfs_stats_reset(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_stats_reset(%p)", (void*)lfs);
+
+    memset(&lfs->stats, 0, sizeof(lfs->stats));
+
+    LFS_TRACE("lfs_stats_reset -> %d", 0);
+    LFS_UNLOCK(lfs->cfg);
+    return 0;
+}
+#endif
+
 #ifdef LFS_MIGRATE
 int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
     int err = LFS_LOCK(cfg);
@@ -0,0 +1,99 @@
+/*
+ * lfs_at45.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "lfs_at45.h"
+
+
+/*Static buffers in SRAM2, so littlefs does not need the heap*/
+static uint8_t lfs_at45_read_buf[LFS_AT45_CACHE_SIZE] SRAM2_BSS;
+static uint8_t lfs_at45_prog_buf[LFS_AT45_CACHE_SIZE] SRAM2_BSS;
+static uint8_t lfs_at45_lookahead_buf[LFS_AT45_LOOKAHEAD_SIZE] SRAM2_BSS;
+
+/*
+ * The AT45 programs a whole page from its SRAM buffer, so the program size is the page
+ * size. littlefs erases a block before it programs it, so the page program without the
+ * built-in erase is enough (tP instead of tEP); it only clears bits, which is what
+ * LFS_O_LOG needs to program the last page of a log again.
+ */
+const struct lfs_config lfs_at45_cfg = {
+	.read  = lfs_at45_read,
+	.prog  = lfs_at45_prog,
+	.erase = lfs_at45_erase,
+	.sync  = lfs_at45_sync,
+
+	.read_size      = 1,
+	.prog_size      = LFS_AT45_PAGE_SIZE,
+	.block_size     = LFS_AT45_BLOCK_SIZE,
+	.block_count    = LFS_AT45_BLOCK_COUNT,
+	.cache_size     = LFS_AT45_CACHE_SIZE,
+	.lookahead_size = LFS_AT45_LOOKAHEAD_SIZE,
+	.block_cycles   = LFS_AT45_BLOCK_CYCLES,
+	.prog_rewrite   = true,
+
+	.read_buffer      = lfs_at45_read_buf,
+	.prog_buffer      = lfs_at45_prog_buf,
+	.lookahead_buffer = lfs_at45_lookahead_buf,
+};
+
+
+/**
+ * @brief Reads a region of a block (continuous array read).
+ */
+int lfs_at45_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+	at45db_read_data(block * c->block_size + off, (uint8_t *)buffer, size);
+
+	return LFS_ERR_OK;
+}
+
+/**
+ * @brief Programs whole pages of a block, one buffer-to-main operation (without erase)
+ * per page.
+ */
+int lfs_at45_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+	uint32_t addr = block * c->block_size + off;
+	const uint8_t *data = buffer;
+
+	for (lfs_size_t i = 0; i < size; i += c->prog_size) {
+		at45db_program_noerase(addr + i, &data[i], c->prog_size);
+
+		if (at45db_fault_check()) {
+			return LFS_ERR_IO;
+		}
+	}
+
+	return LFS_ERR_OK;
+}
+
+/**
+ * @brief Erases a block.
+ */
+int lfs_at45_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	(void)c;
+
+	at45db_block_erase(block);
+
+	/*Wait for the erase to finish*/
+	if (!at45db_wait_ready(AT45_TBE_US) || at45db_fault_check()) {
+		return LFS_ERR_IO;
+	}
+
+	return LFS_ERR_OK;
+}
+
+/**
+ * @brief Every operation completes before returning, nothing to flush.
+ */
+int lfs_at45_sync(const struct lfs_config *c)
+{
+	(void)c;
+
+	return LFS_ERR_OK;
+}
@@ -0,0 +1,96 @@
+/*
+ * lfs_iflash.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "lfs_iflash.h"
+
+
+/*Static buffers in SRAM2, so littlefs does not need the heap*/
+static uint8_t lfs_iflash_read_buf[LFS_IFLASH_CACHE_SIZE] SRAM2_BSS;
+static uint8_t lfs_iflash_prog_buf[LFS_IFLASH_CACHE_SIZE] SRAM2_BSS;
+static uint8_t lfs_iflash_lookahead_buf[LFS_IFLASH_LOOKAHEAD_SIZE] SRAM2_BSS;
+
+/*
+ * Reads are memory mapped, so the read size is one byte. A double-word can be
+ * programmed only once between erases, which matches the littlefs program model.
+ */
+const struct lfs_config lfs_iflash_cfg = {
+	.read  = lfs_iflash_read,
+	.prog  = lfs_iflash_prog,
+	.erase = lfs_iflash_erase,
+	.sync  = lfs_iflash_sync,
+
+	.read_size      = 1,
+	.prog_size      = LFS_IFLASH_PROG_SIZE,
+	.block_size     = LFS_IFLASH_BLOCK_SIZE,
+	.block_count    = LFS_IFLASH_BLOCK_COUNT,
+	.cache_size     = LFS_IFLASH_CACHE_SIZE,
+	.lookahead_size = LFS_IFLASH_LOOKAHEAD_SIZE,
+	.block_cycles   = LFS_IFLASH_BLOCK_CYCLES,
+	.file_max       = LFS_IFLASH_FILE_MAX,
+
+	.read_buffer      = lfs_iflash_read_buf,
+	.prog_buffer      = lfs_iflash_prog_buf,
+	.lookahead_buffer = lfs_iflash_lookahead_buf,
+};
+
+
+/**
+ * @brief Reads a region of a block straight from the memory map.
+ */
+int lfs_iflash_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+	BL_FLASH_READ(buffer, bl_flash_data_base() + block * c->block_size + off, size);
+
+	return LFS_ERR_OK;
+}
+
+/**
+ * @brief Programs a region of a block, littlefs keeps it aligned to the double-word.
+ */
+int lfs_iflash_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+	uint32_t addr = bl_flash_data_base() + block * c->block_size + off;
+	uint16_t was_locked;
+	uint16_t res;
+
+	was_locked = bl_flash_unlock();
+	res = bl_flash_program(addr, buffer, size);
+	if (was_locked) {
+		bl_flash_lock();
+	}
+
+	return res ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+/**
+ * @brief Erases the page that holds the block.
+ */
+int lfs_iflash_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	uint32_t addr = bl_flash_data_base() + block * c->block_size;
+	uint16_t was_locked;
+	uint16_t res;
+
+	was_locked = bl_flash_unlock();
+	res = bl_flash_page_erase(bl_flash_get_page(addr), bl_flash_get_bank(addr));
+	if (was_locked) {
+		bl_flash_lock();
+	}
+
+	return res ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+/**
+ * @brief Every operation completes before returning, nothing to flush.
+ */
+int lfs_iflash_sync(const struct lfs_config *c)
+{
+	(void)c;
+
+	return LFS_ERR_OK;
+}
@@ -0,0 +1,144 @@
+/*
+ * lfs_tier.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "lfs_tier.h"
+
+
+static const char *const lfs_tier_hot_dirs[] = LFS_TIER_HOT_DIRS;
+
+
+/**
+ * @brief Mounts a file system, formatting it the first time. Only a missing or
+ * corrupted superblock formats, an I/O error of the driver is returned as it is,
+ * so a transient fault never wipes a valid file system.
+ */
+static int lfs_tier_mount_one(lfs_t *lfs, const struct lfs_config *cfg)
+{
+	int res = lfs_mount(lfs, cfg);
+
+	if (res == LFS_ERR_CORRUPT) {
+		/*First boot, or the storage is corrupted*/
+		res = lfs_format(lfs, cfg);
+		if (res != LFS_ERR_OK) {
+			return res;
+		}
+		res = lfs_mount(lfs, cfg);
+	}
+
+	return res;
+}
+
+/**
+ * @brief Mounts both tiers and creates the hot directories.
+ * @retval LFS_ERR_OK on success, a negative littlefs error otherwise.
+ */
+int lfs_tier_mount(lfs_tier_t *tier)
+{
+	int res;
+
+	res = lfs_tier_mount_one(&tier->hot, &lfs_iflash_cfg);
+	if (res != LFS_ERR_OK) {
+		return res;
+	}
+
+	res = lfs_tier_mount_one(&tier->cold, &lfs_at45_cfg);
+	if (res != LFS_ERR_OK) {
+		lfs_unmount(&tier->hot);
+		return res;
+	}
+
+	for (uint32_t i = 0; i < sizeof(lfs_tier_hot_dirs)/sizeof(lfs_tier_hot_dirs[0]); i++) {
+		res = lfs_mkdir(&tier->hot, lfs_tier_hot_dirs[i]);
+		if (res != LFS_ERR_OK && res != LFS_ERR_EXIST) {
+			lfs_tier_unmount(tier);
+			return res;
+		}
+	}
+
+	return LFS_ERR_OK;
+}
+
+int lfs_tier_unmount(lfs_tier_t *tier)
+{
+	int res = lfs_unmount(&tier->hot);
+	int res2 = lfs_unmount(&tier->cold);
+
+	return (res != LFS_ERR_OK) ? res : res2;
+}
+
+/**
+ * @brief Selects the file system of a path, from its top level directory.
+ * @retval The hot or the cold file system.
+ */
+lfs_t *lfs_tier_route(lfs_tier_t *tier, const char *path)
+{
+	size_t len;
+
+	/*Both "cfg/x" and "/cfg/x" name the same file*/
+	while (*path == '/') {
+		path++;
+	}
+
+	for (uint32_t i = 0; i < sizeof(lfs_tier_hot_dirs)/sizeof(lfs_tier_hot_dirs[0]); i++) {
+		len = strlen(lfs_tier_hot_dirs[i] + 1);
+		if (strncmp(path, lfs_tier_hot_dirs[i] + 1, len) == 0 && (path[len] == '/' || path[len] == '\0')) {
+			return &tier->hot;
+		}
+	}
+
+	return &tier->cold;
+}
+
+/**
+ * @brief Opens a file on the tier of its path. LFS_O_LOG only applies on the AT45, the
+ * internal flash cannot program a double-word again and littlefs ignores it there.
+ */
+int lfs_tier_file_open(lfs_tier_t *tier, lfs_tier_file_t *file, const char *path, int flags)
+{
+	file->fs = lfs_tier_route(tier, path);
+
+	return lfs_file_open(file->fs, &file->file, path, flags);
+}
+
+lfs_ssize_t lfs_tier_file_read(lfs_tier_file_t *file, void *buffer, lfs_size_t size)
+{
+	return lfs_file_read(file->fs, &file->file, buffer, size);
+}
+
+/**
+ * @brief Writes to a file. Hot files beyond LFS_IFLASH_FILE_MAX fail with LFS_ERR_FBIG.
+ */
+lfs_ssize_t lfs_tier_file_write(lfs_tier_file_t *file, const void *buffer, lfs_size_t size)
+{
+	return lfs_file_write(file->fs, &file->file, buffer, size);
+}
+
+int lfs_tier_file_sync(lfs_tier_file_t *file)
+{
+	return lfs_file_sync(file->fs, &file->file);
+}
+
+int lfs_tier_file_close(lfs_tier_file_t *file)
+{
+	return lfs_file_close(file->fs, &file->file);
+}
+
+int lfs_tier_stat(lfs_tier_t *tier, const char *path, struct lfs_info *info)
+{
+	return lfs_stat(lfs_tier_route(tier, path), path, info);
+}
+
+int lfs_tier_remove(lfs_tier_t *tier, const char *path)
+{
+	return lfs_remove(lfs_tier_route(tier, path), path);
+}
+
+int lfs_tier_mkdir(lfs_tier_t *tier, const char *path)
+{
+	return lfs_mkdir(lfs_tier_route(tier, path), path);
+}
@@ -14,7 +14,7 @@
 // If user provides their own CRC impl we don't need this
 #ifndef LFS_CRC
 // Software CRC implementation with small lookup table
-uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
+LFS_RAMFUNC uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
     static const uint32_t rtable[16] = {
         0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
         0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
@@ -24,11 +24,14 @@ uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
 
     const uint8_t *data = buffer;
 
+    LFS_PROF_BEGIN(PROF_LFS_CRC);
+
     for (size_t i = 0; i < size; i++) {
         crc = (crc >> 4) ^ rtable[(crc ^ (data[i] >> 0)) & 0xf];
         crc = (crc >> 4) ^ rtable[(crc ^ (data[i] >> 4)) & 0xf];
     }
 
+    LFS_PROF_END(PROF_LFS_CRC);
     return crc;
 }
 #endif
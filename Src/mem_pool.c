@@ -0,0 +1,482 @@
+/*
+ * mem_pool.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "mem_pool.h"
+
+
+/*TLSF parameters: 8 second level lists, blocks below 64 bytes in the first one*/
+#define TLSF_ALIGN			8U
+#define TLSF_SL_LOG2		3U
+#define TLSF_SL_COUNT		(1U << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT		(TLSF_SL_LOG2 + 3U)
+#define TLSF_SMALL			(1U << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT		20U
+
+/*Flags in the size field of a block*/
+#define TLSF_FREE			0x1U
+#define TLSF_PREV_FREE		0x2U
+#define TLSF_FLAGS			0x3U
+
+/**
+ * @brief Header of a TLSF block. The free list links use the payload, so they
+ * exist only while the block is free.
+ */
+typedef struct tlsf_block_ {
+	struct tlsf_block_ *prev_phys;	//Valid only while the previous block is free
+	size_t size;					//Payload size and flags
+	struct tlsf_block_ *next_free;
+	struct tlsf_block_ *prev_free;
+}tlsf_block_t;
+
+/**
+ * @brief The header alone, the same leading members as tlsf_block_t. The sentinel at
+ * the end of the arena has no room for the free list links, so it is accessed as this.
+ */
+typedef struct {
+	tlsf_block_t *prev_phys;
+	size_t size;
+}tlsf_hdr_t;
+
+#define TLSF_HDR			offsetof(tlsf_block_t, next_free)
+#define TLSF_MIN_PAYLOAD	(sizeof(tlsf_block_t) - TLSF_HDR)
+
+/**
+ * @brief A pool of fixed size blocks.
+ */
+typedef struct {
+	uint8_t *base;
+	uint8_t *end;
+	void *free_list;
+	uint16_t block_size;
+	uint16_t blocks;
+	uint16_t used;
+	uint16_t high_water;
+}mem_class_t;
+
+static const uint16_t class_size[MEM_POOL_NCLASSES]   = MEM_POOL_CLASSES;
+static const uint16_t class_blocks[MEM_POOL_NCLASSES] = MEM_POOL_BLOCKS;
+
+static uint64_t pool_mem[(MEM_POOL_BYTES + 7U) / 8U] SRAM2_BSS;
+static uint64_t tlsf_mem[MEM_POOL_TLSF_SIZE / 8U] SRAM2_BSS;
+
+static mem_class_t classes[MEM_POOL_NCLASSES];
+
+/*TLSF free lists and their bitmaps*/
+static uint32_t fl_bitmap;
+static uint32_t sl_bitmap[TLSF_FL_COUNT];
+static tlsf_block_t *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static tlsf_block_t *tlsf_first;
+
+static mem_pool_stats_t stats;
+static uint8_t initialized;
+
+
+/*Index of the most and least significant set bits*/
+static inline uint32_t tlsf_fls(uint32_t x)
+{
+	return 31U - (uint32_t)__builtin_clz(x);
+}
+
+static inline uint32_t tlsf_ffs(uint32_t x)
+{
+	return (uint32_t)__builtin_ctz(x);
+}
+
+static inline size_t tlsf_size(const tlsf_block_t *b)
+{
+	return b->size & ~(size_t)TLSF_FLAGS;
+}
+
+static inline tlsf_block_t *tlsf_next_phys(const tlsf_block_t *b)
+{
+	return (tlsf_block_t *)((uint8_t *)b + TLSF_HDR + tlsf_size(b));
+}
+
+static inline void *tlsf_payload(tlsf_block_t *b)
+{
+	return (uint8_t *)b + TLSF_HDR;
+}
+
+/**
+ * @brief Maps a block size to its first and second level list.
+ */
+static void tlsf_mapping(size_t size, uint32_t *fl, uint32_t *sl)
+{
+	uint32_t f;
+
+	if (size < TLSF_SMALL) {
+		*fl = 0;
+		*sl = (uint32_t)size / (TLSF_SMALL / TLSF_SL_COUNT);
+	} else {
+		f = tlsf_fls((uint32_t)size);
+		*sl = ((uint32_t)size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = f - (TLSF_FL_SHIFT - 1U);
+	}
+}
+
+static void tlsf_insert(tlsf_block_t *b)
+{
+	uint32_t fl, sl;
+
+	tlsf_mapping(tlsf_size(b), &fl, &sl);
+
+	b->prev_free = NULL;
+	b->next_free = free_lists[fl][sl];
+	if (b->next_free) {
+		b->next_free->prev_free = b;
+	}
+	free_lists[fl][sl] = b;
+
+	fl_bitmap     |= (1U << fl);
+	sl_bitmap[fl] |= (1U << sl);
+}
+
+static void tlsf_remove(tlsf_block_t *b)
+{
+	uint32_t fl, sl;
+
+	tlsf_mapping(tlsf_size(b), &fl, &sl);
+
+	if (b->prev_free) {
+		b->prev_free->next_free = b->next_free;
+	} else {
+		free_lists[fl][sl] = b->next_free;
+	}
+	if (b->next_free) {
+		b->next_free->prev_free = b->prev_free;
+	}
+
+	if (!free_lists[fl][sl]) {
+		sl_bitmap[fl] &= ~(1U << sl);
+		if (!sl_bitmap[fl]) {
+			fl_bitmap &= ~(1U << fl);
+		}
+	}
+}
+
+/**
+ * @brief Finds a free block of at least size bytes: the size is rounded up to the next
+ * list, so any block of that list fits, then two bitmap searches find a non empty list.
+ */
+static tlsf_block_t *tlsf_find(size_t size)
+{
+	uint32_t fl, sl, map;
+
+	if (size >= TLSF_SMALL) {
+		size += (1U << (tlsf_fls((uint32_t)size) - TLSF_SL_LOG2)) - 1U;
+	}
+	tlsf_mapping(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT) {
+		return NULL;
+	}
+
+	map = sl_bitmap[fl] & (~0U << sl);
+	if (!map) {
+		map = (fl + 1U < 32U) ? (fl_bitmap & (~0U << (fl + 1U))) : 0;
+		if (!map) {
+			return NULL;
+		}
+		fl  = tlsf_ffs(map);
+		map = sl_bitmap[fl];
+	}
+	sl = tlsf_ffs(map);
+
+	return free_lists[fl][sl];
+}
+
+static void *tlsf_alloc(size_t size)
+{
+	tlsf_block_t *b, *rest;
+	size_t bsize;
+
+	size = (size + TLSF_ALIGN - 1U) & ~(size_t)(TLSF_ALIGN - 1U);
+	if (size < TLSF_MIN_PAYLOAD) {
+		size = TLSF_MIN_PAYLOAD;
+	}
+
+	b = tlsf_find(size);
+	if (!b) {
+		return NULL;
+	}
+	tlsf_remove(b);
+	bsize = tlsf_size(b);
+
+	/*Split when the rest can hold a block of its own*/
+	if (bsize >= size + TLSF_HDR + TLSF_MIN_PAYLOAD) {
+		rest = (tlsf_block_t *)((uint8_t *)b + TLSF_HDR + size);
+		rest->size = (bsize - size - TLSF_HDR) | TLSF_FREE;
+		b->size = size | (b->size & TLSF_PREV_FREE);
+		tlsf_next_phys(rest)->prev_phys = rest;
+		tlsf_next_phys(rest)->size |= TLSF_PREV_FREE;
+		tlsf_insert(rest);
+	}
+
+	/*Mark it used*/
+	b->size &= ~(size_t)TLSF_FREE;
+	tlsf_next_phys(b)->size &= ~(size_t)TLSF_PREV_FREE;
+
+	stats.tlsf_used += (uint32_t)(tlsf_size(b) + TLSF_HDR);
+	if (stats.tlsf_used > stats.tlsf_high_water) {
+		stats.tlsf_high_water = stats.tlsf_used;
+	}
+
+	return tlsf_payload(b);
+}
+
+static void tlsf_free(void *ptr)
+{
+	tlsf_block_t *b = (tlsf_block_t *)((uint8_t *)ptr - TLSF_HDR);
+	tlsf_block_t *next;
+
+	stats.tlsf_used -= (uint32_t)(tlsf_size(b) + TLSF_HDR);
+	b->size |= TLSF_FREE;
+
+	/*Merge with the previous block*/
+	if (b->size & TLSF_PREV_FREE) {
+		tlsf_block_t *prev = b->prev_phys;
+
+		tlsf_remove(prev);
+		prev->size += TLSF_HDR + tlsf_size(b);
+		b = prev;
+	}
+
+	/*Merge with the next block*/
+	next = tlsf_next_phys(b);
+	if (next->size & TLSF_FREE) {
+		tlsf_remove(next);
+		b->size += TLSF_HDR + tlsf_size(next);
+	}
+
+	next = tlsf_next_phys(b);
+	next->prev_phys = b;
+	next->size |= TLSF_PREV_FREE;
+
+	tlsf_insert(b);
+}
+
+/**
+ * @brief Builds the pools and the TLSF arena. Called on the first allocation.
+ * @retval None.
+ */
+void mem_pool_init(void)
+{
+	uint8_t *p = (uint8_t *)pool_mem;
+	tlsf_hdr_t *sentinel;
+
+	memset(&stats, 0, sizeof(stats));
+
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		mem_class_t *c = &classes[i];
+
+		c->block_size = class_size[i];
+		c->blocks     = class_blocks[i];
+		c->used       = 0;
+		c->high_water = 0;
+		c->base       = p;
+		c->free_list  = NULL;
+
+		/*Thread the free list through the blocks*/
+		for (uint32_t j = c->blocks; j > 0; j--) {
+			void **blk = (void **)(p + (j - 1U) * c->block_size);
+
+			*blk = c->free_list;
+			c->free_list = blk;
+		}
+
+		p += (uint32_t)c->block_size * c->blocks;
+		c->end = p;
+	}
+
+	/*One free block over the arena, followed by a used sentinel that stops the merges*/
+	memset(sl_bitmap, 0, sizeof(sl_bitmap));
+	memset(free_lists, 0, sizeof(free_lists));
+	fl_bitmap = 0;
+
+	tlsf_first = (tlsf_block_t *)tlsf_mem;
+	tlsf_first->size = (sizeof(tlsf_mem) - 2U * TLSF_HDR) | TLSF_FREE;
+	sentinel = (tlsf_hdr_t *)tlsf_next_phys(tlsf_first);
+	sentinel->prev_phys = tlsf_first;
+	sentinel->size = TLSF_PREV_FREE;
+	tlsf_insert(tlsf_first);
+
+	stats.tlsf_size = (uint32_t)tlsf_size(tlsf_first);
+
+	initialized = 1;
+}
+
+/**
+ * @brief Allocates memory: from the smallest size class that fits and has a free block,
+ * else from the TLSF arena. The time does not depend on the allocation history.
+ * @param size : The size in bytes.
+ * @retval The memory, 8-byte aligned, or NULL.
+ */
+void *mem_pool_alloc(size_t size)
+{
+	void *p = NULL;
+
+	if (!initialized) {
+		mem_pool_init();
+	}
+
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES && !p; i++) {
+		mem_class_t *c = &classes[i];
+
+		if (size <= c->block_size && c->free_list) {
+			p = c->free_list;
+			c->free_list = *(void **)p;
+
+			c->used++;
+			if (c->used > c->high_water) {
+				c->high_water = c->used;
+			}
+		}
+	}
+
+	if (!p && size) {
+		p = tlsf_alloc(size);
+	}
+
+	if (p) {
+		stats.allocs++;
+	} else {
+		stats.failures++;
+	}
+
+	return p;
+}
+
+/**
+ * @brief Frees memory of mem_pool_alloc(). The pool is found from the address.
+ * @param ptr : The memory, NULL does nothing.
+ * @retval None.
+ */
+void mem_pool_free(void *ptr)
+{
+	uint8_t *p = ptr;
+
+	if (!p) {
+		return;
+	}
+	stats.frees++;
+
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		mem_class_t *c = &classes[i];
+
+		if (p >= c->base && p < c->end) {
+			*(void **)p = c->free_list;
+			c->free_list = p;
+			c->used--;
+			return;
+		}
+	}
+
+	tlsf_free(ptr);
+}
+
+/**
+ * @brief Gets the usage, the high-water marks and the fragmentation of the TLSF arena.
+ * It walks the arena, so it is meant for diagnostics, not for the I/O path.
+ * @retval None.
+ */
+void mem_pool_get_stats(mem_pool_stats_t *out)
+{
+	tlsf_block_t *b;
+	uint32_t free_bytes = 0;
+
+	if (!initialized) {
+		mem_pool_init();
+	}
+
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		stats.cls[i].block_size = classes[i].block_size;
+		stats.cls[i].blocks     = classes[i].blocks;
+		stats.cls[i].used       = classes[i].used;
+		stats.cls[i].high_water = classes[i].high_water;
+	}
+
+	stats.tlsf_free_blocks  = 0;
+	stats.tlsf_largest_free = 0;
+	for (b = tlsf_first; tlsf_size(b); b = tlsf_next_phys(b)) {
+		if (b->size & TLSF_FREE) {
+			stats.tlsf_free_blocks++;
+			free_bytes += (uint32_t)tlsf_size(b);
+			if (tlsf_size(b) > stats.tlsf_largest_free) {
+				stats.tlsf_largest_free = (uint32_t)tlsf_size(b);
+			}
+		}
+	}
+	stats.fragmentation = free_bytes ? 1000U - (stats.tlsf_largest_free * 1000U) / free_bytes : 0;
+
+	*out = stats;
+}
+
+/**
+ * @brief Checks the consistency of the pools and of the TLSF arena.
+ * @retval 0 if consistent, a negative number naming the first broken rule otherwise.
+ */
+int mem_pool_check(void)
+{
+	tlsf_block_t *b, *prev = NULL;
+	uint32_t fl, sl, free_blocks = 0, listed = 0;
+
+	if (!initialized) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		uint32_t n = 0;
+
+		for (void *p = classes[i].free_list; p; p = *(void **)p) {
+			n++;
+		}
+		if (n + classes[i].used != classes[i].blocks) {
+			return -1;
+		}
+	}
+
+	for (b = tlsf_first; tlsf_size(b); b = tlsf_next_phys(b)) {
+		if ((uint8_t *)b >= (uint8_t *)tlsf_mem + sizeof(tlsf_mem)) {
+			return -2;
+		}
+		if (prev) {
+			/*Two free neighbours must have been merged*/
+			if ((prev->size & TLSF_FREE) && (b->size & TLSF_FREE)) {
+				return -3;
+			}
+			if (!!(prev->size & TLSF_FREE) != !!(b->size & TLSF_PREV_FREE)) {
+				return -4;
+			}
+			if ((b->size & TLSF_PREV_FREE) && b->prev_phys != prev) {
+				return -5;
+			}
+		}
+		if (b->size & TLSF_FREE) {
+			free_blocks++;
+		}
+		prev = b;
+	}
+
+	for (fl = 0; fl < TLSF_FL_COUNT; fl++) {
+		for (sl = 0; sl < TLSF_SL_COUNT; sl++) {
+			if (!!free_lists[fl][sl] != !!(sl_bitmap[fl] & (1U << sl))) {
+				return -6;
+			}
+			for (b = free_lists[fl][sl]; b; b = b->next_free) {
+				uint32_t bfl, bsl;
+
+				tlsf_mapping(tlsf_size(b), &bfl, &bsl);
+				if (!(b->size & TLSF_FREE) || bfl != fl || bsl != sl) {
+					return -7;
+				}
+				listed++;
+			}
+		}
+	}
+
+	return (listed == free_blocks) ? 0 : -8;
+}
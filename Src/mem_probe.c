@@ -0,0 +1,251 @@
+/*
+ * mem_probe.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "mem_probe.h"
+#include "mem_pool.h"
+
+
+#if defined(__arm__)
+/*Symbols defined in the linker script, the startup code paints from _end to the stack pointer*/
+extern uint8_t _end;
+extern uint8_t _estack;
+extern uint8_t _Min_Stack_Size;
+extern void *_sbrk(ptrdiff_t incr);
+
+#define PROBE_SP()			((uintptr_t)__get_MSP())
+#define PROBE_GUARD			32U			/*Frame of mem_probe_begin*/
+#else
+/*Host: the stack is the one of the thread that called mem_probe_paint*/
+#define PROBE_HOST_STACK	(64U * 1024U)
+#define PROBE_SP()			((uintptr_t)__builtin_frame_address(0))
+#define PROBE_GUARD			256U		/*Red zone and frame of mem_probe_begin*/
+
+static uintptr_t host_top;
+#endif
+
+static uint32_t stack_hw;				//Deepest use found before a repaint
+static mem_probe_tag_t probe_tag[MEM_PROBE_TAGS];
+static uint32_t probe_ntags;
+static uint32_t probe_lost;				//Probes whose tag did not fit in the table
+
+/**
+ * @brief This function returns the top of the stack.
+ */
+static uintptr_t stack_top(void)
+{
+#if defined(__arm__)
+	return (uintptr_t)&_estack;
+#else
+	return host_top;
+#endif
+}
+
+/**
+ * @brief This function returns the lowest address the stack may reach, the end of the heap.
+ */
+static uintptr_t stack_bottom(void)
+{
+#if defined(__arm__)
+	return ((uintptr_t)_sbrk(0) + 3U) & ~(uintptr_t)3U;
+#else
+	return host_top - PROBE_HOST_STACK;
+#endif
+}
+
+/**
+ * @brief This function fills a word aligned range with the pattern.
+ */
+static void paint(uintptr_t from, uintptr_t to)
+{
+	volatile uint32_t *p = (volatile uint32_t *)(from & ~(uintptr_t)3U);
+
+	while ((uintptr_t)p < to) {
+		*p++ = MEM_PROBE_PATTERN;
+	}
+}
+
+/**
+ * @brief This function returns the lowest word of a range that lost the pattern,
+ * or the end of the range when all of it still holds it.
+ */
+static uintptr_t lowest_used(uintptr_t from, uintptr_t to)
+{
+	const volatile uint32_t *p = (const volatile uint32_t *)(from & ~(uintptr_t)3U);
+
+	while ((uintptr_t)p < to && *p == MEM_PROBE_PATTERN) {
+		p++;
+	}
+
+	return (uintptr_t)p;
+}
+
+/**
+ * @brief This function repaints the free stack below the caller, which restarts the
+ * high-water mark. On the target the startup code has already painted it, on the host
+ * this must be called from main before anything else is measured.
+ */
+__attribute__((noinline)) void mem_probe_paint(void)
+{
+	uintptr_t sp = PROBE_SP();
+
+#if !defined(__arm__)
+	host_top = sp;
+#endif
+	stack_hw = 0;
+	paint(stack_bottom(), sp - PROBE_GUARD);
+}
+
+/**
+ * @brief This function returns the deepest the stack has been since the paint, in bytes.
+ */
+uint32_t mem_probe_stack_high_water(void)
+{
+	uintptr_t top = stack_top();
+	uint32_t used = (uint32_t)(top - lowest_used(stack_bottom(), top));
+
+	return (used > stack_hw) ? used : stack_hw;
+}
+
+/**
+ * @brief This function returns the stack size reserved by the linker script (_Min_Stack_Size).
+ */
+uint32_t mem_probe_stack_reserved(void)
+{
+#if defined(__arm__)
+	return (uint32_t)(uintptr_t)&_Min_Stack_Size;
+#else
+	return PROBE_HOST_STACK;
+#endif
+}
+
+/**
+ * @brief This function returns the bytes the newlib heap took with _sbrk.
+ */
+uint32_t mem_probe_heap_used(void)
+{
+#if defined(__arm__)
+	return (uint32_t)((uint8_t *)_sbrk(0) - &_end);
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief This function starts a probe: it saves the high-water mark, which the repaint
+ * would erase, and paints MEM_PROBE_WINDOW bytes below the stack pointer.
+ * @retval The stack pointer the depth of the probed call is measured from.
+ */
+__attribute__((noinline)) uintptr_t mem_probe_begin(void)
+{
+	uintptr_t sp = PROBE_SP();
+	uintptr_t from = sp - MEM_PROBE_WINDOW;
+
+	stack_hw = mem_probe_stack_high_water();
+
+	if (from < stack_bottom()) {
+		from = stack_bottom();
+	}
+	paint(from, sp - PROBE_GUARD);
+
+	return sp;
+}
+
+/**
+ * @brief This function ends a probe and records the depth under the tag.
+ * @param tag: String literal that names the call, compared by address first.
+ * @param sp: The value mem_probe_begin returned.
+ */
+void mem_probe_end(const char *tag, uintptr_t sp)
+{
+	uintptr_t from = sp - MEM_PROBE_WINDOW;
+	uint32_t depth;
+	uint32_t i;
+
+	if (from < stack_bottom()) {
+		from = stack_bottom();
+	}
+	depth = (uint32_t)(sp - lowest_used(from, sp - PROBE_GUARD));
+
+	if ((uint32_t)(stack_top() - sp) + depth > stack_hw) {
+		stack_hw = (uint32_t)(stack_top() - sp) + depth;
+	}
+
+	for (i = 0; i < probe_ntags; i++) {
+		if (probe_tag[i].tag == tag || strcmp(probe_tag[i].tag, tag) == 0) {
+			break;
+		}
+	}
+	if (i == probe_ntags) {
+		if (probe_ntags == MEM_PROBE_TAGS) {
+			probe_lost++;
+			return;
+		}
+		probe_tag[probe_ntags++].tag = tag;
+	}
+
+	probe_tag[i].calls++;
+	if (depth > probe_tag[i].max_bytes) {
+		probe_tag[i].max_bytes = depth;
+	}
+}
+
+/**
+ * @brief This function returns the table of probed tags.
+ * @param count: Receives the number of entries.
+ */
+const mem_probe_tag_t *mem_probe_tags(uint32_t *count)
+{
+	*count = probe_ntags;
+	return probe_tag;
+}
+
+/**
+ * @brief This function clears the probe table, the high-water mark is kept.
+ */
+void mem_probe_reset(void)
+{
+	memset(probe_tag, 0, sizeof(probe_tag));
+	probe_ntags = 0;
+	probe_lost = 0;
+}
+
+/**
+ * @brief This function prints the stack, heap and allocator usage and the probe table.
+ * A depth of MEM_PROBE_WINDOW or more means the call went below the painted window, one
+ * within the guard below the caller is printed as an upper bound.
+ */
+void mem_probe_report(void)
+{
+	mem_pool_stats_t st;
+	uint32_t hw = mem_probe_stack_high_water();
+	uint32_t reserved = mem_probe_stack_reserved();
+
+	mem_pool_get_stats(&st);
+
+	printf("stack: high water %lu of %lu reserved bytes%s\r\n", (unsigned long)hw,
+		   (unsigned long)reserved, (hw > reserved) ? " (over the reservation)" : "");
+	printf("heap: %lu bytes taken with _sbrk\r\n", (unsigned long)mem_probe_heap_used());
+	printf("littlefs allocator: %lu/%lu arena bytes, high water %lu, fragmentation %lu/1000\r\n",
+		   (unsigned long)st.tlsf_used, (unsigned long)st.tlsf_size,
+		   (unsigned long)st.tlsf_high_water, (unsigned long)st.fragmentation);
+	for (uint32_t i = 0; i < MEM_POOL_NCLASSES; i++) {
+		printf("  class %u: high water %u/%u blocks\r\n", st.cls[i].block_size,
+			   st.cls[i].high_water, st.cls[i].blocks);
+	}
+
+	for (uint32_t i = 0; i < probe_ntags; i++) {
+		const mem_probe_tag_t *t = &probe_tag[i];
+
+		printf("probe %-16s calls %6lu max stack %s%lu bytes\r\n", t->tag, (unsigned long)t->calls,
+			   (t->max_bytes >= MEM_PROBE_WINDOW) ? ">=" : (t->max_bytes <= PROBE_GUARD) ? "<=" : "",
+			   (unsigned long)t->max_bytes);
+	}
+	if (probe_lost) {
+		printf("probe: %lu calls not recorded, the tag table is full\r\n", (unsigned long)probe_lost);
+	}
+}
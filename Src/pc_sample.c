@@ -0,0 +1,210 @@
+/*
+ * pc_sample.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+#if !defined(__arm__)
+#define _GNU_SOURCE						/*REG_RIP of ucontext_t*/
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+#include "pc_sample.h"
+
+
+static uint32_t pcs_buf[PC_SAMPLE_WORDS];
+static volatile uint32_t pcs_len;		//Words taken
+static volatile uint32_t pcs_lost;		//Samples that did not fit
+static uint32_t pcs_hz;
+static uint8_t pcs_lr;
+
+
+/**
+ * @brief This function stores a sample, from the interrupt.
+ */
+static void pcs_record(uint32_t pc, uint32_t lr)
+{
+	uint32_t need = pcs_lr ? 2U : 1U;
+
+	if (pcs_len + need > PC_SAMPLE_WORDS) {
+		pcs_lost++;
+		return;
+	}
+	pcs_buf[pcs_len] = pc;
+	if (pcs_lr) {
+		pcs_buf[pcs_len + 1U] = lr;
+	}
+	pcs_len += need;
+}
+
+#if defined(__arm__)
+/**
+ * @brief This function takes the sample from the exception stack frame
+ * (R0, R1, R2, R3, R12, LR, PC, xPSR).
+ * @param frame: The frame the interrupted code stacked.
+ */
+__attribute__((used)) static void pc_sample_isr(const uint32_t *frame)
+{
+	/*Clear the update flag first, the write takes a few cycles to reach the timer*/
+	CLEAR_BIT(TIM7->SR, TIM_SR_UIF);
+
+	pcs_record(frame[6], frame[5]);
+}
+
+/**
+ * @brief Interrupt of TIM7. Bit 2 of EXC_RETURN tells which stack the frame is on.
+ */
+__attribute__((naked)) void TIM7_IRQHandler(void)
+{
+	__asm volatile (
+		"tst   lr, #4          \n"
+		"ite   eq              \n"
+		"mrseq r0, msp         \n"
+		"mrsne r0, psp         \n"
+		"b     pc_sample_isr   \n"
+	);
+}
+#else
+/**
+ * @brief Host: the PC of the interrupted thread, from the signal context.
+ */
+static void pc_sample_signal(int sig, siginfo_t *info, void *context)
+{
+	(void)sig;
+	(void)info;
+#if defined(__x86_64__)
+	pcs_record((uint32_t)((ucontext_t *)context)->uc_mcontext.gregs[REG_RIP], 0);
+#else
+	(void)context;
+	pcs_record(0, 0);
+#endif
+}
+#endif
+
+/**
+ * @brief This function starts sampling, the buffer keeps the samples taken so far.
+ * @param hz: The sampling rate, 16Hz to 100kHz.
+ * @param with_lr: 1 to record the LR with the PC (target only), which halves the samples
+ * the buffer holds.
+ * @retval 1 if sampling started, 0 for a rate out of range.
+ */
+int pc_sample_start(uint32_t hz, int with_lr)
+{
+	if (hz < 16U || hz > PC_SAMPLE_TICK_HZ / 10U) {
+		return 0;
+	}
+	pc_sample_stop();
+
+	pcs_hz = hz;
+
+#if defined(__arm__)
+	pcs_lr = with_lr ? 1U : 0U;
+
+	/*TIM7 counts at PC_SAMPLE_TICK_HZ and overflows at the sampling rate*/
+	SET_BIT(RCC->APB1ENR1, RCC_APB1ENR1_TIM7EN);
+	WRITE_REG(TIM7->CR1, 0);
+	WRITE_REG(TIM7->PSC, SystemCoreClock / PC_SAMPLE_TICK_HZ - 1U);
+	WRITE_REG(TIM7->ARR, PC_SAMPLE_TICK_HZ / hz - 1U);
+
+	/*Load the prescaler now, the update event sets UIF as well*/
+	WRITE_REG(TIM7->EGR, TIM_EGR_UG);
+	CLEAR_BIT(TIM7->SR, TIM_SR_UIF);
+	SET_BIT(TIM7->DIER, TIM_DIER_UIE);
+
+	/*Lowest priority, the sampler never delays another interrupt*/
+	NVIC_SetPriority(TIM7_IRQn, (1U << __NVIC_PRIO_BITS) - 1U);
+	NVIC_EnableIRQ(TIM7_IRQn);
+	SET_BIT(TIM7->CR1, TIM_CR1_CEN);
+#else
+	struct sigaction sa;
+	struct itimerval it;
+
+	(void)with_lr;
+	pcs_lr = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = pc_sample_signal;
+	sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+	sigaction(SIGPROF, &sa, NULL);
+
+	it.it_interval.tv_sec  = 0;
+	it.it_interval.tv_usec = (suseconds_t)(PC_SAMPLE_TICK_HZ / hz);
+	it.it_value            = it.it_interval;
+	setitimer(ITIMER_PROF, &it, NULL);
+#endif
+
+	return 1;
+}
+
+/**
+ * @brief This function stops sampling, call it before pc_sample_dump().
+ */
+void pc_sample_stop(void)
+{
+#if defined(__arm__)
+	CLEAR_BIT(TIM7->CR1, TIM_CR1_CEN);
+	CLEAR_BIT(TIM7->DIER, TIM_DIER_UIE);
+	NVIC_DisableIRQ(TIM7_IRQn);
+#else
+	struct itimerval it;
+
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, NULL);
+#endif
+}
+
+/**
+ * @brief This function empties the buffer.
+ */
+void pc_sample_reset(void)
+{
+	pcs_len  = 0;
+	pcs_lost = 0;
+}
+
+/**
+ * @brief This function reprograms the prescaler after a system clock change, so the
+ * rate does not change. rcc_set_profile() calls it.
+ */
+void pc_sample_set_clock(void)
+{
+#if defined(__arm__)
+	if (READ_BIT(TIM7->CR1, TIM_CR1_CEN)) {
+		/*UG would set UIF, the interrupt is masked while the prescaler is loaded*/
+		CLEAR_BIT(TIM7->DIER, TIM_DIER_UIE);
+		WRITE_REG(TIM7->PSC, SystemCoreClock / PC_SAMPLE_TICK_HZ - 1U);
+		WRITE_REG(TIM7->EGR, TIM_EGR_UG);
+		CLEAR_BIT(TIM7->SR, TIM_SR_UIF);
+		SET_BIT(TIM7->DIER, TIM_DIER_UIE);
+	}
+#endif
+}
+
+/**
+ * @brief This function returns the number of samples in the buffer.
+ */
+uint32_t pc_sample_count(void)
+{
+	return pcs_len / (pcs_lr ? 2U : 1U);
+}
+
+/**
+ * @brief This function prints the samples, one "pcs <pc> <lr>" line each in hex (the LR
+ * is 0 when it was not recorded), between a "pcs begin" line with the rate and the
+ * counts and a "pcs end" line.
+ */
+void pc_sample_dump(void)
+{
+	uint32_t step = pcs_lr ? 2U : 1U;
+	uint32_t len  = pcs_len;
+
+	printf("pcs begin hz=%lu samples=%lu lost=%lu lr=%u\r\n", (unsigned long)pcs_hz,
+		   (unsigned long)(len / step), (unsigned long)pcs_lost, pcs_lr);
+	for (uint32_t i = 0; i + step <= len; i += step) {
+		printf("pcs %08lx %08lx\r\n", (unsigned long)pcs_buf[i],
+			   (unsigned long)(pcs_lr ? pcs_buf[i + 1U] : 0U));
+	}
+	printf("pcs end\r\n");
+}
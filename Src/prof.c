@@ -0,0 +1,94 @@
+/*
+ * prof.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "prof.h"
+
+#if !defined(__arm__)
+#include <time.h>
+#endif
+
+
+/*Names of the regions, in the order of prof_id_t*/
+static const char *const prof_name[PROF_NREGIONS] = {
+	"spi_tx", "spi_rx", "at45_wait", "lfs_crc", "lfs_commit", "lfs_zcomp",
+	"lfs_zdecomp", "printf"
+};
+
+static prof_region_t prof_table[PROF_NREGIONS];
+
+
+/**
+ * @brief This function adds a pass of a region to the table, PROF_END calls it.
+ * @param id: The region.
+ * @param ticks: The ticks the pass took.
+ */
+void prof_record(prof_id_t id, uint32_t ticks)
+{
+	prof_region_t *r = &prof_table[id];
+
+	r->count++;
+	r->total += ticks;
+	if (ticks > r->max) {
+		r->max = ticks;
+	}
+}
+
+/**
+ * @brief This function returns the table, indexed by prof_id_t.
+ */
+const prof_region_t *prof_regions(void)
+{
+	return prof_table;
+}
+
+/**
+ * @brief This function clears the table.
+ */
+void prof_reset(void)
+{
+	memset(prof_table, 0, sizeof(prof_table));
+}
+
+/**
+ * @brief This function prints the regions that ran: passes, total, mean and maximum
+ * ticks. A region nested in another is counted in both totals. The table is copied
+ * first, the printf region of the report itself is counted in the next one.
+ */
+void prof_report(void)
+{
+	prof_region_t snap[PROF_NREGIONS];
+
+	memcpy(snap, prof_table, sizeof(snap));
+
+	printf("prof: %-10s %10s %14s %10s %10s  (%s)\r\n", "region", "count", "total", "mean", "max", PROF_UNIT);
+	for (uint32_t i = 0; i < PROF_NREGIONS; i++) {
+		const prof_region_t *r = &snap[i];
+
+		if (!r->count) {
+			continue;
+		}
+		printf("prof: %-10s %10lu %14llu %10lu %10lu\r\n", prof_name[i], (unsigned long)r->count,
+			   (unsigned long long)r->total, (unsigned long)(r->total / r->count), (unsigned long)r->max);
+	}
+}
+
+/**
+ * @brief This function returns the nanoseconds of CLOCK_MONOTONIC, the clock of the host
+ * build. It wraps every 4.29s, the difference of two readings is right for shorter regions.
+ */
+uint32_t prof_host_now(void)
+{
+#if defined(__arm__)
+	return 0;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+#endif
+}
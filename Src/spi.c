@@ -9,8 +9,44 @@
 #include "spi.h"
 
 
-/*Buffer for SPI incoming messages*/
-uint8_t SPI_REC_BUF[SPI_REC_BUFF_SIZE];
+/*Buffer for SPI incoming messages, in SRAM2*/
+uint8_t SPI_REC_BUF[SPI_REC_BUFF_SIZE] SRAM2_BSS;
+
+/**
+ * @brief State of an asynchronous transfer.
+ */
+typedef struct {
+	const uint8_t *tx;
+	uint8_t *rx;
+	uint32_t size;
+	uint32_t idx;
+	ev_handler_t handler;
+	void *arg;
+	uint8_t busy;
+}spi_async_t;
+
+/*One transfer at a time for each of SPI1-3*/
+static spi_async_t spi_xfer[3];
+
+/**
+ * @brief Map a peripheral to its state and interrupt line.
+ * @retval The index (0-2), -1 for an unsupported peripheral.
+ */
+static int SPIx_index(SPI_TypeDef *sSPIx, IRQn_Type *irq)
+{
+	if (sSPIx == SPI1) {
+		*irq = SPI1_IRQn;
+		return 0;
+	} else if (sSPIx == SPI2) {
+		*irq = SPI2_IRQn;
+		return 1;
+	} else if (sSPIx == SPI3) {
+		*irq = SPI3_IRQn;
+		return 2;
+	}
+
+	return -1;
+}
 
 void SPIx_init(SPI_TypeDef *sSPIx, GPIO_TypeDef *GPIOx)
 {
@@ -35,9 +71,9 @@ void SPIx_init(SPI_TypeDef *sSPIx, GPIO_TypeDef *GPIOx)
 
 	/**
 	 * Since the peripheral that we need to communicate has 5MHz max speed we need
-	 * to divide our clock to a valid number (16/4 = 4)
+	 * to divide our clock to a valid number (16/4 = 4, 80/16 = 5)
 	*/
-	MODIFY_REG(sSPIx->CR1, SPI_CR1_BR, (0x06 << SPI_CR1_BR_Pos));
+	MODIFY_REG(sSPIx->CR1, SPI_CR1_BR, (SPIx_prescaler(SystemCoreClock, SPIx_MAX_CLK_HZ) << SPI_CR1_BR_Pos));
 
 	/*Set the idle state of the clock to be low (0)*/
 	CLEAR_BIT(sSPIx->CR1, SPI_CR1_CPOL);
@@ -72,6 +108,28 @@ void SPIx_init(SPI_TypeDef *sSPIx, GPIO_TypeDef *GPIOx)
 
 }
 
+uint32_t SPIx_prescaler(uint32_t pclk, uint32_t max_hz)
+{
+	uint32_t br = 0;
+
+	/*Smallest division (2, 4, ..., 256) that keeps SCK under the limit*/
+	while (br < 7 && (pclk >> (br + 1)) > max_hz) {
+		br++;
+	}
+
+	return br;
+}
+
+void SPIx_set_clock(SPI_TypeDef *sSPIx)
+{
+	/*Wait the last frame, the prescaler must not change during a transfer*/
+	while (READ_BIT(sSPIx->SR, SPI_SR_BSY)) {}
+
+	CLEAR_BIT(sSPIx->CR1, SPI_CR1_SPE);
+	MODIFY_REG(sSPIx->CR1, SPI_CR1_BR, (SPIx_prescaler(SystemCoreClock, SPIx_MAX_CLK_HZ) << SPI_CR1_BR_Pos));
+	SET_BIT(sSPIx->CR1, SPI_CR1_SPE);
+}
+
 void SPIx_deinit(SPI_TypeDef *sSPIx)
 {
 	uint32_t i=0; //Iterations
@@ -89,7 +147,7 @@ void SPIx_deinit(SPI_TypeDef *sSPIx)
 	while (READ_BIT(sSPIx->SR, SPI_SR_FRLVL) != (0x00)) {
 
 		/*Read what data that has been stack iSnto the RX_BUFFER*/
-		SPI_REC_BUF[i] = sSPIx->DR;
+		SPI_REC_BUF[i] = SPIx_DR_READ(sSPIx);
 
 		i++;
 	}
@@ -101,13 +159,16 @@ void SPIx_transmit(SPI_TypeDef *sSPIx, uint8_t *data, uint32_t size)
 {
 	int i=0; //Iterations
 
+	PROF_BEGIN(PROF_SPI_TX);
+	SPI_TRACE_TX(data, size);
+
 	while ( i < size) {
 
 		/*Wait until TXE bit is set, which indicates TX_FIFO is empty*/
 		while (!(READ_BIT(sSPIx->SR, SPI_SR_TXE))) {}
 
 		/*Load the data to the TX_FIFO, in order to transmit data to shift register*/
-		*((volatile uint8_t *) &sSPIx->DR) = data[i];
+		SPIx_DR_WRITE(sSPIx, data[i]);
 
 		i++;
 	}
@@ -122,13 +183,18 @@ void SPIx_transmit(SPI_TypeDef *sSPIx, uint8_t *data, uint32_t size)
 	 * 	An overrun condition occurs when data is received by a master or slave and the RXFIFO
 	 *	has not enough space to store this received data. This can happen if the software
 	 *	did not have enough time to read the previously received data.
+	 *	Drain the RX_FIFO byte by byte: a 16-bit read of DR pops two frames and leaves the
+	 *	others, up to 4 of them, to be taken by the next receive as data.
 	 */
-
-	(void)(sSPIx->DR);
+	while (READ_BIT(sSPIx->SR, SPI_SR_FRLVL)) {
+		(void)SPIx_DR_READ(sSPIx);
+	}
 	(void)(sSPIx->SR);
+
+	PROF_END(PROF_SPI_TX);
 }
 
-uint8_t SPIx_receive_byte(SPI_TypeDef *sSPIx)
+RAMFUNC uint8_t SPIx_receive_byte(SPI_TypeDef *sSPIx)
 {
 	uint8_t rec_data;
 
@@ -136,33 +202,108 @@ uint8_t SPIx_receive_byte(SPI_TypeDef *sSPIx)
 	while (READ_BIT(sSPIx->SR, SPI_SR_BSY)) {}
 
 	/*Load dummy data to DR register*/
-	*((volatile uint8_t *) &sSPIx->DR) = 0xFF;
+	SPIx_DR_WRITE(sSPIx, 0xFF);
 
 	/*Wait for RXNE to become 1, means RX_FIFO has data to be read*/
 	while (!(READ_BIT(sSPIx->SR, SPI_SR_RXNE))) {}
 
-	rec_data = *((volatile uint8_t *) &sSPIx->DR);
+	rec_data = SPIx_DR_READ(sSPIx);
+	SPI_TRACE_RX(1U);
 
 	return rec_data;
 }
 
-void SPIx_receive(SPI_TypeDef *sSPIx, uint8_t *recBuf, uint32_t size)
+RAMFUNC void SPIx_receive(SPI_TypeDef *sSPIx, uint8_t *recBuf, uint32_t size)
 {
+	PROF_BEGIN(PROF_SPI_RX);
+
 	for (int i=0;i<size;i++)
 	{
 		recBuf[i] = SPIx_receive_byte(sSPIx);
 	}
+
+	PROF_END(PROF_SPI_RX);
+}
+
+
+int SPIx_transfer_async(SPI_TypeDef *sSPIx, const uint8_t *tx, uint8_t *rx, uint32_t size, ev_handler_t handler, void *arg)
+{
+	IRQn_Type irq;
+	int idx = SPIx_index(sSPIx, &irq);
+
+	if (idx < 0 || spi_xfer[idx].busy || size == 0) {
+		return 0;
+	}
+
+	spi_xfer[idx].tx      = tx;
+	spi_xfer[idx].rx      = rx;
+	spi_xfer[idx].size    = size;
+	spi_xfer[idx].idx     = 0;
+	spi_xfer[idx].handler = handler;
+	spi_xfer[idx].arg     = arg;
+	spi_xfer[idx].busy    = 1;
+
+	SPI_TRACE_TX(tx, tx ? size : 0U);
+	if (rx) {
+		SPI_TRACE_RX(size);
+	}
+
+	/*Drop the stale bytes left by the transmit-only functions*/
+	while (READ_BIT(sSPIx->SR, SPI_SR_FRLVL)) {
+		(void)SPIx_DR_READ(sSPIx);
+	}
+
+	/*One byte in flight: every RXNE interrupt reads a byte and loads the next one*/
+	NVIC_EnableIRQ(irq);
+	SET_BIT(sSPIx->CR2, SPI_CR2_RXNEIE);
+	SPIx_DR_WRITE(sSPIx, tx ? tx[0] : 0xFF);
+
+	return 1;
 }
 
+void SPIx_irq_handler(SPI_TypeDef *sSPIx)
+{
+	IRQn_Type irq;
+	int idx = SPIx_index(sSPIx, &irq);
+	spi_async_t *x;
+	uint8_t data;
+
+	if (idx < 0 || !READ_BIT(sSPIx->SR, SPI_SR_RXNE)) {
+		return;
+	}
+	x = &spi_xfer[idx];
+
+	data = SPIx_DR_READ(sSPIx);
+	if (x->rx) {
+		x->rx[x->idx] = data;
+	}
+	x->idx++;
+
+	if (x->idx < x->size) {
+		/*Load the next byte*/
+		SPIx_DR_WRITE(sSPIx, x->tx ? x->tx[x->idx] : 0xFF);
+	} else {
+		CLEAR_BIT(sSPIx->CR2, SPI_CR2_RXNEIE);
+		x->busy = 0;
+
+		if (x->handler) {
+			evloop_post(x->handler, x->arg, x->size);
+		}
+	}
+}
 
 void SPIx_enable_slave(GPIO_TypeDef *GPIOx)
 {
 	/*High to low transaction of CS pin enables the slave devise*/
 	CLEAR_BIT(GPIOx->ODR, (1U<<SPIx_GPIO_CS_PIN));
+	SPIx_CS_CHANGED(GPIOx);
+	SPI_TRACE_SELECT();
 }
 
 void SPIx_disable_slave(GPIO_TypeDef *GPIOx)
 {
 	/*Low to high transaction of CS pin disables the slave device*/
 	SET_BIT(GPIOx->ODR, (1U<<SPIx_GPIO_CS_PIN));
+	SPIx_CS_CHANGED(GPIOx);
+	SPI_TRACE_DESELECT();
 }
@@ -0,0 +1,120 @@
+/*
+ * spi_trace.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "spi_trace.h"
+#include "timebase.h"
+
+
+uint32_t spi_trace_rx_bytes;
+
+static spi_trace_rec_t trace_ring[SPI_TRACE_DEPTH];
+static uint32_t trace_head;				//Next entry to write
+static uint32_t trace_count;			//Valid entries, up to SPI_TRACE_DEPTH
+static uint32_t trace_lost;				//Entries overwritten since the reset
+
+/*The transaction in progress*/
+static spi_trace_rec_t trace_cur;
+static uint32_t trace_tx_bytes;
+static uint32_t trace_t0;
+static uint8_t trace_selected;
+
+
+/**
+ * @brief This function starts an entry, SPIx_enable_slave calls it.
+ */
+void spi_trace_select(void)
+{
+	memset(&trace_cur, 0, sizeof(trace_cur));
+	trace_tx_bytes     = 0;
+	spi_trace_rx_bytes = 0;
+	trace_cur.start_us = timebase_us();
+	trace_t0           = TIMEBASE_CYCCNT();
+	trace_selected     = 1;
+}
+
+/**
+ * @brief This function adds the bytes sent to the entry in progress, the first
+ * SPI_TRACE_CMD_BYTES of them are kept.
+ * @param data: The bytes, NULL for dummy bytes.
+ * @param size: Their number.
+ */
+void spi_trace_tx(const uint8_t *data, uint32_t size)
+{
+	for (uint32_t i = 0; data && i < size && trace_tx_bytes + i < SPI_TRACE_CMD_BYTES; i++) {
+		trace_cur.cmd[trace_tx_bytes + i] = data[i];
+	}
+	trace_tx_bytes += size;
+}
+
+/**
+ * @brief This function ends the entry and puts it in the ring, SPIx_disable_slave calls it.
+ * A deselect without a select (SPIx_init) is ignored.
+ */
+void spi_trace_deselect(void)
+{
+	if (!trace_selected) {
+		return;
+	}
+	trace_selected = 0;
+
+	trace_cur.hold_cycles = (uint32_t)TIMEBASE_CYCCNT() - trace_t0;
+	trace_cur.tx_bytes    = (trace_tx_bytes > 0xFFFFU) ? 0xFFFFU : (uint16_t)trace_tx_bytes;
+	trace_cur.rx_bytes    = (spi_trace_rx_bytes > 0xFFFFU) ? 0xFFFFU : (uint16_t)spi_trace_rx_bytes;
+
+	trace_ring[trace_head] = trace_cur;
+	trace_head = (trace_head + 1U) % SPI_TRACE_DEPTH;
+	if (trace_count < SPI_TRACE_DEPTH) {
+		trace_count++;
+	} else {
+		trace_lost++;
+	}
+}
+
+/**
+ * @brief This function empties the ring.
+ */
+void spi_trace_reset(void)
+{
+	trace_head     = 0;
+	trace_count    = 0;
+	trace_lost     = 0;
+	trace_selected = 0;
+}
+
+/**
+ * @brief This function returns the number of entries in the ring.
+ */
+uint32_t spi_trace_count(void)
+{
+	return trace_count;
+}
+
+/**
+ * @brief This function writes the header and the entries, oldest first. The output
+ * function sends the bytes, for example with USARTx_transmit() on the target or fwrite()
+ * on the host. Dump with the bus idle, a transaction during the dump may overwrite the
+ * oldest entries.
+ * @param out: Called with consecutive pieces of the stream.
+ */
+void spi_trace_dump(void (*out)(const void *data, uint32_t size))
+{
+	spi_trace_hdr_t hdr;
+	uint32_t first = (trace_head + SPI_TRACE_DEPTH - trace_count) % SPI_TRACE_DEPTH;
+
+	hdr.magic    = SPI_TRACE_MAGIC;
+	hdr.version  = SPI_TRACE_VERSION;
+	hdr.rec_size = sizeof(spi_trace_rec_t);
+	hdr.core_hz  = SystemCoreClock;
+	hdr.records  = trace_count;
+	hdr.lost     = trace_lost;
+	out(&hdr, sizeof(hdr));
+
+	for (uint32_t i = 0; i < trace_count; i++) {
+		out(&trace_ring[(first + i) % SPI_TRACE_DEPTH], sizeof(spi_trace_rec_t));
+	}
+}
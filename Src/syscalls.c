@@ -29,6 +29,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include "prof.h"
 
 
 /* Variables */
@@ -82,10 +83,12 @@ __attribute__((weak)) int _write(int file, char *ptr, int len)
   (void)file;
   int DataIdx;
 
+  PROF_BEGIN(PROF_PRINTF);
   for (DataIdx = 0; DataIdx < len; DataIdx++)
   {
     __io_putchar(*ptr++);
   }
+  PROF_END(PROF_PRINTF);
   return len;
 }
 
@@ -7,6 +7,9 @@
 
 
 #include "system_init.h"
+#include "spi.h"
+#include "uart.h"
+#include "pc_sample.h"
 
 
 void rcc_init(void)
@@ -15,13 +18,13 @@ void rcc_init(void)
 	SET_BIT(RCC->CR, RCC_CR_HSION);
 
 	/*Wait until the clock is ready*/
-	while (!READ_BIT(RCC->CR, RCC_CR_HSIRDY)) {}
+	RCC_WAIT_UNTIL(READ_BIT(RCC->CR, RCC_CR_HSIRDY));
 
 	/*Select the HSI as system core clock*/
 	MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, (0x01<<RCC_CFGR_SW_Pos));
 
 	/*Wait for HSI to be the system clock*/
-	while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI) {}
+	RCC_WAIT_UNTIL((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_HSI);
 
 	/*Update the SystemCoreClock variable. This is for debugging.
 	 * Copy the below parameter to live expressions and see the
@@ -29,29 +32,145 @@ void rcc_init(void)
 	SystemCoreClockUpdate();
 }
 
-/*
- * Our clock is HSI = 16MHz. It means that we have 16 000 000  cycles per seconds.
- * 1ms = 1000 seconds, that means we shall divide the FCLK / 16000 because 16 000 000 / 16 000 = 1000.
- * Loading that value to SysTick Reload register we are going to have an "interrupr" into the COUNTFLAG every 1 ms.
+uint32_t rcc_profile_hz(clock_profile_t profile)
+{
+	switch (profile) {
+	case CLOCK_HSI_16MHZ:
+		return 16000000U;
+	case CLOCK_MSI_48MHZ:
+		return 48000000U;
+	case CLOCK_PLL_80MHZ:
+		return 80000000U;
+	default:
+		return 0;
+	}
+}
+
+uint32_t rcc_flash_latency(uint32_t hz)
+{
+	/*One more wait state for every 16MHz step (0WS up to 16MHz, ..., 4WS up to 80MHz)*/
+	return (hz - 1U) / FLASH_WS_STEP_HZ;
+}
+
+/**
+ * @brief Set the flash wait states and wait until the new value is taken into account.
  */
-void delay_ms(int delay)
+static void rcc_set_latency(uint32_t latency)
+{
+	MODIFY_REG(FLASH->ACR, FLASH_ACR_LATENCY, latency << FLASH_ACR_LATENCY_Pos);
+
+	RCC_WAIT_UNTIL((READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos) == latency);
+}
+
+/**
+ * @brief Reprogram the enabled SPI/USART peripherals and the sampling timer after a
+ * SYSCLK change. The APB prescalers are 1, so all of them run from SYSCLK.
+ */
+static void rcc_propagate(uint32_t old_hz, uint32_t new_hz)
 {
+	SPI_TypeDef *spi[] = { SPI1, SPI2, SPI3 };
+	USART_TypeDef *usart[] = { USART1, USART2, USART3 };
+	uint32_t baud;
 
-	/*Load the starting value of SysTick counter*/
-	SysTick->LOAD = 16000 - 1;
+	for (uint32_t i = 0; i < 3; i++) {
+		if (READ_BIT(spi[i]->CR1, SPI_CR1_SPE)) {
+			SPIx_set_clock(spi[i]);
+		}
+	}
+
+	for (uint32_t i = 0; i < 3; i++) {
+		if (READ_BIT(usart[i]->CR1, USART_CR1_UE) && usart[i]->BRR) {
+			/*Keep the bit rate the peripheral was programmed with. BRR rounds it
+			 * down, so it is derived from BRR only when it was set elsewhere*/
+			baud = USARTx_get_baudrate(usart[i]);
+			if (baud == 0) {
+				baud = old_hz / usart[i]->BRR;
+			}
+			USARTx_set_baudrate(usart[i], baud, new_hz);
+		}
+	}
 
-	/*Clear the previous value if any*/
-	SysTick->VAL = 0;
+	pc_sample_set_clock();
+}
+
+uint16_t rcc_set_profile(clock_profile_t profile)
+{
+	uint32_t old_hz = SystemCoreClock;
+	uint32_t new_hz = rcc_profile_hz(profile);
+	uint32_t latency;
+
+	if (new_hz == 0) {
+		return 0;
+	}
 
-	/*Select the internal clock source of the SysTick timer*/
-	SET_BIT(SysTick->CTRL, SYSTICK_CLK_SRC);
+	latency = rcc_flash_latency(new_hz);
 
-	/*Enable the SysTick timer*/
-	SET_BIT(SysTick->CTRL, SYSTICK_ENABLE);
+	/*Account the cycles counted so far with the old frequency*/
+	(void)timebase_us();
 
-	for (uint16_t i=0; i < delay; i++) {
+	/*Voltage range 1 (up to 80MHz). The PWR clock is needed to access the register*/
+	SET_BIT(RCC->APB1ENR1, RCC_APB1ENR1_PWREN);
+	MODIFY_REG(PWR->CR1, PWR_CR1_VOS, PWR_CR1_VOS_0);
+	RCC_WAIT_UNTIL(!READ_BIT(PWR->SR2, PWR_SR2_VOSF));
 
-		/*Wait for the COUNTFLAG to set*/
-		while (!READ_BIT(SysTick->CTRL, SYSTICK_CTN_FLAG)) {}
+	/*Enable the ART accelerator: prefetch, instruction and data cache*/
+	SET_BIT(FLASH->ACR, FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+
+	/*Going up, the wait states must be increased before the switch*/
+	if (latency > (READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos)) {
+		rcc_set_latency(latency);
+	}
+
+	/*Run from HSI16 while the other sources are reconfigured*/
+	rcc_init();
+
+	if (profile == CLOCK_MSI_48MHZ) {
+		/*MSI range 11 (48MHz), selected by MSIRANGE in RCC_CR*/
+		SET_BIT(RCC->CR, RCC_CR_MSION);
+		RCC_WAIT_UNTIL(READ_BIT(RCC->CR, RCC_CR_MSIRDY));
+		MODIFY_REG(RCC->CR, RCC_CR_MSIRANGE, RCC_CR_MSIRANGE_11);
+		SET_BIT(RCC->CR, RCC_CR_MSIRGSEL);
+		RCC_WAIT_UNTIL(READ_BIT(RCC->CR, RCC_CR_MSIRDY));
+
+		/*Select the MSI as system core clock*/
+		MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, (0x00<<RCC_CFGR_SW_Pos));
+		RCC_WAIT_UNTIL((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_MSI);
+	} else if (profile == CLOCK_PLL_80MHZ) {
+		/*The PLL can be configured only while it is off*/
+		CLEAR_BIT(RCC->CR, RCC_CR_PLLON);
+		RCC_WAIT_UNTIL(!READ_BIT(RCC->CR, RCC_CR_PLLRDY));
+
+		/*HSI16 / M(1) * N(10) = 160MHz VCO, / R(2) = 80MHz*/
+		WRITE_REG(RCC->PLLCFGR, RCC_PLLCFGR_PLLSRC_HSI | (0x00 << RCC_PLLCFGR_PLLM_Pos) |
+				  (10U << RCC_PLLCFGR_PLLN_Pos) | (0x00 << RCC_PLLCFGR_PLLR_Pos) | RCC_PLLCFGR_PLLREN);
+
+		SET_BIT(RCC->CR, RCC_CR_PLLON);
+		RCC_WAIT_UNTIL(READ_BIT(RCC->CR, RCC_CR_PLLRDY));
+
+		/*Select the PLL as system core clock*/
+		MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, (0x03<<RCC_CFGR_SW_Pos));
+		RCC_WAIT_UNTIL((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL);
+	}
+
+	/*Going down, the wait states can be decreased after the switch*/
+	if (latency < (READ_BIT(FLASH->ACR, FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos)) {
+		rcc_set_latency(latency);
+	}
+
+	SystemCoreClockUpdate();
+
+	rcc_propagate(old_hz, SystemCoreClock);
+
+	return 1;
+}
+
+/*
+ * The delay runs on the DWT cycle counter through the time base, so the SysTick
+ * timer is left free and the delay holds for every clock profile.
+ */
+void delay_ms(int delay)
+{
+	for (int i = 0; i < delay; i++) {
+		delay_us(1000U);
 	}
 }
@@ -0,0 +1,81 @@
+/*
+ * timebase.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: ngrigoriadis
+ */
+
+
+#include "timebase.h"
+
+
+/*CYCCNT value the clock was last extended at*/
+static uint32_t tb_last_cyc;
+
+/*Microseconds counted so far and the cycles left over (less than one microsecond)*/
+static uint32_t tb_us;
+static uint32_t tb_rem_cyc;
+
+
+void timebase_init(void)
+{
+	/*Enable the trace block, the DWT is not clocked otherwise*/
+	SET_BIT(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+
+	/*Start the cycle counter from zero*/
+	DWT->CYCCNT = 0;
+	SET_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk);
+
+	tb_last_cyc = TIMEBASE_CYCCNT();
+	tb_us       = 0;
+	tb_rem_cyc  = 0;
+}
+
+uint32_t timebase_us(void)
+{
+	uint32_t now, elapsed;
+	uint32_t cyc_per_us = SystemCoreClock / 1000000U;
+
+	/*Start the counter on first use, so delays work before timebase_init()*/
+	if (!READ_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk)) {
+		timebase_init();
+	}
+
+	now = TIMEBASE_CYCCNT();
+	elapsed = now - tb_last_cyc;
+
+	tb_last_cyc = now;
+
+	/*Split first, so the sum with the left over cycles cannot overflow*/
+	tb_us      += elapsed / cyc_per_us;
+	tb_rem_cyc += elapsed % cyc_per_us;
+	if (tb_rem_cyc >= cyc_per_us) {
+		tb_us      += tb_rem_cyc / cyc_per_us;
+		tb_rem_cyc %= cyc_per_us;
+	}
+
+	return tb_us;
+}
+
+uint32_t timebase_elapsed_us(uint32_t since)
+{
+	return timebase_us() - since;
+}
+
+deadline_t timebase_deadline(uint32_t timeout_us)
+{
+	return timebase_us() + timeout_us;
+}
+
+int timebase_expired(deadline_t deadline)
+{
+	/*Signed difference, it holds across the wrap of the counter*/
+	return ((int32_t)(timebase_us() - deadline) >= 0) ? 1 : 0;
+}
+
+void delay_us(uint32_t us)
+{
+	deadline_t deadline = timebase_deadline(us);
+
+	while (!timebase_expired(deadline)) {}
+}
@@ -11,6 +11,44 @@
 
 #include "uart.h"
 
+/**
+ * @brief State of an asynchronous transmission.
+ */
+typedef struct {
+	const char *data;
+	uint16_t size;
+	uint16_t idx;
+	ev_handler_t handler;
+	void *arg;
+	uint8_t busy;
+}usart_async_t;
+
+/*One transmission at a time for each of USART1-3*/
+static usart_async_t usart_tx[3];
+
+/*Bit rate each of USART1-3 was programmed with, 0 if not set by the driver*/
+static uint32_t usart_baud[3];
+
+/**
+ * @brief Map a peripheral to its state and interrupt line.
+ * @retval The index (0-2), -1 for an unsupported peripheral.
+ */
+static int USARTx_index(USART_TypeDef * USARTx, IRQn_Type *irq)
+{
+	if (USARTx == USART1) {
+		*irq = USART1_IRQn;
+		return 0;
+	} else if (USARTx == USART2) {
+		*irq = USART2_IRQn;
+		return 1;
+	} else if (USARTx == USART3) {
+		*irq = USART3_IRQn;
+		return 2;
+	}
+
+	return -1;
+}
+
 /*
  * USART1-3 have all the features included, so their configuration is common. If you want,
  * to use UART4|UART5|LPUART1, you have to check the reference manual of the micro-controller,
@@ -19,6 +57,8 @@
 void USARTx_init(USART_TypeDef * USARTx, GPIO_TypeDef *GPIOx, int USARTx_GPIO_RX_PIN, int USARTx_GPIO_TX_PIN)
 {
 	uint32_t usart_div;
+	IRQn_Type irq;
+	int idx = USARTx_index(USARTx, &irq);
 
 	/*Initialize USART GPIO pins*/
 	USARTx_gpio_init(GPIOx, USARTx_GPIO_RX_PIN, USARTx_GPIO_TX_PIN);
@@ -55,6 +95,9 @@ void USARTx_init(USART_TypeDef * USARTx, GPIO_TypeDef *GPIOx, int USARTx_GPIO_RX
 	/*Set the BAUDRATE*/
 	usart_div = calculate_u_div(BAUDRATE);
 	WRITE_REG(USARTx->BRR, usart_div);
+	if (idx >= 0) {
+		usart_baud[idx] = BAUDRATE;
+	}
 
 	/*Enable the transmitter*/
 	SET_BIT(USARTx->CR1, USART_CR1_TE);
@@ -68,7 +111,33 @@ void USARTx_init(USART_TypeDef * USARTx, GPIO_TypeDef *GPIOx, int USARTx_GPIO_RX
 
 uint32_t calculate_u_div(uint32_t bd)
 {
-	return (SYSTEM_CLK/bd);
+	return (SystemCoreClock/bd);
+}
+
+void USARTx_set_baudrate(USART_TypeDef * USARTx, uint32_t bd, uint32_t pclk)
+{
+	IRQn_Type irq;
+	int idx = USARTx_index(USARTx, &irq);
+
+	/*Wait for the last frame to leave the shift register*/
+	while (!READ_BIT(USARTx->ISR, USART_ISR_TC)) {}
+
+	/*BRR can only be written while the peripheral is disabled*/
+	CLEAR_BIT(USARTx->CR1, USART_CR1_UE);
+	WRITE_REG(USARTx->BRR, pclk/bd);
+	SET_BIT(USARTx->CR1, USART_CR1_UE);
+
+	if (idx >= 0) {
+		usart_baud[idx] = bd;
+	}
+}
+
+uint32_t USARTx_get_baudrate(USART_TypeDef * USARTx)
+{
+	IRQn_Type irq;
+	int idx = USARTx_index(USARTx, &irq);
+
+	return (idx < 0) ? 0 : usart_baud[idx];
 }
 
 void USARTx_write_byte(USART_TypeDef * USARTx, uint8_t data)
@@ -125,6 +194,61 @@ void USARTx_transmit(USART_TypeDef * USARTx, char *data, uint16_t size)
 	}
 }
 
+int USARTx_transmit_async(USART_TypeDef * USARTx, const char *data, uint16_t size, ev_handler_t handler, void *arg)
+{
+	IRQn_Type irq;
+	int idx = USARTx_index(USARTx, &irq);
+
+	if (idx < 0 || usart_tx[idx].busy) {
+		return 0;
+	}
+
+	usart_tx[idx].data    = data;
+	usart_tx[idx].size    = size;
+	usart_tx[idx].idx     = 0;
+	usart_tx[idx].handler = handler;
+	usart_tx[idx].arg     = arg;
+	usart_tx[idx].busy    = 1;
+
+	/*The TXE interrupt loads the frames, starting with the first one*/
+	NVIC_EnableIRQ(irq);
+	SET_BIT(USARTx->CR1, USART_CR1_TXEIE);
+
+	return 1;
+}
+
+void USARTx_irq_handler(USART_TypeDef * USARTx)
+{
+	IRQn_Type irq;
+	int idx = USARTx_index(USARTx, &irq);
+	usart_async_t *tx;
+
+	if (idx < 0) {
+		return;
+	}
+	tx = &usart_tx[idx];
+
+	if (READ_BIT(USARTx->CR1, USART_CR1_TXEIE) && READ_BIT(USARTx->ISR, USART_ISR_TXE)) {
+		if (tx->idx < tx->size) {
+			/*Load the next frame to TDR*/
+			USARTx->TDR = (tx->data[tx->idx++] & 0xFF);
+		} else {
+			/*All the frames are loaded, wait for the last one to leave the shift register*/
+			CLEAR_BIT(USARTx->CR1, USART_CR1_TXEIE);
+			SET_BIT(USARTx->CR1, USART_CR1_TCIE);
+		}
+	}
+
+	if (READ_BIT(USARTx->CR1, USART_CR1_TCIE) && READ_BIT(USARTx->ISR, USART_ISR_TC)) {
+		CLEAR_BIT(USARTx->CR1, USART_CR1_TCIE);
+		tx->busy = 0;
+
+		if (tx->handler) {
+			evloop_post(tx->handler, tx->arg, tx->size);
+		}
+	}
+}
+
 void USARTx_deinit(USART_TypeDef *USARTx)
 {
 	/*Disable USARTx peripheral*/